@@ -0,0 +1,51 @@
+#!/bin/bash
+
+# build_tools.sh
+#   This script builds the native tools lib/c_lib/tools/*.cpp for the
+#   current lib/c_lib/model.hpp and copies them into the current folder
+#
+# USAGE
+#   build_tools.sh [TOOL...]
+#
+#   Builds all tools if no TOOL (e.g. normalization_integral) is given.
+#   The compiler may be set with CXX (default: clang++, as in
+#   lib/c_lib/py_wrapper/setup.py), the target with ARCH (default:
+#   -march=native, which enables the AVX2/AVX-512 phase space kernels
+#   of lib/c_lib/fct/valid_mask.hpp; use e.g. ARCH=-march=x86-64 for
+#   portable binaries).
+
+
+###### FUNCTIONS
+function cdmeson_deca
+{
+  while [[ $PWD != '/' && ${PWD##*/} != 'meson_deca' ]]; do cd ..; done
+}
+
+###### MAIN
+# Define model directory, meson_deca directory and CmdStan directory
+MODEL_FOLDER=$(pwd)
+cdmeson_deca
+MESON_DECA=$(pwd)
+CMDSTAN=$(dirname "$MESON_DECA")
+
+CXX=${CXX:-clang++}
+ARCH=${ARCH:--march=native}
+FLAGS="-O3 -std=c++11 -pthread -DNDEBUG $ARCH"
+INCLUDES="-isystem $CMDSTAN/stan/lib/boost_1.55.0 -isystem $CMDSTAN/stan/lib/eigen_3.2.4 -I $CMDSTAN/stan/src -I $CMDSTAN"
+
+# Models with incoherent background define MESON_DECA_HAS_BACKGROUND
+if grep -q "^#define MESON_DECA_HAS_BACKGROUND" "$MESON_DECA/lib/c_lib/model.hpp"; then
+  FLAGS="$FLAGS -DMESON_DECA_BACKGROUND"
+fi
+
+TOOLS="$@"
+if [[ -z $TOOLS ]]; then
+  TOOLS=$(cd "$MESON_DECA/lib/c_lib/tools" && ls *.cpp | sed "s@\.cpp@@")
+fi
+
+for TOOL in $TOOLS
+do
+  echo "#### MESON_DECA: Building $TOOL..."
+  $CXX $FLAGS $INCLUDES "$MESON_DECA/lib/c_lib/tools/$TOOL.cpp" -o "$MODEL_FOLDER/$TOOL" || exit 1
+done
+cd "$MODEL_FOLDER"
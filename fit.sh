@@ -17,6 +17,9 @@ cdmeson_deca
 MDECA_DIR=$PWD
 cd $MODEL_DIR
 
+# Threads per chain for the likelihood (3 chains run in parallel)
+export MESON_DECA_NUM_THREADS=${MESON_DECA_NUM_THREADS:-$(( $(nproc) / 3 > 0 ? $(nproc) / 3 : 1 ))}
+
 # Do fitting and plot the results
 # (Sample 4 chains)
 for i in {1..3}
@@ -2,9 +2,10 @@
 
 # generate.sh NUM_SAMPLES
 #
-# Generate the data using STAN_data_generator executable, with
-# NUM_SAMPLES events. The samples are converted to a '.root' file 
-# and to model-dependent '.data.R' file for future analysis.
+# Generate the data using STAN_data_generator executable (or the
+# native tool generate_events, if built), with NUM_SAMPLES events.
+# The samples are converted to a '.root' file and to model-dependent
+# '.data.R' file for future analysis.
 #
 # CAVEAT: run from the model folder.
 
@@ -22,7 +23,13 @@ MDECA_DIR=$PWD
 cd $MODEL_DIR
 
 # Generate and plot data
-./STAN_data_generator sample num_samples=$1 data file=STAN_data_generator.data.R output file=generated_data.csv
+if [[ -x ./generate_events ]]; then
+  # Native tool (build_tools.sh generate_events): independent events,
+  # see lib/c_lib/tools/generate_events.cpp
+  ./generate_events --events $1 --data STAN_data_generator.data.R --output generated_data.csv || exit 1
+else
+  ./STAN_data_generator sample num_samples=$1 data file=STAN_data_generator.data.R output file=generated_data.csv
+fi
 $MDECA_DIR/utils/plot_2d_csv.py generated_data.csv generated_data.pdf
 
 
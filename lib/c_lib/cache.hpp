@@ -0,0 +1,36 @@
+#ifndef MESON_DECA__LIB__C_LIB__CACHE_HPP
+#define MESON_DECA__LIB__C_LIB__CACHE_HPP
+
+#include <meson_deca/lib/c_lib/cache/amplitudes.hpp>
+#include <meson_deca/lib/c_lib/cache/columns.hpp>
+#include <meson_deca/lib/c_lib/cache/fingerprint.hpp>
+#include <meson_deca/lib/c_lib/cache/hash.hpp>
+#include <meson_deca/lib/c_lib/cache/integral.hpp>
+#include <meson_deca/lib/c_lib/cache/store.hpp>
+
+/*
+ *  On-disk cache of precomputed amplitudes and normalization integrals.
+ *
+ *  DESCRIPTION
+ *    The pipeline recomputes normalization_integral.py and the
+ *    amplitudes A_cv of every event on each run, even if neither the
+ *    model nor the events changed. The native tools (lib/c_lib/tools,
+ *    option --cache DIR) keep these results in a content-addressed
+ *    store (store.hpp): the key of every entry I[i,j] and of every
+ *    amplitude column A_r(y_1..y_D) is a hash of the fingerprints of
+ *    the resonances involved (fingerprint.hpp) and of the integration
+ *    settings or the event file. A change of one resonance parameter
+ *    thus misses exactly the entries of that resonance.
+ *
+ *    Loading is a read of the raw doubles, i.e. milliseconds.
+ *
+ *    During sampling with floating lineshape parameters, columns.hpp
+ *    keeps the amplitude columns in memory, keyed on the parameter
+ *    values of their resonance.
+ *
+ *  FUNCTIONS
+ *    Are currently listed in particular files - amplitudes.hpp,
+ *    columns.hpp, fingerprint.hpp, hash.hpp, integral.hpp, store.hpp.
+ */
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef MESON_DECA__LIB__C_LIB__CACHE__AMPLITUDES_HPP
+#define MESON_DECA__LIB__C_LIB__CACHE__AMPLITUDES_HPP
+
+#include <stan/math/prim/mat/fun/Eigen.hpp>
+#include <algorithm> // std::min
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <meson_deca/lib/c_lib/cache/fingerprint.hpp>
+#include <meson_deca/lib/c_lib/cache/hash.hpp>
+#include <meson_deca/lib/c_lib/cache/store.hpp>
+#include <meson_deca/lib/c_lib/complex/matrix.hpp>
+#include <meson_deca/lib/c_lib/parallel/thread_pool.hpp>
+
+/*
+ *  Cached per-event amplitudes.
+ *
+ *  DESCRIPTION
+ *    The amplitudes A_r(y_d) of all events d form one column per
+ *    resonance (and per background amplitude); every column is cached
+ *    under the key (fingerprint of A_r, hash of the event file). If
+ *    only some columns are missing, the model is evaluated once for all
+ *    events and the missing columns are saved.
+ *
+ *  TYPES
+ *    amplitude_columns
+ *
+ *  FUNCTIONS
+ *    amplitude_columns evaluate(model, events)
+ *    amplitude_columns amplitudes(model, events, events_key, fp, store)
+ */
+
+namespace cache {
+
+  // Events per task of evaluate()
+  const int events_per_task = 1024;
+
+
+  /**
+   * amplitude_columns
+   *
+   * A_re(d,r) + i A_im(d,r) = A_r(y_d), A_bkg(d,b); zero for events
+   * outside the phase space.
+   */
+  struct amplitude_columns {
+    Eigen::MatrixXd re;
+    Eigen::MatrixXd im;
+    Eigen::MatrixXd bkg;
+  };
+
+
+  inline uint64_t
+  amplitude_key(uint64_t fp_r, uint64_t events_key) {
+    return hasher().add(std::string("A")).add(fp_r).add(events_key).value();
+  }
+
+  inline uint64_t
+  background_amplitude_key(uint64_t fp_b, uint64_t events_key) {
+    return hasher().add(std::string("A_bkg")).add(fp_b).add(events_key).value();
+  }
+
+
+  /**
+   * amplitude_columns evaluate(model, events)
+   *
+   * The amplitudes of all events, on the parallel::pool() threads; every
+   * task evaluates its events inside the phase space in one batch.
+   *
+   * @tparam F Amplitude model, see integrate::plain()
+   */
+  template <typename F>
+  inline amplitude_columns
+  evaluate(const F& model, const std::vector<Eigen::VectorXd>& events) {
+    int D = events.size();
+    amplitude_columns res;
+    res.re.setZero(D, model.num_resonances());
+    res.im.setZero(D, model.num_resonances());
+    res.bkg.setZero(D, model.num_background());
+
+    int n_tasks = (D + events_per_task - 1) / events_per_task;
+    parallel::pool()->run(n_tasks, [&](int t) {
+        // Contiguous copy of the events inside the phase space
+        std::vector<int> index;
+        std::vector<double> y;
+        int end = std::min(D, (t + 1) * events_per_task);
+        for (int d = t * events_per_task; d < end; d++) {
+          if (!model.in_phase_space(events[d]))
+            continue;
+          index.push_back(d);
+          y.insert(y.end(), events[d].data(), events[d].data() + events[d].rows());
+        }
+        if (index.empty())
+          return;
+
+        complex::split_matrix A;
+        Eigen::MatrixXd A_bkg;
+        model.batch(&y[0], index.size(), A, A_bkg);
+        for (int r = 0; r < A.rows(); r++) {
+          for (size_t k = 0; k < index.size(); k++) {
+            res.re(index[k], r) = A.re(r)[k];
+            res.im(index[k], r) = A.im(r)[k];
+          }
+        }
+        for (size_t k = 0; k < index.size(); k++)
+          res.bkg.row(index[k]) = A_bkg.col(k).transpose();
+      });
+    return res;
+  }
+
+
+  /**
+   * amplitude_columns amplitudes(model, events, events_key, fp, store)
+   *
+   * Loads the amplitudes of the events (whose file has the hash
+   * events_key) from store or evaluates them and saves the missing
+   * columns. fp are the fingerprints of the model.
+   *
+   * @tparam F Amplitude model, see integrate::plain()
+   */
+  template <typename F>
+  inline amplitude_columns
+  amplitudes(const F& model, const std::vector<Eigen::VectorXd>& events,
+             uint64_t events_key, const fingerprints& fp, const store& cache) {
+
+    int D = events.size();
+    int R = fp.resonance.size();
+    int B = fp.background.size();
+    amplitude_columns res;
+    res.re.resize(D, R);
+    res.im.resize(D, R);
+    res.bkg.resize(D, B);
+
+    // Resonance column: re(0..D-1), im(0..D-1)
+    std::vector<bool> missing(R + B, false);
+    bool complete = true;
+    std::vector<double> c;
+    for (int r = 0; r < R; r++) {
+      if (cache.load(amplitude_key(fp.resonance[r], events_key), c)
+          && (int) c.size() == 2 * D) {
+        res.re.col(r) = Eigen::Map<Eigen::VectorXd>(&c[0], D);
+        res.im.col(r) = Eigen::Map<Eigen::VectorXd>(&c[D], D);
+      } else {
+        missing[r] = true;
+        complete = false;
+      }
+    }
+    for (int b = 0; b < B; b++) {
+      if (cache.load(background_amplitude_key(fp.background[b], events_key), c)
+          && (int) c.size() == D) {
+        res.bkg.col(b) = Eigen::Map<Eigen::VectorXd>(&c[0], D);
+      } else {
+        missing[R + b] = true;
+        complete = false;
+      }
+    }
+    if (complete || D == 0)
+      return res;
+
+    res = evaluate(model, events);
+    for (int r = 0; r < R; r++) {
+      if (!missing[r])
+        continue;
+      c.resize(2 * D);
+      Eigen::Map<Eigen::VectorXd>(&c[0], D) = res.re.col(r);
+      Eigen::Map<Eigen::VectorXd>(&c[D], D) = res.im.col(r);
+      cache.save(amplitude_key(fp.resonance[r], events_key), c);
+    }
+    for (int b = 0; b < B; b++) {
+      if (!missing[R + b])
+        continue;
+      c.resize(D);
+      Eigen::Map<Eigen::VectorXd>(&c[0], D) = res.bkg.col(b);
+      cache.save(background_amplitude_key(fp.background[b], events_key), c);
+    }
+    return res;
+  }
+
+}
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef MESON_DECA__LIB__C_LIB__CACHE__COLUMNS_HPP
+#define MESON_DECA__LIB__C_LIB__CACHE__COLUMNS_HPP
+
+#include <vector>
+
+#include <meson_deca/lib/c_lib/complex/scalar.hpp>
+#include <meson_deca/lib/c_lib/likelihood/gradient.hpp>
+
+/*
+ *  In-memory amplitude columns keyed on resonance parameters.
+ *
+ *  DESCRIPTION
+ *    With floating lineshape parameters, the amplitudes A_r(y_d) of the
+ *    (fixed) events of a fit are recomputed at every gradient
+ *    evaluation. But the columns of the resonances with fixed
+ *    parameters never change, and a rejected HMC proposal returns the
+ *    sampler to parameters it has already seen. A column_cache keeps,
+ *    per resonance, the last columns together with the parameter
+ *    values they were computed with; column() recomputes a column only
+ *    for parameter values it does not hold.
+ *
+ *    A column holds A_r and its partial derivatives with respect to
+ *    the parameters (in double precision), so a hit also serves
+ *    autodiff parameters: column() attaches the cached partials to the
+ *    parameters of the current tape (one node per real and imaginary
+ *    part). Columns are computed by kernels with analytic partials,
+ *    e.g. resonances::breit_wigner::partials on the invariants of the
+ *    events (structures/three_body/invariants.hpp):
+ *
+ *      cache::column_cache columns(R);  // with the events
+ *      ...
+ *      std::vector<T> p = {M, W};       // per gradient evaluation
+ *      cache::column(columns, r, p, D,
+ *        [&](const double* p, complex_scalar<double>* A,
+ *            complex_scalar<double>* dA) {
+ *          rho_770.partials(inv.ab, p[0], p[1], A, dA, false);
+ *          rho_770.partials(inv.cb, p[0], p[1], A, dA, true);
+ *        }, res);
+ *
+ *    A resonance with fixed parameters has an empty parameter vector,
+ *    i.e. it is computed once. A cache belongs to one set of events
+ *    and is not thread-safe. A_cv_events of d_to_3pi_model_dep (mass
+ *    and width of rho_770 floating) is built this way.
+ *
+ *  TYPES
+ *    column_cache
+ *
+ *  FUNCTIONS
+ *    void column(column_cache, r, params, D, kernel, res)
+ */
+
+namespace cache {
+
+  /**
+   * column_cache
+   *
+   * Up to 'slots' columns per resonance r = 0 .. R - 1; a miss
+   * replaces the least recently used column of r. hits() and misses()
+   * count the lookups.
+   */
+  class column_cache {
+  public:
+
+    struct column {
+      std::vector<double> params; // Tag: parameter values
+      std::vector<complex::complex_scalar<double> > A;  // A[d]
+      std::vector<complex::complex_scalar<double> > dA; // dA[P d + k] = d A[d] / d params[k]
+      long last_use;
+    };
+
+    column_cache(int R, int slots = 2) :
+      columns_(R), slots_(slots), clock_(0), hits_(0), misses_(0) {};
+
+    /**
+     * const column& get(r, params, D, kernel)
+     *
+     * The column of resonance r at params for D events. On a miss,
+     * kernel(p, A, dA) computes it, with the layout of column.
+     */
+    template <typename Kernel>
+    const column& get(int r, const std::vector<double>& params, int D,
+                      const Kernel& kernel) {
+      std::vector<column>& cols = columns_[r];
+      clock_++;
+      for (size_t i = 0; i < cols.size(); i++) {
+        if (cols[i].params == params && (int) cols[i].A.size() == D) {
+          hits_++;
+          cols[i].last_use = clock_;
+          return cols[i];
+        }
+      }
+
+      misses_++;
+      size_t i = cols.size();
+      if ((int) i < slots_) {
+        cols.push_back(column());
+      } else {
+        i = 0;
+        for (size_t j = 1; j < cols.size(); j++)
+          if (cols[j].last_use < cols[i].last_use)
+            i = j;
+      }
+      column& c = cols[i];
+      c.params = params;
+      c.A.resize(D);
+      c.dA.resize(long(D) * params.size());
+      c.last_use = clock_;
+      kernel(params.empty() ? 0 : &params[0], c.A.data(),
+             c.dA.empty() ? 0 : &c.dA[0]);
+      return c;
+    }
+
+    long hits() const {
+      return hits_;
+    }
+
+    long misses() const {
+      return misses_;
+    }
+
+    void reset_counts() {
+      hits_ = 0;
+      misses_ = 0;
+    }
+
+    void clear() {
+      for (size_t r = 0; r < columns_.size(); r++)
+        columns_[r].clear();
+    }
+
+  private:
+    std::vector<std::vector<column> > columns_;
+    int slots_;
+    long clock_, hits_, misses_;
+  };
+
+
+  /**
+   * void column(cache, r, params, D, kernel, res)
+   *
+   * res[d] = A_r(y_d) at the parameters params (double or autodiff),
+   * from the cache or computed by kernel (see column_cache::get).
+   */
+  template <typename T, typename Kernel>
+  inline void
+  column(column_cache& cache, int r, const std::vector<T>& params, int D,
+         const Kernel& kernel, complex::complex_scalar<T>* res) {
+    int P = params.size();
+    std::vector<double> p(P);
+    for (int k = 0; k < P; k++)
+      p[k] = likelihood::value(params[k]);
+
+    const column_cache::column& c = cache.get(r, p, D, kernel);
+    std::vector<complex::complex_scalar<double> > grad(P);
+    for (int d = 0; d < D; d++) {
+      for (int k = 0; k < P; k++)
+        grad[k] = c.dA[long(P) * d + k];
+      res[d] = likelihood::attach_gradients(c.A[d], params, grad);
+    }
+  }
+
+}
+
+#endif
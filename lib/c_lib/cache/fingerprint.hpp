@@ -0,0 +1,114 @@
+#ifndef MESON_DECA__LIB__C_LIB__CACHE__FINGERPRINT_HPP
+#define MESON_DECA__LIB__C_LIB__CACHE__FINGERPRINT_HPP
+
+#include <stan/math/prim/mat/fun/Eigen.hpp>
+#include <stdint.h>
+#include <vector>
+
+#include <meson_deca/lib/c_lib/cache/hash.hpp>
+#include <meson_deca/lib/c_lib/rng/stream.hpp>
+
+/*
+ *  Fingerprints of the model amplitudes.
+ *
+ *  DESCRIPTION
+ *    A cached artifact must be invalidated whenever the definition of
+ *    a resonance changes: its entry in the resonance list of model.hpp,
+ *    the constants of its particles (structures/particles.hpp) or its
+ *    width (structures/resonances.hpp). The compiled tools can not read
+ *    these sources, but they can evaluate them: the fingerprint of
+ *    resonance r hashes the bit patterns of A_r at fixed probe points.
+ *    Changing any parameter of r changes A_r (practically) everywhere,
+ *    hence its fingerprint, and leaves the fingerprints of the other
+ *    resonances untouched - so exactly the artifacts built from A_r are
+ *    invalidated. The same holds for the background amplitudes.
+ *
+ *  TYPES
+ *    fingerprints
+ *
+ *  FUNCTIONS
+ *    std::vector<VectorXd> probe_points(model, map, n_probes)
+ *    fingerprints fingerprint(model, probes)
+ */
+
+namespace cache {
+
+  // Default number of probe points
+  const int num_probes = 64;
+
+
+  /**
+   * fingerprints
+   *
+   * One hash per resonance and per background amplitude.
+   */
+  struct fingerprints {
+    std::vector<uint64_t> resonance;
+    std::vector<uint64_t> background;
+  };
+
+
+  /**
+   * std::vector<VectorXd> probe_points(model, map, n_probes)
+   *
+   * The first n_probes points of map (fixed random numbers) inside the
+   * phase space; gives up after 1000 * n_probes tries.
+   *
+   * @tparam F   Amplitude model, see integrate::plain()
+   * @tparam Map Point map, see integrate::box
+   */
+  template <typename F, typename Map>
+  inline std::vector<Eigen::VectorXd>
+  probe_points(const F& model, const Map& map, int n_probes) {
+    std::vector<Eigen::VectorXd> res;
+    std::vector<double> u(map.dim());
+    Eigen::VectorXd y, A_re, A_im, A_bkg;
+    for (long k = 0; k < 1000L * n_probes && (int) res.size() < n_probes; k++) {
+      rng::uniform(0, k, 1, map.dim(), &u[0], 0, rng::probes);
+      if (map.map(&u[0], y) > 0 && model(y, A_re, A_im, A_bkg))
+        res.push_back(y);
+    }
+    return res;
+  }
+
+
+  /**
+   * fingerprints fingerprint(model, probes)
+   *
+   * Hashes of the amplitudes at the probe points.
+   *
+   * @tparam F Amplitude model, see integrate::plain()
+   */
+  template <typename F>
+  inline fingerprints
+  fingerprint(const F& model, const std::vector<Eigen::VectorXd>& probes) {
+    std::vector<hasher> h_res(model.num_resonances());
+    std::vector<hasher> h_bkg(model.num_background());
+
+    Eigen::VectorXd A_re, A_im, A_bkg;
+    for (size_t k = 0; k < probes.size(); k++) {
+      const Eigen::VectorXd& y = probes[k];
+      bool valid = model(y, A_re, A_im, A_bkg);
+      for (size_t r = 0; r < h_res.size(); r++) {
+        h_res[r].add(y.data(), y.rows() * sizeof(double)).add(uint64_t(valid));
+        if (valid)
+          h_res[r].add(A_re(r)).add(A_im(r));
+      }
+      for (size_t b = 0; b < h_bkg.size(); b++) {
+        h_bkg[b].add(y.data(), y.rows() * sizeof(double)).add(uint64_t(valid));
+        if (valid)
+          h_bkg[b].add(A_bkg(b));
+      }
+    }
+
+    fingerprints res;
+    for (size_t r = 0; r < h_res.size(); r++)
+      res.resonance.push_back(h_res[r].value());
+    for (size_t b = 0; b < h_bkg.size(); b++)
+      res.background.push_back(h_bkg[b].value());
+    return res;
+  }
+
+}
+
+#endif
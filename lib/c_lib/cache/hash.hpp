@@ -0,0 +1,126 @@
+#ifndef MESON_DECA__LIB__C_LIB__CACHE__HASH_HPP
+#define MESON_DECA__LIB__C_LIB__CACHE__HASH_HPP
+
+#include <cstdio>
+#include <cstring> // memcpy
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+
+/*
+ *  64-bit content hashes.
+ *
+ *  DESCRIPTION
+ *    Not cryptographic; the keys only have to tell apart the artifacts
+ *    of one user. Bytes are hashed in 8-byte words (FNV-1a style
+ *    multiply, followed by a final avalanche), so that hashing event
+ *    files of a few GB takes about as long as reading them.
+ *
+ *  TYPES
+ *    hasher
+ *
+ *  FUNCTIONS
+ *    std::string hex(uint64_t)
+ *    uint64_t hash_file(std::string)
+ */
+
+namespace cache {
+
+  /**
+   * hasher
+   *
+   * Incremental hash: add() data in a fixed order, then read value().
+   */
+  class hasher {
+  public:
+    hasher() : h_(14695981039346656037ULL) {};
+
+    hasher& add(const void* data, size_t n) {
+      const unsigned char* p = static_cast<const unsigned char*>(data);
+      for (; n >= 8; n -= 8, p += 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        mix(w);
+      }
+      uint64_t w = 0;
+      memcpy(&w, p, n);
+      mix(w ^ (uint64_t(n) << 56));
+      return *this;
+    }
+
+    hasher& add(uint64_t x) {
+      mix(x);
+      return *this;
+    }
+
+    // Bit pattern of x (0. and -0. differ)
+    hasher& add(double x) {
+      uint64_t w;
+      memcpy(&w, &x, 8);
+      mix(w);
+      return *this;
+    }
+
+    hasher& add(const std::string& s) {
+      add(uint64_t(s.size()));
+      return add(s.data(), s.size());
+    }
+
+    uint64_t value() const {
+      uint64_t h = h_;
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 33;
+      h *= 0xc4ceb9fe1a85ec53ULL;
+      h ^= h >> 33;
+      return h;
+    }
+
+  private:
+    uint64_t h_;
+
+    void mix(uint64_t w) {
+      h_ = (h_ ^ w) * 1099511628211ULL;
+      h_ ^= h_ >> 29;
+    }
+  };
+
+
+  /**
+   * std::string hex(key)
+   *
+   * 16 hexadecimal digits.
+   */
+  inline std::string
+  hex(uint64_t key) {
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", (unsigned long long) key);
+    return buf;
+  }
+
+
+  /**
+   * uint64_t hash_file(path)
+   *
+   * Hash of the contents of a file; throws std::runtime_error if the
+   * file can not be read.
+   */
+  inline uint64_t
+  hash_file(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (f == 0)
+      throw std::runtime_error("hash_file: cannot open " + path);
+
+    hasher h;
+    static const size_t chunk = 1 << 20;
+    std::string buf(chunk, '\0');
+    size_t n;
+    while ((n = fread(&buf[0], 1, chunk, f)) > 0)
+      h.add(&buf[0], n);
+    fclose(f);
+    return h.value();
+  }
+
+}
+
+#endif
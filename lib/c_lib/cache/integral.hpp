@@ -0,0 +1,134 @@
+#ifndef MESON_DECA__LIB__C_LIB__CACHE__INTEGRAL_HPP
+#define MESON_DECA__LIB__C_LIB__CACHE__INTEGRAL_HPP
+
+#include <stan/math/prim/mat/fun/Eigen.hpp>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <meson_deca/lib/c_lib/cache/fingerprint.hpp>
+#include <meson_deca/lib/c_lib/cache/hash.hpp>
+#include <meson_deca/lib/c_lib/cache/store.hpp>
+#include <meson_deca/lib/c_lib/integrate/amplitude_sum.hpp>
+
+/*
+ *  Cached normalization integrals.
+ *
+ *  DESCRIPTION
+ *    Every entry I[i,j] (value, error and number of points) is cached
+ *    under the key (fingerprint of A_i, fingerprint of A_j, settings),
+ *    the background integrals under (fingerprint of A_bkg_b, settings);
+ *    settings is a hash of everything else the estimate depends on
+ *    (bounds, number of points, seed, method).
+ *
+ *    Since the integrators estimate all entries from the same points,
+ *    one missing entry means one integration; its result replaces the
+ *    missing entries only.
+ *
+ *  FUNCTIONS
+ *    normalization_integral integral(fingerprints, settings, store, compute)
+ */
+
+namespace cache {
+
+  inline uint64_t
+  integral_key(uint64_t fp_i, uint64_t fp_j, uint64_t settings) {
+    return hasher().add(std::string("I")).add(fp_i).add(fp_j).add(settings).value();
+  }
+
+  inline uint64_t
+  background_integral_key(uint64_t fp_b, uint64_t settings) {
+    return hasher().add(std::string("I_bkg")).add(fp_b).add(settings).value();
+  }
+
+
+  /**
+   * normalization_integral integral(fp, settings, store, compute)
+   *
+   * Loads the normalization integrals of the amplitudes with the
+   * fingerprints fp from store or, if any entry is missing, calls
+   * compute() and saves the missing entries.
+   *
+   * @tparam Compute Callable integrate::normalization_integral()
+   */
+  template <typename Compute>
+  inline integrate::normalization_integral
+  integral(const fingerprints& fp, uint64_t settings, const store& cache,
+           const Compute& compute) {
+
+    int R = fp.resonance.size();
+    int B = fp.background.size();
+    integrate::normalization_integral res;
+    res.I.assign(2, Eigen::MatrixXd(R, R));
+    res.I_error.assign(2, Eigen::MatrixXd(R, R));
+    res.I_bkg.resize(B);
+    res.I_bkg_error.resize(B);
+    res.n_points = 0;
+    res.n_valid = 0;
+
+    // Entries: value re, im, error re, im, n_points, n_valid
+    std::vector<bool> missing(R * R + B, false);
+    bool complete = true;
+    std::vector<double> e;
+    for (int j = 0; j < R; j++) {
+      for (int i = 0; i < R; i++) {
+        uint64_t key = integral_key(fp.resonance[i], fp.resonance[j], settings);
+        if (cache.load(key, e) && e.size() == 6) {
+          res.I[0](i,j) = e[0];
+          res.I[1](i,j) = e[1];
+          res.I_error[0](i,j) = e[2];
+          res.I_error[1](i,j) = e[3];
+          res.n_points = e[4];
+          res.n_valid = e[5];
+        } else {
+          missing[j * R + i] = true;
+          complete = false;
+        }
+      }
+    }
+    for (int b = 0; b < B; b++) {
+      uint64_t key = background_integral_key(fp.background[b], settings);
+      if (cache.load(key, e) && e.size() == 4) {
+        res.I_bkg(b) = e[0];
+        res.I_bkg_error(b) = e[1];
+        res.n_points = e[2];
+        res.n_valid = e[3];
+      } else {
+        missing[R * R + b] = true;
+        complete = false;
+      }
+    }
+    if (complete)
+      return res;
+
+    res = compute();
+    for (int j = 0; j < R; j++) {
+      for (int i = 0; i < R; i++) {
+        if (!missing[j * R + i])
+          continue;
+        e.resize(6);
+        e[0] = res.I[0](i,j);
+        e[1] = res.I[1](i,j);
+        e[2] = res.I_error[0](i,j);
+        e[3] = res.I_error[1](i,j);
+        e[4] = res.n_points;
+        e[5] = res.n_valid;
+        cache.save(integral_key(fp.resonance[i], fp.resonance[j], settings), e);
+      }
+    }
+    for (int b = 0; b < B; b++) {
+      if (!missing[R * R + b])
+        continue;
+      e.resize(4);
+      e[0] = res.I_bkg(b);
+      e[1] = res.I_bkg_error(b);
+      e[2] = res.n_points;
+      e[3] = res.n_valid;
+      cache.save(background_integral_key(fp.background[b], settings), e);
+    }
+    return res;
+  }
+
+}
+
+#endif
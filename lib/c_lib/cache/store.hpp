@@ -0,0 +1,108 @@
+#ifndef MESON_DECA__LIB__C_LIB__CACHE__STORE_HPP
+#define MESON_DECA__LIB__C_LIB__CACHE__STORE_HPP
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring> // memcmp, memcpy
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <sys/stat.h> // mkdir
+#include <unistd.h> // getpid
+#include <vector>
+
+#include <meson_deca/lib/c_lib/cache/hash.hpp>
+
+/*
+ *  Content-addressed store of double arrays.
+ *
+ *  DESCRIPTION
+ *    Every artifact lives in the file <dir>/<hex(key)>.bin: a 24 byte
+ *    header (magic "MDCACHE1", key, number of doubles) followed by the
+ *    doubles in native byte order. The key is a hash of everything the
+ *    artifact depends on, so a file is never updated: changed inputs
+ *    give a different key, and stale files are simply never read again
+ *    (delete the folder to reclaim the space).
+ *
+ *    Files are written to a temporary name and renamed, so concurrent
+ *    runs and interrupted writes never leave a truncated artifact.
+ *
+ *  TYPES
+ *    store
+ */
+
+namespace cache {
+
+  /**
+   * store
+   *
+   * Folder of cached arrays; counts the hits and misses of load().
+   */
+  class store {
+  public:
+    mutable long hits;
+    mutable long misses;
+
+    // Creates the folder dir (not its parents) if necessary
+    explicit store(const std::string& dir) : hits(0), misses(0), dir_(dir) {
+      if (mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST)
+        throw std::runtime_error("cache::store: cannot create " + dir);
+    }
+
+    std::string path(uint64_t key) const {
+      return dir_ + "/" + hex(key) + ".bin";
+    }
+
+    // Reads the array of key into data; false if it is not cached
+    bool load(uint64_t key, std::vector<double>& data) const {
+      FILE* f = fopen(path(key).c_str(), "rb");
+      bool ok = f != 0;
+      if (ok) {
+        char header[24];
+        uint64_t k, n;
+        ok = fread(header, 1, 24, f) == 24 && memcmp(header, magic(), 8) == 0;
+        memcpy(&k, header + 8, 8);
+        memcpy(&n, header + 16, 8);
+        ok = ok && k == key;
+        if (ok) {
+          data.resize(n);
+          ok = n == 0 || fread(&data[0], sizeof(double), n, f) == n;
+        }
+        fclose(f);
+      }
+      (ok ? hits : misses)++;
+      return ok;
+    }
+
+    void save(uint64_t key, const std::vector<double>& data) const {
+      std::string name = path(key);
+      std::string tmp = name + ".tmp" + std::to_string((long) getpid());
+      FILE* f = fopen(tmp.c_str(), "wb");
+      if (f == 0)
+        throw std::runtime_error("cache::store: cannot write " + tmp);
+
+      char header[24];
+      uint64_t n = data.size();
+      memcpy(header, magic(), 8);
+      memcpy(header + 8, &key, 8);
+      memcpy(header + 16, &n, 8);
+      bool ok = fwrite(header, 1, 24, f) == 24
+        && (n == 0 || fwrite(&data[0], sizeof(double), n, f) == n);
+      ok = fclose(f) == 0 && ok;
+      if (!ok || rename(tmp.c_str(), name.c_str()) != 0) {
+        remove(tmp.c_str());
+        throw std::runtime_error("cache::store: cannot write " + name);
+      }
+    }
+
+  private:
+    std::string dir_;
+
+    static const char* magic() {
+      return "MDCACHE1";
+    }
+  };
+
+}
+
+#endif
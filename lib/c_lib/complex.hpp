@@ -4,13 +4,17 @@
 #include <meson_deca/lib/c_lib/complex/scalar.hpp>
 #include <meson_deca/lib/c_lib/complex/vector.hpp>
 #include <meson_deca/lib/c_lib/complex/matrix.hpp>
+#include <meson_deca/lib/c_lib/complex/expression.hpp>
 
 /*
  *  Introduce complex number operations in a STAN-friendly way.
  *
  *  DESCRIPTION
- *    Complex numbers are described as std::vector<double>
- *    (STAN array of reals; also referred to as 'complex_scalar').
+ *    Complex numbers are described as complex::complex_scalar<T>, a
+ *    fixed-size pair (re, im) that lives on the stack. STAN itself
+ *    still passes complex numbers as std::vector<double> (STAN array
+ *    of reals); complex::scalar::to_array/from_array convert between
+ *    the two representations at the STAN boundary (model.hpp).
  * 
  *    Complex vectors are described as 
  *      std::vector<Eigen::Matrix<double, Eigen::Dynamic, 1> >.
@@ -20,19 +24,28 @@
  *      std::vector<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> >.
  *    (STAN array of matrices; also referred to as 'complex_matrix').
  *
- *    There are no new type definitions for complex-valued objects described
- *    above. None of the operators are overloaded. The reason is that STAN
+ *    The native code evaluates the amplitudes of many events at once
+ *    into a complex::split_matrix (matrix.hpp), an aligned R x D matrix
+ *    with separate real and imaginary parts; it never crosses the STAN
+ *    boundary.
+ *
+ *    Apart from complex_scalar, there are no new type definitions for 
+ *    complex-valued objects described above. None of the operators are 
+ *    overloaded. The reason is that STAN
  *    would not be able to differentiate between a complex vector and an array
- *    of vectors. Therefore, BEWARE the following: under such operators as +, 
- *    *, etc., all complex-valued objects behave as std::vectors. For example,
- *    if you want to multiply two complex numbers, do not use '*' operator, 
- *    but rather the function complex::scalar::mult. But using the operator 
- *    '+' is okay, since (in Cartesian coordinates) the sum of two complex 
- *    numbers is isomorphic to the sum of two vectors.
+ *    of vectors. Therefore, BEWARE the following: complex_scalar has no
+ *    arithmetic operators at all, and under such operators as +, *, etc.
+ *    complex vectors and matrices behave as std::vectors. Combine complex
+ *    numbers with the functions of complex::scalar instead, e.g. add,
+ *    subtract and mult.
  *
  *    Since no new types/classes are really introduced, all distinction between
  *    complex objects is implemented via namespaces. 
  *
+ *    Chains of complex_scalar operations in the kernels may be written
+ *    with complex::expression (expression.hpp), which evaluates them in
+ *    one pass and drops the terms of structurally zero parts.
+ *
  *  FUNCTIONS
  *    Are currently listed in particular files - scalar.hpp, vector.hpp, matrix.hpp.
  */
@@ -0,0 +1,375 @@
+#ifndef MESON_DECA__LIB__C_LIB__COMPLEX__EXPRESSION_HPP
+#define MESON_DECA__LIB__C_LIB__COMPLEX__EXPRESSION_HPP
+
+#include <type_traits> // std::is_base_of, std::declval
+#include <utility>
+
+#include <meson_deca/lib/c_lib/complex/scalar.hpp>
+
+
+/*
+ *  Lazy chains of complex_scalar operations.
+ *
+ *  DESCRIPTION
+ *    A kernel such as fct::flatte::value chains several operations of
+ *    complex::scalar, each returning a complex_scalar temporary, and
+ *    many of the operands are purely real or imaginary (complex(x, 0),
+ *    the factor i); complex::scalar::mult still multiplies their zero
+ *    parts. For T = stan::math::var every such product and sum is a
+ *    node on the autodiff tape.
+ *
+ *    The functions of complex::expression build the chain as a tree of
+ *    small expression objects instead; eval() evaluates it in one pass.
+ *    Every node evaluates its operands once (e.g. inverse computes
+ *    |z|^2 once for both parts), and the real and imaginary parts of a
+ *    node are typed: a part that is structurally zero has the type
+ *    'zero', so the terms it would contribute are dropped at compile
+ *    time. For instance
+ *
+ *      eval(inverse(subtract(M * M - m2,
+ *                            mult(c, times_i(mult(g * g, p))))))
+ *
+ *    computes (M^2 - m2 + c g^2 p.im, - c g^2 p.re) / |.|^2 without a
+ *    single multiplication by 0 or 1. The operations are the same as
+ *    those of complex::scalar in the same order, so for finite values
+ *    the result is identical (up to the sign of zero parts).
+ *
+ *    Operands are complex_scalar<T> (wrapped as they are), real
+ *    scalars (double, var, fvar; imaginary part zero) or expressions.
+ *    Expressions hold their operands by value, so they may outlive
+ *    the temporaries they were built from. As in the rest of
+ *    complex::, no operators are overloaded.
+ *
+ *  TYPES
+ *    zero
+ *
+ *  FUNCTIONS
+ *    expression add(operand, operand)
+ *    expression subtract(operand, operand)
+ *    expression mult(operand, operand)
+ *    expression inverse(operand)
+ *    expression times_i(operand)
+ *    expression real(scalar)
+ *    expression imag(scalar)
+ *    complex_scalar eval(expression)
+ *    scalar abs2(expression)
+ */
+
+
+namespace complex {
+  namespace expression {
+
+    /**
+     * zero
+     *
+     * Type of a part that is structurally zero.
+     */
+    struct zero {};
+
+
+    // Arithmetic on parts; zero absorbs or drops out
+
+    template <typename T0, typename T1>
+    inline auto sum(const T0& a, const T1& b) -> decltype(a + b) { return a + b; }
+    template <typename T>
+    inline T sum(const T& a, zero) { return a; }
+    template <typename T>
+    inline T sum(zero, const T& b) { return b; }
+    inline zero sum(zero, zero) { return zero(); }
+
+    template <typename T0, typename T1>
+    inline auto difference(const T0& a, const T1& b) -> decltype(a - b) { return a - b; }
+    template <typename T>
+    inline T difference(const T& a, zero) { return a; }
+    template <typename T>
+    inline auto difference(zero, const T& b) -> decltype(-b) { return -b; }
+    inline zero difference(zero, zero) { return zero(); }
+
+    template <typename T0, typename T1>
+    inline auto product(const T0& a, const T1& b) -> decltype(a * b) { return a * b; }
+    template <typename T>
+    inline zero product(const T&, zero) { return zero(); }
+    template <typename T>
+    inline zero product(zero, const T&) { return zero(); }
+    inline zero product(zero, zero) { return zero(); }
+
+    template <typename T0, typename T1>
+    inline auto quotient(const T0& a, const T1& b) -> decltype(a / b) { return a / b; }
+    template <typename T>
+    inline zero quotient(zero, const T&) { return zero(); }
+
+    template <typename T>
+    inline auto negative(const T& a) -> decltype(-a) { return -a; }
+    inline zero negative(zero) { return zero(); }
+
+    // Scalar type of a complex number with parts R, I
+    template <typename R, typename I>
+    struct scalar_of {
+      typedef decltype(std::declval<R>() + std::declval<I>()) type;
+    };
+    template <typename R>
+    struct scalar_of<R, zero> { typedef R type; };
+    template <typename I>
+    struct scalar_of<zero, I> { typedef I type; };
+    template <>
+    struct scalar_of<zero, zero> { typedef double type; };
+
+    template <typename T, typename P>
+    inline T to_scalar(const P& p) { return p; }
+    template <typename T>
+    inline T to_scalar(zero) { return T(0.0); }
+
+
+    // Evaluated node: a complex number with typed parts
+    template <typename R, typename I>
+    struct parts {
+      R re;
+      I im;
+      parts(const R& _re, const I& _im) : re(_re), im(_im) {};
+    };
+
+    template <typename R, typename I>
+    inline parts<R, I> make_parts(const R& re, const I& im) {
+      return parts<R, I>(re, im);
+    }
+
+
+    // Base of all expression nodes
+    struct node {};
+
+    template <typename T>
+    struct scalar_node : node {
+      complex_scalar<T> z;
+      explicit scalar_node(const complex_scalar<T>& _z) : z(_z) {};
+      parts<T, T> eval() const { return parts<T, T>(z.re, z.im); }
+    };
+
+    template <typename T>
+    struct real_node : node {
+      T x;
+      explicit real_node(const T& _x) : x(_x) {};
+      parts<T, zero> eval() const { return parts<T, zero>(x, zero()); }
+    };
+
+    template <typename T>
+    struct imag_node : node {
+      T x;
+      explicit imag_node(const T& _x) : x(_x) {};
+      parts<zero, T> eval() const { return parts<zero, T>(zero(), x); }
+    };
+
+    // Operand -> node: expressions as they are, complex_scalar wrapped,
+    // anything else is a real scalar
+    template <typename X, bool is_node = std::is_base_of<node, X>::value>
+    struct as_node {
+      typedef real_node<X> type;
+      static type wrap(const X& x) { return type(x); }
+    };
+    template <typename X>
+    struct as_node<X, true> {
+      typedef X type;
+      static const X& wrap(const X& x) { return x; }
+    };
+    template <typename T>
+    struct as_node<complex_scalar<T>, false> {
+      typedef scalar_node<T> type;
+      static type wrap(const complex_scalar<T>& z) { return type(z); }
+    };
+
+    // Parts of a node of type N
+    template <typename N>
+    struct parts_of {
+      typedef decltype(std::declval<const N&>().eval()) type;
+      typedef decltype(std::declval<type>().re) re;
+      typedef decltype(std::declval<type>().im) im;
+    };
+
+    template <typename A, typename B>
+    struct add_node : node {
+      A a;
+      B b;
+      add_node(const A& _a, const B& _b) : a(_a), b(_b) {};
+      typedef typename parts_of<A>::re ar; typedef typename parts_of<A>::im ai;
+      typedef typename parts_of<B>::re br; typedef typename parts_of<B>::im bi;
+      typedef decltype(sum(std::declval<ar>(), std::declval<br>())) re_type;
+      typedef decltype(sum(std::declval<ai>(), std::declval<bi>())) im_type;
+      parts<re_type, im_type> eval() const {
+        typename parts_of<A>::type x = a.eval();
+        typename parts_of<B>::type y = b.eval();
+        return make_parts(sum(x.re, y.re), sum(x.im, y.im));
+      }
+    };
+
+    template <typename A, typename B>
+    struct subtract_node : node {
+      A a;
+      B b;
+      subtract_node(const A& _a, const B& _b) : a(_a), b(_b) {};
+      typedef typename parts_of<A>::re ar; typedef typename parts_of<A>::im ai;
+      typedef typename parts_of<B>::re br; typedef typename parts_of<B>::im bi;
+      typedef decltype(difference(std::declval<ar>(), std::declval<br>())) re_type;
+      typedef decltype(difference(std::declval<ai>(), std::declval<bi>())) im_type;
+      parts<re_type, im_type> eval() const {
+        typename parts_of<A>::type x = a.eval();
+        typename parts_of<B>::type y = b.eval();
+        return make_parts(difference(x.re, y.re), difference(x.im, y.im));
+      }
+    };
+
+    // As complex::scalar::mult: (x.re y.re - x.im y.im, x.im y.re + x.re y.im)
+    template <typename A, typename B>
+    struct mult_node : node {
+      A a;
+      B b;
+      mult_node(const A& _a, const B& _b) : a(_a), b(_b) {};
+      typedef typename parts_of<A>::re ar; typedef typename parts_of<A>::im ai;
+      typedef typename parts_of<B>::re br; typedef typename parts_of<B>::im bi;
+      typedef decltype(difference(product(std::declval<ar>(), std::declval<br>()),
+                                  product(std::declval<ai>(), std::declval<bi>()))) re_type;
+      typedef decltype(sum(product(std::declval<ai>(), std::declval<br>()),
+                           product(std::declval<ar>(), std::declval<bi>()))) im_type;
+      parts<re_type, im_type> eval() const {
+        typename parts_of<A>::type x = a.eval();
+        typename parts_of<B>::type y = b.eval();
+        return make_parts(difference(product(x.re, y.re), product(x.im, y.im)),
+                          sum(product(x.im, y.re), product(x.re, y.im)));
+      }
+    };
+
+    // As complex::scalar::inverse; |z|^2 is computed once
+    template <typename A>
+    struct inverse_node : node {
+      A a;
+      explicit inverse_node(const A& _a) : a(_a) {};
+      typedef typename parts_of<A>::re ar; typedef typename parts_of<A>::im ai;
+      typedef decltype(sum(product(std::declval<ar>(), std::declval<ar>()),
+                           product(std::declval<ai>(), std::declval<ai>()))) norm_type;
+      typedef decltype(quotient(std::declval<ar>(), std::declval<norm_type>())) re_type;
+      typedef decltype(quotient(negative(std::declval<ai>()),
+                                std::declval<norm_type>())) im_type;
+      parts<re_type, im_type> eval() const {
+        typename parts_of<A>::type x = a.eval();
+        norm_type norm = sum(product(x.re, x.re), product(x.im, x.im));
+        return make_parts(quotient(x.re, norm), quotient(negative(x.im), norm));
+      }
+    };
+
+    // i z = (- z.im, z.re), no multiplication
+    template <typename A>
+    struct times_i_node : node {
+      A a;
+      explicit times_i_node(const A& _a) : a(_a) {};
+      typedef typename parts_of<A>::re ar; typedef typename parts_of<A>::im ai;
+      parts<decltype(negative(std::declval<ai>())), ar> eval() const {
+        typename parts_of<A>::type x = a.eval();
+        return make_parts(negative(x.im), x.re);
+      }
+    };
+
+
+    /**
+     * expression add(a, b), subtract(a, b), mult(a, b)
+     *
+     * Lazy a + b, a - b, a * b of two operands (complex_scalar, real
+     * scalar or expression).
+     */
+    template <typename X, typename Y>
+    inline add_node<typename as_node<X>::type, typename as_node<Y>::type>
+    add(const X& a, const Y& b) {
+      return add_node<typename as_node<X>::type, typename as_node<Y>::type>(
+        as_node<X>::wrap(a), as_node<Y>::wrap(b));
+    }
+
+    template <typename X, typename Y>
+    inline subtract_node<typename as_node<X>::type, typename as_node<Y>::type>
+    subtract(const X& a, const Y& b) {
+      return subtract_node<typename as_node<X>::type, typename as_node<Y>::type>(
+        as_node<X>::wrap(a), as_node<Y>::wrap(b));
+    }
+
+    template <typename X, typename Y>
+    inline mult_node<typename as_node<X>::type, typename as_node<Y>::type>
+    mult(const X& a, const Y& b) {
+      return mult_node<typename as_node<X>::type, typename as_node<Y>::type>(
+        as_node<X>::wrap(a), as_node<Y>::wrap(b));
+    }
+
+
+    /**
+     * expression inverse(a), times_i(a)
+     *
+     * Lazy 1 / a and i * a.
+     */
+    template <typename X>
+    inline inverse_node<typename as_node<X>::type>
+    inverse(const X& a) {
+      return inverse_node<typename as_node<X>::type>(as_node<X>::wrap(a));
+    }
+
+    template <typename X>
+    inline times_i_node<typename as_node<X>::type>
+    times_i(const X& a) {
+      return times_i_node<typename as_node<X>::type>(as_node<X>::wrap(a));
+    }
+
+
+    /**
+     * expression real(x), imag(x)
+     *
+     * The complex numbers (x, 0) and (0, x) of a real scalar x.
+     */
+    template <typename T>
+    inline real_node<T> real(const T& x) {
+      return real_node<T>(x);
+    }
+
+    template <typename T>
+    inline imag_node<T> imag(const T& x) {
+      return imag_node<T>(x);
+    }
+
+
+    /**
+     * complex_scalar eval(expression)
+     *
+     * Evaluates the expression e; zero parts become T(0).
+     */
+    template <typename X>
+    inline
+    complex_scalar<typename scalar_of<typename parts_of<typename as_node<X>::type>::re,
+                                      typename parts_of<typename as_node<X>::type>::im>::type>
+    eval(const X& e) {
+      typedef typename as_node<X>::type N;
+      typedef typename scalar_of<typename parts_of<N>::re,
+                                 typename parts_of<N>::im>::type T;
+      typename parts_of<N>::type p = as_node<X>::wrap(e).eval();
+      return complex_scalar<T>(to_scalar<T>(p.re), to_scalar<T>(p.im));
+    }
+
+
+    /**
+     * scalar abs2(expression)
+     *
+     * |e|^2, without the zero parts.
+     */
+    template <typename X>
+    struct abs2_type {
+      typedef typename parts_of<typename as_node<X>::type>::re R;
+      typedef typename parts_of<typename as_node<X>::type>::im I;
+      typedef decltype(sum(product(std::declval<R>(), std::declval<R>()),
+                           product(std::declval<I>(), std::declval<I>()))) norm_type;
+      typedef typename scalar_of<norm_type, zero>::type type;
+    };
+
+    template <typename X>
+    inline typename abs2_type<X>::type
+    abs2(const X& e) {
+      typename parts_of<typename as_node<X>::type>::type p
+        = as_node<X>::wrap(e).eval();
+      return to_scalar<typename abs2_type<X>::type>(
+        sum(product(p.re, p.re), product(p.im, p.im)));
+    }
+
+  }
+}
+#endif
@@ -2,8 +2,10 @@
 #define MESON_DECA__LIB__C_LIB__COMPLEX__MATRIX_HPP
 
 #include <stan/math/prim/mat/fun/Eigen.hpp>
+#include <stdint.h> // uintptr_t
 #include <vector>
 
+#include <meson_deca/lib/c_lib/complex/scalar.hpp>
 
 /*
  *  Introduce complex matrix operations in a STAN-friendly way.
@@ -11,14 +13,179 @@
  *  DESCRIPTION
  *    See meson_deca/lib/c_lib/complex/complex.hpp
  *
+ *    Outside of STAN, the amplitudes of D events are evaluated in
+ *    batches into a split_matrix: the R x D complex matrix
+ *    A(r, d) = A_r(y_d) with the real and the imaginary parts in two
+ *    separate row-major blocks. A row holds one resonance for all
+ *    events; rows start at 64-byte boundaries, so the event loop of a
+ *    resonance kernel (fill_row) runs over contiguous, aligned memory
+ *    and the dispatch over the resonances stays out of it.
+ *
+ *  TYPES
+ *    split_matrix
+ *
  *  FUNCTIONS
- *    Nothing done yet!
+ *    void fill_row(split_matrix, int, kernel, const double*, int)
+ *    void fill_row(split_matrix, int, kernel, const E*)
  */
 
 
-//namespace complex {
-//  namespace matrix {
+namespace complex {
+
+  /**
+   * split_matrix
+   *
+   * R x D complex matrix, re(r)[d] + i im(r)[d]. The row stride is D
+   * rounded up to a multiple of 8 doubles (one cache line); the padding
+   * is zero. resize() keeps the storage if it is large enough, so a
+   * matrix can be reused for consecutive batches without allocations.
+   */
+  class split_matrix {
+  public:
+    static const int align = 8; // doubles
+
+    split_matrix() : rows_(0), cols_(0), stride_(0) {};
+
+    split_matrix(int R, int D) : rows_(0), cols_(0), stride_(0) {
+      resize(R, D);
+    }
+
+    split_matrix(const split_matrix& other) :
+      rows_(0), cols_(0), stride_(0) {
+      *this = other;
+    }
+
+    // The copy has its own alignment offset
+    split_matrix& operator=(const split_matrix& other) {
+      if (this != &other) {
+        resize(other.rows_, other.cols_);
+        for (int r = 0; r < rows_; r++) {
+          for (long d = 0; d < stride_; d++) {
+            re(r)[d] = other.re(r)[d];
+            im(r)[d] = other.im(r)[d];
+          }
+        }
+      }
+      return *this;
+    }
+
+    void resize(int R, int D) {
+      rows_ = R;
+      cols_ = D;
+      stride_ = (long(D) + align - 1) / align * align;
+      size_t n = 2 * R * stride_ + align;
+      if (data_.size() < n)
+        data_.resize(n);
+      for (int r = 0; r < R; r++) {
+        for (long d = D; d < stride_; d++) {
+          re(r)[d] = 0.;
+          im(r)[d] = 0.;
+        }
+      }
+    }
+
+    int rows() const {
+      return rows_;
+    }
+
+    int cols() const {
+      return cols_;
+    }
+
+    long stride() const {
+      return stride_;
+    }
+
+    double* re(int r) {
+      return base() + r * stride_;
+    }
+
+    double* im(int r) {
+      return base() + (rows_ + r) * stride_;
+    }
+
+    const double* re(int r) const {
+      return base() + r * stride_;
+    }
+
+    const double* im(int r) const {
+      return base() + (rows_ + r) * stride_;
+    }
+
+    // Column d (amplitudes of event d) in the layout of A_cv
+    void col(int d, Eigen::VectorXd& A_re, Eigen::VectorXd& A_im) const {
+      A_re.resize(rows_);
+      A_im.resize(rows_);
+      for (int r = 0; r < rows_; r++) {
+        A_re(r) = re(r)[d];
+        A_im(r) = im(r)[d];
+      }
+    }
+
+  private:
+    int rows_, cols_;
+    long stride_;
+    std::vector<double> data_;
+
+    // First 64-byte aligned element of data_
+    double* base() {
+      return const_cast<double*>(static_cast<const split_matrix&>(*this).base());
+    }
+
+    const double* base() const {
+      if (data_.empty())
+        return 0;
+      const double* p = &data_[0];
+      uintptr_t offset = reinterpret_cast<uintptr_t>(p) % (align * sizeof(double));
+      return offset ? p + (align * sizeof(double) - offset) / sizeof(double) : p;
+    }
+  };
+
+
+  namespace matrix {
+
+    /**
+     * void fill_row(split_matrix A, int r, kernel, const double* y, int N)
+     *
+     * A(r, d) = kernel(y + d N) for all events d < A.cols(). y holds the
+     * events contiguously, N variables each; kernel maps the variables
+     * of one event to a complex_scalar<double>. The kernel is a template
+     * parameter, so it is inlined into the event loop.
+     */
+    template <typename K>
+    inline void
+    fill_row(split_matrix& A, int r, const K& kernel, const double* y, int N) {
+      double* re = A.re(r);
+      double* im = A.im(r);
+      int D = A.cols();
+      for (int d = 0; d < D; d++) {
+        complex_scalar<double> z = kernel(y + long(d) * N);
+        re[d] = z.re;
+        im[d] = z.im;
+      }
+    }
+
+
+    /**
+     * void fill_row(split_matrix A, int r, kernel, const E* events)
+     *
+     * A(r, d) = kernel(events[d]) for all events d < A.cols(), e.g. for
+     * event contexts (resonances::event_3) computed once per event and
+     * shared by the rows of all resonances.
+     */
+    template <typename K, typename E>
+    inline void
+    fill_row(split_matrix& A, int r, const K& kernel, const E* events) {
+      double* re = A.re(r);
+      double* im = A.im(r);
+      int D = A.cols();
+      for (int d = 0; d < D; d++) {
+        complex_scalar<double> z = kernel(events[d]);
+        re[d] = z.re;
+        im[d] = z.im;
+      }
+    }
 
-//  }
-//}
+  }
+}
 #endif
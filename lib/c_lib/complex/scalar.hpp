@@ -11,6 +11,9 @@
  *  DESCRIPTION
  *    See meson_deca/lib/c_lib/complex/complex.hpp
  *
+ *  TYPES
+ *    complex_scalar<T>
+ *
  *  FUNCTIONS
  *    complex_scalar abs2(complex_scalar)
  *    complex_scalar add(complex_scalar, complex_scalar)
@@ -21,24 +24,52 @@
  *    complex_scalar mult(complex_scalar, complex_scalar)
  *    complex_scalar mult(scalar, complex_scalar)
  *    complex_scalar subtract(complex_scalar, complex_scalar)
+ *
+ *    complex_scalar from_array(array)   [STAN boundary only]
+ *    array to_array(complex_scalar)     [STAN boundary only]
  */
 
 
 namespace complex {
+
+  /**
+   * complex_scalar<T>
+   *
+   * Fixed-size complex number (real part, imaginary part) that lives
+   * on the stack. Unlike std::vector<T>(2), creating or copying it
+   * never touches the heap; for T = double it is trivially copyable.
+   *
+   * @tparam T Scalar type (double, stan::math::var, stan::math::fvar)
+   */
+  template <typename T>
+  struct complex_scalar {
+    T re; // Real part
+    T im; // Imaginary part
+
+    complex_scalar() {};
+
+    complex_scalar(const T& _re, const T& _im) : re(_re), im(_im) {};
+
+    // Promotion, e.g. complex_scalar<double> -> complex_scalar<var>
+    template <typename T1>
+    complex_scalar(const complex_scalar<T1>& z) : re(z.re), im(z.im) {};
+  };
+
+
   namespace scalar {
 
     /**
      * scalar abs2(complex_scalar)
      *
      * Square magnitude of a complex number.
-     * Takes the vector (a, b), returns a**2 + b**2.
+     * Takes the number (a, b), returns a**2 + b**2.
      *
      * @tparam T Scalar type
      */
     template <typename T>
     inline T
-    abs2(const std::vector<T> &v) {
-        return v[0] * v[0] + v[1] * v[1];
+    abs2(const complex_scalar<T> &v) {
+        return v.re * v.re + v.im * v.im;
     }
 
 
@@ -51,13 +82,10 @@ namespace complex {
      */
     template <typename T0, typename T1>
     inline
-    std::vector<typename boost::math::tools::promote_args<T0,T1>::type> 
-    add(const std::vector<T0> &v1, const std::vector<T1> &v2) {
+    complex_scalar<typename boost::math::tools::promote_args<T0,T1>::type>
+    add(const complex_scalar<T0> &v1, const complex_scalar<T1> &v2) {
         typedef typename boost::math::tools::promote_args<T0,T1>::type T_res;
-        std::vector<T_res> res(2);
-        res[0] = v1[0] + v2[0];
-        res[1] = v1[1] + v2[1];
-        return res;
+        return complex_scalar<T_res>(v1.re + v2.re, v1.im + v2.im);
     }
 
 
@@ -65,19 +93,16 @@ namespace complex {
      * complex_scalar complex(scalar, scalar)
      *
      * Complex number constructor.
-     * Takes two scalars a,b returns the vector (a, b).
+     * Takes two scalars a,b returns the number (a, b).
      *
      * @tparam T0, T1 Scalar type
      */
     template <typename T0, typename T1>
     inline
-    std::vector<typename boost::math::tools::promote_args<T0,T1>::type>
+    complex_scalar<typename boost::math::tools::promote_args<T0,T1>::type>
     complex(const T0& re, const T1& im) {
       typedef typename boost::math::tools::promote_args<T0,T1>::type T_res;
-      std::vector<T_res> res(2);
-      res[0] = re;
-      res[1] = im;
-      return res;
+      return complex_scalar<T_res>(re, im);
     }
 
 
@@ -90,14 +115,10 @@ namespace complex {
      */
     template <typename T>
     inline
-    std::vector<T> inverse(const std::vector<T>& y) {
+    complex_scalar<T> inverse(const complex_scalar<T>& y) {
 
-        std::vector<T> res(2);
-        T norm = y[0] * y[0] + y[1] * y[1];
-
-        res[0] = y[0] / norm;
-        res[1] = -y[1] / norm;
-        return res;
+        T norm = y.re * y.re + y.im * y.im;
+        return complex_scalar<T>(y.re / norm, -y.im / norm);
     }
 
 
@@ -111,11 +132,8 @@ namespace complex {
      */
     template <typename T>
     inline
-    std::vector<T> one(const T& y) {
-        std::vector<T> res(2);
-        res[0] = 1.0;
-        res[1] = 0.0;
-        return res;
+    complex_scalar<T> one(const T& /* y */) {
+        return complex_scalar<T>(1.0, 0.0);
     }
 
 
@@ -129,11 +147,8 @@ namespace complex {
      */
     template <typename T>
     inline
-    std::vector<T> one_i(const T& y) {
-        std::vector<T> res(2);
-        res[0] = 0.0;
-        res[1] = 1.0;
-        return res;
+    complex_scalar<T> one_i(const T& /* y */) {
+        return complex_scalar<T>(0.0, 1.0);
     }
 
 
@@ -146,13 +161,11 @@ namespace complex {
      */
     template <typename T0, typename T1>
     inline
-    std::vector<typename boost::math::tools::promote_args<T0,T1>::type> 
-    mult(const std::vector<T0> &v1, const std::vector<T1> &v2) {
+    complex_scalar<typename boost::math::tools::promote_args<T0,T1>::type>
+    mult(const complex_scalar<T0> &v1, const complex_scalar<T1> &v2) {
       typedef typename boost::math::tools::promote_args<T0,T1>::type T_res;
-      std::vector<T_res> res(2);
-      res[0] = v1[0] * v2[0] - v1[1] * v2[1];
-      res[1] = v1[1] * v2[0] + v1[0] * v2[1];
-      return res;
+      return complex_scalar<T_res>(v1.re * v2.re - v1.im * v2.im,
+                                   v1.im * v2.re + v1.re * v2.im);
     }
 
 
@@ -165,13 +178,10 @@ namespace complex {
      */
     template <typename T0, typename T1>
     inline
-    std::vector<typename boost::math::tools::promote_args<T0,T1>::type> 
-    mult(const T0 &v1, const std::vector<T1> &v2) {
+    complex_scalar<typename boost::math::tools::promote_args<T0,T1>::type>
+    mult(const T0 &v1, const complex_scalar<T1> &v2) {
       typedef typename boost::math::tools::promote_args<T0,T1>::type T_res;
-      std::vector<T_res> res(2);
-      res[0] = v1 * v2[0];
-      res[1] = v1 * v2[1];
-      return res;
+      return complex_scalar<T_res>(v1 * v2.re, v1 * v2.im);
     }
 
 
@@ -184,15 +194,45 @@ namespace complex {
      */
     template <typename T0, typename T1>
     inline
-    std::vector<typename boost::math::tools::promote_args<T0,T1>::type> 
-    subtract(const std::vector<T0> &v1, const std::vector<T1> &v2) {
+    complex_scalar<typename boost::math::tools::promote_args<T0,T1>::type>
+    subtract(const complex_scalar<T0> &v1, const complex_scalar<T1> &v2) {
         typedef typename boost::math::tools::promote_args<T0,T1>::type T_res;
-        std::vector<T_res> res(2);
-        res[0] = v1[0] - v2[0];
-        res[1] = v1[1] - v2[1];
+        return complex_scalar<T_res>(v1.re - v2.re, v1.im - v2.im);
+    }
+
+
+    /**
+     * array to_array(complex_scalar)
+     *
+     * Converts a complex number to the STAN representation (array of
+     * two reals). Only meant for the STAN boundary (model.hpp).
+     *
+     * @tparam T Scalar type
+     */
+    template <typename T>
+    inline
+    std::vector<T> to_array(const complex_scalar<T>& z) {
+        std::vector<T> res(2);
+        res[0] = z.re;
+        res[1] = z.im;
         return res;
     }
 
+
+    /**
+     * complex_scalar from_array(array)
+     *
+     * Converts the STAN representation of a complex number (array of
+     * two reals) to a complex_scalar. Only meant for the STAN boundary.
+     *
+     * @tparam T Scalar type
+     */
+    template <typename T>
+    inline
+    complex_scalar<T> from_array(const std::vector<T>& v) {
+        return complex_scalar<T>(v[0], v[1]);
+    }
+
   }
 }
 #endif
@@ -4,6 +4,8 @@
 #include <stan/math/prim/mat/fun/Eigen.hpp>
 #include <vector>
 
+#include <meson_deca/lib/c_lib/complex/scalar.hpp>
+
 /*
  *  Introduce complex vector operations in a STAN-friendly way.
  *
@@ -12,7 +14,8 @@
  *
  *  FUNCTIONS
  *    complex_vector mult(complex_vector, complex_vector)
- *    complex_vector sum(complex_vector, complex_vector)
+ *    complex_scalar sum(complex_vector)
+ *    complex_scalar mult_sum<R>(complex_vector, complex_vector)
  */
 
 
@@ -59,19 +62,58 @@ namespace complex {
      */
     template <typename T>
     inline
-    std::vector<T> sum(const std::vector<Eigen::Matrix<T,Eigen::Dynamic,1> > &v) {
+    complex_scalar<T> sum(const std::vector<Eigen::Matrix<T,Eigen::Dynamic,1> > &v) {
 
-        std::vector<T> res(2);
-        res[0] = 0.0;
-        res[1] = 0.0;
+        complex_scalar<T> res(0.0, 0.0);
 
         for (int i = 0; i < v[0].rows(); i++) {
-            res[0] += v[0](i);
-            res[1] += v[1](i);
+            res.re += v[0](i);
+            res.im += v[1](i);
         }
 
         return res;
     }
+
+
+    /**
+     * complex_number mult_sum<R>(complex_vector, complex_vector)
+     *
+     * sum(mult(v1, v2)) for vectors of the compile-time size R (e.g.
+     * the number of resonances of a model), in the same order of
+     * operations, but without the temporary vectors and with fixed-size
+     * access to v1, v2, so the loop is unrolled. With a mask (see
+     * structures/active_resonances.hpp), only the terms i with
+     * mask[i] != 0 are summed.
+     *
+     * @tparam R Size of v1, v2
+     * @tparam T0,T1 Scalar types
+     */
+    template <int R, typename T0, typename T1>
+    inline
+    complex_scalar<typename boost::math::tools::promote_args<T0,T1>::type>
+    mult_sum(const std::vector<Eigen::Matrix<T0,Eigen::Dynamic,1> > &v1,
+             const std::vector<Eigen::Matrix<T1,Eigen::Dynamic,1> > &v2,
+             const unsigned char* mask = 0) {
+
+        if (v1[0].rows() != R || v2[0].rows() != R) {
+            std::cout << "Arugment size mismatch in complex::vector::mult_sum.";
+        }
+
+        typedef typename boost::math::tools::promote_args<T0,T1>::type T_res;
+        Eigen::Map<const Eigen::Matrix<T0, R, 1> > a_re(v1[0].data()), a_im(v1[1].data());
+        Eigen::Map<const Eigen::Matrix<T1, R, 1> > b_re(v2[0].data()), b_im(v2[1].data());
+
+        complex_scalar<T_res> res(0.0, 0.0);
+        for (int i = 0; i < R; i++) {
+            if (mask && !mask[i])
+                continue;
+            T_res re = a_re(i) * b_re(i) - a_im(i) * b_im(i);
+            T_res im = a_re(i) * b_im(i) + a_im(i) * b_re(i);
+            res.re += re;
+            res.im += im;
+        }
+        return res;
+    }
   }
 }
 #endif
@@ -0,0 +1,29 @@
+#ifndef MESON_DECA__LIB__C_LIB__DATA_HPP
+#define MESON_DECA__LIB__C_LIB__DATA_HPP
+
+#include <meson_deca/lib/c_lib/data/amplitude_file.hpp>
+#include <meson_deca/lib/c_lib/data/rdump.hpp>
+
+/*
+ *  Binary event data.
+ *
+ *  DESCRIPTION
+ *    For 10^6 events, the R dump of A_cv_data is gigabytes of text that
+ *    every chain parses into millions of small vectors. The amplitude
+ *    file (amplitude_file.hpp) stores the same numbers as aligned
+ *    columns of doubles and is memory-mapped by the STAN-callable
+ *    amplitude_file_log_likelihood (model.hpp): no parsing, no copies,
+ *    one page cache for all chains.
+ *
+ *    The file is written by lib/c_lib/tools/amplitudes.cpp (option
+ *    --amplitude-file).
+ *
+ *    The native tools read the parameters of the STAN data files (R
+ *    dump) with rdump.hpp.
+ *
+ *  FUNCTIONS
+ *    Are currently listed in particular files - amplitude_file.hpp,
+ *    rdump.hpp.
+ */
+
+#endif
@@ -0,0 +1,231 @@
+#ifndef MESON_DECA__LIB__C_LIB__DATA__AMPLITUDE_FILE_HPP
+#define MESON_DECA__LIB__C_LIB__DATA__AMPLITUDE_FILE_HPP
+
+#include <stan/math/prim/mat/fun/Eigen.hpp>
+#include <cstdio>
+#include <cstdlib> // getenv
+#include <cstring> // memcmp, memcpy
+#include <fcntl.h> // open
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+#include <unistd.h> // close
+#include <vector>
+
+#include <meson_deca/lib/c_lib/likelihood/log_likelihood.hpp> // amplitude_view
+
+/*
+ *  Columnar binary file of event amplitudes.
+ *
+ *  DESCRIPTION
+ *    Replaces A_cv_data (and A_v_background_abs2_data, y_data) in the
+ *    R dump read by STAN. The file is
+ *
+ *      header (128 bytes, all fields uint64 in native byte order)
+ *        magic   "MDAMP001"
+ *        version 1
+ *        D       number of events
+ *        N       number of variables y
+ *        R       number of resonances
+ *        B       number of background amplitudes
+ *        stride  doubles per column (D rounded up to a multiple of 8)
+ *        offset  byte offset of the first column (128)
+ *        (zero padding)
+ *      N + 2 R + B columns of stride doubles, in the order
+ *        y_1 .. y_N, Re A_1 .. Re A_R, Im A_1 .. Im A_R,
+ *        A_bkg_1 .. A_bkg_B
+ *
+ *    so every column is 64-byte aligned. amplitude_file maps the file
+ *    read-only: nothing is parsed or copied, and processes reading the
+ *    same file (e.g. the chains of fit.sh) share the page cache.
+ *
+ *  TYPES
+ *    amplitude_file
+ *
+ *  FUNCTIONS
+ *    void write_amplitude_file(path, y, A_re, A_im, A_bkg)
+ *    const amplitude_file& mapped_amplitudes()
+ */
+
+namespace data {
+
+  const uint64_t amplitude_file_version = 1;
+  const uint64_t amplitude_file_header = 128;
+
+
+  // Doubles per column of D events
+  inline uint64_t
+  amplitude_file_stride(uint64_t D) {
+    return (D + 7) / 8 * 8;
+  }
+
+
+  /**
+   * void write_amplitude_file(path, y, A_re, A_im, A_bkg)
+   *
+   * Writes the events y (D x N), the amplitudes A_re + i A_im (D x R)
+   * and the background amplitudes A_bkg (D x B, may have no columns);
+   * throws std::runtime_error on failure.
+   */
+  inline void
+  write_amplitude_file(const std::string& path, const Eigen::MatrixXd& y,
+                       const Eigen::MatrixXd& A_re, const Eigen::MatrixXd& A_im,
+                       const Eigen::MatrixXd& A_bkg) {
+    uint64_t D = y.rows();
+    if (A_re.rows() != y.rows() || A_im.rows() != y.rows()
+        || A_im.cols() != A_re.cols() || A_bkg.rows() != y.rows())
+      throw std::domain_error("write_amplitude_file: size mismatch");
+
+    uint64_t header[amplitude_file_header / 8] = {0};
+    memcpy(header, "MDAMP001", 8);
+    header[1] = amplitude_file_version;
+    header[2] = D;
+    header[3] = y.cols();
+    header[4] = A_re.cols();
+    header[5] = A_bkg.cols();
+    header[6] = amplitude_file_stride(D);
+    header[7] = amplitude_file_header;
+
+    FILE* f = fopen(path.c_str(), "wb");
+    if (f == 0)
+      throw std::runtime_error("write_amplitude_file: cannot write " + path);
+    bool ok = fwrite(header, 1, amplitude_file_header, f) == amplitude_file_header;
+
+    std::vector<double> column(header[6], 0.);
+    const Eigen::MatrixXd* blocks[4] = {&y, &A_re, &A_im, &A_bkg};
+    for (int k = 0; k < 4 && ok; k++) {
+      for (int c = 0; c < blocks[k]->cols() && ok; c++) {
+        Eigen::Map<Eigen::VectorXd>(&column[0], D) = blocks[k]->col(c);
+        ok = fwrite(&column[0], sizeof(double), column.size(), f) == column.size();
+      }
+    }
+    ok = fclose(f) == 0 && ok;
+    if (!ok)
+      throw std::runtime_error("write_amplitude_file: cannot write " + path);
+  }
+
+
+  /**
+   * amplitude_file
+   *
+   * Read-only memory map of an amplitude file; throws
+   * std::runtime_error if the file can not be mapped or is not an
+   * amplitude file. Not copyable.
+   */
+  class amplitude_file {
+  public:
+    explicit amplitude_file(const std::string& path) : path_(path) {
+      int fd = open(path.c_str(), O_RDONLY);
+      struct stat st;
+      if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0)
+          close(fd);
+        throw std::runtime_error("amplitude_file: cannot open " + path);
+      }
+      size_ = st.st_size;
+      base_ = size_ >= amplitude_file_header ?
+        mmap(0, size_, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+      close(fd);
+      if (base_ == MAP_FAILED)
+        throw std::runtime_error("amplitude_file: cannot map " + path);
+
+      const uint64_t* h = static_cast<const uint64_t*>(base_);
+      D_ = h[2];
+      N_ = h[3];
+      R_ = h[4];
+      B_ = h[5];
+      stride_ = h[6];
+      offset_ = h[7];
+      if (memcmp(base_, "MDAMP001", 8) != 0 || h[1] != amplitude_file_version
+          || stride_ != amplitude_file_stride(D_) || offset_ % 64 != 0
+          || offset_ + (N_ + 2 * R_ + B_) * stride_ * sizeof(double) > size_) {
+        munmap(base_, size_);
+        throw std::runtime_error("amplitude_file: " + path
+                                 + " is not a valid amplitude file");
+      }
+    }
+
+    ~amplitude_file() {
+      munmap(base_, size_);
+    }
+
+    int num_events() const {
+      return D_;
+    }
+
+    int num_variables() const {
+      return N_;
+    }
+
+    int num_resonances() const {
+      return R_;
+    }
+
+    int num_background() const {
+      return B_;
+    }
+
+    const std::string& path() const {
+      return path_;
+    }
+
+    // Columns (D doubles each)
+    const double* y(int n) const {
+      return column(n);
+    }
+
+    const double* re(int r) const {
+      return column(N_ + r);
+    }
+
+    const double* im(int r) const {
+      return column(N_ + R_ + r);
+    }
+
+    const double* bkg(int b) const {
+      return column(N_ + 2 * R_ + b);
+    }
+
+    // The amplitudes as seen by the likelihood
+    likelihood::amplitude_view view() const {
+      return likelihood::amplitude_view(D_, R_, B_, stride_, re(0), im(0),
+                                        B_ > 0 ? bkg(0) : 0);
+    }
+
+  private:
+    std::string path_;
+    void* base_;
+    uint64_t size_;
+    uint64_t D_, N_, R_, B_, stride_, offset_;
+
+    amplitude_file(const amplitude_file&);
+    amplitude_file& operator=(const amplitude_file&);
+
+    const double* column(uint64_t c) const {
+      return reinterpret_cast<const double*>(
+        static_cast<const char*>(base_) + offset_ + c * stride_ * sizeof(double));
+    }
+  };
+
+
+  /**
+   * const amplitude_file& mapped_amplitudes()
+   *
+   * The amplitude file of the process, named by the environment
+   * variable MESON_DECA_AMPLITUDE_FILE (default: amplitudes.mdamp in
+   * the working directory). STAN has no string arguments, so the
+   * STAN-callable functions in model.hpp read their data from here; the
+   * file is mapped on the first call and stays mapped.
+   */
+  inline const amplitude_file&
+  mapped_amplitudes() {
+    static const char* name = getenv("MESON_DECA_AMPLITUDE_FILE");
+    static amplitude_file file(name != 0 ? name : "amplitudes.mdamp");
+    return file;
+  }
+
+}
+
+#endif
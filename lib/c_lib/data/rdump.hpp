@@ -0,0 +1,88 @@
+#ifndef MESON_DECA__LIB__C_LIB__DATA__RDUMP_HPP
+#define MESON_DECA__LIB__C_LIB__DATA__RDUMP_HPP
+
+#include <cctype>  // isalnum
+#include <cstdlib> // strtod
+#include <istream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+ *  Reader of the R dump data files of STAN.
+ *
+ *  DESCRIPTION
+ *    The data of STAN_data_generator.data.R, e.g.
+ *
+ *      theta <- structure(c(-1.17, 0.67, ..., 1.0, 0.0), .Dim = c(2,7))
+ *      theta_background_abs2 <- c(0.2, 0.2)
+ *
+ *    as flat vectors of doubles in the order of the file, which is the
+ *    column-major order of R: the entries of the STAN array
+ *    vector[R] theta[2] are theta[1][1], theta[2][1], theta[1][2], ...
+ *    Only the numeric values of scalars, c(...) and structure(c(...),
+ *    .Dim = ...) are read; the dimensions are left to the caller.
+ *
+ *  FUNCTIONS
+ *    map<string, vector<double> > read_rdump(istream)
+ */
+
+namespace data {
+
+  /**
+   * map<string, vector<double> > read_rdump(in)
+   *
+   * The variables 'name <- value' of the R dump in (see above).
+   */
+  inline std::map<std::string, std::vector<double> >
+  read_rdump(std::istream& in) {
+    std::string s((std::istreambuf_iterator<char>(in)),
+                  std::istreambuf_iterator<char>());
+    std::map<std::string, std::vector<double> > res;
+
+    size_t pos = 0;
+    while ((pos = s.find("<-", pos)) != std::string::npos) {
+      // Name: the word before '<-'
+      size_t e = pos;
+      while (e > 0 && (s[e - 1] == ' ' || s[e - 1] == '\t'))
+        e--;
+      size_t b = e;
+      while (b > 0 && (isalnum(s[b - 1]) || s[b - 1] == '_' || s[b - 1] == '.'
+                       || s[b - 1] == '"'))
+        b--;
+      std::string name = s.substr(b, e - b);
+      if (name.size() > 1 && name[0] == '"')
+        name = name.substr(1, name.size() - 2);
+      pos += 2;
+
+      // Values: a scalar, or the first c(...) of the expression
+      std::vector<double>& values = res[name];
+      size_t v = s.find_first_not_of(" \t\n", pos);
+      if (v == std::string::npos)
+        break;
+      size_t end = s.find_first_of("\n", v);
+      if (s.compare(v, 2, "c(") == 0 || s.compare(v, 10, "structure(") == 0) {
+        v = s.find("c(", v) + 2;
+        end = s.find(')', v);
+      }
+      const char* p = s.c_str() + v;
+      const char* p_end = s.c_str() + (end == std::string::npos ? s.size() : end);
+      while (p < p_end) {
+        char* next;
+        double x = std::strtod(p, &next);
+        if (next == p) {
+          p++; // Separator
+          continue;
+        }
+        values.push_back(x);
+        p = next;
+      }
+      pos = end == std::string::npos ? s.size() : end;
+    }
+    return res;
+  }
+
+}
+
+#endif
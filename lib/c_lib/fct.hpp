@@ -5,7 +5,9 @@
 #include <meson_deca/lib/c_lib/fct/breakup_momentum.hpp>
 #include <meson_deca/lib/c_lib/fct/breit_wigner.hpp>
 #include <meson_deca/lib/c_lib/fct/flatte.hpp>
+#include <meson_deca/lib/c_lib/fct/lineshape_table.hpp>
 #include <meson_deca/lib/c_lib/fct/valid.hpp>
+#include <meson_deca/lib/c_lib/fct/valid_mask.hpp>
 #include <meson_deca/lib/c_lib/fct/zemach.hpp>
 
 #endif
@@ -8,13 +8,67 @@
 
 namespace fct {
 
+  /**
+   * Return floating-point Blatt-Weisskopf form factor for a given
+   * squared breakup momentum (see blatt_weisskopf below).
+   *
+   * Used with the breakup momenta of an event context (e.g.
+   * resonances::kinematics_3), which are shared by all resonances.
+   *
+   * @param J_R resonance spin
+   * @param r2_P parent particle squared radius
+   * @param p2 squared breakup momentum
+   * @return Blatt-Weisskopf form factor
+   */
+  template <typename T>
+  inline
+  T blatt_weisskopf_p2(int J_R, double r2_P, const T& p2) {
+
+    if (J_R == 0 or J_R > 2) return 1;
+
+    T z = p2 * r2_P;
+    if (J_R == 1) {
+      return sqrt(1.0 / (1.0 + z));
+    }
+    if (J_R == 2) {
+      return sqrt(1.0 / (9.0 + 3.0 * z + z * z));
+    }
+
+    return 0;
+  }
+
+
+  /**
+   * Return d log B / d p2 of the Blatt-Weisskopf form factor
+   * B = blatt_weisskopf_p2(J_R, r2_P, p2).
+   *
+   * @param J_R resonance spin
+   * @param r2_P parent particle squared radius
+   * @param p2 squared breakup momentum
+   * @return logarithmic derivative of the form factor
+   */
+  inline
+  double blatt_weisskopf_p2_dlog(int J_R, double r2_P, double p2) {
+
+    double z = p2 * r2_P;
+    if (J_R == 1) {
+      return - 0.5 * r2_P / (1.0 + z);
+    }
+    if (J_R == 2) {
+      return - 0.5 * r2_P * (3.0 + 2.0 * z) / (9.0 + 3.0 * z + z * z);
+    }
+
+    return 0;
+  }
+
+
   /**
    * Return floating-point Blatt-Weisskopf form factor.
    *
    * Implemented as in: arxiv:1406.6311v2, p. 151, eq. (13.2.8).
    *
    * @param J_R resonance spin
-   * @param r2_p parent particle squared radius
+   * @param r2_P parent particle squared radius
    * @param m2_ab Dalitz plot variable (squared mass)
    * @param m_a 1st daughter particle mass of m2_ab
    * @param m_b 2nd daughter particle mass of m2_ab
@@ -30,15 +84,8 @@ namespace fct {
 
     typedef typename boost::math::tools::promote_args<T0,T1,T2>::type T;
 
-    T p2 = fct::breakup_momentum::p2(m2_ab, m_a, m_b) * r2_P;
-    if (J_R == 1) {
-      return sqrt(1.0 / (1.0 + p2));
-    }
-    if (J_R == 2) {
-      return sqrt(1.0 / (9.0 + 3.0 * p2 + p2 * p2));
-    }
-
-    return 0;
+    return blatt_weisskopf_p2(J_R, r2_P,
+                              T(fct::breakup_momentum::p2(m2_ab, m_a, m_b)));
   }
 
 }
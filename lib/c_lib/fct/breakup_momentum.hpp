@@ -33,6 +33,57 @@ namespace fct {
     }
 
 
+    /**
+     * Return d p2(m2_R, m_a, m_b) / d m2_R.
+     *
+     * @param m2_R decaying particle squared mass
+     * @param m_a 1st daughter mass
+     * @param m_b 2nd daughter mass
+     */
+    inline
+    double
+    dp2_dm2_R(double m2_R, double m_a, double m_b) {
+      double s_p = (m_a + m_b) * (m_a + m_b);
+      double s_m = (m_a - m_b) * (m_a - m_b);
+      return (m2_R * m2_R - s_p * s_m) / (4.0 * m2_R * m2_R);
+    }
+
+
+    /**
+     * Return d p2(m2_R, m_a, m_b) / d m_a.
+     *
+     * @param m2_R decaying particle squared mass
+     * @param m_a 1st daughter mass
+     * @param m_b 2nd daughter mass
+     */
+    inline
+    double
+    dp2_dm_a(double m2_R, double m_a, double m_b) {
+      double s_p = (m_a + m_b) * (m_a + m_b);
+      double s_m = (m_a - m_b) * (m_a - m_b);
+      return - ((m_a + m_b) * (m2_R - s_m) + (m_a - m_b) * (m2_R - s_p))
+        / (2.0 * m2_R);
+    }
+
+
+    /**
+     * Return complex breakup momentum for a given squared breakup
+     * momentum (imaginary below the threshold).
+     *
+     * @param p2 squared breakup momentum
+     * @return breakup momentum
+     */
+    template <typename T>
+    inline
+    complex::complex_scalar<T>
+    complex_p_p2(const T& p2) {
+      if (p2 >= 0)
+        return complex::scalar::complex(sqrt(p2), 0.);
+      else
+        return complex::scalar::complex(0., sqrt(-p2));
+    }
+
+
     /**
      * Return complex breakup momentum.
      *
@@ -43,20 +94,14 @@ namespace fct {
      */
     template <typename T0, typename T1, typename T2>
     inline
-    std::vector<typename boost::math::tools::promote_args<T0,T1,T2>::type>
+    complex::complex_scalar<typename boost::math::tools::promote_args<T0,T1,T2>::type>
     complex_p(const T0& m2_R, const T1& m_a, const T2& m_b) {
 
       typedef typename boost::math::tools::promote_args<T0,T1,T2>::type T_res;
 
       T_res p2 = fct::breakup_momentum::p2(m2_R, m_a, m_b);
-      std::vector<T_res> res(2);      
-
-      if (p2 >= 0)
-        res = complex::scalar::complex(sqrt(p2), 0.);
-      else
-        res = complex::scalar::complex(0., sqrt(-p2));
 
-      return res;
+      return fct::breakup_momentum::complex_p_p2(p2);
     }
 
 
@@ -3,10 +3,27 @@
 
 #include <vector>
 #include <cmath>
+#include <type_traits> // std::enable_if
 
 #include <meson_deca/lib/c_lib/fct/breakup_momentum.hpp>
 #include <meson_deca/lib/c_lib/fct/blatt_weisskopf.hpp>
 #include <meson_deca/lib/c_lib/complex.hpp>
+#include <meson_deca/lib/c_lib/likelihood/gradient.hpp>
+
+/*
+ * Breit-Wigner propagator and running width.
+ *
+ * DESCRIPTION
+ *   value() and relativistic_width() are generic in the scalar type.
+ *   With autodiff parameters (stan::math::var M_R, W_R or width) and
+ *   double kinematics, the overloads below evaluate the kernel in
+ *   double precision together with its partial derivatives in closed
+ *   form (value_partials, relativistic_width_partials), and put the
+ *   result on the tape as a single node per real output (see
+ *   likelihood::attach_gradients), instead of the expression graph of
+ *   the generic version. Forward mode (fvar) parameters use the
+ *   generic version.
+ */
 
 namespace fct {
   namespace breit_wigner {
@@ -20,19 +37,75 @@ namespace fct {
      * @return Breit-Wigner dynamical form factor
      */
     template <typename T0, typename T1, typename T2>
-    std::vector<typename boost::math::tools::promote_args<T0,T1,T2>::type>
+    complex::complex_scalar<typename boost::math::tools::promote_args<T0,T1,T2>::type>
     value(const T0& M_R, const T1& m2_ab, const T2& width_m2_ab) {
 
       typedef typename boost::math::tools::promote_args<T0,T1,T2>::type T_res;
 
-      std::vector<T_res> res(2);
-      res = complex::scalar::complex(M_R * M_R - m2_ab, - M_R * width_m2_ab);
+      complex::complex_scalar<T_res> res
+        = complex::scalar::complex(M_R * M_R - m2_ab, - M_R * width_m2_ab);
  
       return complex::scalar::inverse(res);
 
     }
 
 
+    /**
+     * Return the Breit-Wigner form factor as above, and its partial
+     * derivatives with respect to M_R and width_m2_ab.
+     *
+     * @param M_R resonance mass
+     * @param m2_ab Dalitz plot variable (squared mass)
+     * @param width_m2_ab resonance width
+     * @param d_M d value / d M_R
+     * @param d_W d value / d width_m2_ab
+     * @return Breit-Wigner dynamical form factor
+     */
+    inline
+    complex::complex_scalar<double>
+    value_partials(double M_R, double m2_ab, double width_m2_ab,
+                   complex::complex_scalar<double>& d_M,
+                   complex::complex_scalar<double>& d_W) {
+
+      complex::complex_scalar<double> res
+        = fct::breit_wigner::value(M_R, m2_ab, width_m2_ab);
+
+      // res = 1 / D, D = M_R^2 - m2_ab - i M_R width: d res = - res^2 d D
+      complex::complex_scalar<double> minus_res2(
+        res.im * res.im - res.re * res.re, - 2. * res.re * res.im);
+
+      d_M = complex::scalar::mult(minus_res2,
+        complex::complex_scalar<double>(2. * M_R, - width_m2_ab));
+      d_W = complex::scalar::mult(minus_res2,
+        complex::complex_scalar<double>(0., - M_R));
+
+      return res;
+    }
+
+
+    /**
+     * Return the Breit-Wigner form factor for autodiff parameters
+     * M_R, width_m2_ab and a fixed m2_ab (analytic partials).
+     */
+    template <typename T0, typename T2>
+    typename std::enable_if<likelihood::reverse_mode<T0,T2>::value,
+      complex::complex_scalar<typename boost::math::tools::promote_args<T0,T2>::type> >::type
+    value(const T0& M_R, double m2_ab, const T2& width_m2_ab) {
+
+      typedef typename boost::math::tools::promote_args<T0,T2>::type T_res;
+
+      std::vector<complex::complex_scalar<double> > grad(2);
+      complex::complex_scalar<double> res = value_partials(
+        likelihood::value(M_R), m2_ab, likelihood::value(width_m2_ab),
+        grad[0], grad[1]);
+
+      std::vector<T_res> operands;
+      operands.push_back(T_res(M_R));
+      operands.push_back(T_res(width_m2_ab));
+      return likelihood::attach_gradients(res, operands, grad);
+    }
+
+
     /**
      * Return Relativistic Breit Wigner resonance width.
      *
@@ -62,6 +135,109 @@ namespace fct {
     }
 
 
+    /**
+     * Return Relativistic Breit Wigner resonance width, as above, for a
+     * precomputed mass m_ab = sqrt(m2_ab) and squared breakup momentum
+     * p2_ab = breakup_momentum::p2(m2_ab, m_a, m_b) (event context).
+     *
+     * @param M_R resonance mass
+     * @param W_R resonance width
+     * @param J_R resonance spin
+     * @param r_R resonance radius
+     * @param m_ab invariant mass of a and b
+     * @param p2_ab squared breakup momentum at m_ab
+     * @param m_a 1st daughter mass
+     * @param m_b 2nd daughter mass
+     */
+    template <typename T0, typename T1, typename T2>
+    typename boost::math::tools::promote_args<T0,T1,T2>::type
+    relativistic_width(double M_R, double W_R, double J_R, double r_R,
+		       const T0& m_ab, const T0& p2_ab,
+		       const T1& m_a, const T2& m_b) {
+
+      typedef typename boost::math::tools::promote_args<T0,T1,T2>::type T_res;
+      T_res res;
+      res = W_R * M_R / m_ab *
+        pow(p2_ab / fct::breakup_momentum::p2(M_R*M_R, m_a, m_b), J_R + 0.5) *
+        pow(fct::blatt_weisskopf_p2(J_R, r_R*r_R, p2_ab), 2) /
+        pow(fct::blatt_weisskopf(J_R, r_R*r_R, M_R*M_R, m_a, m_b), 2);
+
+      return res;
+    }
+
+
+    /**
+     * Return the relativistic width as above (precomputed m_ab, p2_ab),
+     * and its partial derivatives with respect to M_R and W_R.
+     *
+     * @param d_M d width / d M_R
+     * @param d_W d width / d W_R
+     */
+    inline
+    double
+    relativistic_width_partials(double M_R, double W_R, double J_R, double r_R,
+                                double m_ab, double p2_ab,
+                                double m_a, double m_b,
+                                double& d_M, double& d_W) {
+
+      double res = relativistic_width(M_R, W_R, J_R, r_R, m_ab, p2_ab, m_a, m_b);
+
+      // The width is linear in W_R
+      d_W = W_R != 0. ? res / W_R
+        : relativistic_width(M_R, 1., J_R, r_R, m_ab, p2_ab, m_a, m_b);
+
+      // d p2_R / d M_R, p2_R = p2(M_R^2, m_a, m_b), and d log B_R / d p2_R
+      // of the Blatt-Weisskopf factor at M_R
+      double p2_R = fct::breakup_momentum::p2(M_R * M_R, m_a, m_b);
+      double dp2_R = 2. * M_R * fct::breakup_momentum::dp2_dm2_R(M_R * M_R, m_a, m_b);
+      double dlog_B = fct::blatt_weisskopf_p2_dlog(J_R, r_R * r_R, p2_R);
+
+      // width ~ M_R p2_R^-(J_R + 1/2) B_R^-2
+      d_M = res * (1. / M_R - ((J_R + 0.5) / p2_R + 2. * dlog_B) * dp2_R);
+
+      return res;
+    }
+
+
+    /**
+     * Return the relativistic width for autodiff parameters M_R, W_R
+     * and fixed kinematics (analytic partials), precomputed m_ab and
+     * p2_ab ...
+     */
+    template <typename T3, typename T4>
+    typename std::enable_if<likelihood::reverse_mode<T3,T4>::value,
+      typename boost::math::tools::promote_args<T3,T4>::type>::type
+    relativistic_width(const T3& M_R, const T4& W_R, double J_R, double r_R,
+                       double m_ab, double p2_ab, double m_a, double m_b) {
+
+      typedef typename boost::math::tools::promote_args<T3,T4>::type T_res;
+
+      std::vector<double> grad(2);
+      double res = relativistic_width_partials(
+        likelihood::value(M_R), likelihood::value(W_R), J_R, r_R,
+        m_ab, p2_ab, m_a, m_b, grad[0], grad[1]);
+
+      std::vector<T_res> operands;
+      operands.push_back(T_res(M_R));
+      operands.push_back(T_res(W_R));
+      return likelihood::attach_gradients(res, operands, grad);
+    }
+
+
+    /**
+     * ... or at m2_ab.
+     */
+    template <typename T3, typename T4>
+    typename std::enable_if<likelihood::reverse_mode<T3,T4>::value,
+      typename boost::math::tools::promote_args<T3,T4>::type>::type
+    relativistic_width(const T3& M_R, const T4& W_R, double J_R, double r_R,
+                       double m2_ab, double m_a, double m_b) {
+
+      return relativistic_width(M_R, W_R, J_R, r_R, sqrt(m2_ab),
+        fct::breakup_momentum::p2(m2_ab, m_a, m_b), m_a, m_b);
+    }
+
+
   }
 }
 #endif
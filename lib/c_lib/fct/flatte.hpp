@@ -3,10 +3,12 @@
 
 #include <vector>
 #include <cmath>
+#include <type_traits> // std::enable_if
 
 #include <meson_deca/lib/c_lib/structures/particles.hpp> // particles::pi, k
 #include <meson_deca/lib/c_lib/fct/breakup_momentum.hpp> // breakup_momentum::complex_p
 #include <meson_deca/lib/c_lib/complex.hpp>
+#include <meson_deca/lib/c_lib/likelihood/gradient.hpp>
 
 
 namespace fct {
@@ -25,30 +27,138 @@ namespace fct {
      * @return Flatte dynamical form factor
      */
     template <typename T0, typename T1, typename T2, typename T3>
-    std::vector<typename boost::math::tools::promote_args<T0,T1,T2,T3>::type>
+    complex::complex_scalar<typename boost::math::tools::promote_args<T0,T1,T2,T3>::type>
     value(const T0& M_R, const T1& m2_ab, const T2& gpp, const T3& gkk) {
 
-      typedef typename boost::math::tools::promote_args<T0,T1,T2,T3>::type T_res;
-      std::vector<T_res> pp(2);
-      std::vector<T_res> kk(2);
-      std::vector<T_res> temp(2);
-
-      pp = complex::scalar::mult(complex::scalar::complex(gpp * gpp, 0.0),
-             fct::breakup_momentum::complex_p(m2_ab, particles::pi.m, 
-					      particles::pi.m));
-
-      kk = complex::scalar::mult(complex::scalar::complex(gkk * gkk, 0.0),
-             fct::breakup_momentum::complex_p(m2_ab, particles::k.m,
-					      particles::k.m));
-     
-      temp = complex::scalar::mult(complex::scalar::complex(0.0, 1.0), 
-				   complex::scalar::add(pp,kk));
-
-      return complex::scalar::inverse(
-        complex::scalar::subtract(
-	complex::scalar::complex(M_R*M_R - m2_ab, 0.0), 
-	complex::scalar::mult(complex::scalar::complex(2. / sqrt(m2_ab),0.0),
-			      temp)));
+      // One fused evaluation (complex/expression.hpp): the real factors
+      // and i are not multiplied as complex numbers
+      return complex::expression::eval(
+        complex::expression::inverse(
+        complex::expression::subtract(
+          M_R*M_R - m2_ab,
+          complex::expression::mult(2. / sqrt(m2_ab),
+          complex::expression::times_i(
+          complex::expression::add(
+            complex::expression::mult(gpp * gpp,
+              fct::breakup_momentum::complex_p(m2_ab, particles::pi.m,
+                                               particles::pi.m)),
+            complex::expression::mult(gkk * gkk,
+              fct::breakup_momentum::complex_p(m2_ab, particles::k.m,
+                                               particles::k.m))))))));
+    }
+
+
+    /**
+     * Return complex Flatte form factor, as above, for a precomputed
+     * mass m_ab = sqrt(m2_ab) and squared pi pi breakup momentum
+     * p2_pp = breakup_momentum::p2(m2_ab, pi.m, pi.m) (event context).
+     *
+     * @param M_R resonance mass
+     * @param m2_ab Dalitz plot variable (squared mass)
+     * @param m_ab sqrt(m2_ab)
+     * @param p2_pp squared pi pi breakup momentum at m_ab
+     * @param gpp phase-space factor*coupling const**2 of the channel -> pi+pi
+     * @param gkk -//-                                 of the channel -> K+K
+     * @return Flatte dynamical form factor
+     */
+    template <typename T0, typename T1, typename T2, typename T3>
+    complex::complex_scalar<typename boost::math::tools::promote_args<T0,T1,T2,T3>::type>
+    value(const T0& M_R, const T1& m2_ab, const T1& m_ab, const T1& p2_pp,
+          const T2& gpp, const T3& gkk) {
+
+      return complex::expression::eval(
+        complex::expression::inverse(
+        complex::expression::subtract(
+          M_R*M_R - m2_ab,
+          complex::expression::mult(2. / m_ab,
+          complex::expression::times_i(
+          complex::expression::add(
+            complex::expression::mult(gpp * gpp,
+              fct::breakup_momentum::complex_p_p2(p2_pp)),
+            complex::expression::mult(gkk * gkk,
+              fct::breakup_momentum::complex_p(m2_ab, particles::k.m,
+                                               particles::k.m))))))));
+    }
+
+
+    /**
+     * Return the Flatte form factor as above (precomputed m_ab, p2_pp),
+     * and its partial derivatives with respect to M_R, gpp and gkk.
+     *
+     * @param d_M d value / d M_R
+     * @param d_gpp d value / d gpp
+     * @param d_gkk d value / d gkk
+     */
+    inline
+    complex::complex_scalar<double>
+    value_partials(double M_R, double m2_ab, double m_ab, double p2_pp,
+                   double gpp, double gkk,
+                   complex::complex_scalar<double>& d_M,
+                   complex::complex_scalar<double>& d_gpp,
+                   complex::complex_scalar<double>& d_gkk) {
+
+      complex::complex_scalar<double> res
+        = fct::flatte::value(M_R, m2_ab, m_ab, p2_pp, gpp, gkk);
+
+      // res = 1 / D, D = M_R^2 - m2_ab - 2 i (gpp^2 p_pp + gkk^2 p_kk) / m_ab:
+      // d res = - res^2 d D
+      complex::complex_scalar<double> minus_res2(
+        res.im * res.im - res.re * res.re, - 2. * res.re * res.im);
+
+      // - d D / d g = 4 i g p / m_ab
+      complex::complex_scalar<double> i_pp = complex::expression::eval(
+        complex::expression::times_i(complex::expression::mult(4. / m_ab,
+          fct::breakup_momentum::complex_p_p2(p2_pp))));
+      complex::complex_scalar<double> i_kk = complex::expression::eval(
+        complex::expression::times_i(complex::expression::mult(4. / m_ab,
+          fct::breakup_momentum::complex_p(m2_ab, particles::k.m, particles::k.m))));
+
+      d_M = complex::scalar::mult(2. * M_R, minus_res2);
+      d_gpp = complex::scalar::mult(- gpp, complex::scalar::mult(minus_res2, i_pp));
+      d_gkk = complex::scalar::mult(- gkk, complex::scalar::mult(minus_res2, i_kk));
+
+      return res;
+    }
+
+
+    /**
+     * Return the Flatte form factor for autodiff parameters M_R, gpp,
+     * gkk and fixed kinematics (analytic partials), precomputed m_ab
+     * and p2_pp ...
+     */
+    template <typename T0, typename T2, typename T3>
+    typename std::enable_if<likelihood::reverse_mode<T0,T2,T3>::value,
+      complex::complex_scalar<typename boost::math::tools::promote_args<T0,T2,T3>::type> >::type
+    value(const T0& M_R, double m2_ab, double m_ab, double p2_pp,
+          const T2& gpp, const T3& gkk) {
+
+      typedef typename boost::math::tools::promote_args<T0,T2,T3>::type T_res;
+
+      std::vector<complex::complex_scalar<double> > grad(3);
+      complex::complex_scalar<double> res = value_partials(
+        likelihood::value(M_R), m2_ab, m_ab, p2_pp,
+        likelihood::value(gpp), likelihood::value(gkk),
+        grad[0], grad[1], grad[2]);
+
+      std::vector<T_res> operands;
+      operands.push_back(T_res(M_R));
+      operands.push_back(T_res(gpp));
+      operands.push_back(T_res(gkk));
+      return likelihood::attach_gradients(res, operands, grad);
+    }
+
+
+    /**
+     * ... or at m2_ab.
+     */
+    template <typename T0, typename T2, typename T3>
+    typename std::enable_if<likelihood::reverse_mode<T0,T2,T3>::value,
+      complex::complex_scalar<typename boost::math::tools::promote_args<T0,T2,T3>::type> >::type
+    value(const T0& M_R, double m2_ab, const T2& gpp, const T3& gkk) {
+
+      return fct::flatte::value(M_R, m2_ab, sqrt(m2_ab),
+        fct::breakup_momentum::p2(m2_ab, particles::pi.m, particles::pi.m),
+        gpp, gkk);
     }
   }
 }
@@ -0,0 +1,286 @@
+#ifndef MESON_DECA__LIB__C_LIB__FCT__LINESHAPE_TABLE_HPP
+#define MESON_DECA__LIB__C_LIB__FCT__LINESHAPE_TABLE_HPP
+
+#include <algorithm> // std::max, std::min, std::upper_bound
+#include <cmath> // sqrt
+#include <vector>
+
+#include <meson_deca/lib/c_lib/complex.hpp>
+
+/*
+ * Tabulated complex functions of one variable.
+ *
+ * DESCRIPTION
+ *   With fixed masses and widths, the lineshape of a resonance (e.g.
+ *   F_P F_R T_R of resonances::breit_wigner) depends on m2_ab only. A
+ *   lineshape_table replaces it by piecewise cubic interpolation on a
+ *   non-uniform grid over [s_min, s_max]:
+ *
+ *   - Lineshapes have square root branch points at the thresholds
+ *     of the breakup momenta: s_min and, e.g. for Flatte, the K K
+ *     threshold. The range is cut into segments at these points;
+ *     every segment is tabulated in u = sqrt(|s - s_k|), s_k the
+ *     branch point at its end, in which the lineshape is smooth.
+ *   - Every interval holds the cubic through f at its ends and at
+ *     1/3, 2/3 of it (f is never evaluated outside [s_min, s_max]).
+ *   - An interval is split in halves until the interpolation error at
+ *     1/6, 1/2, 5/6 of it is below tol / 4 * scale, scale = max |f|
+ *     (the factor 4 covers the error between the test points). The
+ *     grid is fine near the peaks and coarse elsewhere.
+ *   - A uniform index of the intervals of a segment finds the interval
+ *     of u in a few comparisons.
+ *
+ *   max_error() is the largest error at the test points relative to
+ *   scale, i.e. the achieved bound; check() compares the table with f
+ *   on an independent, dense grid.
+ *
+ * TYPES
+ *   lineshape_table
+ */
+
+namespace fct {
+
+  /**
+   * lineshape_table
+   *
+   * Piecewise cubic interpolant of f: [s_min, s_max] -> C, see above.
+   */
+  class lineshape_table {
+  public:
+    static const int initial_intervals = 32; // Per segment
+    static const int max_depth = 30;         // Bisections of an interval
+    static const int intervals_per_bucket = 2;
+
+    lineshape_table() : s_min_(0.), s_max_(0.), tol_(0.), scale_(0.),
+                        max_error_(0.) {};
+
+    /**
+     * lineshape_table(f, s_min, s_max, tol, branch_points)
+     *
+     * Tabulates f, a callable double -> complex_scalar<double>, with
+     * the error bound tol relative to max |f|. branch_points are the
+     * square root branch points of f inside (s_min, s_max), if any.
+     */
+    template <typename F>
+    lineshape_table(const F& f, double s_min, double s_max, double tol,
+                    const std::vector<double>& branch_points
+                      = std::vector<double>()) :
+      s_min_(s_min), s_max_(s_max), tol_(tol), scale_(0.), max_error_(0.) {
+
+      // Scale of f from a uniform grid, raised by later evaluations
+      const int n_scale = 1024;
+      for (int i = 0; i <= n_scale; i++) {
+        double s = i == n_scale ? s_max_ : s_min_ + (s_max_ - s_min_) * i / n_scale;
+        scale_ = std::max(scale_, abs(f(s)));
+      }
+
+      // Cuts: s_min, the branch points and the midpoints between two
+      // branch points; a segment is anchored at its branch point
+      std::vector<double> b(1, s_min_);
+      for (size_t k = 0; k < branch_points.size(); k++)
+        if (branch_points[k] > s_min_ && branch_points[k] < s_max_)
+          b.push_back(branch_points[k]);
+      std::sort(b.begin(), b.end());
+      for (size_t k = 0; k < b.size(); k++) {
+        double s_end = k + 1 < b.size() ? 0.5 * (b[k] + b[k + 1]) : s_max_;
+        if (k > 0)
+          add_segment(f, b[k], -1., b[k] - 0.5 * (b[k - 1] + b[k]));
+        add_segment(f, b[k], 1., s_end - b[k]);
+      }
+    }
+
+    /**
+     * complex_scalar<double> operator()(s)
+     *
+     * Interpolated value at s; s is clamped to [s_min, s_max].
+     */
+    complex::complex_scalar<double> operator()(double s) const {
+      s = std::min(std::max(s, s_min_), s_max_);
+      size_t k = 0;
+      while (k + 1 < segments_.size() && s > segments_[k].end())
+        k++;
+      return segments_[k](s);
+    }
+
+    double s_min() const {
+      return s_min_;
+    }
+
+    double s_max() const {
+      return s_max_;
+    }
+
+    int intervals() const {
+      int n = 0;
+      for (size_t k = 0; k < segments_.size(); k++)
+        n += segments_[k].intervals();
+      return n;
+    }
+
+    double tolerance() const {
+      return tol_;
+    }
+
+    // Largest error at the test points, relative to max |f|
+    double max_error() const {
+      return max_error_;
+    }
+
+    /**
+     * double check(f, n)
+     *
+     * Largest difference between the table and f at n + 1 uniform
+     * points and at the midpoints between them, relative to max |f|.
+     */
+    template <typename F>
+    double check(const F& f, int n) const {
+      double err = 0.;
+      for (int i = 0; i <= 2 * n; i++) {
+        double s = i == 2 * n ? s_max_ : s_min_ + (s_max_ - s_min_) * i / (2 * n);
+        err = std::max(err, abs(complex::scalar::subtract((*this)(s), f(s))));
+      }
+      return err / scale_;
+    }
+
+  private:
+
+    // Part of the range between s(0) and s(u_max), s(u) = anchor + sign u^2
+    struct segment {
+      double anchor, sign, u_max;
+      std::vector<double> knots;      // intervals() + 1 values of u
+      std::vector<double> inv_width;  // 1 / width of every interval
+      std::vector<double> coef;       // re, im of c_0 .. c_3 per interval
+      std::vector<int> bucket;        // First interval of every bucket
+      double inv_bucket;
+
+      double s(double u) const {
+        return anchor + sign * u * u;
+      }
+
+      // Upper end in s
+      double end() const {
+        return sign > 0 ? s(u_max) : anchor;
+      }
+
+      int intervals() const {
+        return knots.size() - 1;
+      }
+
+      complex::complex_scalar<double> operator()(double s) const {
+        double u = std::min(sqrt(std::max(sign * (s - anchor), 0.)), u_max);
+        int j = std::min(int(u * inv_bucket), (int) bucket.size() - 2);
+        int i = bucket[j];
+        int i_end = bucket[j + 1];
+        if (i_end > i) // Intervals starting before the next bucket
+          i = std::upper_bound(knots.begin() + i + 1, knots.begin() + i_end + 1, u)
+            - knots.begin() - 1;
+        i = std::min(i, intervals() - 1);
+
+        double x = (u - knots[i]) * inv_width[i];
+        const double* c = &coef[8 * i];
+        return complex::complex_scalar<double>(
+          c[0] + x * (c[2] + x * (c[4] + x * c[6])),
+          c[1] + x * (c[3] + x * (c[5] + x * c[7])));
+      }
+    };
+
+    double s_min_, s_max_;
+    double tol_, scale_, max_error_;
+    std::vector<segment> segments_; // In the order of s
+
+    // s of the point u of seg, kept inside [s_min, s_max] (rounding)
+    double s_of(const segment& seg, double u) const {
+      return std::min(std::max(seg.s(u), s_min_), s_max_);
+    }
+
+    static double abs(const complex::complex_scalar<double>& z) {
+      return sqrt(z.re * z.re + z.im * z.im);
+    }
+
+    // Tabulates f on s = anchor + sign u^2, 0 <= u <= sqrt(length)
+    template <typename F>
+    void add_segment(const F& f, double anchor, double sign, double length) {
+      segment seg;
+      seg.anchor = anchor;
+      seg.sign = sign;
+      seg.u_max = sqrt(length);
+      seg.knots.push_back(0.);
+
+      complex::complex_scalar<double> f_0 = f(s_of(seg, 0.));
+      for (int i = 0; i < initial_intervals; i++) {
+        double u_1 = seg.u_max * (i + 1) / initial_intervals;
+        complex::complex_scalar<double> f_1 = f(s_of(seg, u_1));
+        refine(f, seg, seg.knots.back(), u_1, f_0, f_1, 0);
+        f_0 = f_1;
+      }
+
+      int n = seg.intervals();
+      int buckets = intervals_per_bucket * n;
+      seg.inv_bucket = buckets / seg.u_max;
+      seg.bucket.resize(buckets + 1);
+      int i = 0;
+      for (int j = 0; j <= buckets; j++) {
+        double u = j / seg.inv_bucket;
+        while (i + 1 < n && seg.knots[i + 1] <= u)
+          i++;
+        seg.bucket[j] = i;
+      }
+
+      segments_.push_back(seg);
+    }
+
+    // Appends the interval [u_0, u_1] (f_0, f_1 at its ends) to seg,
+    // split in halves until the error bound holds
+    template <typename F>
+    void refine(const F& f, segment& seg, double u_0, double u_1,
+                const complex::complex_scalar<double>& f_0,
+                const complex::complex_scalar<double>& f_1, int depth) {
+      double h = u_1 - u_0;
+      complex::complex_scalar<double> f_a = f(s_of(seg, u_0 + h / 3.));
+      complex::complex_scalar<double> f_b = f(s_of(seg, u_0 + 2. * h / 3.));
+
+      // Cubic through x = 0, 1/3, 2/3, 1
+      double c[8];
+      fit(f_0.re, f_a.re, f_b.re, f_1.re, c);
+      fit(f_0.im, f_a.im, f_b.im, f_1.im, c + 1);
+
+      const double x_test[3] = {1. / 6., 0.5, 5. / 6.};
+      complex::complex_scalar<double> f_mid;
+      double err = 0.;
+      for (int k = 0; k < 3; k++) {
+        double x = x_test[k];
+        complex::complex_scalar<double> f_x = f(s_of(seg, u_0 + x * h));
+        if (k == 1)
+          f_mid = f_x;
+        scale_ = std::max(scale_, abs(f_x));
+        double re = c[0] + x * (c[2] + x * (c[4] + x * c[6]));
+        double im = c[1] + x * (c[3] + x * (c[5] + x * c[7]));
+        err = std::max(err, abs(complex::complex_scalar<double>(re - f_x.re,
+                                                                im - f_x.im)));
+      }
+
+      if (err <= 0.25 * tol_ * scale_ || depth == max_depth) {
+        seg.knots.push_back(u_1);
+        seg.inv_width.push_back(1. / h);
+        seg.coef.insert(seg.coef.end(), c, c + 8);
+        max_error_ = std::max(max_error_, err / scale_);
+        return;
+      }
+      double u_mid = u_0 + 0.5 * h;
+      refine(f, seg, u_0, u_mid, f_0, f_mid, depth + 1);
+      refine(f, seg, u_mid, u_1, f_mid, f_1, depth + 1);
+    }
+
+    // Coefficients c[0], c[2], c[4], c[6] of the cubic with the values
+    // f_0 .. f_3 at x = 0, 1/3, 2/3, 1
+    static void fit(double f_0, double f_1, double f_2, double f_3, double* c) {
+      c[0] = f_0;
+      c[2] = 0.5 * (-11. * f_0 + 18. * f_1 - 9. * f_2 + 2. * f_3);
+      c[4] = 0.5 * (18. * f_0 - 45. * f_1 + 36. * f_2 - 9. * f_3);
+      c[6] = 0.5 * (-9. * f_0 + 27. * f_1 - 27. * f_2 + 9. * f_3);
+    }
+  };
+
+}
+
+#endif
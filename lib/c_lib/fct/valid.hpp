@@ -12,7 +12,11 @@
  * FUNCTIONS
  * valid(m2_ab, m2_bc, p, a, b, c) - Check m2_ab, m2_bc for p->abc decay
  * valid(m2_ab, m2_bc, m2_p, m2_a, m2_b, m2_c) - As above, other input type
- * valid_5d() // WRONG. To be corrected.
+ * valid_5d(m2_12, m2_14, m2_23, m2_34, m2_13, p, a, b, c, d) - P->abcd
+ * gram_det_4(x_01, ..., m2_3) - Gram determinant of the 4-body decay
+ * gram_det_3(x_01, x_02, x_12, m2_0, m2_1, m2_2) - the same for 3 momenta
+ *
+ * Batched, branch-free versions: valid_mask.hpp
  * 
  */
 
@@ -95,14 +99,78 @@ namespace fct {
 
 
   /**
-   * bool valid_5d(m2_12, ..., m2_123, p, a, b, c)
+   * T gram_det_4(x_01, x_02, x_03, x_12, x_13, x_23, m2_0, ..., m2_3)
+   *
+   * Determinant of the symmetric 4x4 matrix X with X_ii = 2 m2_i and
+   * X_ij = x_ij = m2_ij - m2_i - m2_j = 2 p_i.p_j, i.e. 16 times the
+   * Gram determinant of the four final state momenta of P -> abcd. It
+   * is negative inside the phase space.
+   *
+   * Evaluated by the Laplace expansion in the 2x2 minors of the rows
+   * 0,1 and 2,3 (about 50 flops).
+   */
+  template <typename T>
+  inline
+  T gram_det_4(const T& x_01, const T& x_02, const T& x_03,
+               const T& x_12, const T& x_13, const T& x_23,
+               double m2_0, double m2_1, double m2_2, double m2_3)
+  {
+    const double x_00 = 2. * m2_0, x_11 = 2. * m2_1;
+    const double x_22 = 2. * m2_2, x_33 = 2. * m2_3;
+
+    // Minors of the rows 0,1 ...
+    T s0 = x_00 * x_11 - x_01 * x_01;
+    T s1 = x_00 * x_12 - x_02 * x_01;
+    T s2 = x_00 * x_13 - x_03 * x_01;
+    T s3 = x_01 * x_12 - x_02 * x_11;
+    T s4 = x_01 * x_13 - x_03 * x_11;
+    T s5 = x_02 * x_13 - x_03 * x_12;
+
+    // ... and of the rows 2,3
+    T c5 = x_22 * x_33 - x_23 * x_23;
+    T c4 = x_12 * x_33 - x_23 * x_13;
+    T c3 = x_12 * x_23 - x_22 * x_13;
+    T c2 = x_02 * x_33 - x_23 * x_03;
+    T c1 = x_02 * x_23 - x_22 * x_03;
+    T c0 = x_02 * x_13 - x_12 * x_03;
+
+    return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+  }
+
+
+  /**
+   * T gram_det_3(x_01, x_02, x_12, m2_0, m2_1, m2_2)
+   *
+   * Determinant of the symmetric 3x3 matrix X with X_ii = 2 m2_i and
+   * X_ij = x_ij = 2 p_i.p_j (cf. gram_det_4), i.e. 8 times the Gram
+   * determinant of three momenta. It is positive if the three momenta
+   * are physical (inside the Dalitz plot of their 3-body subsystem).
+   */
+  template <typename T>
+  inline
+  T gram_det_3(const T& x_01, const T& x_02, const T& x_12,
+               double m2_0, double m2_1, double m2_2)
+  {
+    const double x_00 = 2. * m2_0, x_11 = 2. * m2_1, x_22 = 2. * m2_2;
+    return x_00 * (x_11 * x_22 - x_12 * x_12)
+      - x_01 * (x_01 * x_22 - x_12 * x_02)
+      + x_02 * (x_01 * x_12 - x_11 * x_02);
+  }
+
+
+  /**
+   * bool valid_5d(m2_12, ..., m2_13, p, a, b, c, d)
    *
    * Determines whether we are in an energetically allowed
    * phase space region of the decay P -> R_1 d -> R_2 c d -> a b c d.
    *
-   * The variable m2_123 is passed, although it can also be derived 
-   * from the invariant masses before that. We pass it to save one
-   * computation line; maybe it does not really matter (sigh).
+   * After the bounds of the single invariants, the point is inside if
+   * the Gram determinant of the momenta (gram_det_4) is negative and
+   * the one of a, b, c (gram_det_3) is positive. Together with the
+   * thresholds of m2_12 this gives the Gram matrix the signature of
+   * four physical momenta; a negative gram_det_4 alone also admits
+   * points with the opposite signature (about 1.3% of the accepted
+   * points for D -> 4 pi).
    */
   template <typename T0, typename T1, typename T2, typename T3, typename T4>
   bool valid_5d(const T0 &m2_12, const T1 &m2_14, const T2 &m2_23,
@@ -111,24 +179,23 @@ namespace fct {
 		const particle &a, const particle &b, 
 		const particle &c, const particle &d)
   {
-    typedef typename boost::math::tools::promote_args<T1,T3,T4>::type T_134;
     typedef typename boost::math::tools::promote_args<T0,T1,T2,T3,T4>::type T_res;
 
     // 5D hypercube lower boundaries
-    if ( m2_12 < pow(a.m + b.m, 2) ||
-         m2_14 < pow(a.m + d.m, 2) ||
-         m2_23 < pow(b.m + c.m, 2) ||
-         m2_34 < pow(c.m + d.m, 2) ||
-         m2_13 < pow(a.m + c.m, 2) ) {
+    if ( m2_12 < (a.m + b.m) * (a.m + b.m) ||
+         m2_14 < (a.m + d.m) * (a.m + d.m) ||
+         m2_23 < (b.m + c.m) * (b.m + c.m) ||
+         m2_34 < (c.m + d.m) * (c.m + d.m) ||
+         m2_13 < (a.m + c.m) * (a.m + c.m) ) {
       return 0;
     }
 
     // 5D hypercube upper boundaries
-    if ( m2_12 > pow(Parent.m - c.m - d.m, 2) ||
-         m2_14 > pow(Parent.m - b.m - c.m, 2) ||
-         m2_23 > pow(Parent.m - a.m - d.m, 2) ||
-         m2_34 > pow(Parent.m - a.m - b.m, 2) ||
-         m2_13 > pow(Parent.m - b.m - d.m, 2) ) {
+    if ( m2_12 > (Parent.m - c.m - d.m) * (Parent.m - c.m - d.m) ||
+         m2_14 > (Parent.m - b.m - c.m) * (Parent.m - b.m - c.m) ||
+         m2_23 > (Parent.m - a.m - d.m) * (Parent.m - a.m - d.m) ||
+         m2_34 > (Parent.m - a.m - b.m) * (Parent.m - a.m - b.m) ||
+         m2_13 > (Parent.m - b.m - d.m) * (Parent.m - b.m - d.m) ) {
       return 0;
     }
 
@@ -139,54 +206,21 @@ namespace fct {
          sqrt(m2_13) + sqrt(m2_24) > Parent.m ) {
       return 0;
     }
-    
-
-
-
-    const T0 M = m2_12;
-    const T0 M2 = M*M;
-
-    const T3 N = m2_34;
-    const T3 N2 = N*N;
 
-    const T_res P = m2_12 + m2_14 + m2_24 - a.m2 - b.m2 - d.m2; // m2_124
-    const T_res P2 = P*P;
+    // 16 times the Gram determinant; formerly expanded into a
+    // polynomial of about 100 terms in the 3-body masses
+    T_res B = gram_det_4(T_res(m2_12 - a.m2 - b.m2), T_res(m2_13 - a.m2 - c.m2),
+                         T_res(m2_14 - a.m2 - d.m2), T_res(m2_23 - b.m2 - c.m2),
+                         T_res(m2_24 - b.m2 - d.m2), T_res(m2_34 - c.m2 - d.m2),
+                         a.m2, b.m2, c.m2, d.m2);
 
-    const T_134 Q = m2_13 + m2_14 + m2_34 - a.m2 - c.m2 - d.m2; // m2_134;
-    const T_134 Q2 = Q*Q;
-
-    const T1 R = m2_14;
-    const T1 R2 = R*R;
-
-    const double m = c.m2;
-    const double m2 = m*m;
-
-    const double n = b.m2;
-    const double n2 = n*n;
-    
-    const double p = a.m2;
-    const double p2 = p*p;
-
-    const double q = d.m2;
-    const double q2 = q*q;
+    if (B >= 0.)
+      return false;
 
-    const double r = Parent.m2; // E^2
-    const double r2 = r*r;
+    T_res B_abc = gram_det_3(T_res(m2_12 - a.m2 - b.m2), T_res(m2_13 - a.m2 - c.m2),
+                             T_res(m2_23 - b.m2 - c.m2), a.m2, b.m2, c.m2);
 
-    
-    T_res B = (M2*Q2 + N2*P2 + M2*R2 + N2*R2 + P2*Q2) - 2.*(M2*Q*R + N2*P*R + M*N*R2 + M*P*Q2 + N*P2*Q)
-        + 2.*(M*N*P*Q + M*N*P*R + M*N*Q*R + M*P*Q*R + N*P*Q*R) - 2.*(M2*Q*m + N2*P*n + M2*R*m + N2*R*n + M*Q2*q
-            + N*P2*p + M*R2*r + N*R2*r + P2*Q*p + P*Q2*q) - 2.*(M*N*P*m + M*N*Q*n + M*P*R*p + N*Q*R*q + P*Q*R*r)
-        + 2.*(M*N*R*(m + n - 2.*r) + M*P*Q*(m + p - 2.*q) + N*Q*P*(n + q - 2.*p) + Q*R*M*(q + r - 2.*m) + P*R*N*(p + r - 2.*n))
-        + (M2*m2 + N2*n2 + P2*p2 + Q2*q2 + R2*r2) + 2.*(M*N*m*n + M*P*m*p + N*Q*n*q + P*R*p*r + Q*R*q*r)
-        + 2.*(M*Q*(m*q + m*n + q*n + m*p + q*r - p*r) + N*P*(n*p + n*m + p*m + p*r + n*q - q*r) + M*R*(m*r + m*p + r*p + m*n + r*q - n*q)
-            + N*R*(n*r + n*q + r*q + n*m + r*p - m*p) + P*Q*(p*q + p*r + q*r + p*m + q*n - m*n) ) - 2.*(M*m*(m*p + m*n + q*r - p*r - n*q + 2.*n*p)
-            + N*n*(n*m + n*q + p*r - p*m - q*r + 2.*m*q) + P*p*(p*m + p*r + n*q - m*n - q*r + 2.*m*r) + Q*q*(q*n + q*r + m*p - m*n - p*r + 2.*n*r) 
-            + R*r*(r*p + r*q + m*n - m*p - n*q + 2.*p*q) ) + (m2*n2 + m2*p2 + n2*q2 + p2*r2 + q2*r2) - 2.*(m2*n*p + m*n2*q + m*p2*r + n*q2*r + p*q*r2)
-            + 2.*(m*n*p*q + m*n*p*r + m*n*q*r + m*p*q*r + n*p*q*r);
-
-  
-    if (B < 0.)
+    if (B_abc > 0.)
       return true;
 
     return false;
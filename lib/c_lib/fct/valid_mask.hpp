@@ -0,0 +1,296 @@
+#ifndef MESON_DECA__LIB__C_LIB__FCT__VALID_MASK_HPP
+#define MESON_DECA__LIB__C_LIB__FCT__VALID_MASK_HPP
+
+#include <cmath> // sqrt
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include <meson_deca/lib/c_lib/fct/valid.hpp>
+#include <meson_deca/lib/c_lib/structures/struct_particles.hpp>
+// class particle
+
+/*
+ * Branch-free phase space checks for arrays of points.
+ *
+ * DESCRIPTION
+ *   The integrators and the generator reject a large part of their
+ *   points, so they check whole batches first. The kernels write one
+ *   byte (0 or 1) per point and contain no data-dependent branches:
+ *   with AVX-512 or AVX2 enabled at compile time (e.g. -march=native),
+ *   8 or 4 points are checked per instruction, otherwise the scalar
+ *   loop is left to the auto-vectorizer.
+ *
+ *   valid_mask uses the Dalitz plot boundary without square roots or
+ *   divisions:
+ *
+ *     |2 s (m2_bc - m2_b - m2_c) - u v| <= sqrt(L_b L_c),
+ *     u = s - m2_a + m2_b,  v = m2_p - s - m2_c,
+ *     L_b = u^2 - 4 s m2_b,  L_c = v^2 - 4 s m2_c,  s = m2_ab,
+ *
+ *   (fct::valid multiplied by 4 s^2 and squared). valid_5d_mask uses
+ *   the bounds of fct::valid_5d, gram_det_4 and gram_det_3. Both agree
+ *   with the scalar functions up to rounding at the boundary.
+ *
+ * FUNCTIONS
+ *   valid_mask(m2_ab, m2_bc, n, p, a, b, c, mask)
+ *   valid_5d_mask(m2_12, m2_14, m2_23, m2_34, m2_13, n, p, a, b, c, d, mask)
+ */
+
+namespace fct {
+
+  /**
+   * dalitz_bounds
+   *
+   * Constants of valid_mask for the decay p -> a + b + c.
+   */
+  struct dalitz_bounds {
+    double lo, hi;           // Range of m2_ab
+    double m2_a, m2_b, m2_c, m2_p;
+
+    dalitz_bounds(const particle &p, const particle &a,
+                  const particle &b, const particle &c) :
+      lo(a.m2 + b.m2 + 2. * sqrt(a.m2 * b.m2)),
+      hi(p.m2 + c.m2 - 2. * sqrt(p.m2 * c.m2)),
+      m2_a(a.m2), m2_b(b.m2), m2_c(c.m2), m2_p(p.m2) {};
+
+    // One point, without branches
+    bool inside(double s, double t) const {
+      double u = s - m2_a + m2_b;
+      double v = m2_p - s - m2_c;
+      double X = 2. * s * (t - m2_b - m2_c) - u * v;
+      double L_b = u * u - 4. * s * m2_b;
+      double L_c = v * v - 4. * s * m2_c;
+      return (s >= lo) & (s <= hi) & (L_b >= 0.) & (L_c >= 0.)
+        & (X * X <= L_b * L_c);
+    }
+  };
+
+
+  /**
+   * void valid_mask(m2_ab, m2_bc, n, p, a, b, c, mask)
+   *
+   * mask[k] = valid(m2_ab[k], m2_bc[k], p, a, b, c) for k < n.
+   */
+  inline
+  void valid_mask(const double* m2_ab, const double* m2_bc, int n,
+                  const particle &p, const particle &a,
+                  const particle &b, const particle &c,
+                  unsigned char* mask)
+  {
+    const dalitz_bounds B(p, a, b, c);
+    int k = 0;
+
+#if defined(__AVX512F__)
+    const __m512d lo = _mm512_set1_pd(B.lo), hi = _mm512_set1_pd(B.hi);
+    const __m512d m2_a = _mm512_set1_pd(B.m2_a), m2_b = _mm512_set1_pd(B.m2_b);
+    const __m512d m2_c = _mm512_set1_pd(B.m2_c), m2_p = _mm512_set1_pd(B.m2_p);
+    const __m512d two = _mm512_set1_pd(2.), four = _mm512_set1_pd(4.);
+    const __m512d zero = _mm512_setzero_pd();
+    for (; k + 8 <= n; k += 8) {
+      __m512d s = _mm512_loadu_pd(m2_ab + k);
+      __m512d t = _mm512_loadu_pd(m2_bc + k);
+      __m512d u = _mm512_add_pd(_mm512_sub_pd(s, m2_a), m2_b);
+      __m512d v = _mm512_sub_pd(_mm512_sub_pd(m2_p, s), m2_c);
+      __m512d X = _mm512_sub_pd(
+        _mm512_mul_pd(_mm512_mul_pd(two, s),
+                      _mm512_sub_pd(_mm512_sub_pd(t, m2_b), m2_c)),
+        _mm512_mul_pd(u, v));
+      __m512d L_b = _mm512_sub_pd(_mm512_mul_pd(u, u),
+                                  _mm512_mul_pd(_mm512_mul_pd(four, s), m2_b));
+      __m512d L_c = _mm512_sub_pd(_mm512_mul_pd(v, v),
+                                  _mm512_mul_pd(_mm512_mul_pd(four, s), m2_c));
+      __mmask8 m = _mm512_cmp_pd_mask(s, lo, _CMP_GE_OQ)
+        & _mm512_cmp_pd_mask(s, hi, _CMP_LE_OQ)
+        & _mm512_cmp_pd_mask(L_b, zero, _CMP_GE_OQ)
+        & _mm512_cmp_pd_mask(L_c, zero, _CMP_GE_OQ)
+        & _mm512_cmp_pd_mask(_mm512_mul_pd(X, X), _mm512_mul_pd(L_b, L_c),
+                             _CMP_LE_OQ);
+      for (int i = 0; i < 8; i++)
+        mask[k + i] = (m >> i) & 1;
+    }
+#elif defined(__AVX2__)
+    const __m256d lo = _mm256_set1_pd(B.lo), hi = _mm256_set1_pd(B.hi);
+    const __m256d m2_a = _mm256_set1_pd(B.m2_a), m2_b = _mm256_set1_pd(B.m2_b);
+    const __m256d m2_c = _mm256_set1_pd(B.m2_c), m2_p = _mm256_set1_pd(B.m2_p);
+    const __m256d two = _mm256_set1_pd(2.), four = _mm256_set1_pd(4.);
+    const __m256d zero = _mm256_setzero_pd();
+    for (; k + 4 <= n; k += 4) {
+      __m256d s = _mm256_loadu_pd(m2_ab + k);
+      __m256d t = _mm256_loadu_pd(m2_bc + k);
+      __m256d u = _mm256_add_pd(_mm256_sub_pd(s, m2_a), m2_b);
+      __m256d v = _mm256_sub_pd(_mm256_sub_pd(m2_p, s), m2_c);
+      __m256d X = _mm256_sub_pd(
+        _mm256_mul_pd(_mm256_mul_pd(two, s),
+                      _mm256_sub_pd(_mm256_sub_pd(t, m2_b), m2_c)),
+        _mm256_mul_pd(u, v));
+      __m256d L_b = _mm256_sub_pd(_mm256_mul_pd(u, u),
+                                  _mm256_mul_pd(_mm256_mul_pd(four, s), m2_b));
+      __m256d L_c = _mm256_sub_pd(_mm256_mul_pd(v, v),
+                                  _mm256_mul_pd(_mm256_mul_pd(four, s), m2_c));
+      __m256d in = _mm256_and_pd(
+        _mm256_and_pd(_mm256_cmp_pd(s, lo, _CMP_GE_OQ),
+                      _mm256_cmp_pd(s, hi, _CMP_LE_OQ)),
+        _mm256_and_pd(_mm256_cmp_pd(L_b, zero, _CMP_GE_OQ),
+                      _mm256_cmp_pd(L_c, zero, _CMP_GE_OQ)));
+      in = _mm256_and_pd(in, _mm256_cmp_pd(_mm256_mul_pd(X, X),
+                                           _mm256_mul_pd(L_b, L_c), _CMP_LE_OQ));
+      int m = _mm256_movemask_pd(in);
+      for (int i = 0; i < 4; i++)
+        mask[k + i] = (m >> i) & 1;
+    }
+#endif
+
+    for (; k < n; k++)
+      mask[k] = B.inside(m2_ab[k], m2_bc[k]);
+  }
+
+
+  /**
+   * gram_bounds
+   *
+   * Constants of valid_5d_mask for the decay P -> a + b + c + d.
+   */
+  struct gram_bounds {
+    double lo[5], hi[5]; // Ranges of m2_12, m2_14, m2_23, m2_34, m2_13
+    double m_P, sum;     // sum = m2_24 + m2_12 + m2_14 + m2_23 + m2_34 + m2_13
+    double m2_a, m2_b, m2_c, m2_d;
+
+    gram_bounds(const particle &P, const particle &a, const particle &b,
+                const particle &c, const particle &d) :
+      m_P(P.m), sum(P.m2 + 2.*(a.m2 + b.m2 + c.m2 + d.m2)),
+      m2_a(a.m2), m2_b(b.m2), m2_c(c.m2), m2_d(d.m2) {
+      const double m[5][2] = {{a.m + b.m, c.m + d.m}, {a.m + d.m, b.m + c.m},
+                              {b.m + c.m, a.m + d.m}, {c.m + d.m, a.m + b.m},
+                              {a.m + c.m, b.m + d.m}};
+      for (int i = 0; i < 5; i++) {
+        lo[i] = m[i][0] * m[i][0];
+        hi[i] = (P.m - m[i][1]) * (P.m - m[i][1]);
+      }
+    }
+
+    // One point, without branches (the order of the variables is that
+    // of valid_5d)
+    bool inside(const double* x) const {
+      bool in = true;
+      for (int i = 0; i < 5; i++)
+        in = in & !(x[i] < lo[i]) & !(x[i] > hi[i]);
+      double m2_24 = sum - x[0] - x[1] - x[2] - x[3] - x[4];
+      in = in & !(sqrt(x[0]) + sqrt(x[3]) > m_P)
+        & !(sqrt(x[1]) + sqrt(x[2]) > m_P)
+        & !(sqrt(x[4]) + sqrt(m2_24) > m_P);
+      double B = gram_det_4(x[0] - m2_a - m2_b, x[4] - m2_a - m2_c,
+                            x[1] - m2_a - m2_d, x[2] - m2_b - m2_c,
+                            m2_24 - m2_b - m2_d, x[3] - m2_c - m2_d,
+                            m2_a, m2_b, m2_c, m2_d);
+      double B_abc = gram_det_3(x[0] - m2_a - m2_b, x[4] - m2_a - m2_c,
+                                x[2] - m2_b - m2_c, m2_a, m2_b, m2_c);
+      return in & (B < 0.) & (B_abc > 0.);
+    }
+  };
+
+
+  /**
+   * void valid_5d_mask(m2_12, m2_14, m2_23, m2_34, m2_13, n, P, a, b, c, d,
+   *                    mask)
+   *
+   * mask[k] = valid_5d(m2_12[k], ..., m2_13[k], P, a, b, c, d) for k < n.
+   */
+  inline
+  void valid_5d_mask(const double* m2_12, const double* m2_14,
+                     const double* m2_23, const double* m2_34,
+                     const double* m2_13, int n,
+                     const particle &P, const particle &a, const particle &b,
+                     const particle &c, const particle &d,
+                     unsigned char* mask)
+  {
+    const gram_bounds G(P, a, b, c, d);
+    int k = 0;
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+    const double* in[5] = {m2_12, m2_14, m2_23, m2_34, m2_13};
+#if defined(__AVX512F__)
+    typedef __m512d vec;
+    const int lanes = 8;
+#define MD_SET1 _mm512_set1_pd
+#define MD_LOAD _mm512_loadu_pd
+#define MD_ADD _mm512_add_pd
+#define MD_SUB _mm512_sub_pd
+#define MD_MUL _mm512_mul_pd
+#define MD_SQRT _mm512_sqrt_pd
+#else
+    typedef __m256d vec;
+    const int lanes = 4;
+#define MD_SET1 _mm256_set1_pd
+#define MD_LOAD _mm256_loadu_pd
+#define MD_ADD _mm256_add_pd
+#define MD_SUB _mm256_sub_pd
+#define MD_MUL _mm256_mul_pd
+#define MD_SQRT _mm256_sqrt_pd
+#endif
+    const vec m2_a = MD_SET1(G.m2_a), m2_b = MD_SET1(G.m2_b);
+    const vec m2_c = MD_SET1(G.m2_c), m2_d = MD_SET1(G.m2_d);
+    const vec m_P = MD_SET1(G.m_P), zero = MD_SET1(0.);
+    for (; k + lanes <= n; k += lanes) {
+      vec x[5];
+      for (int i = 0; i < 5; i++)
+        x[i] = MD_LOAD(in[i] + k);
+      vec m2_24 = MD_SUB(MD_SUB(MD_SUB(MD_SUB(MD_SUB(MD_SET1(G.sum), x[0]),
+                                              x[1]), x[2]), x[3]), x[4]);
+      vec s_0 = MD_ADD(MD_SQRT(x[0]), MD_SQRT(x[3]));
+      vec s_1 = MD_ADD(MD_SQRT(x[1]), MD_SQRT(x[2]));
+      vec s_2 = MD_ADD(MD_SQRT(x[4]), MD_SQRT(m2_24));
+      vec B = gram_det_4(MD_SUB(MD_SUB(x[0], m2_a), m2_b),
+                         MD_SUB(MD_SUB(x[4], m2_a), m2_c),
+                         MD_SUB(MD_SUB(x[1], m2_a), m2_d),
+                         MD_SUB(MD_SUB(x[2], m2_b), m2_c),
+                         MD_SUB(MD_SUB(m2_24, m2_b), m2_d),
+                         MD_SUB(MD_SUB(x[3], m2_c), m2_d),
+                         G.m2_a, G.m2_b, G.m2_c, G.m2_d);
+      vec B_abc = gram_det_3(MD_SUB(MD_SUB(x[0], m2_a), m2_b),
+                             MD_SUB(MD_SUB(x[4], m2_a), m2_c),
+                             MD_SUB(MD_SUB(x[2], m2_b), m2_c),
+                             G.m2_a, G.m2_b, G.m2_c);
+#if defined(__AVX512F__)
+      __mmask8 out = 0;
+      for (int i = 0; i < 5; i++)
+        out |= _mm512_cmp_pd_mask(x[i], MD_SET1(G.lo[i]), _CMP_LT_OQ)
+          | _mm512_cmp_pd_mask(x[i], MD_SET1(G.hi[i]), _CMP_GT_OQ);
+      out |= _mm512_cmp_pd_mask(s_0, m_P, _CMP_GT_OQ)
+        | _mm512_cmp_pd_mask(s_1, m_P, _CMP_GT_OQ)
+        | _mm512_cmp_pd_mask(s_2, m_P, _CMP_GT_OQ);
+      int m = _mm512_cmp_pd_mask(B, zero, _CMP_LT_OQ)
+        & _mm512_cmp_pd_mask(B_abc, zero, _CMP_GT_OQ) & ~out;
+#else
+      vec out = zero;
+      for (int i = 0; i < 5; i++)
+        out = _mm256_or_pd(out, _mm256_or_pd(
+          _mm256_cmp_pd(x[i], MD_SET1(G.lo[i]), _CMP_LT_OQ),
+          _mm256_cmp_pd(x[i], MD_SET1(G.hi[i]), _CMP_GT_OQ)));
+      out = _mm256_or_pd(out, _mm256_or_pd(_mm256_cmp_pd(s_0, m_P, _CMP_GT_OQ),
+        _mm256_or_pd(_mm256_cmp_pd(s_1, m_P, _CMP_GT_OQ),
+                     _mm256_cmp_pd(s_2, m_P, _CMP_GT_OQ))));
+      int m = _mm256_movemask_pd(
+        _mm256_andnot_pd(out, _mm256_and_pd(_mm256_cmp_pd(B, zero, _CMP_LT_OQ),
+                                            _mm256_cmp_pd(B_abc, zero, _CMP_GT_OQ))));
+#endif
+      for (int i = 0; i < lanes; i++)
+        mask[k + i] = (m >> i) & 1;
+    }
+#undef MD_SET1
+#undef MD_LOAD
+#undef MD_ADD
+#undef MD_SUB
+#undef MD_MUL
+#undef MD_SQRT
+#endif
+
+    for (; k < n; k++) {
+      double x[5] = {m2_12[k], m2_14[k], m2_23[k], m2_34[k], m2_13[k]};
+      mask[k] = G.inside(x);
+    }
+  }
+
+}
+#endif
@@ -0,0 +1,30 @@
+#ifndef MESON_DECA__LIB__C_LIB__GENERATE_HPP
+#define MESON_DECA__LIB__C_LIB__GENERATE_HPP
+
+#include <meson_deca/lib/c_lib/generate/accept_reject.hpp>
+#include <meson_deca/lib/c_lib/generate/phase_space.hpp>
+#include <meson_deca/lib/c_lib/generate/weighted.hpp>
+#include <meson_deca/lib/c_lib/generate/write.hpp>
+
+/*
+ *  Native event generation.
+ *
+ *  DESCRIPTION
+ *    Generators of physical events of the decays described by the
+ *    structures in lib/c_lib/structures. Random numbers are supplied by
+ *    the caller, so the generators hold no mutable state and can be
+ *    shared between threads.
+ *
+ *    Events distributed as the model intensity are drawn by
+ *    accept-reject from any point map of lib/c_lib/integrate, best one
+ *    adapted to the intensity (integrate::adapt), or kept with their
+ *    weights (weighted.hpp). write.hpp writes them in the layout of the
+ *    CmdSTAN output; the command line tool is
+ *    lib/c_lib/tools/generate_events.cpp.
+ *
+ *  FUNCTIONS
+ *    Are currently listed in particular files - accept_reject.hpp,
+ *    phase_space.hpp, weighted.hpp, write.hpp.
+ */
+
+#endif
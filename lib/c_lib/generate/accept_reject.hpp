@@ -0,0 +1,135 @@
+#ifndef MESON_DECA__LIB__C_LIB__GENERATE__ACCEPT_REJECT_HPP
+#define MESON_DECA__LIB__C_LIB__GENERATE__ACCEPT_REJECT_HPP
+
+#include <stan/math/prim/mat/fun/Eigen.hpp>
+#include <algorithm> // std::max, std::min
+#include <vector>
+
+#include <meson_deca/lib/c_lib/integrate/plain.hpp> // points_per_block, batch_amplitudes
+#include <meson_deca/lib/c_lib/integrate/vegas.hpp> // weight_stats, importance_weights
+#include <meson_deca/lib/c_lib/parallel/reduce.hpp>
+#include <meson_deca/lib/c_lib/rng/stream.hpp>
+
+/*
+ *  Accept-reject generation of model events.
+ *
+ *  DESCRIPTION
+ *    A point y of a point map (lib/c_lib/integrate: box, multichannel,
+ *    vegas_map, ...) with the weight w is kept with the probability
+ *    h / h_max, h = w * f(y); the kept points are distributed as f.
+ *    The fraction of kept points is mean(h) / h_max, so a map adapted
+ *    to f (integrate::adapt with intensity_importance) needs far fewer
+ *    model evaluations than uniform points.
+ *
+ *    Points with h > h_max are kept, but counted in overflows; their
+ *    region is undersampled, so h_max should exceed the largest weight
+ *    seen in the training (vegas_stats).
+ *
+ *  TYPES
+ *    event_sample
+ *
+ *  FUNCTIONS
+ *    event_sample accept_reject(model, map, importance, n_events, h_max,
+ *                               seed)
+ */
+
+namespace generate {
+
+  // Largest number of points tried in one round of accept_reject; keeps
+  // the round size an int if the efficiency is tiny.
+  const int max_points_per_round = 1 << 26;
+
+  /**
+   * event_sample
+   *
+   * Kept events and the statistics of the weights of all tried points.
+   */
+  struct event_sample {
+    std::vector<Eigen::VectorXd> events;
+    integrate::weight_stats weights;
+    long overflows;
+
+    event_sample() : overflows(0) {};
+
+    // Appends other (the reduction keeps the order of the blocks)
+    event_sample& operator+=(const event_sample& other) {
+      events.insert(events.end(), other.events.begin(), other.events.end());
+      weights += other.weights;
+      overflows += other.overflows;
+      return *this;
+    }
+  };
+
+
+  /**
+   * event_sample accept_reject(model, map, importance, n_events, h_max,
+   *                            seed)
+   *
+   * Generates n_events events with the density importance(A(y)) in
+   * rounds of parallel trials, each sized by the efficiency of the
+   * rounds before. The events depend on the seed, not on the number of
+   * threads. If all weights of the first round vanish, no events are
+   * returned. Point k of a round and its acceptance test use the
+   * counters of point k (rng::accept_reject), so a single trial can be
+   * replayed with rng::uniform(seed, k, 1, map.dim() + 1, u, round,
+   * rng::accept_reject).
+   *
+   * @tparam F   Amplitude model, see integrate::plain()
+   * @tparam Map Point map
+   * @tparam Imp integrate::intensity_importance (or any density of A)
+   */
+  template <typename F, typename Map, typename Imp>
+  inline event_sample
+  accept_reject(const F& model, const Map& map, const Imp& importance,
+                int n_events, double h_max, unsigned long seed) {
+
+    event_sample res;
+    for (uint32_t round = 0; (int) res.events.size() < n_events; round++) {
+      int missing = n_events - res.events.size();
+      double efficiency = res.weights.n > 0 ?
+        double(res.events.size()) / res.weights.n : 0.;
+      double n_wanted = efficiency > 0 ? 1.1 * missing / efficiency : missing;
+      int n_try = std::min(n_wanted, double(max_points_per_round));
+      n_try = std::max(n_try, integrate::points_per_block);
+
+      res += parallel::reduce(n_try, integrate::points_per_block, event_sample(),
+        [&](int begin, int end, event_sample& acc) {
+          // Point k: map.dim() numbers for the point, one for the test
+          int dim = map.dim() + 1;
+          std::vector<double> u(integrate::points_per_batch * dim), w, ys, h;
+          Eigen::VectorXd y;
+          integrate::batch_amplitudes batch;
+          for (int k0 = begin; k0 < end; k0 += integrate::points_per_batch) {
+            int n = std::min(end - k0, integrate::points_per_batch);
+            rng::uniform(seed, k0, n, dim, &u[0], round, rng::accept_reject);
+            w.clear();
+            ys.clear();
+            for (int k = 0; k < n; k++) {
+              w.push_back(map.map(&u[k * dim], y));
+              ys.insert(ys.end(), y.data(), y.data() + y.rows());
+            }
+            integrate::importance_weights(model, importance, w, ys, batch, h);
+
+            int N = y.rows();
+            for (size_t d = 0; d < h.size(); d++) {
+              acc.weights.add(h[d]);
+              if (h[d] > h_max)
+                acc.overflows++;
+              if (h[d] > 0 && u[d * dim + dim - 1] * h_max < h[d])
+                acc.events.push_back(
+                  Eigen::VectorXd(Eigen::Map<const Eigen::VectorXd>(&ys[d * N], N)));
+            }
+          }
+        });
+
+      if (!(res.weights.max > 0))
+        break; // f vanishes on the whole map
+    }
+    if ((int) res.events.size() > n_events)
+      res.events.resize(n_events);
+    return res;
+  }
+
+}
+
+#endif
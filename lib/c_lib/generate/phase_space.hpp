@@ -0,0 +1,308 @@
+#ifndef MESON_DECA__LIB__C_LIB__GENERATE__PHASE_SPACE_HPP
+#define MESON_DECA__LIB__C_LIB__GENERATE__PHASE_SPACE_HPP
+
+#include <stan/math/prim/mat/fun/Eigen.hpp>
+#include <algorithm> // std::sort
+#include <cmath> // sqrt, cos, sin
+
+#include <meson_deca/lib/c_lib/fct/breakup_momentum.hpp>
+#include <meson_deca/lib/c_lib/structures/four_body/base.hpp>
+
+/*
+ *  N-body phase space generator (GENBOD, F. James, CERN W515).
+ *
+ *  DESCRIPTION
+ *    The decay P -> 1 2 ... N is generated as a chain of two-body
+ *    decays P -> M_{N-1} N,  M_{N-1} -> M_{N-2} (N-1), ...,  M_2 -> 1 2
+ *    with the intermediate masses M_k drawn uniformly (ordered) and
+ *    isotropic decay angles. The event weight
+ *
+ *      w = (T^(N-2) / (N-2)!) * (2 pi)^(N-1) / (2 M) * prod_k p_k
+ *
+ *    (T = M - sum m_i, p_k the breakup momenta) is normalized to
+ *    the Lorentz-invariant phase space
+ *      R_N = \int delta^4(P - sum p_i) prod_i d^3p_i / (2 E_i),
+ *    i.e. E[w g] = \int g dR_N. Every generated event is physical.
+ *
+ *    For the 4-body decays of resonance_base_4 the events are returned
+ *    as the model variables y = (m2_12, m2_14, m2_23, m2_34, m2_13) with
+ *    1,2,3,4 = a,b,c,d (cf. P_R1d_R2cd_abcd::value).
+ *
+ *    CAVEAT. The models are normalized w.r.t. dy (see
+ *    calculate_normalization_integral.py), whereas R_4 has the density
+ *    proportional to 1/sqrt(-G(y)) in y (G the Gram determinant of the
+ *    momenta). Use y_weight() to convert to the dy measure.
+ *
+ *  TYPES
+ *    lorentz_vector
+ *    genbod<N>
+ *    phase_space_4
+ *
+ *  FUNCTIONS
+ *    phase_space_4 make_phase_space(resonance_base_4)
+ */
+
+namespace generate {
+
+  /**
+   * lorentz_vector
+   *
+   * Four-momentum (E, px, py, pz).
+   */
+  struct lorentz_vector {
+    double E, x, y, z;
+
+    lorentz_vector() : E(0), x(0), y(0), z(0) {};
+
+    lorentz_vector(double _E, double _x, double _y, double _z) :
+      E(_E), x(_x), y(_y), z(_z) {};
+
+    // Invariant square mass of the sum of two momenta
+    double m2_with(const lorentz_vector& q) const {
+      double e = E + q.E, px = x + q.x, py = y + q.y, pz = z + q.z;
+      return e * e - px * px - py * py - pz * pz;
+    }
+  };
+
+
+  /**
+   * genbod<N>
+   *
+   * Phase space generator for the decay of a particle with mass M into
+   * N particles with masses m[0], ..., m[N-1]. Holds no state besides
+   * the masses; the random numbers come from the caller, so one
+   * generator may be shared by several threads.
+   *
+   * @tparam N Number of final state particles (N >= 2)
+   */
+  template <int N>
+  struct genbod {
+    double M;    // Parent mass
+    double m[N]; // Final state masses
+    double T;    // Kinetic energy release M - sum m
+
+    genbod(double _M, const double* _m) : M(_M) {
+      T = M;
+      for (int i = 0; i < N; i++) {
+        m[i] = _m[i];
+        T -= m[i];
+      }
+    }
+
+    // Breakup momentum of M_k -> m_1 m_2 (0 if below threshold)
+    static double p(double M_k, double m_1, double m_2) {
+      double p2 = fct::breakup_momentum::p2(M_k * M_k, m_1, m_2);
+      return p2 > 0 ? sqrt(p2) : 0.;
+    }
+
+    // Constant factor of the weight
+    double norm() const {
+      double res = 0.5 / M;
+      for (int k = 1; k <= N - 2; k++)
+        res *= T / k;
+      for (int k = 1; k < N; k++)
+        res *= 2. * M_PI;
+      return res;
+    }
+
+    /**
+     * double max_weight()
+     *
+     * Upper bound of the event weight (as in GENBOD): every breakup
+     * momentum is bounded by its value for the largest possible
+     * mother and the smallest possible daughter mass.
+     */
+    double max_weight() const {
+      double M_min = m[0], M_max = m[0] + T, res = norm();
+      for (int k = 1; k < N; k++) {
+        M_max += m[k];
+        res *= p(M_max, M_min, m[k]);
+        M_min += m[k];
+      }
+      return res;
+    }
+
+    /**
+     * double event(u, p_out)
+     *
+     * Generates one event from the 3N-4 uniform random numbers
+     * u[0], ..., u[3N-5] in [0,1) and returns its weight; the momenta
+     * (in the rest frame of the parent) are stored in p_out[0..N-1].
+     *
+     * The mapping u -> event is deterministic, so u may also come
+     * from a low-discrepancy sequence.
+     */
+    double event(const double* u, lorentz_vector* p_out) const {
+
+      // Intermediate masses M_k = m_1 + ... + m_k + r_k T,
+      // with 0 < r_2 < ... < r_{N-1} < 1 ordered uniform
+      double r[N];
+      r[0] = 0;
+      for (int k = 1; k < N - 1; k++)
+        r[k] = u[k - 1];
+      r[N - 1] = 1;
+      std::sort(r + 1, r + N - 1);
+
+      double M_k[N];
+      double sum_m = 0;
+      for (int k = 0; k < N; k++) {
+        sum_m += m[k];
+        M_k[k] = sum_m + r[k] * T;
+      }
+
+      // Breakup momenta p_k of M_{k+1} -> M_k m_{k+1}
+      double p_k[N - 1];
+      double w = norm();
+      for (int k = 0; k < N - 1; k++) {
+        p_k[k] = p(M_k[k + 1], M_k[k], m[k + 1]);
+        if (p_k[k] == 0)
+          return 0;
+        w *= p_k[k];
+      }
+
+      // First pair in the rest frame of M_2, along the y axis
+      p_out[0] = lorentz_vector(sqrt(p_k[0] * p_k[0] + m[0] * m[0]), 0, p_k[0], 0);
+      p_out[1] = lorentz_vector(sqrt(p_k[0] * p_k[0] + m[1] * m[1]), 0, -p_k[0], 0);
+
+      const double* angles = u + (N - 2);
+      for (int k = 1; k < N; k++) {
+        // Isotropic direction of the decay M_{k+1} -> M_k m_{k+1}
+        double cos_theta = 2. * angles[2 * (k - 1)] - 1.;
+        double sin_theta = sqrt(1. - cos_theta * cos_theta);
+        double phi = 2. * M_PI * angles[2 * (k - 1) + 1];
+        double cos_phi = cos(phi), sin_phi = sin(phi);
+
+        // Rotate particles 1..k+1 (y axis -> direction) ...
+        for (int j = 0; j <= k; j++) {
+          lorentz_vector& q = p_out[j];
+          // rotation about z by theta, then about y by phi
+          double x1 = q.x * cos_theta - q.y * sin_theta;
+          double y1 = q.x * sin_theta + q.y * cos_theta;
+          double z1 = q.z;
+          q.x = x1 * cos_phi + z1 * sin_phi;
+          q.y = y1;
+          q.z = -x1 * sin_phi + z1 * cos_phi;
+        }
+        if (k == N - 1)
+          break;
+
+        // ... and boost them to the rest frame of M_{k+2}, where
+        // M_{k+1} moves along +y with momentum p_k[k]
+        double E_k = sqrt(p_k[k] * p_k[k] + M_k[k] * M_k[k]);
+        double beta = p_k[k] / E_k;
+        double gamma = E_k / M_k[k];
+        for (int j = 0; j <= k; j++) {
+          lorentz_vector& q = p_out[j];
+          double E = gamma * (q.E + beta * q.y);
+          q.y = gamma * (q.y + beta * q.E);
+          q.E = E;
+        }
+        p_out[k + 1] = lorentz_vector(sqrt(p_k[k] * p_k[k] + m[k + 1] * m[k + 1]),
+                                      0, -p_k[k], 0);
+      }
+      return w;
+    }
+  };
+
+
+  /**
+   * phase_space_4
+   *
+   * GENBOD for P -> a b c d, returning the model variables
+   * y = (m2_12, m2_14, m2_23, m2_34, m2_13).
+   */
+  struct phase_space_4 : genbod<4> {
+
+    // Number of uniform random numbers per event
+    static const int dim = 3 * 4 - 4;
+
+    phase_space_4(double _M, const double* _m) : genbod<4>(_M, _m) {};
+
+    /**
+     * double event(u, y)
+     *
+     * Generates the event for the uniform random numbers u[0..7],
+     * stores its invariants in y (size 5) and returns the weight.
+     */
+    template <typename T_u>
+    double event(const T_u& u, Eigen::VectorXd& y) const {
+      double u_[dim];
+      for (int i = 0; i < dim; i++)
+        u_[i] = u[i];
+
+      lorentz_vector p[4];
+      double w = genbod<4>::event(u_, p);
+
+      y.resize(5);
+      y(0) = p[0].m2_with(p[1]); // m2_12
+      y(1) = p[0].m2_with(p[3]); // m2_14
+      y(2) = p[1].m2_with(p[2]); // m2_23
+      y(3) = p[2].m2_with(p[3]); // m2_34
+      y(4) = p[0].m2_with(p[2]); // m2_13
+      return w;
+    }
+
+    /**
+     * double gram(y)
+     *
+     * Gram determinant det(p_i . p_j), i,j in {a,b,c,d}, computed from
+     * the invariants y (m2_24 follows from sum m2_ij = M^2 + 2 sum m_i^2).
+     * It is negative inside the phase space and vanishes on its
+     * boundary (coplanar momenta).
+     */
+    double gram(const Eigen::VectorXd& y) const {
+      double m2[4];
+      double sum_m2 = 0;
+      for (int i = 0; i < 4; i++) {
+        m2[i] = m[i] * m[i];
+        sum_m2 += m2[i];
+      }
+      double m2_24 = M * M + 2. * sum_m2 - y(0) - y(1) - y(2) - y(3) - y(4);
+
+      // Pair masses m2_ij, particles 0..3 = a..d
+      double m2_ij[4][4];
+      m2_ij[0][1] = y(0);
+      m2_ij[0][3] = y(1);
+      m2_ij[1][2] = y(2);
+      m2_ij[2][3] = y(3);
+      m2_ij[0][2] = y(4);
+      m2_ij[1][3] = m2_24;
+
+      Eigen::Matrix4d g;
+      for (int i = 0; i < 4; i++) {
+        g(i,i) = m2[i];
+        for (int j = i + 1; j < 4; j++)
+          g(i,j) = g(j,i) = 0.5 * (m2_ij[i][j] - m2[i] - m2[j]);
+      }
+      return g.determinant();
+    }
+
+    /**
+     * double y_weight(y)
+     *
+     * Ratio of the measures d^5y / dR_4 at y: if an event has the
+     * weight w, then w * y_weight(y) is its weight w.r.t. dy, the
+     * measure used by the models. dR_4 = pi^2 / (32 M^2) d^5y / sqrt(-G)
+     * (Byckling, Kajantie, Particle Kinematics, ch. V).
+     */
+    double y_weight(const Eigen::VectorXd& y) const {
+      double G = gram(y);
+      return G < 0 ? 32. * M * M / (M_PI * M_PI) * sqrt(-G) : 0.;
+    }
+  };
+
+
+  /**
+   * phase_space_4 make_phase_space(resonance_base_4)
+   *
+   * Phase space generator for the particles of a 4-body resonance.
+   */
+  inline phase_space_4
+  make_phase_space(const resonances::resonance_base_4& res) {
+    double m[4] = {res.a.m, res.b.m, res.c.m, res.d.m};
+    return phase_space_4(res.P.m, m);
+  }
+
+}
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef MESON_DECA__LIB__C_LIB__GENERATE__WEIGHTED_HPP
+#define MESON_DECA__LIB__C_LIB__GENERATE__WEIGHTED_HPP
+
+#include <stan/math/prim/mat/fun/Eigen.hpp>
+#include <algorithm> // std::min
+#include <vector>
+
+#include <meson_deca/lib/c_lib/integrate/plain.hpp> // points_per_block, batch_amplitudes
+#include <meson_deca/lib/c_lib/integrate/vegas.hpp> // weight_stats, importance_weights
+#include <meson_deca/lib/c_lib/parallel/reduce.hpp>
+#include <meson_deca/lib/c_lib/rng/stream.hpp>
+
+/*
+ *  Weighted model events.
+ *
+ *  DESCRIPTION
+ *    Instead of accepting a point y of a map with the probability
+ *    h / h_max (accept_reject.hpp), every point with h = w * f(y) > 0
+ *    is kept together with its weight h. The weighted points are
+ *    distributed as f, no envelope maximum is needed and no model
+ *    evaluation is thrown away; sum(h) / n_points estimates the
+ *    integral of f over the map.
+ *
+ *  TYPES
+ *    weighted_sample
+ *
+ *  FUNCTIONS
+ *    weighted_sample weighted(model, map, importance, n_points, seed)
+ */
+
+namespace generate {
+
+  /**
+   * weighted_sample
+   *
+   * Points with a non-zero weight, their weights h, and the statistics
+   * of the weights of all tried points.
+   */
+  struct weighted_sample {
+    std::vector<Eigen::VectorXd> events;
+    std::vector<double> h;
+    integrate::weight_stats weights;
+
+    // Appends other (the reduction keeps the order of the blocks)
+    weighted_sample& operator+=(const weighted_sample& other) {
+      events.insert(events.end(), other.events.begin(), other.events.end());
+      h.insert(h.end(), other.h.begin(), other.h.end());
+      weights += other.weights;
+      return *this;
+    }
+  };
+
+
+  /**
+   * weighted_sample weighted(model, map, importance, n_points, seed)
+   *
+   * Tries n_points points of map in parallel blocks and keeps those
+   * with h > 0. The points are those of integrate::plain() with the
+   * same seed (rng::points).
+   *
+   * @tparam F   Amplitude model, see integrate::plain()
+   * @tparam Map Point map
+   * @tparam Imp integrate::intensity_importance (or any density of A)
+   */
+  template <typename F, typename Map, typename Imp>
+  inline weighted_sample
+  weighted(const F& model, const Map& map, const Imp& importance,
+           int n_points, unsigned long seed) {
+
+    return parallel::reduce(n_points, integrate::points_per_block, weighted_sample(),
+      [&](int begin, int end, weighted_sample& acc) {
+        int dim = map.dim();
+        std::vector<double> u(integrate::points_per_batch * dim), w, ys, h;
+        Eigen::VectorXd y;
+        integrate::batch_amplitudes batch;
+        for (int k0 = begin; k0 < end; k0 += integrate::points_per_batch) {
+          int n = std::min(end - k0, integrate::points_per_batch);
+          rng::uniform(seed, k0, n, dim, &u[0]);
+          w.clear();
+          ys.clear();
+          for (int k = 0; k < n; k++) {
+            w.push_back(map.map(&u[k * dim], y));
+            ys.insert(ys.end(), y.data(), y.data() + y.rows());
+          }
+          integrate::importance_weights(model, importance, w, ys, batch, h);
+
+          int N = y.rows();
+          for (size_t d = 0; d < h.size(); d++) {
+            acc.weights.add(h[d]);
+            if (h[d] > 0) {
+              acc.events.push_back(
+                Eigen::VectorXd(Eigen::Map<const Eigen::VectorXd>(&ys[d * N], N)));
+              acc.h.push_back(h[d]);
+            }
+          }
+        }
+      });
+  }
+
+}
+
+#endif
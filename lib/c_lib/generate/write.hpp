@@ -0,0 +1,74 @@
+#ifndef MESON_DECA__LIB__C_LIB__GENERATE__WRITE_HPP
+#define MESON_DECA__LIB__C_LIB__GENERATE__WRITE_HPP
+
+#include <stan/math/prim/mat/fun/Eigen.hpp>
+#include <cstdio>
+#include <ostream>
+#include <vector>
+
+/*
+ *  Output of generated events.
+ *
+ *  FUNCTIONS
+ *    void write_csv(ostream, events, lp, h)
+ *    void write_binary(ostream, events)
+ */
+
+namespace generate {
+
+  /**
+   * void write_csv(out, events, lp, h)
+   *
+   * Writes the events in the layout of the CmdSTAN output file read by
+   * utils/csv_to_root.py and utils/plot_2d_csv.py: a header line
+   *
+   *   lp__,y.1,...,y.N          (lp__,weight,y.1,...,y.N if h is given)
+   *
+   * and one line per event with lp[d] (the log density of event d),
+   * h[d] and the N variables. Comment lines ('#') may be written to out
+   * before. h may be 0 (unweighted events).
+   */
+  inline void
+  write_csv(std::ostream& out, const std::vector<Eigen::VectorXd>& events,
+            const std::vector<double>& lp, const std::vector<double>* h) {
+    int N = events.empty() ? 0 : events[0].rows();
+    out << "lp__";
+    if (h)
+      out << ",weight";
+    for (int n = 0; n < N; n++)
+      out << ",y." << n + 1;
+    out << "\n";
+
+    char buf[32];
+    for (size_t d = 0; d < events.size(); d++) {
+      snprintf(buf, sizeof(buf), "%.17g", lp[d]);
+      out << buf;
+      if (h) {
+        snprintf(buf, sizeof(buf), "%.17g", (*h)[d]);
+        out << "," << buf;
+      }
+      for (int n = 0; n < N; n++) {
+        snprintf(buf, sizeof(buf), "%.17g", events[d](n));
+        out << "," << buf;
+      }
+      out << "\n";
+    }
+  }
+
+
+  /**
+   * void write_binary(out, events)
+   *
+   * Writes the events as rows of N doubles (native byte order), the
+   * layout of the file y_data.bin of lib/c_lib/tools/amplitudes.cpp.
+   */
+  inline void
+  write_binary(std::ostream& out, const std::vector<Eigen::VectorXd>& events) {
+    for (size_t d = 0; d < events.size(); d++)
+      out.write(reinterpret_cast<const char*>(events[d].data()),
+                events[d].rows() * sizeof(double));
+  }
+
+}
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef MESON_DECA__LIB__C_LIB__INTEGRATE_HPP
+#define MESON_DECA__LIB__C_LIB__INTEGRATE_HPP
+
+#include <meson_deca/lib/c_lib/integrate/amplitude_sum.hpp>
+#include <meson_deca/lib/c_lib/integrate/channels.hpp>
+#include <meson_deca/lib/c_lib/integrate/phase_space.hpp>
+#include <meson_deca/lib/c_lib/integrate/plain.hpp>
+#include <meson_deca/lib/c_lib/integrate/qmc.hpp>
+#include <meson_deca/lib/c_lib/integrate/vegas.hpp>
+#include <meson_deca/lib/c_lib/integrate/write.hpp>
+
+/*
+ *  Native computation of the normalization integrals.
+ *
+ *  DESCRIPTION
+ *    The STAN fit needs I[i,j] = \int conj(A_i(y)) A_j(y) dy over the
+ *    phase space (and, for models with background, the integrals of
+ *    A_v_background_abs2). utils/calculate_normalization_integral.py
+ *    evaluates the model once per point through the python wrapper;
+ *    the functions in this folder evaluate A_cv<double> directly and
+ *    split the points over the parallel::pool() threads.
+ *
+ *    The points are either uniform in a box (plain.hpp) or, for 4-body
+ *    decays, GENBOD phase space events (phase_space.hpp), which are all
+ *    physical. Instead of pseudo-random numbers, randomized Sobol or
+ *    Halton points may be used (qmc.hpp); qmc() also increases the
+ *    number of points until a requested precision is reached.
+ *
+ *    For peaked integrands, the points may be importance sampled: a
+ *    VEGAS grid adapted to the amplitudes (vegas.hpp) on top of any of
+ *    the maps above or of a mixture of Breit-Wigner channels
+ *    (channels.hpp).
+ *
+ *    Point k is drawn from its own counter-based random stream
+ *    (lib/c_lib/rng), and the sums of fixed blocks of points are added
+ *    in a fixed order; the result depends on the seed, but not on the
+ *    number of threads. utils/calculate_normalization_integral.py
+ *    draws the same points (lib/py_lib/philox.py).
+ *
+ *    The command line tool is lib/c_lib/tools/normalization_integral.cpp
+ *    (built into the model folder by build_tools.sh).
+ *
+ *  FUNCTIONS
+ *    Are currently listed in particular files - amplitude_sum.hpp,
+ *    channels.hpp, phase_space.hpp, plain.hpp, qmc.hpp, vegas.hpp,
+ *    write.hpp.
+ */
+
+#endif
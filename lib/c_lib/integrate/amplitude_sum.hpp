@@ -0,0 +1,210 @@
+#ifndef MESON_DECA__LIB__C_LIB__INTEGRATE__AMPLITUDE_SUM_HPP
+#define MESON_DECA__LIB__C_LIB__INTEGRATE__AMPLITUDE_SUM_HPP
+
+#include <stan/math/prim/mat/fun/Eigen.hpp>
+#include <algorithm> // std::max
+#include <cmath> // sqrt, fabs, isfinite
+#include <vector>
+
+/*
+ *  Monte Carlo estimate of the normalization integrals
+ *    I[i,j] = \int conj(A_i(y)) A_j(y) dy,   I_bkg[b] = \int A_bkg_b(y) dy.
+ *
+ *  TYPES
+ *    amplitude_sum
+ *    normalization_integral
+ *
+ *  FUNCTIONS
+ *    matrix standard_error(matrix, matrix, int)
+ *    normalization_integral estimate(amplitude_sum)
+ */
+
+namespace integrate {
+
+  /**
+   * amplitude_sum
+   *
+   * Accumulates the weighted terms w * conj(A_i) A_j (and w * A_bkg_b)
+   * and their squares over the sample points. A point outside the
+   * phase space contributes a zero term, but is counted.
+   *
+   * Sums over disjoint sets of points are combined with operator+=.
+   */
+  struct amplitude_sum {
+    long n;       // Number of sample points
+    long n_valid; // Number of points inside the phase space
+    Eigen::MatrixXd s_re, s_im;   // Sum of the terms
+    Eigen::MatrixXd s2_re, s2_im; // Sum of the squared terms
+    Eigen::VectorXd s_bkg, s2_bkg;
+
+    amplitude_sum(int R, int B) :
+      n(0), n_valid(0),
+      s_re(Eigen::MatrixXd::Zero(R, R)), s_im(Eigen::MatrixXd::Zero(R, R)),
+      s2_re(Eigen::MatrixXd::Zero(R, R)), s2_im(Eigen::MatrixXd::Zero(R, R)),
+      s_bkg(Eigen::VectorXd::Zero(B)), s2_bkg(Eigen::VectorXd::Zero(B)) {};
+
+    // Point with weight w and amplitudes A_re + i*A_im, A_bkg
+    void add(double w, const Eigen::VectorXd& A_re, const Eigen::VectorXd& A_im,
+             const Eigen::VectorXd& A_bkg) {
+      n++;
+      n_valid++;
+      int R = A_re.rows();
+      for (int j = 0; j < R; j++) {
+        for (int i = 0; i < R; i++) {
+          // conj(A_i) A_j
+          double t_re = w * (A_re(i) * A_re(j) + A_im(i) * A_im(j));
+          double t_im = w * (A_re(i) * A_im(j) - A_im(i) * A_re(j));
+          s_re(i,j) += t_re;
+          s_im(i,j) += t_im;
+          s2_re(i,j) += t_re * t_re;
+          s2_im(i,j) += t_im * t_im;
+        }
+      }
+      for (int b = 0; b < A_bkg.rows(); b++) {
+        double t = w * A_bkg(b);
+        s_bkg(b) += t;
+        s2_bkg(b) += t * t;
+      }
+    }
+
+    // Point outside the phase space
+    void add_zero() {
+      n++;
+    }
+
+    amplitude_sum& operator+=(const amplitude_sum& other) {
+      n += other.n;
+      n_valid += other.n_valid;
+      s_re += other.s_re;
+      s_im += other.s_im;
+      s2_re += other.s2_re;
+      s2_im += other.s2_im;
+      s_bkg += other.s_bkg;
+      s2_bkg += other.s2_bkg;
+      return *this;
+    }
+  };
+
+
+  /**
+   * normalization_integral
+   *
+   * Integrals and their statistical (one standard deviation) errors.
+   * I, I_error have the STAN representation matrix I[2]; I_error holds
+   * the errors of the real and of the imaginary parts.
+   */
+  struct normalization_integral {
+    std::vector<Eigen::MatrixXd> I;
+    std::vector<Eigen::MatrixXd> I_error;
+    Eigen::VectorXd I_bkg;
+    Eigen::VectorXd I_bkg_error;
+    long n_points;
+    long n_valid;
+
+    /**
+     * double max_rel_error()
+     *
+     * Largest relative error. The error of I[i,j] is taken relative to
+     * sqrt(I[i,i] I[j,j]) (an upper bound of |I[i,j]|), so that entries
+     * which vanish by symmetry do not dominate.
+     */
+    double max_rel_error() const {
+      double res = 0;
+      int R = I[0].rows();
+      for (int i = 0; i < R; i++) {
+        for (int j = 0; j < R; j++) {
+          double scale = sqrt(std::fabs(I[0](i,i) * I[0](j,j)));
+          double err = std::max(I_error[0](i,j), I_error[1](i,j));
+          if (scale > 0)
+            res = std::max(res, err / scale);
+        }
+      }
+      for (int b = 0; b < I_bkg.rows(); b++) {
+        if (I_bkg(b) != 0)
+          res = std::max(res, I_bkg_error(b) / std::fabs(I_bkg(b)));
+      }
+      return res;
+    }
+
+    /**
+     * int non_finite_resonance()
+     *
+     * Index i of the first resonance with a non-finite entry in its row
+     * of I or I_error; -1 if all entries are finite. A_i that is nan at
+     * some sample point spoils the whole row and column i, so the
+     * diagonal entries are checked first.
+     */
+    int non_finite_resonance() const {
+      int R = I[0].rows();
+      for (int i = 0; i < R; i++)
+        if (!std::isfinite(I[0](i,i)) || !std::isfinite(I_error[0](i,i)))
+          return i;
+      for (int i = 0; i < R; i++)
+        for (int j = 0; j < R; j++)
+          for (int k = 0; k < 2; k++)
+            if (!std::isfinite(I[k](i,j)) || !std::isfinite(I_error[k](i,j)))
+              return i;
+      return -1;
+    }
+
+    /**
+     * int non_finite_background()
+     *
+     * Index b of the first background component with a non-finite
+     * I_bkg or I_bkg_error; -1 if all are finite.
+     */
+    int non_finite_background() const {
+      for (int b = 0; b < I_bkg.rows(); b++)
+        if (!std::isfinite(I_bkg(b)) || !std::isfinite(I_bkg_error(b)))
+          return b;
+      return -1;
+    }
+  };
+
+
+  /**
+   * standard_error(s, s2, n)
+   *
+   * Standard error of the mean of n terms with sum s and sum of
+   * squares s2, i.e. sqrt((s2/n - (s/n)^2) / (n-1)).
+   */
+  template <typename T>
+  inline T
+  standard_error(const T& s, const T& s2, long n) {
+    double n1 = n > 1 ? n - 1 : 1;
+    T res(s.rows(), s.cols());
+    for (int j = 0; j < s.cols(); j++) {
+      for (int i = 0; i < s.rows(); i++) {
+        double mean = s(i,j) / n;
+        res(i,j) = sqrt(std::max(0., (s2(i,j) / n - mean * mean) / n1));
+      }
+    }
+    return res;
+  }
+
+
+  /**
+   * normalization_integral estimate(amplitude_sum)
+   *
+   * Mean of the weighted terms and its standard error.
+   */
+  inline normalization_integral
+  estimate(const amplitude_sum& sum) {
+    normalization_integral res;
+    res.n_points = sum.n;
+    res.n_valid = sum.n_valid;
+
+    res.I.resize(2);
+    res.I_error.resize(2);
+    res.I[0] = sum.s_re / double(sum.n);
+    res.I[1] = sum.s_im / double(sum.n);
+    res.I_error[0] = standard_error(sum.s_re, sum.s2_re, sum.n);
+    res.I_error[1] = standard_error(sum.s_im, sum.s2_im, sum.n);
+    res.I_bkg = sum.s_bkg / double(sum.n);
+    res.I_bkg_error = standard_error(sum.s_bkg, sum.s2_bkg, sum.n);
+    return res;
+  }
+
+}
+
+#endif
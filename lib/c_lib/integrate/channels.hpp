@@ -0,0 +1,139 @@
+#ifndef MESON_DECA__LIB__C_LIB__INTEGRATE__CHANNELS_HPP
+#define MESON_DECA__LIB__C_LIB__INTEGRATE__CHANNELS_HPP
+
+#include <stan/math/prim/mat/fun/Eigen.hpp>
+#include <cmath> // atan, tan
+#include <stdexcept>
+#include <vector>
+
+#include <meson_deca/lib/c_lib/fct/breakup_momentum.hpp>
+#include <meson_deca/lib/c_lib/integrate/plain.hpp> // box
+#include <meson_deca/lib/c_lib/structures/particles.hpp>
+#include <meson_deca/lib/c_lib/structures/three_body/bw.hpp>
+#include <meson_deca/lib/c_lib/structures/three_body/flatte.hpp>
+
+/*
+ *  Multi-channel mappings for peaked lineshapes.
+ *
+ *  DESCRIPTION
+ *    A narrow resonance concentrates the integrand in a band
+ *    |m2 - M^2| ~ M Gamma of one variable. The channel of the resonance
+ *    samples that variable from the Breit-Wigner density
+ *
+ *        g(m2) ~ 1 / ((m2 - M^2)^2 + (M Gamma)^2)
+ *
+ *    (by m2 = M^2 + M Gamma tan(t), t uniform) and the other variables
+ *    uniformly. multichannel mixes the uniform box with the channels;
+ *    the weight of a point is 1 / sum_c alpha_c g_c(y), so every point
+ *    counts for the whole integral, whichever channel produced it.
+ *
+ *  TYPES
+ *    bw_channel
+ *    multichannel
+ */
+
+namespace integrate {
+
+  /**
+   * bw_channel
+   *
+   * Breit-Wigner peak at m2 with the "width" mw = M Gamma in the
+   * variable y(k).
+   */
+  struct bw_channel {
+    int k;
+    double m2;
+    double mw;
+
+    bw_channel(int _k, double _m2, double _mw) : k(_k), m2(_m2), mw(_mw) {};
+
+    // Mass and width of a Breit-Wigner resonance
+    bw_channel(int _k, const resonances::breit_wigner& r) :
+      k(_k), m2(r.R.m2), mw(r.R.m * r.W) {};
+
+    // Position and width of the pole of the Flatte denominator
+    //   M^2 - m2 - i (2 / m) (G_pp^2 p_pipi + G_kk^2 p_KK)
+    // at m = M (below the KK threshold p_KK is imaginary and shifts
+    // the peak).
+    bw_channel(int _k, const resonances::flatte& r) : k(_k) {
+      complex::complex_scalar<double> p_pp, p_kk;
+      p_pp = fct::breakup_momentum::complex_p(r.R.m2, particles::pi.m,
+                                              particles::pi.m);
+      p_kk = fct::breakup_momentum::complex_p(r.R.m2, particles::k.m,
+                                              particles::k.m);
+      double g_pp = r.G_pp * r.G_pp, g_kk = r.G_kk * r.G_kk;
+      m2 = r.R.m2 + 2. / r.R.m * (g_pp * p_pp.im + g_kk * p_kk.im);
+      mw = 2. / r.R.m * (g_pp * p_pp.re + g_kk * p_kk.re);
+    }
+  };
+
+
+  /**
+   * multichannel
+   *
+   * Point map (cf. box) drawing from the mixture of the uniform
+   * distribution in the box (weight alpha[0]) and the channels
+   * (weights alpha[1], ...). It uses dim() + 1 uniform numbers, the
+   * last one selects the channel.
+   */
+  struct multichannel {
+    integrate::box region;
+    std::vector<bw_channel> channels;
+    std::vector<double> alpha;
+    std::vector<double> t_min, t_max; // Range of t = atan((y_k - m2) / mw)
+
+    // Equal weights for the box and every channel
+    multichannel(const integrate::box& _region,
+                 const std::vector<bw_channel>& _channels) :
+      region(_region), channels(_channels),
+      alpha(_channels.size() + 1, 1. / (_channels.size() + 1)) {
+
+      for (size_t c = 0; c < channels.size(); c++) {
+        const bw_channel& ch = channels[c];
+        if (ch.k < 0 || ch.k >= region.dim() || ch.mw <= 0)
+          throw std::domain_error("multichannel: invalid channel");
+        t_min.push_back(atan((region.lower(ch.k) - ch.m2) / ch.mw));
+        t_max.push_back(atan((region.upper(ch.k) - ch.m2) / ch.mw));
+      }
+    }
+
+    int dim() const {
+      return region.dim() + 1;
+    }
+
+    // Density sum_c alpha_c g_c(y) w.r.t. dy
+    double density(const Eigen::VectorXd& y) const {
+      double g_box = 1. / region.volume();
+      double g = alpha[0] * g_box;
+      for (size_t c = 0; c < channels.size(); c++) {
+        const bw_channel& ch = channels[c];
+        double width = region.upper(ch.k) - region.lower(ch.k);
+        double d = y(ch.k) - ch.m2;
+        g += alpha[c + 1] * g_box * width * ch.mw
+          / ((t_max[c] - t_min[c]) * (d * d + ch.mw * ch.mw));
+      }
+      return g;
+    }
+
+    double map(const double* u, Eigen::VectorXd& y) const {
+      region.map(u, y);
+
+      // Channel of u[dim() - 1]
+      double a = u[region.dim()];
+      size_t c = 0;
+      while (c + 1 < alpha.size() && a >= alpha[c]) {
+        a -= alpha[c];
+        c++;
+      }
+      if (c > 0) {
+        const bw_channel& ch = channels[c - 1];
+        double t = t_min[c - 1] + (t_max[c - 1] - t_min[c - 1]) * u[ch.k];
+        y(ch.k) = ch.m2 + ch.mw * tan(t);
+      }
+      return 1. / density(y);
+    }
+  };
+
+}
+
+#endif
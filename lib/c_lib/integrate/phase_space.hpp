@@ -0,0 +1,64 @@
+#ifndef MESON_DECA__LIB__C_LIB__INTEGRATE__PHASE_SPACE_HPP
+#define MESON_DECA__LIB__C_LIB__INTEGRATE__PHASE_SPACE_HPP
+
+#include <stan/math/prim/mat/fun/Eigen.hpp>
+
+#include <meson_deca/lib/c_lib/generate/phase_space.hpp>
+#include <meson_deca/lib/c_lib/integrate/plain.hpp>
+
+/*
+ *  Monte Carlo integration with 4-body phase space points.
+ *
+ *  TYPES
+ *    phase_space_map
+ *
+ *  FUNCTIONS
+ *    normalization_integral phase_space(model, phase_space_4, n_points, seed)
+ */
+
+namespace integrate {
+
+  /**
+   * phase_space_map
+   *
+   * Point map (cf. box) producing GENBOD events (generate/phase_space.hpp)
+   * instead of uniform points in a box, so no point is wasted outside
+   * the phase space. The weight w * y_weight(y) refers to the measure
+   * dy, like the weight of a box, and both agree within errors: for
+   * the phase space volume of D4pi_flat, GENBOD gives 0.8551 +- 0.0005
+   * and the box with fct::valid_5d 0.859 +- 0.004.
+   */
+  struct phase_space_map {
+    generate::phase_space_4 generator;
+
+    explicit phase_space_map(const generate::phase_space_4& _generator) :
+      generator(_generator) {};
+
+    int dim() const {
+      return generate::phase_space_4::dim;
+    }
+
+    double map(const double* u, Eigen::VectorXd& y) const {
+      double w = generator.event(u, y);
+      return w > 0 ? w * generator.y_weight(y) : 0.;
+    }
+  };
+
+
+  /**
+   * normalization_integral phase_space(model, generator, n_points, seed)
+   *
+   * plain() with phase space points.
+   *
+   * @tparam F Amplitude model, see plain()
+   */
+  template <typename F>
+  inline normalization_integral
+  phase_space(const F& model, const generate::phase_space_4& generator,
+              int n_points, unsigned long seed) {
+    return integrate::plain(model, phase_space_map(generator), n_points, seed);
+  }
+
+}
+
+#endif
@@ -0,0 +1,237 @@
+#ifndef MESON_DECA__LIB__C_LIB__INTEGRATE__PLAIN_HPP
+#define MESON_DECA__LIB__C_LIB__INTEGRATE__PLAIN_HPP
+
+#include <stan/math/prim/mat/fun/Eigen.hpp>
+#include <algorithm> // std::min
+#include <vector>
+
+#include <meson_deca/lib/c_lib/complex/matrix.hpp>
+#include <meson_deca/lib/c_lib/integrate/amplitude_sum.hpp>
+#include <meson_deca/lib/c_lib/parallel/reduce.hpp>
+#include <meson_deca/lib/c_lib/rng/stream.hpp>
+
+/*
+ *  Plain Monte Carlo integration (pseudo-random points).
+ *
+ *  TYPES
+ *    box
+ *    batch_amplitudes
+ *    point_batch
+ *
+ *  FUNCTIONS
+ *    void add_point(model, w, y, amplitude_sum, ...)
+ *    normalization_integral plain(model, map, n_points, seed)
+ */
+
+namespace integrate {
+
+  // Sample points per block of the parallel sum. Point k is drawn from
+  // its own random stream (rng::uniform), so the result depends on the
+  // seed only.
+  const int points_per_block = 4096;
+
+  // Points per call of the batched amplitudes (point_batch)
+  const int points_per_batch = 256;
+
+
+  /**
+   * box
+   *
+   * Integration region lower(k) <= y(k) <= upper(k).
+   *
+   * Like every point map of this folder, it provides
+   *   int dim() const                     number of uniform numbers,
+   *   double map(u, y) const              point y for u in [0,1)^dim
+   *                                       and its weight (1/density).
+   */
+  struct box {
+    Eigen::VectorXd lower;
+    Eigen::VectorXd upper;
+
+    box(const Eigen::VectorXd& _lower, const Eigen::VectorXd& _upper) :
+      lower(_lower), upper(_upper) {};
+
+    int dim() const {
+      return lower.rows();
+    }
+
+    double volume() const {
+      return (upper - lower).prod();
+    }
+
+    double map(const double* u, Eigen::VectorXd& y) const {
+      y.resize(dim());
+      for (int i = 0; i < dim(); i++)
+        y(i) = lower(i) + (upper(i) - lower(i)) * u[i];
+      return volume();
+    }
+  };
+
+
+  /**
+   * void add_point(model, w, y, acc, A_re, A_im, A_bkg)
+   *
+   * Adds the model amplitudes at y with the weight w to acc (a zero
+   * term if w == 0 or y lies outside the phase space). A_* are work
+   * space.
+   */
+  template <typename F>
+  inline void
+  add_point(const F& model, double w, const Eigen::VectorXd& y,
+            amplitude_sum& acc, Eigen::VectorXd& A_re, Eigen::VectorXd& A_im,
+            Eigen::VectorXd& A_bkg) {
+    if (w > 0 && model(y, A_re, A_im, A_bkg))
+      acc.add(w, A_re, A_im, A_bkg);
+    else
+      acc.add_zero();
+  }
+
+
+  /**
+   * batch_amplitudes
+   *
+   * Work space for the amplitudes of a batch of D points y (N variables
+   * each) with the weights w: evaluate() checks the phase space of all
+   * points at once (model.in_phase_space(y, D, mask), branch-free) and
+   * calls model.batch() for the points with w > 0 inside of it.
+   * Reused for consecutive batches without allocations.
+   */
+  class batch_amplitudes {
+  public:
+    template <typename F>
+    void evaluate(const F& model, const double* w, const double* y,
+                  int D, int N) {
+      mask_.resize(D);
+      index_.resize(D);
+      y_valid_.clear();
+      if (D > 0)
+        model.in_phase_space(y, D, &mask_[0]);
+      int n = 0;
+      for (int d = 0; d < D; d++) {
+        bool ok = w[d] > 0 && mask_[d];
+        index_[d] = ok ? n++ : -1;
+        if (ok)
+          y_valid_.insert(y_valid_.end(), y + long(d) * N, y + long(d + 1) * N);
+      }
+      model.batch(n > 0 ? &y_valid_[0] : 0, n, A_, A_bkg_);
+    }
+
+    // Point d has w > 0 and lies inside the phase space
+    bool valid(int d) const {
+      return index_[d] >= 0;
+    }
+
+    // Amplitudes of the valid point d
+    void get(int d, Eigen::VectorXd& A_re, Eigen::VectorXd& A_im,
+             Eigen::VectorXd& A_bkg) const {
+      A_.col(index_[d], A_re, A_im);
+      A_bkg = A_bkg_.col(index_[d]);
+    }
+
+  private:
+    std::vector<unsigned char> mask_;
+    std::vector<int> index_;
+    std::vector<double> y_valid_;
+    complex::split_matrix A_;
+    Eigen::MatrixXd A_bkg_;
+  };
+
+
+  /**
+   * point_batch
+   *
+   * Collects the points of a block and adds their amplitudes to an
+   * amplitude_sum points_per_batch at a time, through batch_amplitudes.
+   * Points with w == 0 or outside the phase space are added as zero
+   * terms. The points keep their order, so the sum is the same as with
+   * add_point() for every point.
+   */
+  class point_batch {
+  public:
+    template <typename F>
+    void add(const F& model, double w, const Eigen::VectorXd& y,
+             amplitude_sum& acc) {
+      N_ = y.rows();
+      w_.push_back(w);
+      y_.insert(y_.end(), y.data(), y.data() + y.rows());
+      if ((int) w_.size() == points_per_batch)
+        flush(model, acc);
+    }
+
+    // Adds the collected points; must be called at the end of a block
+    template <typename F>
+    void flush(const F& model, amplitude_sum& acc) {
+      int D = w_.size();
+      if (D == 0)
+        return;
+      batch_.evaluate(model, &w_[0], &y_[0], D, N_);
+      for (int d = 0; d < D; d++) {
+        if (batch_.valid(d)) {
+          batch_.get(d, A_re_, A_im_, A_bkg_);
+          acc.add(w_[d], A_re_, A_im_, A_bkg_);
+        } else {
+          acc.add_zero();
+        }
+      }
+      w_.clear();
+      y_.clear();
+    }
+
+  private:
+    int N_;
+    std::vector<double> w_, y_;
+    batch_amplitudes batch_;
+    Eigen::VectorXd A_re_, A_im_, A_bkg_;
+  };
+
+
+  /**
+   * normalization_integral plain(model, map, n_points, seed)
+   *
+   * Estimates I[i,j] = \int conj(A_i) A_j dy (and the background
+   * integrals) from n_points pseudo-random points of map (e.g. uniform
+   * points in a box), on the parallel::pool() threads.
+   *
+   * @tparam F Amplitude model with the members
+   *             int num_resonances() const,
+   *             int num_background() const,
+   *             bool operator()(y, A_re, A_im, A_bkg) const,
+   *             bool in_phase_space(y) const,
+   *             void in_phase_space(y, D, mask) const,
+   *             void batch(y, D, A, A_bkg) const;
+   *           the call fills the amplitudes at y and returns false if
+   *           y lies outside the phase space (A_* are then ignored);
+   *           in_phase_space(y, D, mask) checks D contiguous points;
+   *           batch() fills the R x D split_matrix A and the B x D
+   *           matrix A_bkg for D contiguous points inside of it.
+   * @tparam Map Point map (box, phase_space_map)
+   */
+  template <typename F, typename Map>
+  inline normalization_integral
+  plain(const F& model, const Map& map, int n_points, unsigned long seed) {
+
+    amplitude_sum zero(model.num_resonances(), model.num_background());
+
+    amplitude_sum sum = parallel::reduce(n_points, points_per_block, zero,
+      [&](int begin, int end, amplitude_sum& acc) {
+        int dim = map.dim();
+        std::vector<double> u(points_per_batch * dim);
+        Eigen::VectorXd y;
+        point_batch batch;
+        for (int k0 = begin; k0 < end; k0 += points_per_batch) {
+          int n = std::min(end - k0, points_per_batch);
+          rng::uniform(seed, k0, n, dim, &u[0]);
+          for (int k = 0; k < n; k++) {
+            double w = map.map(&u[k * dim], y);
+            batch.add(model, w, y, acc);
+          }
+        }
+        batch.flush(model, acc);
+      });
+
+    return estimate(sum);
+  }
+
+}
+
+#endif
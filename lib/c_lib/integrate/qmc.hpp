@@ -0,0 +1,238 @@
+#ifndef MESON_DECA__LIB__C_LIB__INTEGRATE__QMC_HPP
+#define MESON_DECA__LIB__C_LIB__INTEGRATE__QMC_HPP
+
+#include <stan/math/prim/mat/fun/Eigen.hpp>
+#include <cmath> // sqrt
+#include <stdexcept>
+#include <stdint.h>
+#include <vector>
+
+#include <meson_deca/lib/c_lib/integrate/amplitude_sum.hpp>
+#include <meson_deca/lib/c_lib/integrate/plain.hpp> // point_batch, points_per_block
+#include <meson_deca/lib/c_lib/parallel/reduce.hpp>
+#include <meson_deca/lib/c_lib/rng/stream.hpp>
+
+/*
+ *  Randomized quasi-Monte Carlo integration.
+ *
+ *  DESCRIPTION
+ *    Low-discrepancy (Sobol or Halton) points fill [0,1)^dim much more
+ *    evenly than pseudo-random points; for smooth integrands the error
+ *    falls almost like 1/n instead of 1/sqrt(n).
+ *
+ *    To keep error bars, the sequence is randomized K times (digital
+ *    shift for Sobol, random shift modulo 1 for Halton). Every shifted
+ *    sequence gives an unbiased estimate I_r; the result is their mean
+ *    and the error is the standard deviation of the mean over r.
+ *
+ *    qmc() doubles the number of points per replica until every entry
+ *    reaches the requested relative precision (see max_rel_error()).
+ *
+ *  TYPES
+ *    sobol
+ *    halton
+ *
+ *  FUNCTIONS
+ *    normalization_integral estimate(replica sums)
+ *    normalization_integral qmc(model, map, sequence, ...)
+ */
+
+namespace integrate {
+
+  /**
+   * sobol
+   *
+   * Sobol sequence (Gray code free, random access) with the direction
+   * numbers of S. Joe and F. Y. Kuo (new-joe-kuo-6.21201), up to
+   * max_dim dimensions.
+   */
+  class sobol {
+  public:
+    static const int max_dim = 13;
+    static const int bits = 32;
+
+    explicit sobol(int dim) : dim_(dim) {
+      if (dim > max_dim)
+        throw std::domain_error("sobol: too many dimensions");
+
+      // Degree s, coefficients a and initial m_1..m_s of the primitive
+      // polynomials for the dimensions 2, 3, ...
+      static const int s[max_dim] = {0, 1, 2, 3, 3, 4, 4, 5, 5, 5, 5, 5, 5};
+      static const int a[max_dim] = {0, 0, 1, 1, 2, 1, 4, 2, 4, 7, 11, 13, 14};
+      static const int m[max_dim][5] = {
+        {0}, {1}, {1, 3}, {1, 3, 1}, {1, 1, 1}, {1, 1, 3, 3}, {1, 3, 5, 13},
+        {1, 1, 5, 5, 17}, {1, 1, 5, 5, 5}, {1, 1, 7, 11, 19}, {1, 1, 5, 1, 1},
+        {1, 1, 1, 3, 11}, {1, 3, 5, 5, 31}};
+
+      for (int d = 0; d < dim; d++) {
+        uint32_t* v = v_[d];
+        if (d == 0) {
+          // Van der Corput sequence
+          for (int i = 0; i < bits; i++)
+            v[i] = uint32_t(1) << (bits - 1 - i);
+          continue;
+        }
+        for (int i = 0; i < s[d] && i < bits; i++)
+          v[i] = uint32_t(m[d][i]) << (bits - 1 - i);
+        for (int i = s[d]; i < bits; i++) {
+          v[i] = v[i - s[d]] ^ (v[i - s[d]] >> s[d]);
+          for (int k = 1; k < s[d]; k++)
+            if ((a[d] >> (s[d] - 1 - k)) & 1)
+              v[i] ^= v[i - k];
+        }
+      }
+    }
+
+    int dim() const {
+      return dim_;
+    }
+
+    // Point k, XOR-ed with shift[0..dim-1]
+    void point(uint32_t k, const uint32_t* shift, double* u) const {
+      for (int d = 0; d < dim_; d++) {
+        uint32_t x = shift[d];
+        for (int i = 0; k >> i; i++)
+          if ((k >> i) & 1)
+            x ^= v_[d][i];
+        u[d] = x * (1. / 4294967296.);
+      }
+    }
+
+  private:
+    int dim_;
+    uint32_t v_[max_dim][bits];
+  };
+
+
+  /**
+   * halton
+   *
+   * Halton sequence (radical inverses in the first prime bases).
+   */
+  class halton {
+  public:
+    static const int max_dim = 16;
+
+    explicit halton(int dim) : dim_(dim) {
+      if (dim > max_dim)
+        throw std::domain_error("halton: too many dimensions");
+    }
+
+    int dim() const {
+      return dim_;
+    }
+
+    // Point k, shifted by shift[d] / 2^32 modulo 1
+    void point(uint32_t k, const uint32_t* shift, double* u) const {
+      static const int primes[max_dim] = {2, 3, 5, 7, 11, 13, 17, 19,
+                                          23, 29, 31, 37, 41, 43, 47, 53};
+      for (int d = 0; d < dim_; d++) {
+        double x = 0, f = 1. / primes[d];
+        for (uint32_t n = k; n > 0; n /= primes[d], f /= primes[d])
+          x += f * (n % primes[d]);
+        x += shift[d] * (1. / 4294967296.);
+        u[d] = x < 1. ? x : x - 1.;
+      }
+    }
+
+  private:
+    int dim_;
+  };
+
+
+  /**
+   * normalization_integral estimate(sums)
+   *
+   * Combines the sums of K independently randomized replicas: the mean
+   * of the replica estimates and its standard error.
+   */
+  inline normalization_integral
+  estimate(const std::vector<amplitude_sum>& sums) {
+    int K = sums.size();
+    amplitude_sum total(sums[0].s_re.rows(), sums[0].s_bkg.rows());
+    amplitude_sum squares = total; // Sum of the squared replica estimates
+    for (int r = 0; r < K; r++) {
+      double n = sums[r].n;
+      total += sums[r];
+      squares.s_re += (sums[r].s_re / n).cwiseAbs2();
+      squares.s_im += (sums[r].s_im / n).cwiseAbs2();
+      squares.s_bkg += (sums[r].s_bkg / n).cwiseAbs2();
+    }
+
+    // Replica estimates I_r have equal weight (equal n per replica)
+    normalization_integral res = estimate(total);
+    double n = sums[0].n;
+    amplitude_sum means = total; // Sum of the replica estimates
+    means.s_re /= n;
+    means.s_im /= n;
+    means.s_bkg /= n;
+    res.I_error[0] = standard_error(means.s_re, squares.s_re, K);
+    res.I_error[1] = standard_error(means.s_im, squares.s_im, K);
+    res.I_bkg_error = standard_error(means.s_bkg, squares.s_bkg, K);
+    return res;
+  }
+
+
+  /**
+   * normalization_integral qmc(model, map, sequence, replicas, n_start,
+   *                            n_max, precision, seed)
+   *
+   * Randomized QMC estimate of the normalization integrals. Every
+   * replica uses the points 0..n-1 of the sequence with its own random
+   * shift. Starting with n = n_start, n is doubled (re-using the points
+   * already evaluated) until max_rel_error() <= precision or n reaches
+   * n_max; precision <= 0 means a single pass with n_start points.
+   *
+   * n_start should be a power of 2 for Sobol points.
+   *
+   * @tparam F   Amplitude model, see plain()
+   * @tparam Map Point map (box, phase_space_map)
+   * @tparam Seq Low-discrepancy sequence (sobol, halton)
+   */
+  template <typename F, typename Map, typename Seq>
+  inline normalization_integral
+  qmc(const F& model, const Map& map, const Seq& sequence, int replicas,
+      int n_start, int n_max, double precision, unsigned long seed) {
+
+    int dim = map.dim();
+    amplitude_sum zero(model.num_resonances(), model.num_background());
+    std::vector<amplitude_sum> sums(replicas, zero);
+
+    // Random shifts of the replicas
+    std::vector<std::vector<uint32_t> > shift(replicas, std::vector<uint32_t>(dim));
+    for (int r = 0; r < replicas; r++) {
+      rng::stream s(seed, r, 0, rng::shifts);
+      for (int d = 0; d < dim; d++)
+        shift[r][d] = s.next_u32();
+    }
+
+    normalization_integral res;
+    int n_done = 0;
+    for (int n = n_start; ; n *= 2) {
+      for (int r = 0; r < replicas; r++) {
+        sums[r] += parallel::reduce(n - n_done, points_per_block, zero,
+          [&](int begin, int end, amplitude_sum& acc) {
+            std::vector<double> u(dim);
+            Eigen::VectorXd y;
+            point_batch batch;
+            for (int k = n_done + begin; k < n_done + end; k++) {
+              sequence.point(k, &shift[r][0], &u[0]);
+              double w = map.map(&u[0], y);
+              batch.add(model, w, y, acc);
+            }
+            batch.flush(model, acc);
+          });
+      }
+      n_done = n;
+
+      res = estimate(sums);
+      if (precision <= 0 || res.max_rel_error() <= precision
+          || n > n_max / 2)
+        break;
+    }
+    return res;
+  }
+
+}
+
+#endif
@@ -0,0 +1,464 @@
+#ifndef MESON_DECA__LIB__C_LIB__INTEGRATE__VEGAS_HPP
+#define MESON_DECA__LIB__C_LIB__INTEGRATE__VEGAS_HPP
+
+#include <stan/math/prim/mat/fun/Eigen.hpp>
+#include <algorithm> // std::max, std::min
+#include <cmath> // log, pow
+#include <stdexcept>
+#include <vector>
+
+#include <meson_deca/lib/c_lib/integrate/plain.hpp> // points_per_block, batch_amplitudes
+#include <meson_deca/lib/c_lib/parallel/reduce.hpp>
+#include <meson_deca/lib/c_lib/rng/stream.hpp>
+
+/*
+ *  VEGAS adaptive importance sampling.
+ *
+ *  DESCRIPTION
+ *    The grid splits every uniform number u_d of a point map into bins
+ *    of equal probability but different widths; training iterations
+ *    move the bin edges until every bin carries the same share of
+ *    \int h^2, where h = w f is the weighted importance function f
+ *    (trace_importance for the normalization integrals, the model
+ *    intensity for event generation). The adapted grid is again a
+ *    point map (vegas_map), so it is used with plain(), qmc() and
+ *    generate::accept_reject() like a box.
+ *
+ *    Any point map may be adapted, in particular a multichannel map
+ *    (channels.hpp): the grid of its channel-selecting number then
+ *    tunes the channel weights as well.
+ *
+ *    weight_stats of the weights h (per point variance, largest
+ *    weight) before and after the adaptation measure the variance
+ *    reduction and the gain in accept-reject efficiency over the
+ *    uniform baseline.
+ *
+ *  TYPES
+ *    weight_stats
+ *    vegas_stats
+ *    trace_importance
+ *    intensity_importance
+ *    vegas_grid
+ *    vegas_map
+ *
+ *  FUNCTIONS
+ *    weight_stats sample_weights(model, map, importance, n_points, seed)
+ *    vegas_map adapt(model, map, importance, iterations, n_points, seed,
+ *                    stats)
+ */
+
+namespace integrate {
+
+  /**
+   * weight_stats
+   *
+   * Number, sum, sum of squares and maximum of sample weights.
+   */
+  struct weight_stats {
+    long n;
+    double s;
+    double s2;
+    double max;
+
+    weight_stats() : n(0), s(0), s2(0), max(0) {};
+
+    void add(double h) {
+      n++;
+      s += h;
+      s2 += h * h;
+      max = std::max(max, h);
+    }
+
+    double mean() const {
+      return n > 0 ? s / n : 0.;
+    }
+
+    // Variance of a single weight
+    double variance() const {
+      return n > 1 ? (s2 - s * s / n) / (n - 1) : 0.;
+    }
+
+    // Acceptance rate of accept-reject sampling with the maximum max
+    double efficiency() const {
+      return max > 0 ? mean() / max : 0.;
+    }
+
+    weight_stats& operator+=(const weight_stats& other) {
+      n += other.n;
+      s += other.s;
+      s2 += other.s2;
+      max = std::max(max, other.max);
+      return *this;
+    }
+  };
+
+
+  /**
+   * vegas_stats
+   *
+   * Weight statistics of the uniform baseline and of every training
+   * iteration of adapt(); iterations.back() belongs to the returned
+   * grid.
+   */
+  struct vegas_stats {
+    weight_stats uniform;
+    std::vector<weight_stats> iterations;
+
+    // Ratio of the variances per point, i.e. of the numbers of points
+    // needed for the same error
+    double variance_reduction() const {
+      double v = iterations.empty() ? 0. : iterations.back().variance();
+      return v > 0 ? uniform.variance() / v : 0.;
+    }
+
+    // Ratio of the accept-reject efficiencies
+    double efficiency_gain() const {
+      double e = uniform.efficiency();
+      return e > 0 && !iterations.empty() ? iterations.back().efficiency() / e : 0.;
+    }
+  };
+
+
+  /**
+   * trace_importance
+   *
+   * sum_i |A_i|^2 + sum_b A_bkg_b: large wherever any diagonal entry of
+   * the normalization integral gets its weight (the off-diagonal
+   * entries are bounded by the diagonal ones).
+   */
+  struct trace_importance {
+    double operator()(const Eigen::VectorXd& A_re, const Eigen::VectorXd& A_im,
+                      const Eigen::VectorXd& A_bkg) const {
+      return A_re.squaredNorm() + A_im.squaredNorm() + A_bkg.sum();
+    }
+  };
+
+
+  /**
+   * intensity_importance
+   *
+   * Model intensity |A * theta|^2 + A_bkg * theta_bkg (cf.
+   * likelihood::sum_log_f), the density of the generated events.
+   */
+  struct intensity_importance {
+    Eigen::VectorXd theta_re;
+    Eigen::VectorXd theta_im;
+    Eigen::VectorXd theta_bkg;
+
+    intensity_importance(const Eigen::VectorXd& _theta_re,
+                         const Eigen::VectorXd& _theta_im,
+                         const Eigen::VectorXd& _theta_bkg) :
+      theta_re(_theta_re), theta_im(_theta_im), theta_bkg(_theta_bkg) {};
+
+    double operator()(const Eigen::VectorXd& A_re, const Eigen::VectorXd& A_im,
+                      const Eigen::VectorXd& A_bkg) const {
+      double s_re = A_re.dot(theta_re) - A_im.dot(theta_im);
+      double s_im = A_im.dot(theta_re) + A_re.dot(theta_im);
+      double f = s_re * s_re + s_im * s_im;
+      if (A_bkg.rows() > 0)
+        f += A_bkg.dot(theta_bkg);
+      return f;
+    }
+  };
+
+
+  /**
+   * vegas_grid
+   *
+   * Piecewise linear map u -> x of [0,1)^dim onto itself, separately
+   * for every coordinate: u_d in bin i (of equal width 1/bins) is
+   * mapped linearly onto [edge_i, edge_{i+1}].
+   */
+  class vegas_grid {
+  public:
+    static const int max_dim = 16;
+    static const int default_bins = 64;
+
+    vegas_grid(int dim, int bins) : dim_(dim), bins_(bins),
+                                    edges_(dim * (bins + 1)) {
+      if (dim > max_dim)
+        throw std::domain_error("vegas_grid: too many dimensions");
+      for (int d = 0; d < dim; d++)
+        for (int i = 0; i <= bins; i++)
+          edges_[d * (bins + 1) + i] = double(i) / bins;
+    }
+
+    int dim() const {
+      return dim_;
+    }
+
+    int bins() const {
+      return bins_;
+    }
+
+    // Sets x and the bin of every coordinate, returns the Jacobian dx/du
+    double map(const double* u, double* x, int* bin) const {
+      double J = 1;
+      for (int d = 0; d < dim_; d++) {
+        double t = u[d] * bins_;
+        int i = std::min(int(t), bins_ - 1);
+        const double* e = &edges_[d * (bins_ + 1)];
+        double h = e[i + 1] - e[i];
+        x[d] = e[i] + (t - i) * h;
+        J *= bins_ * h;
+        bin[d] = i;
+      }
+      return J;
+    }
+
+    /**
+     * void refine(h2, alpha)
+     *
+     * Moves the edges so that the bins share sum_bin h^2 (h2[d * bins
+     * + i], accumulated with the current grid) more evenly. The bin
+     * sums are smoothed and damped as in G. P. Lepage, J. Comput. Phys.
+     * 27 (1978) 192; alpha (about 0.5 - 2) sets the speed of the
+     * adaptation.
+     */
+    void refine(const std::vector<double>& h2, double alpha) {
+      std::vector<double> r(bins_), e(bins_ + 1);
+      for (int d = 0; d < dim_; d++) {
+        const double* s = &h2[d * bins_];
+        double* edge = &edges_[d * (bins_ + 1)];
+
+        // Smoothing over neighbouring bins
+        double total = 0;
+        for (int i = 0; i < bins_; i++) {
+          int lo = std::max(i - 1, 0), hi = std::min(i + 1, bins_ - 1);
+          double sum = 0;
+          for (int j = lo; j <= hi; j++)
+            sum += s[j];
+          r[i] = sum / (hi - lo + 1);
+          total += r[i];
+        }
+        if (!(total > 0))
+          continue;
+
+        // Damping
+        double r_sum = 0;
+        for (int i = 0; i < bins_; i++) {
+          double f = r[i] / total;
+          r[i] = (f > 0 && f < 1) ? pow((f - 1) / log(f), alpha) : 0.;
+          r_sum += r[i];
+        }
+        if (!(r_sum > 0))
+          continue;
+
+        // New edges: equal shares of sum r
+        double per_bin = r_sum / bins_, acc = 0;
+        int j = 0;
+        e[0] = 0;
+        for (int i = 1; i < bins_; i++) {
+          double target = i * per_bin;
+          while (j < bins_ - 1 && acc + r[j] < target)
+            acc += r[j++];
+          double frac = r[j] > 0 ? std::min((target - acc) / r[j], 1.) : 0.;
+          e[i] = edge[j] + frac * (edge[j + 1] - edge[j]);
+        }
+        e[bins_] = 1;
+        for (int i = 0; i <= bins_; i++)
+          edge[i] = e[i];
+      }
+    }
+
+  private:
+    int dim_;
+    int bins_;
+    std::vector<double> edges_;
+  };
+
+
+  /**
+   * vegas_map
+   *
+   * Point map: u -> x by the grid, then x -> y by the base map. The
+   * weight is the Jacobian of the grid times the base weight (which
+   * keeps the estimates unbiased for any base map, also a
+   * non-invertible one like multichannel).
+   *
+   * @tparam Map Base point map (box, multichannel, phase_space_map)
+   */
+  template <typename Map>
+  struct vegas_map {
+    Map base;
+    vegas_grid grid;
+
+    vegas_map(const Map& _base, const vegas_grid& _grid) :
+      base(_base), grid(_grid) {};
+
+    int dim() const {
+      return base.dim();
+    }
+
+    double map(const double* u, Eigen::VectorXd& y) const {
+      int bin[vegas_grid::max_dim];
+      return map(u, y, bin);
+    }
+
+    // Also returns the bins of u (for the training)
+    double map(const double* u, Eigen::VectorXd& y, int* bin) const {
+      double x[vegas_grid::max_dim];
+      double J = grid.map(u, x, bin);
+      return J * base.map(x, y);
+    }
+  };
+
+
+  /**
+   * double importance_weight(model, importance, w, y, A_re, A_im, A_bkg)
+   *
+   * h = w * importance(A(y)), zero outside the phase space. A_* are
+   * work space.
+   */
+  template <typename F, typename Imp>
+  inline double
+  importance_weight(const F& model, const Imp& importance, double w,
+                    const Eigen::VectorXd& y, Eigen::VectorXd& A_re,
+                    Eigen::VectorXd& A_im, Eigen::VectorXd& A_bkg) {
+    if (w > 0 && model(y, A_re, A_im, A_bkg))
+      return w * importance(A_re, A_im, A_bkg);
+    return 0.;
+  }
+
+
+  /**
+   * void importance_weights(model, importance, w, y, batch, h)
+   *
+   * h[d] = w[d] * importance(A(y_d)) for the points y (contiguous,
+   * w.size() of them) in one batch; zero outside the phase space.
+   * batch and h are work space.
+   */
+  template <typename F, typename Imp>
+  inline void
+  importance_weights(const F& model, const Imp& importance,
+                     const std::vector<double>& w, const std::vector<double>& y,
+                     batch_amplitudes& batch, std::vector<double>& h) {
+    int D = w.size();
+    h.assign(D, 0.);
+    if (D == 0)
+      return;
+    batch.evaluate(model, &w[0], &y[0], D, y.size() / D);
+    Eigen::VectorXd A_re, A_im, A_bkg;
+    for (int d = 0; d < D; d++) {
+      if (batch.valid(d)) {
+        batch.get(d, A_re, A_im, A_bkg);
+        h[d] = w[d] * importance(A_re, A_im, A_bkg);
+      }
+    }
+  }
+
+
+  /**
+   * weight_stats sample_weights(model, map, importance, n_points, seed)
+   *
+   * Statistics of h = w * importance at n_points pseudo-random points
+   * of map; with a box, this is the uniform baseline of vegas_stats.
+   *
+   * @tparam F   Amplitude model, see plain()
+   * @tparam Map Point map
+   * @tparam Imp trace_importance, intensity_importance
+   */
+  template <typename F, typename Map, typename Imp>
+  inline weight_stats
+  sample_weights(const F& model, const Map& map, const Imp& importance,
+                 int n_points, unsigned long seed) {
+    return parallel::reduce(n_points, points_per_block, weight_stats(),
+      [&](int begin, int end, weight_stats& acc) {
+        int dim = map.dim();
+        std::vector<double> u(points_per_batch * dim), w, ys, h;
+        Eigen::VectorXd y;
+        batch_amplitudes batch;
+        for (int k0 = begin; k0 < end; k0 += points_per_batch) {
+          int n = std::min(end - k0, points_per_batch);
+          rng::uniform(seed, k0, n, dim, &u[0]);
+          w.clear();
+          ys.clear();
+          for (int k = 0; k < n; k++) {
+            w.push_back(map.map(&u[k * dim], y));
+            ys.insert(ys.end(), y.data(), y.data() + y.rows());
+          }
+          importance_weights(model, importance, w, ys, batch, h);
+          for (size_t d = 0; d < h.size(); d++)
+            acc.add(h[d]);
+        }
+      });
+  }
+
+
+  // Training sums of one iteration: weights and h^2 per grid bin
+  struct vegas_sum {
+    weight_stats weights;
+    std::vector<double> h2;
+
+    explicit vegas_sum(int size) : h2(size, 0.) {};
+
+    vegas_sum& operator+=(const vegas_sum& other) {
+      weights += other.weights;
+      for (size_t i = 0; i < h2.size(); i++)
+        h2[i] += other.h2[i];
+      return *this;
+    }
+  };
+
+
+  /**
+   * vegas_map adapt(model, map, importance, iterations, n_points, seed,
+   *                 stats)
+   *
+   * Trains a vegas_grid (default_bins bins, alpha = 1.5) for map:
+   * every iteration samples n_points points with the current grid and
+   * refines it, except after the last one. The weight statistics of
+   * the iterations are appended to stats.iterations.
+   *
+   * The result depends on the seed, not on the number of threads.
+   *
+   * @tparam F   Amplitude model, see plain()
+   * @tparam Map Point map
+   * @tparam Imp trace_importance, intensity_importance
+   */
+  template <typename F, typename Map, typename Imp>
+  inline vegas_map<Map>
+  adapt(const F& model, const Map& map, const Imp& importance,
+        int iterations, int n_points, unsigned long seed, vegas_stats& stats) {
+
+    const double alpha = 1.5;
+    vegas_map<Map> res(map, vegas_grid(map.dim(), vegas_grid::default_bins));
+    int bins = res.grid.bins();
+
+    for (int it = 0; it < iterations; it++) {
+      vegas_sum sum = parallel::reduce(n_points, points_per_block,
+                                       vegas_sum(map.dim() * bins),
+        [&](int begin, int end, vegas_sum& acc) {
+          int dim = map.dim();
+          std::vector<double> u(points_per_batch * dim), w, ys, h;
+          std::vector<int> bins_of(points_per_batch * dim);
+          Eigen::VectorXd y;
+          batch_amplitudes batch;
+          for (int k0 = begin; k0 < end; k0 += points_per_batch) {
+            int n = std::min(end - k0, points_per_batch);
+            rng::uniform(seed, k0, n, dim, &u[0], it, rng::training);
+            w.clear();
+            ys.clear();
+            for (int k = 0; k < n; k++) {
+              w.push_back(res.map(&u[k * dim], y, &bins_of[k * dim]));
+              ys.insert(ys.end(), y.data(), y.data() + y.rows());
+            }
+            importance_weights(model, importance, w, ys, batch, h);
+            for (size_t j = 0; j < h.size(); j++) {
+              acc.weights.add(h[j]);
+              for (int d = 0; d < map.dim(); d++)
+                acc.h2[d * bins + bins_of[j * map.dim() + d]] += h[j] * h[j];
+            }
+          }
+        });
+
+      stats.iterations.push_back(sum.weights);
+      if (it + 1 < iterations)
+        res.grid.refine(sum.h2, alpha);
+    }
+    return res;
+  }
+
+}
+
+#endif
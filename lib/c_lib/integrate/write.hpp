@@ -0,0 +1,91 @@
+#ifndef MESON_DECA__LIB__C_LIB__INTEGRATE__WRITE_HPP
+#define MESON_DECA__LIB__C_LIB__INTEGRATE__WRITE_HPP
+
+#include <cmath> // isfinite
+#include <cstdio>
+#include <ostream>
+#include <string>
+
+#include <meson_deca/lib/c_lib/integrate/amplitude_sum.hpp>
+
+/*
+ *  Output of the normalization integrals.
+ *
+ *  FUNCTIONS
+ *    void write_python(ostream, normalization_integral)
+ */
+
+namespace integrate {
+
+  // Python literal of a real number; nan/inf as float('nan') etc.
+  inline std::string
+  python_real(double x) {
+    char buf[32];
+    if (std::isfinite(x))
+      snprintf(buf, sizeof(buf), "%.17g", x);
+    else
+      snprintf(buf, sizeof(buf), "float('%g')", x);
+    return buf;
+  }
+
+  // Python literal of a complex number, e.g. (1.5-0.25j)
+  inline std::string
+  python_complex(double re, double im) {
+    if (std::isfinite(re) && std::isfinite(im)) {
+      char buf[64];
+      snprintf(buf, sizeof(buf), "(%.17g%+.17gj)", re, im);
+      return buf;
+    }
+    return "complex(" + python_real(re) + "," + python_real(im) + ")";
+  }
+
+
+  /**
+   * void write_python(out, result, background)
+   *
+   * Writes the file normalization_integral.py, as read by
+   * utils/data_analysis__root_to_dataR.py:
+   *   I_ = np.asarray([[...], ...])
+   *   I_error_ = np.asarray([[...], ...])
+   *   I_background_ = np.asarray([...])        (if background)
+   *   I_background_error_ = np.asarray([...])  (if background)
+   *
+   * Like lib/py_lib/mcint.py, row j of I_ holds the integrals of
+   * conj(A_i) A_j (the reader transposes I_). The entries of I_error_
+   * are (error of Re) + (error of Im)j.
+   */
+  inline void
+  write_python(std::ostream& out, const normalization_integral& res,
+               bool background) {
+    int R = res.I[0].rows();
+    const char* names[2] = {"I_", "I_error_"};
+    const std::vector<Eigen::MatrixXd>* values[2] = {&res.I, &res.I_error};
+
+    for (int k = 0; k < 2; k++) {
+      const std::vector<Eigen::MatrixXd>& M = *values[k];
+      out << names[k] << " = np.asarray([";
+      for (int j = 0; j < R; j++) {
+        out << (j ? ",[" : "[");
+        for (int i = 0; i < R; i++)
+          out << (i ? "," : "") << python_complex(M[0](i,j), M[1](i,j));
+        out << "]";
+      }
+      out << "])\n";
+    }
+
+    if (!background)
+      return;
+
+    out << "I_background_ = np.asarray([";
+    for (int b = 0; b < res.I_bkg.rows(); b++)
+      out << (b ? "," : "") << python_real(res.I_bkg(b));
+    out << "])\n";
+    out << "I_background_error_ = np.asarray([";
+    for (int b = 0; b < res.I_bkg_error.rows(); b++)
+      out << (b ? "," : "") << python_real(res.I_bkg_error(b));
+    out << "])\n";
+  }
+
+}
+
+#endif
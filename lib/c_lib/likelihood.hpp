@@ -0,0 +1,36 @@
+#ifndef MESON_DECA__LIB__C_LIB__LIKELIHOOD_HPP
+#define MESON_DECA__LIB__C_LIB__LIKELIHOOD_HPP
+
+#include <meson_deca/lib/c_lib/likelihood/gradient.hpp>
+#include <meson_deca/lib/c_lib/likelihood/norm.hpp>
+#include <meson_deca/lib/c_lib/likelihood/log_likelihood.hpp>
+
+/*
+ *  Whole-dataset log-likelihood of the amplitude fit with analytic
+ *  gradients.
+ *
+ *  DESCRIPTION
+ *    The naive STAN model block
+ *
+ *      for (d in 1:D)
+ *        logH <- logH + log(f_model(A_cv_data[d], theta) / Norm(theta, I));
+ *
+ *    puts O(R) autodiff nodes per event on the tape and evaluates the
+ *    O(R^2) normalization D times. The functions in this folder work on
+ *    plain doubles instead: they compute
+ *
+ *      L(theta) = sum_d log f_model(A_d, theta) - D * log Norm(theta, I)
+ *
+ *    together with dL/dtheta in one pass over the data. The STAN-callable
+ *    wrappers in model.hpp attach this gradient to a single autodiff node.
+ *
+ *    The complex vector theta is passed as two real vectors theta_re,
+ *    theta_im (just like the STAN representation theta[2]); gradients
+ *    are returned in the same form.
+ *
+ *  FUNCTIONS
+ *    Are currently listed in particular files - gradient.hpp, norm.hpp,
+ *    log_likelihood.hpp.
+ */
+
+#endif
@@ -0,0 +1,253 @@
+#ifndef MESON_DECA__LIB__C_LIB__LIKELIHOOD__GRADIENT_HPP
+#define MESON_DECA__LIB__C_LIB__LIKELIHOOD__GRADIENT_HPP
+
+#include <stan/math/prim/mat/fun/Eigen.hpp>
+#include <boost/math/tools/promotion.hpp>
+#include <type_traits> // std::is_arithmetic, std::is_same
+#include <vector>
+
+#include <meson_deca/lib/c_lib/complex/scalar.hpp>
+
+namespace stan {
+  namespace math {
+    class var;
+  }
+}
+
+/*
+ *  Glue between the double-valued likelihood kernels and STAN autodiff.
+ *
+ *  TYPES
+ *    all_constant<T...>
+ *    reverse_mode<T...>
+ *    precomputed<T...>
+ *
+ *  FUNCTIONS
+ *    double value(scalar)
+ *    scalar attach_gradients(double, array of scalars, array of doubles)
+ *    complex_scalar attach_gradients(complex_scalar, array of scalars,
+ *                                    array of complex_scalars)
+ *    scalar attach_gradients_cv(double, complex_vector, vector, vector)
+ *    scalar attach_gradients_cv(double, complex_vector, vector, vector,
+ *                               vector, vector)
+ *    array flatten(complex_vector)
+ *    void value_of_cv(complex_vector, vector, vector)
+ */
+
+namespace likelihood {
+
+  /**
+   * all_constant<T...>
+   *
+   * all_constant<T...>::value is true if all T are plain arithmetic
+   * types (double, int), i.e. no autodiff variables. Selects the
+   * autodiff overloads of kernels with analytic partials (fct).
+   */
+  template <typename... T>
+  struct all_constant : std::true_type {};
+
+  template <typename T, typename... Ts>
+  struct all_constant<T, Ts...>
+    : std::integral_constant<bool, std::is_arithmetic<T>::value &&
+                                   all_constant<Ts...>::value> {};
+
+
+  /**
+   * reverse_mode<T...>
+   *
+   * reverse_mode<T...>::value is true if at least one T is
+   * stan::math::var and all others are plain arithmetic types. Only
+   * these can carry precomputed gradients (attach_gradients); all
+   * other scalars (fvar) use the generic templates.
+   */
+  template <typename... T>
+  struct reverse_mode : std::false_type {};
+
+  template <typename T>
+  struct reverse_mode<T>
+    : std::is_same<typename std::remove_cv<T>::type, stan::math::var> {};
+
+  template <typename T, typename T1, typename... Ts>
+  struct reverse_mode<T, T1, Ts...>
+    : std::integral_constant<bool,
+        (reverse_mode<T>::value || std::is_arithmetic<T>::value) &&
+        (reverse_mode<T1, Ts...>::value ||
+         (reverse_mode<T>::value && all_constant<T1, Ts...>::value))> {};
+
+
+  /**
+   * precomputed<T...>
+   *
+   * precomputed<T...>::value is true if a function of T... can return
+   * its value with precomputed gradients (attach_gradients): all T are
+   * plain arithmetic types, or reverse_mode<T...>.
+   */
+  template <typename... T>
+  struct precomputed
+    : std::integral_constant<bool, all_constant<T...>::value ||
+                                   reverse_mode<T...>::value> {};
+
+
+  /**
+   * double value(scalar)
+   *
+   * Value of a (possibly autodiff) scalar.
+   */
+  inline double value(double x) {
+    return x;
+  }
+
+  template <typename T>
+  inline double value(const T& x) {
+    return value_of(x); // found via ADL for stan::math::var
+  }
+
+
+  /**
+   * scalar attach_gradients(value, operands, gradients)
+   *
+   * Returns 'value' as a scalar of the operand type. If the operands
+   * are autodiff variables, the result is a single node on the tape
+   * whose partial derivatives w.r.t. operands[i] are gradients[i].
+   * For double operands the value is returned as is.
+   */
+  inline double
+  attach_gradients(double value, const std::vector<double>&,
+                   const std::vector<double>&) {
+    return value;
+  }
+
+  template <typename T>
+  inline T
+  attach_gradients(double value, const std::vector<T>& operands,
+                   const std::vector<double>& gradients) {
+    return precomputed_gradients(value, operands, gradients); // ADL
+  }
+
+
+  /**
+   * complex_scalar attach_gradients(value, operands, gradients)
+   *
+   * As above, for a complex value: the real and imaginary part are one
+   * node each, gradients[i] = d value / d operands[i].
+   */
+  template <typename T>
+  inline complex::complex_scalar<T>
+  attach_gradients(const complex::complex_scalar<double>& value,
+                   const std::vector<T>& operands,
+                   const std::vector<complex::complex_scalar<double> >& gradients) {
+    int n = gradients.size();
+    std::vector<double> g_re(n), g_im(n);
+    for (int i = 0; i < n; i++) {
+      g_re[i] = gradients[i].re;
+      g_im[i] = gradients[i].im;
+    }
+    return complex::complex_scalar<T>(
+      likelihood::attach_gradients(value.re, operands, g_re),
+      likelihood::attach_gradients(value.im, operands, g_im));
+  }
+
+
+  /**
+   * scalar attach_gradients_cv(value, theta, grad_re, grad_im)
+   *
+   * attach_gradients with the operands theta (STAN representation
+   * vector theta[2]); grad_re, grad_im are the derivatives w.r.t. the
+   * real and imaginary parts of theta.
+   */
+  template <typename T>
+  inline T
+  attach_gradients_cv(double value,
+                      const std::vector<Eigen::Matrix<T, Eigen::Dynamic, 1> >& theta,
+                      const Eigen::VectorXd& grad_re,
+                      const Eigen::VectorXd& grad_im) {
+    int R = grad_re.rows();
+    std::vector<T> operands(2 * R);
+    std::vector<double> grad(2 * R);
+    for (int i = 0; i < R; i++) {
+      operands[i] = theta[0](i);
+      operands[R + i] = theta[1](i);
+      grad[i] = grad_re(i);
+      grad[R + i] = grad_im(i);
+    }
+    return likelihood::attach_gradients(value, operands, grad);
+  }
+
+
+  /**
+   * scalar attach_gradients_cv(value, theta, grad_re, grad_im,
+   *                            theta_bkg, grad_bkg)
+   *
+   * As above, plus the real operands theta_bkg (background) with the
+   * derivatives grad_bkg.
+   */
+  template <typename T0, typename T1>
+  inline typename boost::math::tools::promote_args<T0,T1>::type
+  attach_gradients_cv(double value,
+                      const std::vector<Eigen::Matrix<T0, Eigen::Dynamic, 1> >& theta,
+                      const Eigen::VectorXd& grad_re,
+                      const Eigen::VectorXd& grad_im,
+                      const Eigen::Matrix<T1, Eigen::Dynamic, 1>& theta_bkg,
+                      const Eigen::VectorXd& grad_bkg) {
+
+    typedef typename boost::math::tools::promote_args<T0,T1>::type T_res;
+
+    int R = grad_re.rows();
+    int B = grad_bkg.rows();
+    std::vector<T_res> operands(2 * R + B);
+    std::vector<double> grad(2 * R + B);
+    for (int i = 0; i < R; i++) {
+      operands[i] = theta[0](i);
+      operands[R + i] = theta[1](i);
+      grad[i] = grad_re(i);
+      grad[R + i] = grad_im(i);
+    }
+    for (int i = 0; i < B; i++) {
+      operands[2 * R + i] = theta_bkg(i);
+      grad[2 * R + i] = grad_bkg(i);
+    }
+    return likelihood::attach_gradients(value, operands, grad);
+  }
+
+
+  /**
+   * array flatten(complex_vector)
+   *
+   * Concatenates the real and imaginary part of a complex vector
+   * (STAN representation vector[R] v[2]) into one array of length 2R.
+   * Used to collect the operands for attach_gradients.
+   */
+  template <typename T>
+  inline std::vector<T>
+  flatten(const std::vector<Eigen::Matrix<T, Eigen::Dynamic, 1> >& v) {
+    int R = v[0].rows();
+    std::vector<T> res(2 * R);
+    for (int i = 0; i < R; i++) {
+      res[i] = v[0](i);
+      res[R + i] = v[1](i);
+    }
+    return res;
+  }
+
+
+  /**
+   * void value_of_cv(complex_vector, vector, vector)
+   *
+   * Values of a (possibly autodiff) complex vector as two real vectors.
+   */
+  template <typename T>
+  inline void
+  value_of_cv(const std::vector<Eigen::Matrix<T, Eigen::Dynamic, 1> >& v,
+              Eigen::VectorXd& v_re, Eigen::VectorXd& v_im) {
+    int R = v[0].rows();
+    v_re.resize(R);
+    v_im.resize(R);
+    for (int i = 0; i < R; i++) {
+      v_re(i) = likelihood::value(v[0](i));
+      v_im(i) = likelihood::value(v[1](i));
+    }
+  }
+
+}
+
+#endif
@@ -0,0 +1,591 @@
+#ifndef MESON_DECA__LIB__C_LIB__LIKELIHOOD__LOG_LIKELIHOOD_HPP
+#define MESON_DECA__LIB__C_LIB__LIKELIHOOD__LOG_LIKELIHOOD_HPP
+
+#include <stan/math/prim/mat/fun/Eigen.hpp>
+#include <type_traits> // std::enable_if
+#include <vector>
+#include <cmath>
+
+#include <meson_deca/lib/c_lib/likelihood/gradient.hpp>
+#include <meson_deca/lib/c_lib/likelihood/norm.hpp>
+#include <meson_deca/lib/c_lib/parallel/reduce.hpp>
+
+/*
+ *  Whole-dataset log-likelihood with analytic gradient.
+ *
+ *  DESCRIPTION
+ *    The event data A_cv_data has the STAN layout vector[R] A[D,2]
+ *    (A[d][0] - real part, A[d][1] - imaginary part of the amplitudes
+ *    of event d); the background data has the layout vector[B] A_bkg[D].
+ *    Columnar data (e.g. memory-mapped, see data/amplitude_file.hpp) is
+ *    passed as an amplitude_view instead.
+ *
+ *    The sum over events runs on the parallel::pool() threads in blocks
+ *    of events_per_block events; the block sums are added in a fixed
+ *    tree order, so the result does not depend on the thread count.
+ *
+ *    log_likelihood_cv attaches the analytic gradient for double and
+ *    stan::math::var (reverse_mode, see gradient.hpp). Other scalars
+ *    (fvar) evaluate the same sums serially in their own arithmetic.
+ *
+ *  TYPES
+ *    event_sum
+ *    amplitude_view
+ *
+ *  FUNCTIONS
+ *    double sum_log_f(A_cv_data, ...)
+ *    event_sum parallel_sum_log_f(A_cv_data, ...)
+ *    double log_likelihood(A_cv_data, theta, I, ...)
+ *    double log_likelihood(A_cv_data, theta, I, A_bkg, theta_bkg, I_bkg, ...)
+ *    double log_likelihood(amplitude_view, theta, I, theta_bkg, I_bkg, ...)
+ *    void mask_cv(vector, vector, mask)
+ *    complex_vector mask_cv(complex_vector, mask)
+ *    scalar abs2_dot_cv(vector, vector, complex_vector)
+ *    scalar log_likelihood_cv(A_cv_data, theta, I, mask)
+ *    scalar log_likelihood_cv(A_cv_data, theta, I, A_bkg, theta_bkg, I_bkg,
+ *                             mask)
+ *    scalar log_likelihood_cv(amplitude_view, theta, I, theta_bkg, I_bkg,
+ *                             mask)
+ */
+
+namespace likelihood {
+
+  typedef std::vector<std::vector<Eigen::VectorXd> > amplitude_data;
+
+  // Events per block of the parallel sum. Changing this value changes
+  // the order of the floating point additions.
+  const int events_per_block = 256;
+
+
+  /**
+   * event_sum
+   *
+   * Partial sum of log f_model over a range of events together with
+   * its gradient.
+   */
+  struct event_sum {
+    double value;
+    Eigen::VectorXd grad_re;
+    Eigen::VectorXd grad_im;
+    Eigen::VectorXd grad_bkg;
+
+    event_sum(int R, int B) : 
+      value(0), grad_re(Eigen::VectorXd::Zero(R)), 
+      grad_im(Eigen::VectorXd::Zero(R)), grad_bkg(Eigen::VectorXd::Zero(B)) {};
+
+    event_sum& operator+=(const event_sum& other) {
+      value += other.value;
+      grad_re += other.grad_re;
+      grad_im += other.grad_im;
+      grad_bkg += other.grad_bkg;
+      return *this;
+    }
+  };
+
+
+  /**
+   * amplitude_view
+   *
+   * Columnar amplitudes: Re A_r(y_d) = re[r * stride + d], likewise im
+   * and bkg (bkg may be a null pointer if B == 0). The view does not
+   * own the data.
+   */
+  struct amplitude_view {
+    int D, R, B;
+    long stride;
+    const double* re;
+    const double* im;
+    const double* bkg;
+
+    amplitude_view(int _D, int _R, int _B, long _stride, const double* _re,
+                   const double* _im, const double* _bkg) :
+      D(_D), R(_R), B(_B), stride(_stride), re(_re), im(_im), bkg(_bkg) {};
+  };
+
+
+  /**
+   * double sum_log_f(A_cv_data, A_bkg, theta_re, theta_im, theta_bkg,
+   *                  d_begin, d_end, grad_re, grad_im, grad_bkg)
+   *
+   * Returns sum_d log f_model(A_d, theta) over the events
+   * d_begin <= d < d_end and ADDS the derivatives w.r.t. theta_re,
+   * theta_im (and theta_bkg) to grad_re, grad_im (and grad_bkg).
+   *
+   * The model function is |A_d * theta|^2 (+ A_bkg_d * theta_bkg, if
+   * A_bkg is not a null pointer).
+   */
+  inline double
+  sum_log_f(const amplitude_data& A, const std::vector<Eigen::VectorXd>* A_bkg,
+            const Eigen::VectorXd& theta_re, const Eigen::VectorXd& theta_im,
+            const Eigen::VectorXd& theta_bkg, int d_begin, int d_end,
+            Eigen::VectorXd& grad_re, Eigen::VectorXd& grad_im,
+            Eigen::VectorXd& grad_bkg) {
+
+    double res = 0;
+    for (int d = d_begin; d < d_end; d++) {
+      const Eigen::VectorXd& A_re = A[d][0];
+      const Eigen::VectorXd& A_im = A[d][1];
+
+      // s = A_d * theta (complex dot product without conjugation)
+      double s_re = A_re.dot(theta_re) - A_im.dot(theta_im);
+      double s_im = A_im.dot(theta_re) + A_re.dot(theta_im);
+      double f = s_re * s_re + s_im * s_im;
+      if (A_bkg != 0)
+        f += (*A_bkg)[d].dot(theta_bkg);
+
+      res += log(f);
+
+      // d log f / d theta = (d f / d theta) / f
+      double c_re = 2. * s_re / f;
+      double c_im = 2. * s_im / f;
+      grad_re += c_re * A_re + c_im * A_im;
+      grad_im += c_im * A_re - c_re * A_im;
+      if (A_bkg != 0)
+        grad_bkg += (*A_bkg)[d] / f;
+    }
+    return res;
+  }
+
+
+  /**
+   * double sum_log_f(amplitude_view, theta_re, theta_im, theta_bkg,
+   *                  d_begin, d_end, grad_re, grad_im, grad_bkg)
+   *
+   * As above, for columnar data (with background if A.B > 0).
+   */
+  inline double
+  sum_log_f(const amplitude_view& A,
+            const Eigen::VectorXd& theta_re, const Eigen::VectorXd& theta_im,
+            const Eigen::VectorXd& theta_bkg, int d_begin, int d_end,
+            Eigen::VectorXd& grad_re, Eigen::VectorXd& grad_im,
+            Eigen::VectorXd& grad_bkg) {
+
+    typedef Eigen::Map<const Eigen::VectorXd, 0, Eigen::InnerStride<> > column;
+    Eigen::InnerStride<> stride(A.stride);
+
+    double res = 0;
+    for (int d = d_begin; d < d_end; d++) {
+      column A_re(A.re + d, A.R, stride);
+      column A_im(A.im + d, A.R, stride);
+
+      double s_re = A_re.dot(theta_re) - A_im.dot(theta_im);
+      double s_im = A_im.dot(theta_re) + A_re.dot(theta_im);
+      double f = s_re * s_re + s_im * s_im;
+      if (A.B > 0)
+        f += column(A.bkg + d, A.B, stride).dot(theta_bkg);
+
+      res += log(f);
+
+      double c_re = 2. * s_re / f;
+      double c_im = 2. * s_im / f;
+      grad_re += c_re * A_re + c_im * A_im;
+      grad_im += c_im * A_re - c_re * A_im;
+      if (A.B > 0)
+        grad_bkg += column(A.bkg + d, A.B, stride) / f;
+    }
+    return res;
+  }
+
+
+  /**
+   * event_sum parallel_sum_log_f(A_cv_data, A_bkg, theta_re, theta_im,
+   *                              theta_bkg)
+   *
+   * sum_log_f over all events, evaluated block-wise on the thread pool
+   * with a deterministic reduction (see parallel/reduce.hpp).
+   */
+  inline event_sum
+  parallel_sum_log_f(const amplitude_data& A, 
+                     const std::vector<Eigen::VectorXd>* A_bkg,
+                     const Eigen::VectorXd& theta_re, 
+                     const Eigen::VectorXd& theta_im,
+                     const Eigen::VectorXd& theta_bkg) {
+
+    event_sum zero(theta_re.rows(), theta_bkg.rows());
+    return parallel::reduce(A.size(), events_per_block, zero,
+      [&](int d_begin, int d_end, event_sum& acc) {
+        acc.value = sum_log_f(A, A_bkg, theta_re, theta_im, theta_bkg,
+                              d_begin, d_end, 
+                              acc.grad_re, acc.grad_im, acc.grad_bkg);
+      });
+  }
+
+
+  /**
+   * event_sum parallel_sum_log_f(amplitude_view, theta_re, theta_im,
+   *                              theta_bkg)
+   *
+   * As above, for columnar data.
+   */
+  inline event_sum
+  parallel_sum_log_f(const amplitude_view& A,
+                     const Eigen::VectorXd& theta_re,
+                     const Eigen::VectorXd& theta_im,
+                     const Eigen::VectorXd& theta_bkg) {
+
+    event_sum zero(theta_re.rows(), theta_bkg.rows());
+    return parallel::reduce(A.D, events_per_block, zero,
+      [&](int d_begin, int d_end, event_sum& acc) {
+        acc.value = sum_log_f(A, theta_re, theta_im, theta_bkg,
+                              d_begin, d_end,
+                              acc.grad_re, acc.grad_im, acc.grad_bkg);
+      });
+  }
+
+
+  /**
+   * double log_likelihood(A_cv_data, theta_re, theta_im, I,
+   *                       grad_re, grad_im)
+   *
+   * Returns sum_d log(f_model(A_d, theta) / Norm(theta, I)) and its
+   * gradient w.r.t. theta_re, theta_im.
+   *
+   * @tparam T_I Normalization matrix type (complex matrix or 
+   *             packed_hermitian, see norm.hpp)
+   */
+  template <typename T_I>
+  inline double
+  log_likelihood(const amplitude_data& A,
+                 const Eigen::VectorXd& theta_re, 
+                 const Eigen::VectorXd& theta_im,
+                 const T_I& I,
+                 Eigen::VectorXd& grad_re, Eigen::VectorXd& grad_im) {
+
+    int D = A.size();
+    Eigen::VectorXd no_bkg(0);
+    event_sum sum = parallel_sum_log_f(A, 0, theta_re, theta_im, no_bkg);
+    double res = sum.value;
+    grad_re = sum.grad_re;
+    grad_im = sum.grad_im;
+
+    Eigen::VectorXd norm_re, norm_im;
+    double N = likelihood::norm(theta_re, theta_im, I, norm_re, norm_im);
+    grad_re -= (D / N) * norm_re;
+    grad_im -= (D / N) * norm_im;
+
+    return res - D * log(N);
+  }
+
+
+  /**
+   * double log_likelihood(A_cv_data, theta_re, theta_im, I,
+   *                       A_bkg, theta_bkg, I_bkg,
+   *                       grad_re, grad_im, grad_bkg)
+   *
+   * As above, for the model with incoherently summed background:
+   *   f_model = |A_d * theta|^2 + A_bkg_d * theta_bkg,
+   *   Norm = conj(theta)' * I * theta + I_bkg * theta_bkg.
+   */
+  template <typename T_I>
+  inline double
+  log_likelihood(const amplitude_data& A,
+                 const Eigen::VectorXd& theta_re, 
+                 const Eigen::VectorXd& theta_im,
+                 const T_I& I,
+                 const std::vector<Eigen::VectorXd>& A_bkg,
+                 const Eigen::VectorXd& theta_bkg,
+                 const Eigen::VectorXd& I_bkg,
+                 Eigen::VectorXd& grad_re, Eigen::VectorXd& grad_im,
+                 Eigen::VectorXd& grad_bkg) {
+
+    int D = A.size();
+    event_sum sum = parallel_sum_log_f(A, &A_bkg, theta_re, theta_im, theta_bkg);
+    double res = sum.value;
+    grad_re = sum.grad_re;
+    grad_im = sum.grad_im;
+    grad_bkg = sum.grad_bkg;
+
+    Eigen::VectorXd norm_re, norm_im;
+    double N = likelihood::norm(theta_re, theta_im, I, norm_re, norm_im)
+      + I_bkg.dot(theta_bkg);
+    grad_re -= (D / N) * norm_re;
+    grad_im -= (D / N) * norm_im;
+    grad_bkg -= (D / N) * I_bkg;
+
+    return res - D * log(N);
+  }
+
+
+  /**
+   * double log_likelihood(amplitude_view, theta_re, theta_im, I,
+   *                       theta_bkg, I_bkg, grad_re, grad_im, grad_bkg)
+   *
+   * As above, for columnar data; theta_bkg and I_bkg must have A.B
+   * entries (none for models without background).
+   */
+  template <typename T_I>
+  inline double
+  log_likelihood(const amplitude_view& A,
+                 const Eigen::VectorXd& theta_re,
+                 const Eigen::VectorXd& theta_im,
+                 const T_I& I,
+                 const Eigen::VectorXd& theta_bkg,
+                 const Eigen::VectorXd& I_bkg,
+                 Eigen::VectorXd& grad_re, Eigen::VectorXd& grad_im,
+                 Eigen::VectorXd& grad_bkg) {
+
+    int D = A.D;
+    event_sum sum = parallel_sum_log_f(A, theta_re, theta_im, theta_bkg);
+    double res = sum.value;
+    grad_re = sum.grad_re;
+    grad_im = sum.grad_im;
+    grad_bkg = sum.grad_bkg;
+
+    Eigen::VectorXd norm_re, norm_im;
+    double N = likelihood::norm(theta_re, theta_im, I, norm_re, norm_im)
+      + I_bkg.dot(theta_bkg);
+    grad_re -= (D / N) * norm_re;
+    grad_im -= (D / N) * norm_im;
+    grad_bkg -= (D / N) * I_bkg;
+
+    return res - D * log(N);
+  }
+
+
+  /**
+   * void mask_cv(v_re, v_im, mask)
+   *
+   * Sets the entries i of the complex vector v_re + i v_im with
+   * mask[i] == 0 to zero (nothing if mask is 0). Applied to theta, the
+   * sums over the resonances skip the inactive terms, just as f_model
+   * and Norm with restrict() do (see structures/active_resonances.hpp);
+   * applied to the gradient, the inactive theta do not move.
+   */
+  inline void
+  mask_cv(Eigen::VectorXd& v_re, Eigen::VectorXd& v_im,
+          const unsigned char* mask) {
+    if (mask == 0)
+      return;
+    for (int i = 0; i < v_re.rows(); i++) {
+      if (!mask[i]) {
+        v_re(i) = 0.;
+        v_im(i) = 0.;
+      }
+    }
+  }
+
+
+  /**
+   * complex_vector mask_cv(theta, mask)
+   *
+   * theta (STAN representation vector theta[2]) with the entries i,
+   * mask[i] == 0, replaced by constant zeros; theta itself if mask is
+   * 0. Used by the generic log_likelihood_cv, where the zeros also
+   * keep the gradient of the inactive theta at zero.
+   */
+  template <typename T>
+  inline std::vector<Eigen::Matrix<T, Eigen::Dynamic, 1> >
+  mask_cv(const std::vector<Eigen::Matrix<T, Eigen::Dynamic, 1> >& theta,
+          const unsigned char* mask) {
+    std::vector<Eigen::Matrix<T, Eigen::Dynamic, 1> > res(theta);
+    if (mask == 0)
+      return res;
+    for (int i = 0; i < res[0].rows(); i++) {
+      if (!mask[i]) {
+        res[0](i) = 0.;
+        res[1](i) = 0.;
+      }
+    }
+    return res;
+  }
+
+
+  /**
+   * scalar abs2_dot_cv(A_re, A_im, theta)
+   *
+   * |A * theta|^2 (complex dot product without conjugation) for the
+   * amplitudes A_re + i A_im of one event, in the arithmetic of the
+   * scalar of theta.
+   *
+   * @tparam T_A Real vector type (Eigen vector or strided column)
+   */
+  template <typename T_A, typename T>
+  inline T
+  abs2_dot_cv(const T_A& A_re, const T_A& A_im,
+              const std::vector<Eigen::Matrix<T, Eigen::Dynamic, 1> >& theta) {
+    T s_re = 0;
+    T s_im = 0;
+    for (int i = 0; i < A_re.rows(); i++) {
+      s_re += A_re(i) * theta[0](i) - A_im(i) * theta[1](i);
+      s_im += A_im(i) * theta[0](i) + A_re(i) * theta[1](i);
+    }
+    return s_re * s_re + s_im * s_im;
+  }
+
+
+  /**
+   * scalar log_likelihood_cv(A_cv_data, theta, I, mask)
+   *
+   * log_likelihood for the (possibly autodiff) complex vector theta
+   * (STAN representation vector theta[2]); the gradient is attached to
+   * a single autodiff node, no per-event expression graph is built.
+   * Only the resonances i with mask[i] != 0 contribute (all if mask is
+   * 0, see mask_cv). Throws std::domain_error if theta does not have
+   * I.R entries.
+   */
+  template <typename T>
+  inline typename std::enable_if<likelihood::precomputed<T>::value, T>::type
+  log_likelihood_cv(const amplitude_data& A,
+                    const std::vector<Eigen::Matrix<T, Eigen::Dynamic, 1> >& theta,
+                    const packed_hermitian& I,
+                    const unsigned char* mask = 0) {
+
+    likelihood::check_size("log_likelihood_cv", theta, I);
+    Eigen::VectorXd theta_re, theta_im, grad_re, grad_im;
+    likelihood::value_of_cv(theta, theta_re, theta_im);
+    likelihood::mask_cv(theta_re, theta_im, mask);
+    double res = likelihood::log_likelihood(A, theta_re, theta_im, I,
+                                            grad_re, grad_im);
+    likelihood::mask_cv(grad_re, grad_im, mask);
+    return likelihood::attach_gradients_cv(res, theta, grad_re, grad_im);
+  }
+
+  template <typename T>
+  inline typename std::enable_if<!likelihood::precomputed<T>::value, T>::type
+  log_likelihood_cv(const amplitude_data& A,
+                    const std::vector<Eigen::Matrix<T, Eigen::Dynamic, 1> >& theta,
+                    const packed_hermitian& I,
+                    const unsigned char* mask = 0) {
+
+    likelihood::check_size("log_likelihood_cv", theta, I);
+    std::vector<Eigen::Matrix<T, Eigen::Dynamic, 1> >
+      theta_active = likelihood::mask_cv(theta, mask);
+
+    int D = A.size();
+    T res = 0;
+    for (int d = 0; d < D; d++)
+      res += log(likelihood::abs2_dot_cv(A[d][0], A[d][1], theta_active));
+    return res - D * log(likelihood::norm_cv(theta_active, I));
+  }
+
+
+  /**
+   * scalar log_likelihood_cv(A_cv_data, theta, I, A_bkg, theta_bkg, I_bkg,
+   *                          mask)
+   *
+   * As above, for the model with incoherently summed background.
+   */
+  template <typename T0, typename T1>
+  inline typename std::enable_if<likelihood::precomputed<T0,T1>::value,
+    typename boost::math::tools::promote_args<T0,T1>::type>::type
+  log_likelihood_cv(const amplitude_data& A,
+                    const std::vector<Eigen::Matrix<T0, Eigen::Dynamic, 1> >& theta,
+                    const packed_hermitian& I,
+                    const std::vector<Eigen::VectorXd>& A_bkg,
+                    const Eigen::Matrix<T1, Eigen::Dynamic, 1>& theta_bkg,
+                    const Eigen::VectorXd& I_bkg,
+                    const unsigned char* mask = 0) {
+
+    likelihood::check_size("log_likelihood_cv", theta, I);
+    likelihood::check_size("log_likelihood_cv", theta_bkg, I_bkg);
+    Eigen::VectorXd theta_re, theta_im, grad_re, grad_im, grad_bkg;
+    likelihood::value_of_cv(theta, theta_re, theta_im);
+    likelihood::mask_cv(theta_re, theta_im, mask);
+    Eigen::VectorXd theta_bkg_value(theta_bkg.rows());
+    for (int i = 0; i < theta_bkg.rows(); i++)
+      theta_bkg_value(i) = likelihood::value(theta_bkg(i));
+
+    double res = likelihood::log_likelihood(A, theta_re, theta_im, I,
+                                            A_bkg, theta_bkg_value, I_bkg,
+                                            grad_re, grad_im, grad_bkg);
+    likelihood::mask_cv(grad_re, grad_im, mask);
+    return likelihood::attach_gradients_cv(res, theta, grad_re, grad_im,
+                                           theta_bkg, grad_bkg);
+  }
+
+  template <typename T0, typename T1>
+  inline typename std::enable_if<!likelihood::precomputed<T0,T1>::value,
+    typename boost::math::tools::promote_args<T0,T1>::type>::type
+  log_likelihood_cv(const amplitude_data& A,
+                    const std::vector<Eigen::Matrix<T0, Eigen::Dynamic, 1> >& theta,
+                    const packed_hermitian& I,
+                    const std::vector<Eigen::VectorXd>& A_bkg,
+                    const Eigen::Matrix<T1, Eigen::Dynamic, 1>& theta_bkg,
+                    const Eigen::VectorXd& I_bkg,
+                    const unsigned char* mask = 0) {
+
+    typedef typename boost::math::tools::promote_args<T0,T1>::type T_res;
+
+    likelihood::check_size("log_likelihood_cv", theta, I);
+    std::vector<Eigen::Matrix<T0, Eigen::Dynamic, 1> >
+      theta_active = likelihood::mask_cv(theta, mask);
+
+    int D = A.size();
+    T_res res = 0;
+    for (int d = 0; d < D; d++) {
+      T_res f = likelihood::abs2_dot_cv(A[d][0], A[d][1], theta_active);
+      for (int i = 0; i < theta_bkg.rows(); i++)
+        f += A_bkg[d](i) * theta_bkg(i);
+      res += log(f);
+    }
+    return res - D * log(likelihood::norm_cv(theta_active, I, theta_bkg, I_bkg));
+  }
+
+
+  /**
+   * scalar log_likelihood_cv(amplitude_view, theta, I, theta_bkg, I_bkg,
+   *                          mask)
+   *
+   * As above, for columnar data; theta_bkg and I_bkg must have A.B
+   * entries (none for models without background).
+   */
+  template <typename T0, typename T1>
+  inline typename std::enable_if<likelihood::precomputed<T0,T1>::value,
+    typename boost::math::tools::promote_args<T0,T1>::type>::type
+  log_likelihood_cv(const amplitude_view& A,
+                    const std::vector<Eigen::Matrix<T0, Eigen::Dynamic, 1> >& theta,
+                    const packed_hermitian& I,
+                    const Eigen::Matrix<T1, Eigen::Dynamic, 1>& theta_bkg,
+                    const Eigen::VectorXd& I_bkg,
+                    const unsigned char* mask = 0) {
+
+    likelihood::check_size("log_likelihood_cv", theta, I);
+    likelihood::check_size("log_likelihood_cv", theta_bkg, I_bkg);
+    Eigen::VectorXd theta_re, theta_im, grad_re, grad_im, grad_bkg;
+    likelihood::value_of_cv(theta, theta_re, theta_im);
+    likelihood::mask_cv(theta_re, theta_im, mask);
+    Eigen::VectorXd theta_bkg_value(theta_bkg.rows());
+    for (int i = 0; i < theta_bkg.rows(); i++)
+      theta_bkg_value(i) = likelihood::value(theta_bkg(i));
+
+    double res = likelihood::log_likelihood(A, theta_re, theta_im, I,
+                                            theta_bkg_value, I_bkg,
+                                            grad_re, grad_im, grad_bkg);
+    likelihood::mask_cv(grad_re, grad_im, mask);
+    return likelihood::attach_gradients_cv(res, theta, grad_re, grad_im,
+                                           theta_bkg, grad_bkg);
+  }
+
+  template <typename T0, typename T1>
+  inline typename std::enable_if<!likelihood::precomputed<T0,T1>::value,
+    typename boost::math::tools::promote_args<T0,T1>::type>::type
+  log_likelihood_cv(const amplitude_view& A,
+                    const std::vector<Eigen::Matrix<T0, Eigen::Dynamic, 1> >& theta,
+                    const packed_hermitian& I,
+                    const Eigen::Matrix<T1, Eigen::Dynamic, 1>& theta_bkg,
+                    const Eigen::VectorXd& I_bkg,
+                    const unsigned char* mask = 0) {
+
+    typedef typename boost::math::tools::promote_args<T0,T1>::type T_res;
+    typedef Eigen::Map<const Eigen::VectorXd, 0, Eigen::InnerStride<> > column;
+    Eigen::InnerStride<> stride(A.stride);
+
+    likelihood::check_size("log_likelihood_cv", theta, I);
+    std::vector<Eigen::Matrix<T0, Eigen::Dynamic, 1> >
+      theta_active = likelihood::mask_cv(theta, mask);
+
+    T_res res = 0;
+    for (int d = 0; d < A.D; d++) {
+      T_res f = likelihood::abs2_dot_cv(column(A.re + d, A.R, stride),
+                                        column(A.im + d, A.R, stride),
+                                        theta_active);
+      for (int i = 0; i < A.B; i++)
+        f += A.bkg[i * A.stride + d] * theta_bkg(i);
+      res += log(f);
+    }
+    return res - A.D * log(likelihood::norm_cv(theta_active, I, theta_bkg, I_bkg));
+  }
+
+}
+
+#endif
@@ -0,0 +1,430 @@
+#ifndef MESON_DECA__LIB__C_LIB__LIKELIHOOD__NORM_HPP
+#define MESON_DECA__LIB__C_LIB__LIKELIHOOD__NORM_HPP
+
+#include <stan/math/prim/mat/fun/Eigen.hpp>
+#include <stdexcept>
+#include <string>
+#include <type_traits> // std::enable_if
+#include <vector>
+
+#include <meson_deca/lib/c_lib/likelihood/gradient.hpp>
+
+/*
+ *  Normalization of the model function with analytic gradient.
+ *
+ *  DESCRIPTION
+ *    The normalization matrix I[i,j] = \int conj(A_i) A_j is Hermitian,
+ *    so only its upper triangle is stored ('packed' storage, row by
+ *    row: I[0,0..R-1], I[1,1..R-1], ..., I[R-1,R-1]). Real and imaginary
+ *    parts are kept in two contiguous arrays so that each row segment
+ *    is a plain dot product/axpy, which Eigen vectorizes (SSE/AVX,
+ *    depending on the compiler flags).
+ *
+ *  TYPES
+ *    packed_hermitian
+ *
+ *  FUNCTIONS
+ *    packed_hermitian pack(complex_matrix)
+ *    packed_hermitian pack(packed complex vector)
+ *    packed_hermitian restrict(packed_hermitian, mask)
+ *    complex_vector restrict(complex_vector, mask)
+ *    void check_size(name, complex_vector, packed_hermitian)
+ *    void check_size(name, vector, vector)
+ *    double norm(vector, vector, packed_hermitian)
+ *    double norm(vector, vector, packed_hermitian, vector, vector)
+ *    double norm(vector, vector, complex_matrix, vector, vector)
+ *    scalar norm_cv(complex_vector, packed_hermitian)
+ *    scalar norm_cv(complex_vector, packed_hermitian, vector, vector)
+ */
+
+namespace likelihood {
+
+  /**
+   * packed_hermitian
+   *
+   * Upper triangle of a Hermitian R x R matrix, R*(R+1)/2 entries.
+   * The STAN representation is vector[R*(R+1)/2] I_packed[2].
+   */
+  struct packed_hermitian {
+    int R;
+    Eigen::VectorXd re; // Real parts, row by row
+    Eigen::VectorXd im; // Imaginary parts, row by row
+
+    packed_hermitian() : R(0) {};
+
+    explicit packed_hermitian(int _R) :
+      R(_R), re(Eigen::VectorXd::Zero(_R * (_R + 1) / 2)),
+      im(Eigen::VectorXd::Zero(_R * (_R + 1) / 2)) {};
+
+    // Position of the element (i,i) in re, im; row i continues up to
+    // the element (i,R-1).
+    inline int offset(int i) const {
+      return i * R - i * (i - 1) / 2;
+    }
+  };
+
+
+  /**
+   * packed_hermitian pack(complex_matrix)
+   *
+   * Packs the complex matrix I (STAN representation matrix I[2]).
+   * The Hermitian part (I + I^H)/2 is stored; it gives the same value
+   * of Re(conj(theta)' * I * theta) as I itself, even if I is not
+   * exactly Hermitian due to rounding. Throws std::domain_error if I
+   * is not a square complex matrix.
+   */
+  inline packed_hermitian
+  pack(const std::vector<Eigen::MatrixXd>& I) {
+    if (I.size() != 2 || I[0].rows() != I[0].cols() ||
+        I[1].rows() != I[0].rows() || I[1].cols() != I[0].cols())
+      throw std::domain_error("pack: I is not a square complex matrix");
+
+    int R = I[0].rows();
+    packed_hermitian res(R);
+    int k = 0;
+    for (int i = 0; i < R; i++) {
+      for (int j = i; j < R; j++) {
+        res.re(k) = 0.5 * (I[0](i,j) + I[0](j,i));
+        res.im(k) = 0.5 * (I[1](i,j) - I[1](j,i));
+        k++;
+      }
+    }
+    return res;
+  }
+
+
+  /**
+   * packed_hermitian pack(packed complex vector)
+   *
+   * Wraps the STAN representation vector[R*(R+1)/2] I_packed[2].
+   * Throws std::domain_error if the length of I_packed is not
+   * R*(R+1)/2 for any R.
+   */
+  inline packed_hermitian
+  pack(const std::vector<Eigen::VectorXd>& I_packed) {
+    if (I_packed.size() != 2)
+      throw std::domain_error("pack: I_packed is not a complex vector");
+
+    int n = I_packed[0].rows();
+    int R = 0;
+    while (R * (R + 1) / 2 < n)
+      R++;
+    if (n != R * (R + 1) / 2 || I_packed[1].rows() != n)
+      throw std::domain_error("pack: invalid length of I_packed");
+
+    packed_hermitian res(R);
+    res.re = I_packed[0];
+    res.im = I_packed[1];
+    return res;
+  }
+
+
+  /**
+   * packed_hermitian restrict(I, mask)
+   *
+   * The rows and columns i of I with mask[i] != 0 (see
+   * structures/active_resonances.hpp); I itself if mask is 0.
+   * Together with restrict(theta, mask), norm_cv then skips the
+   * inactive terms.
+   */
+  inline packed_hermitian
+  restrict(const packed_hermitian& I, const unsigned char* mask) {
+    if (mask == 0)
+      return I;
+
+    std::vector<int> active;
+    for (int i = 0; i < I.R; i++)
+      if (mask[i])
+        active.push_back(i);
+
+    int R = active.size();
+    packed_hermitian res(R);
+    int k = 0;
+    for (int i = 0; i < R; i++) {
+      int k_i = I.offset(active[i]) - active[i];
+      for (int j = i; j < R; j++) {
+        res.re(k) = I.re(k_i + active[j]);
+        res.im(k) = I.im(k_i + active[j]);
+        k++;
+      }
+    }
+    return res;
+  }
+
+
+  /**
+   * complex_vector restrict(theta, mask)
+   *
+   * The entries i of theta (STAN representation vector theta[2]) with
+   * mask[i] != 0, in order; theta itself if mask is 0.
+   */
+  template <typename T>
+  inline std::vector<Eigen::Matrix<T, Eigen::Dynamic, 1> >
+  restrict(const std::vector<Eigen::Matrix<T, Eigen::Dynamic, 1> >& theta,
+           const unsigned char* mask) {
+    if (mask == 0)
+      return theta;
+
+    int R = theta[0].rows();
+    int n = 0;
+    for (int i = 0; i < R; i++)
+      n += mask[i] != 0;
+
+    std::vector<Eigen::Matrix<T, Eigen::Dynamic, 1> > res(2);
+    res[0].resize(n);
+    res[1].resize(n);
+    int k = 0;
+    for (int i = 0; i < R; i++) {
+      if (!mask[i])
+        continue;
+      res[0](k) = theta[0](i);
+      res[1](k) = theta[1](i);
+      k++;
+    }
+    return res;
+  }
+
+
+  /**
+   * void check_size(function, theta, I)
+   *
+   * Throws std::domain_error if theta (STAN representation vector
+   * theta[2]) does not have I.R entries; 'function' names the caller
+   * in the message.
+   */
+  template <typename T>
+  inline void
+  check_size(const char* function,
+             const std::vector<Eigen::Matrix<T, Eigen::Dynamic, 1> >& theta,
+             const packed_hermitian& I) {
+    if (theta.size() != 2 || theta[0].rows() != I.R || theta[1].rows() != I.R)
+      throw std::domain_error(std::string(function)
+                              + ": theta does not match the size of I");
+  }
+
+
+  /**
+   * void check_size(function, theta_bkg, I_bkg)
+   *
+   * Throws std::domain_error if theta_bkg and I_bkg differ in length.
+   */
+  template <typename T>
+  inline void
+  check_size(const char* function,
+             const Eigen::Matrix<T, Eigen::Dynamic, 1>& theta_bkg,
+             const Eigen::VectorXd& I_bkg) {
+    if (theta_bkg.rows() != I_bkg.rows())
+      throw std::domain_error(std::string(function)
+                              + ": theta_bkg does not match the size of I_bkg");
+  }
+
+
+  /**
+   * double norm(theta_re, theta_im, I)
+   *
+   * Returns conj(theta)' * I * theta for the packed Hermitian I.
+   * Uses the upper triangle only, i.e.
+   *   sum_i I_ii |theta_i|^2 + 2 Re sum_{i<j} conj(theta_i) I_ij theta_j,
+   * which needs about half the multiply-adds of the full double loop.
+   */
+  inline double
+  norm(const Eigen::VectorXd& theta_re, const Eigen::VectorXd& theta_im,
+       const packed_hermitian& I) {
+
+    int R = I.R;
+    double res = 0;
+    for (int i = 0; i < R; i++) {
+      int n = R - i - 1;
+      int k = I.offset(i);
+
+      res += I.re(k) * (theta_re(i) * theta_re(i) + theta_im(i) * theta_im(i));
+      if (n == 0)
+        continue;
+
+      // sum_{j>i} I_ij theta_j
+      double s_re = I.re.segment(k + 1, n).dot(theta_re.tail(n))
+                  - I.im.segment(k + 1, n).dot(theta_im.tail(n));
+      double s_im = I.re.segment(k + 1, n).dot(theta_im.tail(n))
+                  + I.im.segment(k + 1, n).dot(theta_re.tail(n));
+      res += 2. * (theta_re(i) * s_re + theta_im(i) * s_im);
+    }
+    return res;
+  }
+
+
+  /**
+   * double norm(theta_re, theta_im, I, grad_re, grad_im)
+   *
+   * As above; also stores the derivatives w.r.t. theta_re, theta_im
+   * in grad_re, grad_im. For Hermitian I these are 2 Re(I theta) and
+   * 2 Im(I theta); I theta is assembled from the packed triangle in
+   * one sweep (row dot product for the upper part, axpy for the
+   * lower part).
+   */
+  inline double
+  norm(const Eigen::VectorXd& theta_re, const Eigen::VectorXd& theta_im,
+       const packed_hermitian& I,
+       Eigen::VectorXd& grad_re, Eigen::VectorXd& grad_im) {
+
+    int R = I.R;
+    Eigen::VectorXd y_re = Eigen::VectorXd::Zero(R);
+    Eigen::VectorXd y_im = Eigen::VectorXd::Zero(R);
+
+    for (int i = 0; i < R; i++) {
+      int n = R - i;
+      int k = I.offset(i);
+
+      // Upper triangle incl. diagonal: y_i += sum_{j>=i} I_ij theta_j
+      y_re(i) += I.re.segment(k, n).dot(theta_re.tail(n))
+               - I.im.segment(k, n).dot(theta_im.tail(n));
+      y_im(i) += I.re.segment(k, n).dot(theta_im.tail(n))
+               + I.im.segment(k, n).dot(theta_re.tail(n));
+
+      // Lower triangle: y_j += conj(I_ij) theta_i for j > i
+      if (n > 1) {
+        y_re.tail(n - 1) += theta_re(i) * I.re.segment(k + 1, n - 1)
+                          + theta_im(i) * I.im.segment(k + 1, n - 1);
+        y_im.tail(n - 1) += theta_im(i) * I.re.segment(k + 1, n - 1)
+                          - theta_re(i) * I.im.segment(k + 1, n - 1);
+      }
+    }
+
+    grad_re = 2. * y_re;
+    grad_im = 2. * y_im;
+    return theta_re.dot(y_re) + theta_im.dot(y_im);
+  }
+
+
+  /**
+   * double norm(theta_re, theta_im, I, grad_re, grad_im)
+   *
+   * Convenience overload for the full complex matrix I (STAN
+   * representation matrix I[2]).
+   */
+  inline double
+  norm(const Eigen::VectorXd& theta_re, const Eigen::VectorXd& theta_im,
+       const std::vector<Eigen::MatrixXd>& I,
+       Eigen::VectorXd& grad_re, Eigen::VectorXd& grad_im) {
+    return likelihood::norm(theta_re, theta_im, likelihood::pack(I),
+                            grad_re, grad_im);
+  }
+
+
+  /**
+   * scalar norm_cv(complex_vector theta, I)
+   *
+   * Returns conj(theta)' * I * theta for the (possibly autodiff) complex
+   * vector theta (STAN representation vector theta[2]). For reverse
+   * mode (stan::math::var) the analytic gradient is attached to a single
+   * autodiff node; no per-term expression graph is built. Other scalars
+   * (fvar) evaluate the packed sum in their own arithmetic. Throws
+   * std::domain_error if theta does not have I.R entries.
+   */
+  inline double
+  norm_cv(const std::vector<Eigen::VectorXd>& theta, const packed_hermitian& I) {
+    likelihood::check_size("norm_cv", theta, I);
+    return likelihood::norm(theta[0], theta[1], I);
+  }
+
+  template <typename T>
+  inline typename std::enable_if<likelihood::reverse_mode<T>::value, T>::type
+  norm_cv(const std::vector<Eigen::Matrix<T, Eigen::Dynamic, 1> >& theta,
+          const packed_hermitian& I) {
+
+    likelihood::check_size("norm_cv", theta, I);
+    Eigen::VectorXd theta_re, theta_im, grad_re, grad_im;
+    likelihood::value_of_cv(theta, theta_re, theta_im);
+    double res = likelihood::norm(theta_re, theta_im, I, grad_re, grad_im);
+
+    int R = theta_re.rows();
+    std::vector<double> grad(2 * R);
+    for (int i = 0; i < R; i++) {
+      grad[i] = grad_re(i);
+      grad[R + i] = grad_im(i);
+    }
+    return likelihood::attach_gradients(res, likelihood::flatten(theta), grad);
+  }
+
+  template <typename T>
+  inline typename std::enable_if<!likelihood::reverse_mode<T>::value, T>::type
+  norm_cv(const std::vector<Eigen::Matrix<T, Eigen::Dynamic, 1> >& theta,
+          const packed_hermitian& I) {
+
+    likelihood::check_size("norm_cv", theta, I);
+    int R = I.R;
+    T res = 0;
+    for (int i = 0; i < R; i++) {
+      int k = I.offset(i);
+      res += I.re(k) * (theta[0](i) * theta[0](i) + theta[1](i) * theta[1](i));
+
+      // 2 Re conj(theta_i) I_ij theta_j, j > i
+      for (int j = i + 1; j < R; j++) {
+        k++;
+        T s_re = I.re(k) * theta[0](j) - I.im(k) * theta[1](j);
+        T s_im = I.re(k) * theta[1](j) + I.im(k) * theta[0](j);
+        res += 2. * (theta[0](i) * s_re + theta[1](i) * s_im);
+      }
+    }
+    return res;
+  }
+
+
+  /**
+   * scalar norm_cv(complex_vector theta, I, theta_bkg, I_bkg)
+   *
+   * As above, plus the incoherent background term I_bkg * theta_bkg;
+   * also throws if theta_bkg and I_bkg differ in length.
+   */
+  template <typename T0, typename T1>
+  inline typename std::enable_if<likelihood::reverse_mode<T0,T1>::value,
+    typename boost::math::tools::promote_args<T0,T1>::type>::type
+  norm_cv(const std::vector<Eigen::Matrix<T0, Eigen::Dynamic, 1> >& theta,
+          const packed_hermitian& I,
+          const Eigen::Matrix<T1, Eigen::Dynamic, 1>& theta_bkg,
+          const Eigen::VectorXd& I_bkg) {
+
+    typedef typename boost::math::tools::promote_args<T0,T1>::type T_res;
+
+    likelihood::check_size("norm_cv", theta, I);
+    likelihood::check_size("norm_cv", theta_bkg, I_bkg);
+    Eigen::VectorXd theta_re, theta_im, grad_re, grad_im;
+    likelihood::value_of_cv(theta, theta_re, theta_im);
+    double res = likelihood::norm(theta_re, theta_im, I, grad_re, grad_im);
+
+    int R = theta_re.rows();
+    int B = theta_bkg.rows();
+    std::vector<T_res> operands(2 * R + B);
+    std::vector<double> grad(2 * R + B);
+    for (int i = 0; i < R; i++) {
+      operands[i] = theta[0](i);
+      operands[R + i] = theta[1](i);
+      grad[i] = grad_re(i);
+      grad[R + i] = grad_im(i);
+    }
+    for (int i = 0; i < B; i++) {
+      operands[2 * R + i] = theta_bkg(i);
+      grad[2 * R + i] = I_bkg(i);
+      res += I_bkg(i) * likelihood::value(theta_bkg(i));
+    }
+    return likelihood::attach_gradients(res, operands, grad);
+  }
+
+  template <typename T0, typename T1>
+  inline typename std::enable_if<!likelihood::reverse_mode<T0,T1>::value,
+    typename boost::math::tools::promote_args<T0,T1>::type>::type
+  norm_cv(const std::vector<Eigen::Matrix<T0, Eigen::Dynamic, 1> >& theta,
+          const packed_hermitian& I,
+          const Eigen::Matrix<T1, Eigen::Dynamic, 1>& theta_bkg,
+          const Eigen::VectorXd& I_bkg) {
+
+    likelihood::check_size("norm_cv", theta_bkg, I_bkg);
+    typename boost::math::tools::promote_args<T0,T1>::type
+      res = likelihood::norm_cv(theta, I);
+    for (int i = 0; i < theta_bkg.rows(); i++)
+      res += I_bkg(i) * theta_bkg(i);
+    return res;
+  }
+
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef MESON_DECA__LIB__C_LIB__PARALLEL_HPP
+#define MESON_DECA__LIB__C_LIB__PARALLEL_HPP
+
+#include <meson_deca/lib/c_lib/parallel/thread_pool.hpp>
+#include <meson_deca/lib/c_lib/parallel/reduce.hpp>
+
+/*
+ *  Shared-memory parallelism for event loops.
+ *
+ *  DESCRIPTION
+ *    A single process-wide pool of worker threads (thread_pool.hpp)
+ *    executes independent tasks, e.g. blocks of events. The size of
+ *    the pool is taken from the environment variable
+ *    MESON_DECA_NUM_THREADS (default: 1, i.e. serial) or set with
+ *    parallel::set_num_threads.
+ *
+ *    Reductions (reduce.hpp) split the work into blocks of a FIXED
+ *    size and add the partial results in a fixed tree order. The
+ *    result is therefore bitwise identical for any number of threads.
+ *
+ *    Requires C++11 (-std=c++11 -pthread; see makefile).
+ *
+ *  FUNCTIONS
+ *    Are currently listed in particular files - thread_pool.hpp, reduce.hpp.
+ */
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef MESON_DECA__LIB__C_LIB__PARALLEL__REDUCE_HPP
+#define MESON_DECA__LIB__C_LIB__PARALLEL__REDUCE_HPP
+
+#include <algorithm> // std::min
+#include <vector>
+
+#include <meson_deca/lib/c_lib/parallel/thread_pool.hpp>
+
+/*
+ *  Deterministic parallel reduction.
+ *
+ *  FUNCTIONS
+ *    Acc reduce(int, int, Acc, F)
+ */
+
+namespace parallel {
+
+  /**
+   * Acc reduce(n, block_size, zero, f)
+   *
+   * Splits the items 0, ..., n-1 into blocks of block_size items,
+   * evaluates f(begin, end, acc) for every block on the thread pool
+   * (acc starts as a copy of zero) and adds the block results in a
+   * fixed pairwise tree:
+   *   ((b0 + b1) + (b2 + b3)) + ((b4 + b5) + ...).
+   *
+   * Neither the blocks nor the order of the additions depend on the
+   * number of threads, so the result is bitwise reproducible.
+   *
+   * @tparam Acc Accumulator type, must provide operator+=
+   * @tparam F   Callable void(int begin, int end, Acc& acc)
+   */
+  template <typename Acc, typename F>
+  inline Acc
+  reduce(int n, int block_size, const Acc& zero, const F& f) {
+
+    int n_blocks = (n + block_size - 1) / block_size;
+    if (n_blocks == 0)
+      return zero;
+
+    std::vector<Acc> partial(n_blocks, zero);
+    parallel::pool()->run(n_blocks, [&](int b) {
+        f(b * block_size, std::min(n, (b + 1) * block_size), partial[b]);
+      });
+
+    for (int stride = 1; stride < n_blocks; stride *= 2)
+      for (int b = 0; b + stride < n_blocks; b += 2 * stride)
+        partial[b] += partial[b + stride];
+
+    return partial[0];
+  }
+
+}
+
+#endif
@@ -0,0 +1,223 @@
+#ifndef MESON_DECA__LIB__C_LIB__PARALLEL__THREAD_POOL_HPP
+#define MESON_DECA__LIB__C_LIB__PARALLEL__THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib> // getenv, atoi
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ *  Persistent pool of worker threads.
+ *
+ *  FUNCTIONS
+ *    shared_ptr<thread_pool> pool()
+ *    int num_threads()
+ *    void set_num_threads(int)
+ */
+
+namespace parallel {
+
+  /**
+   * thread_pool
+   *
+   * Executes tasks 0, ..., n_tasks-1 of a job on n_threads threads (the
+   * calling thread plus n_threads-1 workers). The workers are started
+   * once and sleep between jobs, so small jobs do not pay the thread
+   * start-up cost.
+   *
+   * A job started from inside a task, or while another thread is
+   * running a job, is executed serially by the calling thread.
+   */
+  class thread_pool {
+  public:
+
+    explicit thread_pool(int n_threads) :
+      n_tasks_(0), next_(0), active_(0), generation_(0), stop_(false) {
+      for (int i = 1; i < n_threads; i++)
+        workers_.push_back(std::thread(&thread_pool::work, this));
+    }
+
+    ~thread_pool() {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+      }
+      wake_.notify_all();
+      for (size_t i = 0; i < workers_.size(); i++)
+        workers_[i].join();
+    }
+
+    // Number of threads working on a job (including the caller)
+    int size() const {
+      return workers_.size() + 1;
+    }
+
+    // Runs f(0), ..., f(n_tasks-1) and returns when all are done.
+    // Exceptions thrown by f are rethrown in the calling thread.
+    void run(int n_tasks, const std::function<void(int)>& f) {
+
+      std::unique_lock<std::mutex> busy(run_mutex_, std::try_to_lock);
+      if (in_task() || !busy.owns_lock() || workers_.empty() || n_tasks < 2) {
+        for (int i = 0; i < n_tasks; i++)
+          f(i);
+        return;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &f;
+        n_tasks_ = n_tasks;
+        next_ = 0;
+        active_ = workers_.size();
+        error_ = std::exception_ptr();
+        generation_++;
+      }
+      wake_.notify_all();
+
+      execute();
+
+      std::unique_lock<std::mutex> lock(mutex_);
+      done_.wait(lock, [this] { return active_ == 0; });
+      job_ = 0;
+      if (error_)
+        std::rethrow_exception(error_);
+    }
+
+  private:
+
+    // True inside a task executed by this pool
+    static bool& in_task() {
+      static thread_local bool flag = false;
+      return flag;
+    }
+
+    // Takes tasks from the current job until none are left
+    void execute() {
+      in_task() = true;
+      int i;
+      while ((i = next_++) < n_tasks_) {
+        try {
+          (*job_)(i);
+        }
+        catch (...) {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (!error_)
+            error_ = std::current_exception();
+        }
+      }
+      in_task() = false;
+    }
+
+    // Worker loop: sleep until a new job (or stop) arrives
+    void work() {
+      unsigned long seen = 0;
+      for (;;) {
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+          if (stop_)
+            return;
+          seen = generation_;
+        }
+
+        execute();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--active_ == 0)
+          done_.notify_one();
+      }
+    }
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;     // Guards the job description below
+    std::mutex run_mutex_; // One job at a time
+    std::condition_variable wake_;
+    std::condition_variable done_;
+
+    const std::function<void(int)>* job_;
+    int n_tasks_;
+    std::atomic<int> next_;
+    int active_;
+    unsigned long generation_;
+    bool stop_;
+    std::exception_ptr error_;
+  };
+
+
+  /**
+   * int default_num_threads()
+   *
+   * Reads MESON_DECA_NUM_THREADS from the environment; 1 if unset.
+   */
+  inline int default_num_threads() {
+    const char* env = std::getenv("MESON_DECA_NUM_THREADS");
+    int n = env ? std::atoi(env) : 1;
+    return n > 0 ? n : 1;
+  }
+
+
+  // Storage for the process-wide pool; pool_mutex() guards the pointer
+  inline std::shared_ptr<thread_pool>& pool_ptr() {
+    static std::shared_ptr<thread_pool> p(new thread_pool(default_num_threads()));
+    return p;
+  }
+
+  inline std::mutex& pool_mutex() {
+    static std::mutex m;
+    return m;
+  }
+
+
+  /**
+   * shared_ptr<thread_pool> pool()
+   *
+   * Returns the process-wide thread pool. The caller shares its
+   * ownership, so set_num_threads on another thread does not destroy
+   * the pool while a job of this caller is running, e.g.
+   *   parallel::pool()->run(n_tasks, f);
+   */
+  inline std::shared_ptr<thread_pool> pool() {
+    std::lock_guard<std::mutex> lock(pool_mutex());
+    return pool_ptr();
+  }
+
+
+  /**
+   * int num_threads()
+   *
+   * Returns the size of the process-wide thread pool.
+   */
+  inline int num_threads() {
+    return pool()->size();
+  }
+
+
+  /**
+   * void set_num_threads(int)
+   *
+   * Resizes the process-wide thread pool. Jobs that are running keep
+   * the old pool, which is destroyed (and its workers joined) when the
+   * last of them returns; later jobs use the new one.
+   */
+  inline void set_num_threads(int n_threads) {
+    if (n_threads < 1)
+      n_threads = 1;
+
+    std::shared_ptr<thread_pool> old; // Joins its workers after the unlock
+    {
+      std::lock_guard<std::mutex> lock(pool_mutex());
+      if (n_threads == pool_ptr()->size())
+        return;
+      old = pool_ptr();
+      pool_ptr().reset(new thread_pool(n_threads));
+    }
+  }
+
+}
+
+#endif
@@ -1,11 +1,17 @@
 #include<iostream>
+#include <algorithm> // std::min
+#include <cstring>   // std::strcmp
+#include <string>
 
 #include <boost/python/module.hpp>
 #include <boost/python/def.hpp>
 #include <boost/python/list.hpp>
 #include <boost/python/extract.hpp>
+#include <boost/python/errors.hpp>
+#include <boost/python/object.hpp>
 #include <boost/python/suite/indexing/vector_indexing_suite.hpp>
 #include <meson_deca/lib/c_lib/model.hpp>
+#include <meson_deca/lib/c_lib/parallel/thread_pool.hpp>
 
 // Python wrapper for functions specified in model.hpp
 
@@ -52,8 +58,194 @@ namespace stan {
      }
 
 
+    /**
+     * vector _A_cm_py_wrapper(int, int, list)
+     *
+     * Argument wrapper for the batch function A_cm: the list holds D
+     * events of y_len variables one after the other. Returns the
+     * flattened amplitudes [re/im][resonance][event], i.e. the python
+     * array reshape(2, num_resonances(), D).
+     */
+     inline
+     std::vector<double>
+     _A_cm_py_wrapper(int y_len, int D, boost::python::list mapping) {
+
+        // Convert python list to a contiguous array of events
+        std::vector<double> y(y_len * D);
+        for (int i=0; i < y_len * D; i++) {
+            y[i] = boost::python::extract<double>(mapping[i]);
+        }
+
+        complex::split_matrix A;
+        A_cm(y.empty() ? 0 : &y[0], D, A);
+
+        std::vector<double> std_res(2 * NUM_RES * D);
+        for (int r=0; r < NUM_RES; r++) {
+          for (int d=0; d < D; d++) {
+            std_res[r * D + d] = A.re(r)[d];
+            std_res[(NUM_RES + r) * D + d] = A.im(r)[d];
+          }
+        }
+        return std_res;
+     }
+
+
+    /**
+     * py_buffer
+     *
+     * C-contiguous view of a python object with the buffer protocol
+     * (e.g. a numpy array), held for the lifetime of the py_buffer; no
+     * element is converted to a python object. Raises ValueError
+     * (boost::python::error_already_set) if obj is not a buffer of the
+     * given item format ("d": float64, "Zd": complex128, "?"/"B":
+     * bool/uint8), number of dimensions and shape; a shape entry -1
+     * matches any extent.
+     */
+    struct py_buffer {
+      Py_buffer view;
+
+      py_buffer(const boost::python::object& obj, bool writable,
+                const char* name, const char* format, int ndim,
+                const Py_ssize_t* shape) {
+        int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT;
+        if (writable)
+          flags |= PyBUF_WRITABLE;
+        if (PyObject_GetBuffer(obj.ptr(), &view, flags) != 0)
+          boost::python::throw_error_already_set();
+
+        // Native byte order prefixes are irrelevant here
+        const char* f = view.format ? view.format : "B";
+        while (*f == '@' || *f == '=' || *f == '<')
+          f++;
+        bool ok = std::strcmp(f, format) == 0 ||
+          (std::strcmp(format, "?") == 0 && std::strcmp(f, "B") == 0);
+        ok = ok && view.ndim == ndim;
+        for (int k = 0; ok && k < ndim; k++)
+          ok = shape[k] < 0 || view.shape[k] == shape[k];
+        if (!ok) {
+          PyBuffer_Release(&view);
+          std::string msg = std::string(name) + ": expected a C-contiguous "
+            + "array of format '" + format + "' and matching shape";
+          PyErr_SetString(PyExc_ValueError, msg.c_str());
+          boost::python::throw_error_already_set();
+        }
+      }
+
+      ~py_buffer() {
+        PyBuffer_Release(&view);
+      }
+
+      Py_ssize_t extent(int k) const {
+        return view.shape[k];
+      }
+
+      template <typename T>
+      T* data() const {
+        return static_cast<T*>(view.buf);
+      }
+    };
+
+
+    /**
+     * gil_release
+     *
+     * Releases the global interpreter lock for its lifetime, so other
+     * python threads run meanwhile. No python object may be touched
+     * until it is destroyed.
+     */
+    struct gil_release {
+      PyThreadState* state;
+      gil_release() : state(PyEval_SaveThread()) {};
+      ~gil_release() {
+        PyEval_RestoreThread(state);
+      }
+    };
+
+
+    /**
+     * void for_event_blocks(N, f)
+     *
+     * Calls f(begin, end) for the events [0, N) in blocks of 1024, on
+     * the threads of the persistent parallel::pool() (see
+     * set_num_threads below) and with the GIL released.
+     */
+    template <typename F>
+    inline void for_event_blocks(long N, const F& f) {
+      const long block = 1024;
+      int n_tasks = (N + block - 1) / block;
+      gil_release unlocked;
+      parallel::pool()->run(n_tasks, [&](int t) {
+          long begin = t * block;
+          f(begin, std::min(N, begin + block));
+        });
+    }
+
+
+    /**
+     * void _A_cv_batch_py_wrapper(y, out)
+     *
+     * Batch version of A_cv on buffers: y is a float64 array of shape
+     * (N, num_variables()), out a complex128 array of shape
+     * (N, num_resonances()) that receives out[d, r] = A(r+1, y[d]) in
+     * place. The events are evaluated by A_cm in blocks, in parallel.
+     */
+     inline
+     void
+     _A_cv_batch_py_wrapper(boost::python::object y_obj,
+                            boost::python::object out_obj) {
+
+        Py_ssize_t y_shape[2] = {-1, NUM_VAR};
+        py_buffer y(y_obj, false, "A_cv_batch: y", "d", 2, y_shape);
+        Py_ssize_t out_shape[2] = {y.extent(0), NUM_RES};
+        py_buffer out(out_obj, true, "A_cv_batch: out", "Zd", 2, out_shape);
+
+        long N = y.extent(0);
+        const double* y_d = y.data<double>();
+        double* res = out.data<double>(); // re, im interleaved
+
+        for_event_blocks(N, [&](long begin, long end) {
+            complex::split_matrix A;
+            int D = end - begin;
+            A_cm(y_d + begin * NUM_VAR, D, A);
+            for (int d = 0; d < D; d++) {
+              double* res_d = res + 2 * (begin + d) * NUM_RES;
+              for (int r = 0; r < NUM_RES; r++) {
+                res_d[2 * r] = A.re(r)[d];
+                res_d[2 * r + 1] = A.im(r)[d];
+              }
+            }
+          });
+     }
+
+
+    /**
+     * void _in_phase_space_batch_py_wrapper(y, out)
+     *
+     * Batch version of in_phase_space on buffers: y as above, out a
+     * bool (or uint8) array of shape (N,).
+     */
+     inline
+     void
+     _in_phase_space_batch_py_wrapper(boost::python::object y_obj,
+                                      boost::python::object out_obj) {
+
+        Py_ssize_t y_shape[2] = {-1, NUM_VAR};
+        py_buffer y(y_obj, false, "in_phase_space_batch: y", "d", 2, y_shape);
+        Py_ssize_t out_shape[1] = {y.extent(0)};
+        py_buffer out(out_obj, true, "in_phase_space_batch: out", "?", 1,
+                      out_shape);
+
+        const double* y_d = y.data<double>();
+        unsigned char* mask = out.data<unsigned char>();
+        for_event_blocks(y.extent(0), [&](long begin, long end) {
+            in_phase_space(y_d + begin * NUM_VAR, end - begin, mask + begin);
+          });
+     }
+
+
     // Check whether the model has incoherently summed background
-    #ifdef NUM_BACKGR
+    // (setup.py defines MESON_DECA_BACKGROUND, cf. build_tools.sh)
+    #ifdef MESON_DECA_BACKGROUND
     /**
      * vector _A_v_backgr_py_wrapper(vector)
      *
@@ -81,8 +273,52 @@ namespace stan {
 
         return res;
      }
+
+    /**
+     * void _A_v_backgr_batch_py_wrapper(y, out)
+     *
+     * Batch version of A_v_background_abs2 on buffers: y as above, out
+     * a float64 array of shape (N, num_background()).
+     */
+     inline
+     void
+     _A_v_backgr_batch_py_wrapper(boost::python::object y_obj,
+                                  boost::python::object out_obj) {
+
+        Py_ssize_t y_shape[2] = {-1, NUM_VAR};
+        py_buffer y(y_obj, false, "A_v_background_abs2_batch: y", "d", 2,
+                    y_shape);
+        Py_ssize_t out_shape[2] = {y.extent(0), num_background()};
+        py_buffer out(out_obj, true, "A_v_background_abs2_batch: out", "d", 2,
+                      out_shape);
+
+        int B = num_background();
+        const double* y_all = y.data<double>();
+        double* res_all = out.data<double>();
+        for_event_blocks(y.extent(0), [&](long begin, long end) {
+            Eigen::Matrix<double, Eigen::Dynamic, 1> y_d(NUM_VAR);
+            for (long d = begin; d < end; d++) {
+              y_d = Eigen::Map<const Eigen::VectorXd>(y_all + d * NUM_VAR, NUM_VAR);
+              Eigen::Matrix<double, Eigen::Dynamic, 1> res = A_v_background_abs2(y_d);
+              for (int i = 0; i < B; i++)
+                res_all[d * B + i] = res(i);
+            }
+          });
+     }
     #endif
 
+
+    /**
+     * void _set_num_threads_py_wrapper(int)
+     *
+     * Sets the number of threads of the batch functions (default:
+     * MESON_DECA_NUM_THREADS, or 1). The pool persists across calls.
+     */
+    inline void _set_num_threads_py_wrapper(int n_threads) {
+      gil_release unlocked; // May join the workers of the old pool
+      parallel::set_num_threads(n_threads);
+    }
+
   }
 }
 
@@ -94,14 +330,26 @@ BOOST_PYTHON_MODULE(model)
         .def(vector_indexing_suite<std::vector<double> >() );
 
     def("A_cv", stan::math::_A_r_py_wrapper, args("x","y"));
-    #ifdef NUM_BCKGR
+    def("A_cm", stan::math::_A_cm_py_wrapper, args("x","n","y"));
+    #ifdef MESON_DECA_BACKGROUND
     def("A_v_background_abs2", stan::math::_A_v_backgr_py_wrapper, args("x","y"));
     #endif
 
+    // Batch versions on buffers (numpy arrays), see above
+    def("A_cv_batch", stan::math::_A_cv_batch_py_wrapper, args("y","out"));
+    def("in_phase_space_batch", stan::math::_in_phase_space_batch_py_wrapper,
+        args("y","out"));
+    #ifdef MESON_DECA_BACKGROUND
+    def("A_v_background_abs2_batch", stan::math::_A_v_backgr_batch_py_wrapper,
+        args("y","out"));
+    #endif
+
 
-    #ifdef NUM_BCKGR
+    #ifdef MESON_DECA_BACKGROUND
     def("num_background", stan::math::num_background);
     #endif
+    def("set_num_threads", stan::math::_set_num_threads_py_wrapper, args("n"));
+    def("num_threads", parallel::num_threads);
     def("num_resonances", stan::math::num_resonances);
     def("num_variables", stan::math::num_variables);
 }
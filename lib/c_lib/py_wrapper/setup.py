@@ -13,6 +13,13 @@ os.environ["CXX"] = "clang++"
 cmdstan_path = os.getcwd()
 cmdstan_path = cmdstan_path[:cmdstan_path.index('/meson_deca/')]
 
+# Models with incoherent background define MESON_DECA_HAS_BACKGROUND
+# (cf. build_tools.sh)
+define_macros = []
+with open('../model.hpp') as model_hpp:
+    if '\n#define MESON_DECA_HAS_BACKGROUND' in model_hpp.read():
+        define_macros.append(('MESON_DECA_BACKGROUND', None))
+
 setup(name="Model_Dep_Functions",
       ext_modules=[
           Extension("model", ["model.cpp"],
@@ -21,6 +28,9 @@ setup(name="Model_Dep_Functions",
                         cmdstan_path + "/stan/lib/eigen_3.2.4",
                         cmdstan_path + "/stan/src",
                         cmdstan_path],
+          define_macros=define_macros,
+          extra_compile_args=['-std=c++11', '-pthread'],
+          extra_link_args=['-pthread'],
           undef_macros=['NDEBUG']
           )
       ])
@@ -0,0 +1,23 @@
+#ifndef MESON_DECA__LIB__C_LIB__RNG_HPP
+#define MESON_DECA__LIB__C_LIB__RNG_HPP
+
+#include <meson_deca/lib/c_lib/rng/philox.hpp>
+#include <meson_deca/lib/c_lib/rng/stream.hpp>
+
+/*
+ *  Counter-based random numbers.
+ *
+ *  DESCRIPTION
+ *    The parallel samplers (integrate, generate, cache) draw point k
+ *    from the Philox counter k of its sampler (philox.hpp, stream.hpp)
+ *    instead of from a sequential generator per block of points. The
+ *    points then depend only on the seed: not on the number of
+ *    threads, not on the block size, and any point or range of points
+ *    can be recomputed on its own, e.g. to inspect a single event that
+ *    gave a bad weight.
+ *
+ *  FUNCTIONS
+ *    Are currently listed in particular files - philox.hpp, stream.hpp.
+ */
+
+#endif
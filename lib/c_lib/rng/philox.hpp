@@ -0,0 +1,69 @@
+#ifndef MESON_DECA__LIB__C_LIB__RNG__PHILOX_HPP
+#define MESON_DECA__LIB__C_LIB__RNG__PHILOX_HPP
+
+#include <stdint.h>
+
+/*
+ *  Philox4x32-10 counter-based random numbers.
+ *
+ *  DESCRIPTION
+ *    Philox (Salmon, Moraes, Dror, Shaw: "Parallel random numbers: as
+ *    easy as 1, 2, 3", SC 2011) is a keyed bijection of a 128-bit
+ *    counter: philox(counter, key) is a block of four random 32-bit
+ *    words, and any block is computed directly from its counter. A
+ *    random stream is a range of counters, so streams need no state to
+ *    be split, skipped or replayed (see stream.hpp).
+ *
+ *    The block function is the one of Random123 (10 rounds) and
+ *    reproduces its known-answer tests.
+ *
+ *  TYPES
+ *    block
+ *
+ *  FUNCTIONS
+ *    block philox(c0, c1, c2, c3, k0, k1)
+ */
+
+namespace rng {
+
+  /**
+   * block
+   *
+   * Four random 32-bit words.
+   */
+  struct block {
+    uint32_t v[4];
+  };
+
+
+  /**
+   * block philox(c0, c1, c2, c3, k0, k1)
+   *
+   * Philox4x32-10 of the counter (c0, c1, c2, c3) with the key
+   * (k0, k1).
+   */
+  inline block
+  philox(uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3,
+         uint32_t k0, uint32_t k1) {
+    const uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+    const uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+
+    for (int round = 0; round < 10; round++) {
+      uint64_t p0 = uint64_t(M0) * c0;
+      uint64_t p1 = uint64_t(M1) * c2;
+      uint32_t d0 = uint32_t(p1 >> 32) ^ c1 ^ k0;
+      uint32_t d2 = uint32_t(p0 >> 32) ^ c3 ^ k1;
+      c1 = uint32_t(p1);
+      c3 = uint32_t(p0);
+      c0 = d0;
+      c2 = d2;
+      k0 += W0;
+      k1 += W1;
+    }
+    block res = {{c0, c1, c2, c3}};
+    return res;
+  }
+
+}
+
+#endif
@@ -0,0 +1,189 @@
+#ifndef MESON_DECA__LIB__C_LIB__RNG__STREAM_HPP
+#define MESON_DECA__LIB__C_LIB__RNG__STREAM_HPP
+
+#include <cmath> // cos, log, sin, sqrt
+#include <stdint.h>
+
+#include <meson_deca/lib/c_lib/rng/philox.hpp>
+
+/*
+ *  Addressable random streams.
+ *
+ *  DESCRIPTION
+ *    Every random number of the samplers in lib/c_lib is addressed by
+ *
+ *      key     = seed (64 bits)
+ *      counter = (j, k, round, purpose)
+ *
+ *    where k is the index of the point or event, j numbers the blocks
+ *    of its stream, round is e.g. the VEGAS iteration and purpose
+ *    separates the samplers (rng::purpose). Point k is thus always
+ *    drawn from the same counters, whatever the number of threads and
+ *    however the points are split into blocks, and a single point or a
+ *    range of points can be reproduced without the ones before, e.g.
+ *
+ *      rng::uniform(seed, k, 1, map.dim(), &u[0]);  // point k of plain()
+ *
+ *    A block gives two doubles (53 bits each) or four 32-bit words.
+ *    lib/py_lib/philox.py computes the same numbers with numpy.
+ *
+ *  TYPES
+ *    purpose
+ *    stream
+ *
+ *  FUNCTIONS
+ *    double to_uniform(hi, lo)
+ *    void uniform(seed, k_begin, n, dim, u, round, purpose)
+ *    void normal(seed, k_begin, n, dim, z, round, purpose)
+ */
+
+namespace rng {
+
+  /**
+   * purpose
+   *
+   * The samplers of lib/c_lib; the points of integrate::plain,
+   * integrate::sample_weights and generate::weighted are the same.
+   */
+  enum purpose {
+    points = 0,        // integrate::plain, sample_weights, generate::weighted
+    training = 1,      // integrate::adapt (round = iteration)
+    accept_reject = 2, // generate::accept_reject (round)
+    shifts = 3,        // integrate::qmc (k = replica)
+    probes = 4         // cache::probe_points
+  };
+
+
+  /**
+   * double to_uniform(hi, lo)
+   *
+   * Uniform double in (0, 1) from the 53 upper bits of hi:lo; never 0
+   * or 1, so log(u) is finite.
+   */
+  inline double
+  to_uniform(uint32_t hi, uint32_t lo) {
+    uint64_t x = (uint64_t(hi) << 32 | lo) >> 11;
+    return (x + 0.5) * (1. / 9007199254740992.);
+  }
+
+
+  /**
+   * stream
+   *
+   * The random numbers of point k: blocks j = 0, 1, ... of the counter
+   * (j, k, round, purpose). Also a UniformRandomBitGenerator of 64-bit
+   * words for the distributions of <random>.
+   */
+  class stream {
+  public:
+    typedef uint64_t result_type;
+
+    stream(uint64_t seed, uint32_t k, uint32_t round = 0,
+           uint32_t _purpose = points) :
+      k0_(uint32_t(seed)), k1_(uint32_t(seed >> 32)), k_(k), round_(round),
+      purpose_(_purpose), j_(0), pos_(4) {};
+
+    // Next 32-bit word
+    uint32_t next_u32() {
+      if (pos_ == 4) {
+        block_ = philox(j_++, k_, round_, purpose_, k0_, k1_);
+        pos_ = 0;
+      }
+      return block_.v[pos_++];
+    }
+
+    result_type operator()() {
+      uint32_t hi = next_u32();
+      return uint64_t(hi) << 32 | next_u32();
+    }
+
+    static constexpr result_type min() {
+      return 0;
+    }
+
+    static constexpr result_type max() {
+      return ~uint64_t(0);
+    }
+
+    double uniform() {
+      uint32_t hi = next_u32();
+      return to_uniform(hi, next_u32());
+    }
+
+    // Standard normal (Box-Muller of two uniforms)
+    double normal() {
+      double u1 = uniform();
+      double u2 = uniform();
+      return std::sqrt(-2. * std::log(u1)) * std::cos(2. * M_PI * u2);
+    }
+
+    // Skips n 32-bit words
+    void discard(uint64_t n) {
+      uint64_t word = uint64_t(j_) * 4 - (4 - pos_) + n;
+      j_ = word / 4;
+      pos_ = 4;
+      for (int r = word % 4; r > 0; r--)
+        next_u32();
+    }
+
+  private:
+    uint32_t k0_, k1_, k_, round_, purpose_;
+    uint32_t j_;
+    int pos_;
+    block block_;
+  };
+
+
+  /**
+   * void uniform(seed, k_begin, n, dim, u, round, purpose)
+   *
+   * u[(k - k_begin) dim + i] = uniform number i of point k, for the n
+   * points k = k_begin, ...: the same numbers as
+   * stream(seed, k, round, purpose).uniform(). The blocks of all points
+   * are computed in one loop over the points, which the compiler can
+   * vectorize.
+   */
+  inline void
+  uniform(uint64_t seed, uint32_t k_begin, int n, int dim, double* u,
+          uint32_t round = 0, uint32_t _purpose = points) {
+    uint32_t k0 = seed, k1 = seed >> 32;
+    for (int j = 0; 2 * j < dim; j++) {
+      bool both = 2 * j + 1 < dim;
+      for (int p = 0; p < n; p++) {
+        block b = philox(j, k_begin + p, round, _purpose, k0, k1);
+        double* u_p = u + long(p) * dim + 2 * j;
+        u_p[0] = to_uniform(b.v[0], b.v[1]);
+        if (both)
+          u_p[1] = to_uniform(b.v[2], b.v[3]);
+      }
+    }
+  }
+
+
+  /**
+   * void normal(seed, k_begin, n, dim, z, round, purpose)
+   *
+   * As uniform(), standard normal numbers (Box-Muller): the two
+   * uniforms of a block give z[2 j] and z[2 j + 1] of a point.
+   */
+  inline void
+  normal(uint64_t seed, uint32_t k_begin, int n, int dim, double* z,
+         uint32_t round = 0, uint32_t _purpose = points) {
+    uint32_t k0 = seed, k1 = seed >> 32;
+    for (int j = 0; 2 * j < dim; j++) {
+      bool both = 2 * j + 1 < dim;
+      for (int p = 0; p < n; p++) {
+        block b = philox(j, k_begin + p, round, _purpose, k0, k1);
+        double r = std::sqrt(-2. * std::log(to_uniform(b.v[0], b.v[1])));
+        double phi = 2. * M_PI * to_uniform(b.v[2], b.v[3]);
+        double* z_p = z + long(p) * dim + 2 * j;
+        z_p[0] = r * std::cos(phi);
+        if (both)
+          z_p[1] = r * std::sin(phi);
+      }
+    }
+  }
+
+}
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef MESON_DECA__LIB__C_LIB__STRUCTURES__ACTIVE_RESONANCES_HPP
+#define MESON_DECA__LIB__C_LIB__STRUCTURES__ACTIVE_RESONANCES_HPP
+
+#include <stan/math/prim/mat/fun/Eigen.hpp>
+#include <cstdlib> // getenv, strtol
+#include <iostream>
+#include <vector>
+
+#include <meson_deca/lib/c_lib/likelihood/gradient.hpp> // all_constant
+
+/*
+ *  Resonances of a model that are switched on.
+ *
+ *  DESCRIPTION
+ *    A model can list a large catalogue of resonances of which a fit
+ *    uses only some; the others have their coupling theta fixed to
+ *    zero. An inactive resonance is treated as A_r = 0: A_cv and A_cm
+ *    do not evaluate it (its entries are zero), and f_model and Norm
+ *    skip its terms, so neither depends on its theta.
+ *
+ *    The active set of a model (active_resonances() in model.hpp) is
+ *    read once from the environment variable
+ *
+ *      MESON_DECA_ACTIVE_RESONANCES=1,2,6   (res_id as in A_c; unset:
+ *                                            all resonances)
+ *
+ *    just like the amplitude file of data/amplitude_file.hpp; the
+ *    native code may also set() it. In addition, where theta is data
+ *    (double, e.g. the data generator), its entries that are exactly
+ *    zero are skipped (active_mask). A zero of an autodiff theta is not
+ *    skipped: its gradient does not vanish.
+ *
+ *  TYPES
+ *    active_set
+ *
+ *  FUNCTIONS
+ *    const unsigned char* active_mask(active_set, complex_vector, buffer)
+ */
+
+namespace resonances {
+
+  /**
+   * active_set
+   *
+   * Subset of the resonances 0 .. R - 1 of a model (0-based, i.e.
+   * res_id - 1). mask() is 0 if all of them are active.
+   */
+  class active_set {
+  public:
+    explicit active_set(int R) : flags_(R, 1), all_(true) {
+      for (int i = 0; i < R; i++)
+        indices_.push_back(i);
+    };
+
+    // Activates exactly the resonances res_ids (1-based, as res_id of A_c)
+    void set(const std::vector<int>& res_ids) {
+      int R = flags_.size();
+      flags_.assign(R, 0);
+      for (size_t k = 0; k < res_ids.size(); k++) {
+        if (res_ids[k] < 1 || res_ids[k] > R)
+          std::cout << "Warning: active_set: unknown resonance " << res_ids[k]
+                    << " ignored.\n";
+        else
+          flags_[res_ids[k] - 1] = 1;
+      }
+      update();
+    }
+
+    void set_all() {
+      flags_.assign(flags_.size(), 1);
+      update();
+    }
+
+    // Number of resonances of the model
+    int num_resonances() const {
+      return flags_.size();
+    }
+
+    bool all() const {
+      return all_;
+    }
+
+    bool contains(int i) const {
+      return flags_[i] != 0;
+    }
+
+    // Active resonances, 0-based and ascending
+    const std::vector<int>& indices() const {
+      return indices_;
+    }
+
+    // mask()[i] = contains(i), or 0 if all resonances are active
+    const unsigned char* mask() const {
+      return all_ ? 0 : &flags_[0];
+    }
+
+    /**
+     * active_set from_string(R, s)
+     *
+     * Parses a list of res_ids, separated by commas or spaces; an empty
+     * or null string activates all resonances.
+     */
+    static active_set from_string(int R, const char* s) {
+      active_set res(R);
+      if (s == 0)
+        return res;
+
+      std::vector<int> res_ids;
+      bool any = false;
+      while (*s != '\0') {
+        char* end;
+        long id = std::strtol(s, &end, 10);
+        if (end == s) {
+          s++; // Separator
+          continue;
+        }
+        res_ids.push_back(id);
+        any = true;
+        s = end;
+      }
+      if (any)
+        res.set(res_ids);
+      return res;
+    }
+
+    // The active set given by MESON_DECA_ACTIVE_RESONANCES
+    static active_set from_environment(int R) {
+      return from_string(R, std::getenv("MESON_DECA_ACTIVE_RESONANCES"));
+    }
+
+  private:
+    std::vector<unsigned char> flags_;
+    std::vector<int> indices_;
+    bool all_;
+
+    void update() {
+      indices_.clear();
+      for (size_t i = 0; i < flags_.size(); i++)
+        if (flags_[i])
+          indices_.push_back(i);
+      all_ = indices_.size() == flags_.size();
+    }
+  };
+
+
+  /**
+   * const unsigned char* active_mask(active, theta, buffer)
+   *
+   * Mask of the terms of theta (STAN representation vector theta[2])
+   * to evaluate: the active set, and for a constant (double) theta
+   * only its non-zero entries. Returns 0 if all terms are evaluated;
+   * buffer holds at least active.num_resonances() flags.
+   */
+  template <typename T>
+  inline const unsigned char*
+  active_mask(const active_set& active,
+              const std::vector<Eigen::Matrix<T, Eigen::Dynamic, 1> >& theta,
+              unsigned char* buffer) {
+    if (!likelihood::all_constant<T>::value)
+      return active.mask();
+
+    int R = active.num_resonances();
+    bool all = true;
+    for (int i = 0; i < R; i++) {
+      buffer[i] = active.contains(i) &&
+        !(likelihood::value(theta[0](i)) == 0. && likelihood::value(theta[1](i)) == 0.);
+      all = all && buffer[i];
+    }
+    return all ? 0 : buffer;
+  }
+
+}
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef MESON_DECA__LIB__C_LIB__STRUCTURES__FOUR_BODY__INVARIANTS_HPP
+#define MESON_DECA__LIB__C_LIB__STRUCTURES__FOUR_BODY__INVARIANTS_HPP
+
+#include <vector>
+
+#include <meson_deca/lib/c_lib/structures/four_body/base.hpp>
+#include <meson_deca/lib/c_lib/structures/four_body/kinematics.hpp>
+
+namespace resonances {
+
+  // Parameter-independent part of the amplitudes of D events of
+  // P -> R_1 d -> R_2 c d -> a b c d: the members of event_4 that the
+  // resonances read, one column per member (struct of arrays). The
+  // Lorentz boosts, breakup momenta and validity checks of event_4 run
+  // once per event here; with floating resonance parameters, the
+  // kernel P_R1d_R2cd_abcd::values(k, inv, ...) reads only from here.
+  struct invariants_4
+  {
+    int size;
+    std::vector<unsigned char> valid;
+    std::vector<double> m2_12, m2_123;
+    std::vector<double> p2_P, p2_b;      // Form factors P -> R_1 d, R_2 -> a b
+    std::vector<double> z2, cos2_theta;  // Rest frame of R_1
+    std::vector<double> z2_2, cos2_theta_2; // Rest frame of R_2
+    std::vector<unsigned char> zemach_1, zemach_2;
+
+    // The D events y[5 d .. 5 d + 4] = m2_12, m2_14, m2_23, m2_34, m2_13
+    invariants_4(const double* y, int D, const resonance_base_4& r) :
+      size(D), valid(D, 0), m2_12(D, 0.), m2_123(D, 0.), p2_P(D, 0.),
+      p2_b(D, 0.), z2(D, 0.), cos2_theta(D, 0.), z2_2(D, 0.),
+      cos2_theta_2(D, 0.), zemach_1(D, 0), zemach_2(D, 0) {
+
+      for (int d = 0; d < D; d++) {
+        const double* y_d = y + 5 * long(d);
+        event_4<double> e(y_d[0], y_d[1], y_d[2], y_d[3], y_d[4], r);
+        valid[d] = e.valid;
+        m2_12[d] = e.m2_12;
+        m2_123[d] = e.m2_123;
+        if (!e.valid)
+          continue;
+        p2_P[d] = e.p2_P;
+        p2_b[d] = e.p2_b;
+        z2[d] = e.z2;
+        cos2_theta[d] = e.cos2_theta;
+        z2_2[d] = e.z2_2;
+        cos2_theta_2[d] = e.cos2_theta_2;
+        zemach_1[d] = e.zemach_1;
+        zemach_2[d] = e.zemach_2;
+      }
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef MESON_DECA__LIB__C_LIB__STRUCTURES__FOUR_BODY__KINEMATICS_HPP
+#define MESON_DECA__LIB__C_LIB__STRUCTURES__FOUR_BODY__KINEMATICS_HPP
+
+#include <cmath> // sqrt
+
+#include <meson_deca/lib/c_lib/fct/breakup_momentum.hpp>
+#include <meson_deca/lib/c_lib/fct/valid.hpp>
+#include <meson_deca/lib/c_lib/structures/four_body/base.hpp>
+
+namespace resonances {
+
+  // Event context of the 4 particle decay P -> R_1 d -> R_2 c d -> a b c d:
+  // the validity, masses, breakup momenta, energies and the Zemach
+  // variables of one point, which do not depend on the resonances
+  // R_1, R_2. Computed once per event and passed to every resonance
+  // with the same particles P, a, b, c, d (see P_R1d_R2cd_abcd for the
+  // meaning of the variables). If valid is false, only the m2_* are set.
+  template <typename T>
+  struct event_4
+  {
+    static const int num_variables = 5; // m2_12, m2_14, m2_23, m2_34, m2_13
+
+    bool valid; // fct::valid_5d
+    T m2_12, m2_14, m2_23, m2_34, m2_13;
+    T m2_123;   // Invariant square mass of a, b, c
+    T m_12, m_123;
+
+    // Squared breakup momenta of the form factors P -> R_1 d, R_2 -> a b
+    T p2_P, p2_b;
+
+    // Decay P -> R_1 d -> R_2 c d in the rest frame of R_1
+    T p2_c, E_c;
+    T p2_d_rest_frame_of_P, E_d_rest_frame_of_P, E_R_1_rest_frame_of_P;
+    T v_R_1, gamma, p2_d, E_d, s;
+    T z2, cos2_theta;
+    bool zemach_1;  // z2, cos2_theta are physical
+
+    // Decay R_1 -> R_2 c -> a b c in the rest frame of R_2
+    T E_b;
+    T z2_2, cos2_theta_2;
+    bool zemach_2;  // z2_2, cos2_theta_2 are physical
+
+    event_4(const T& _m2_12, const T& _m2_14, const T& _m2_23,
+            const T& _m2_34, const T& _m2_13, const resonance_base_4& r) :
+      valid(false), m2_12(_m2_12), m2_14(_m2_14), m2_23(_m2_23),
+      m2_34(_m2_34), m2_13(_m2_13) {
+
+      const particle &P = r.P, &a = r.a, &b = r.b, &c = r.c, &d = r.d;
+      m2_123 = m2_12 + m2_13 + m2_23 - a.m2 - b.m2 - c.m2;
+      if ( ! fct::valid_5d(m2_12, m2_14, m2_23, m2_34, m2_13,
+                           P, a, b, c, d) == true)
+        return;
+      valid = true;
+
+      m_12 = sqrt(m2_12);
+      m_123 = sqrt(m2_123);
+      p2_P = fct::breakup_momentum::p2(P.m2, m_123, d.m);
+      p2_b = fct::breakup_momentum::p2(m2_12, a.m, b.m);
+
+      p2_c = fct::breakup_momentum::p2(m2_123, m2_12, c.m);
+      E_c = sqrt(c.m2 + p2_c);
+
+      p2_d_rest_frame_of_P = fct::breakup_momentum::p2(P.m2, m2_123, d.m);
+      E_d_rest_frame_of_P = sqrt(d.m2 + p2_d_rest_frame_of_P);
+      // R_1 and d have the same abs. momenta |p2| in rest frame of P
+      E_R_1_rest_frame_of_P = sqrt(m2_123 + p2_d_rest_frame_of_P);
+
+      // Compute p2_d in the rest frame of R_1 by
+      // performing a Lorents boost in the direction -v_R_1
+      v_R_1 = sqrt(p2_d_rest_frame_of_P) / E_R_1_rest_frame_of_P;
+      gamma = 1.0 / sqrt(1.0 - v_R_1 * v_R_1);
+
+      T p_d = gamma * ( sqrt(p2_d_rest_frame_of_P) + E_d_rest_frame_of_P * v_R_1 );
+      p2_d = p_d*p_d;
+      E_d = sqrt(d.m2 + p2_d);
+
+      T p_c_dot_p_d = (-0.5) * (m2_34 - c.m2 - d.m2 - 2.0 * E_c * E_d);
+      cos2_theta = p_c_dot_p_d * p_c_dot_p_d / p2_c / p2_d;
+
+      s = m2_123 + d.m2 + 2.0 * m_123 * E_d;
+      z2 = p2_d / s;
+      zemach_1 = p2_c >= 0 && p2_d_rest_frame_of_P >= 0;
+
+      // p2_c above is calculated in the rest frame of R_1.
+      // We want it in the rest frame of R_2, so we perform a
+      // Lorentz boost again.
+      T E_R_2 = sqrt(m2_12 + p2_c);
+      T v_R_2 = p2_c / E_R_2;
+      T gamma_2 = 1.0 / sqrt(1.0 - v_R_2 * v_R_2);
+      T p2_c_rest_frame_of_R_2 = gamma_2 * (p2_c + E_R_2 * v_R_2);
+      T E_c_rest_frame_of_R_2 = sqrt(c.m2 + p2_c_rest_frame_of_R_2);
+
+      E_b = sqrt(b.m2 + p2_b);
+
+      T p_b_dot_p_c = (-0.5) * (m2_23 - b.m2 - c.m2
+                                - 2.0 * E_b * E_c_rest_frame_of_R_2);
+      cos2_theta_2 = p_b_dot_p_c * p_b_dot_p_c / p2_b / p2_c_rest_frame_of_R_2;
+
+      T s_2 = m2_12 + c.m2 + 2.0 * m_12 * E_c_rest_frame_of_R_2;
+      z2_2 = p2_c / s_2;
+      zemach_2 = p2_b >= 0 && p2_c_rest_frame_of_R_2 >= 0;
+    }
+  };
+
+}
+
+#endif
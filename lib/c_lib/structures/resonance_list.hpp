@@ -0,0 +1,180 @@
+#ifndef MESON_DECA__LIB__C_LIB__STRUCTURES__RESONANCE_LIST_HPP
+#define MESON_DECA__LIB__C_LIB__STRUCTURES__RESONANCE_LIST_HPP
+
+#include <algorithm> // std::fill
+#include <iostream>
+
+#include <meson_deca/lib/c_lib/complex.hpp>
+#include <meson_deca/lib/c_lib/structures/three_body/kinematics.hpp>
+#include <meson_deca/lib/c_lib/structures/four_body/kinematics.hpp>
+
+/*
+ *  Resonance list of a model as a type.
+ *
+ *  DESCRIPTION
+ *    A model (model.hpp) lists its amplitudes once, as the template
+ *    arguments of resonance_list:
+ *
+ *      typedef resonances::resonance_list<resonances::event_3,
+ *        MESON_DECA_AB(resonances::flat_D3pi),
+ *        MESON_DECA_SYM(resonances::f0_980), ...> model_resonances;
+ *
+ *    The number of amplitudes R (size) and of variables N
+ *    (num_variables, from the event context) are compile-time
+ *    constants. value(i, e) replaces the hand-written switch over the
+ *    resonance ids; values() and fill() evaluate all amplitudes of an
+ *    event or a batch in a loop that the compiler unrolls, with every
+ *    amplitude inlined.
+ *
+ *    A term names a resonance object of resonances.hpp (a global, so it
+ *    can be a template argument) and how it is evaluated:
+ *      MESON_DECA_AB(r)           r.value(e.ab), not symmetrized
+ *      MESON_DECA_SYM(r)          r.value_sym(e), symmetrized (a == c)
+ *      MESON_DECA_COMPONENT(r, k) r.value(k, e), 4-body component k
+ *
+ *  TYPES
+ *    resonance_list<E, Terms...>
+ *    term_ab, term_sym, term_component
+ */
+
+#define MESON_DECA_AB(r) resonances::term_ab<decltype(r), &r>
+#define MESON_DECA_SYM(r) resonances::term_sym<decltype(r), &r>
+#define MESON_DECA_COMPONENT(r, k) resonances::term_component<decltype(r), &r, k>
+
+namespace resonances {
+
+  // r.value(e.ab) of a 3-body resonance
+  template <typename R, R* r>
+  struct term_ab {
+    template <typename T>
+    static complex::complex_scalar<T> value(const event_3<T>& e) {
+      return r->value(e.ab);
+    }
+  };
+
+
+  // r.value_sym(e) of a 3-body resonance
+  template <typename R, R* r>
+  struct term_sym {
+    template <typename T>
+    static complex::complex_scalar<T> value(const event_3<T>& e) {
+      return r->value_sym(e);
+    }
+  };
+
+
+  // r.value(k, e) of a 4-body resonance
+  template <typename R, R* r, int k>
+  struct term_component {
+    template <typename T>
+    static complex::complex_scalar<T> value(const event_4<T>& e) {
+      return r->value(k, e);
+    }
+  };
+
+
+  // Term as a function object, for complex::matrix::fill_row
+  template <typename Term>
+  struct term_kernel {
+    template <typename E>
+    complex::complex_scalar<double> operator()(const E& e) const {
+      return Term::value(e);
+    }
+  };
+
+
+  // Terms I, I+1, ... of a resonance_list (recursion over the terms;
+  // the end of the list)
+  template <int I, typename... Terms>
+  struct term_list {
+    template <typename T, typename E>
+    static complex::complex_scalar<T> value(int, const E&) {
+      std::cout << "Fatal error: Unknown resonance occured.";
+      return complex::complex_scalar<T>(1.0, 0.0); // Dummy return
+    }
+
+    template <typename T, typename E>
+    static void values(const E&, T*, T*, const unsigned char*) {};
+
+    template <typename E>
+    static void fill(complex::split_matrix&, const E*,
+                     const unsigned char*) {};
+  };
+
+
+  template <int I, typename Term, typename... Terms>
+  struct term_list<I, Term, Terms...> {
+    typedef term_list<I + 1, Terms...> next;
+
+    template <typename T, typename E>
+    static complex::complex_scalar<T> value(int i, const E& e) {
+      if (i == I)
+        return Term::value(e);
+      return next::template value<T>(i, e);
+    }
+
+    template <typename T, typename E>
+    static void values(const E& e, T* re, T* im, const unsigned char* mask) {
+      if (mask == 0 || mask[I]) {
+        complex::complex_scalar<T> z = Term::value(e);
+        re[I] = z.re;
+        im[I] = z.im;
+      } else {
+        re[I] = 0.0;
+        im[I] = 0.0;
+      }
+      next::values(e, re, im, mask);
+    }
+
+    template <typename E>
+    static void fill(complex::split_matrix& A, const E* events,
+                     const unsigned char* mask) {
+      if (mask == 0 || mask[I]) {
+        complex::matrix::fill_row(A, I, term_kernel<Term>(), events);
+      } else {
+        std::fill(A.re(I), A.re(I) + A.cols(), 0.0);
+        std::fill(A.im(I), A.im(I) + A.cols(), 0.0);
+      }
+      next::fill(A, events, mask);
+    }
+  };
+
+
+  /**
+   * resonance_list<E, Terms...>
+   *
+   * The amplitudes Terms of a model with the event context E (event_3,
+   * event_4), see above. Amplitude i (0-based) is the resonance with
+   * res_id = i + 1 of the STAN functions.
+   */
+  template <template <typename> class E, typename... Terms>
+  struct resonance_list {
+    static const int size = sizeof...(Terms);
+    static const int num_variables = E<double>::num_variables;
+
+    // Amplitude i of the event e
+    template <typename T>
+    static complex::complex_scalar<T> value(int i, const E<T>& e) {
+      return term_list<0, Terms...>::template value<T>(i, e);
+    }
+
+    // All amplitudes of the event e into re[0 .. size), im[0 .. size);
+    // with a mask (see active_resonances.hpp), only those with
+    // mask[i] != 0, the others are zero
+    template <typename T>
+    static void values(const E<T>& e, T* re, T* im,
+                       const unsigned char* mask = 0) {
+      term_list<0, Terms...>::values(e, re, im, mask);
+    }
+
+    // Row i of the size x D matrix A: amplitude i of the events[d]
+    // (zero if mask[i] == 0)
+    static void fill(complex::split_matrix& A, const E<double>* events,
+                     const unsigned char* mask = 0) {
+      term_list<0, Terms...>::fill(A, events, mask);
+    }
+  };
+
+}
+
+#endif
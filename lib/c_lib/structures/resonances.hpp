@@ -5,7 +5,19 @@
 
 namespace resonances {
 
+  // Particle assignments shared by the resonances below; the event
+  // contexts (event_3, event_4) of a model are computed for them.
+  resonances::resonance_base_3 d_to_3pi(particles::d, particles::pi,
+					particles::pi, particles::pi);
+
+  resonances::resonance_base_4 d0_to_4pi(particles::D0, particles::pi,
+					 particles::pi, particles::pi,
+					 particles::pi);
+
   // 3-body decay, Spin 0
+  // (Breit-Wigner and Flatte lineshapes are evaluated exactly; pass
+  // resonances::tabulated_lineshape as the last constructor argument
+  // to interpolate them instead, see three_body/lineshape.hpp)
   resonances::flat_3 flat_D3pi(particles::d, particles::pi, particles::pi, 
 			       particles::pi);
 
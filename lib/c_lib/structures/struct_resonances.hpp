@@ -2,12 +2,21 @@
 #define MESON_DECA__LIB__C_LIB__STRUCTURES__STRUCT_RESONANCES_HPP
 
 // 3-body-decay resonances
+#include <meson_deca/lib/c_lib/structures/three_body/kinematics.hpp>
+#include <meson_deca/lib/c_lib/structures/three_body/invariants.hpp>
+#include <meson_deca/lib/c_lib/structures/three_body/lineshape.hpp>
 #include <meson_deca/lib/c_lib/structures/three_body/flat.hpp>
 #include <meson_deca/lib/c_lib/structures/three_body/bw.hpp>
 #include <meson_deca/lib/c_lib/structures/three_body/flatte.hpp>
 
 // 4-body-decay-resonances
+#include <meson_deca/lib/c_lib/structures/four_body/kinematics.hpp>
+#include <meson_deca/lib/c_lib/structures/four_body/invariants.hpp>
 #include <meson_deca/lib/c_lib/structures/four_body/flat.hpp>
 #include <meson_deca/lib/c_lib/structures/four_body/D_R1d_R2cd_abcd.hpp>
 
+// Resonance list of a model
+#include <meson_deca/lib/c_lib/structures/resonance_list.hpp>
+#include <meson_deca/lib/c_lib/structures/active_resonances.hpp>
+
 #endif
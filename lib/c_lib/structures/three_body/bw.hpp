@@ -6,6 +6,9 @@
 #include <meson_deca/lib/c_lib/fct.hpp>
 #include <meson_deca/lib/c_lib/complex.hpp>
 #include <meson_deca/lib/c_lib/structures/three_body/base.hpp>
+#include <meson_deca/lib/c_lib/structures/three_body/invariants.hpp>
+#include <meson_deca/lib/c_lib/structures/three_body/kinematics.hpp>
+#include <meson_deca/lib/c_lib/structures/three_body/lineshape.hpp>
 
 namespace resonances {
 
@@ -15,54 +18,203 @@ namespace resonances {
     // A BW resonance has the same properties as a particle, and a width
     const particle R; // "Resonance = particle + width"
     const double W; // Width of the resonance
+    lineshape_3 shape; // Optional lineshape table
 
     breit_wigner(particle _P, particle _a, particle _b, particle _c, 
-		 particle _R, double _W) :
-      resonance_base_3(_P, _a, _b, _c), R(_R), W(_W) {};
+		 particle _R, double _W,
+		 lineshape_mode mode = exact_lineshape) :
+      resonance_base_3(_P, _a, _b, _c), R(_R), W(_W) {
+      if (mode == tabulated_lineshape)
+	tabulate();
+    };
+
+
+    // Interpolates the lineshape from a table with the error bound tol
+    // (see lineshape.hpp) ...
+    void tabulate(double tol = lineshape_tolerance) {
+      shape.tabulate(*this, tol, std::vector<double>());
+    }
+
+    // ... or evaluates it exactly (the default)
+    void exact() {
+      shape.table.reset();
+    }
+
+    // Largest deviation of the table from the exact lineshape at
+    // 2n + 1 points, relative to its maximum
+    double check_lineshape(int n = 100000) const {
+      return shape.check(*this, n);
+    }
+
+
+    // Form factors F_P F_R and propagator T_R at m2_ab, given
+    // m_ab = sqrt(m2_ab) and the breakup momenta of kinematics_3
+    template <typename T>
+    void factors(const T& m2_ab, const T& m_ab, const T& p2_ab, const T& p2_P,
+		 T& F, complex::complex_scalar<T>& T_R) const
+    {
+      // Form factor P -> Rc
+      T F_P = fct::blatt_weisskopf_p2(this->R.J, this->P.r2, p2_P) /
+	      fct::blatt_weisskopf(this->R.J, this->P.r2, 
+				   this->P.m2, this->R.m, this->c.m);
+
+      // Form factor R -> ab
+      T F_R = fct::blatt_weisskopf_p2(this->R.J, this->R.r2, p2_ab)/
+	      fct::blatt_weisskopf(this->R.J, this->R.r2, 
+				   this->R.m2, this->a.m, this->b.m);
+
+      T width = fct::breit_wigner::relativistic_width(this->R.m, this->W,
+	this->R.J, this->R.r, m_ab, p2_ab, this->a.m, this->b.m);
+
+      F = F_P * F_R;
+      T_R = fct::breit_wigner::value(this->R.m, m2_ab, width);
+    }
+
+
+    // Lineshape F_P F_R T_R at m2_ab, exact
+    complex::complex_scalar<double> lineshape(double m2_ab) const
+    {
+      double m_ab = sqrt(m2_ab);
+      double F;
+      complex::complex_scalar<double> T_R;
+      factors(m2_ab, m_ab, fct::breakup_momentum::p2(m2_ab, this->a.m, this->b.m),
+	      fct::breakup_momentum::p2(this->P.m2, m_ab, this->c.m), F, T_R);
+      return complex::scalar::mult(F, T_R);
+    }
 
 
     // Evaluates the resonance at the given point in the Dalitz plot
     // for the decay P -> ABC (not symmetrized)
     template <typename T>
-    std::vector<T>
+    complex::complex_scalar<T>
     value(const T& m2_ab, const T& m2_bc) 
     {
+      return this->value(kinematics_3<T>(m2_ab, m2_bc, *this));
+    }
 
-      if (fct::valid(m2_ab, m2_bc, 
-		     this->P, this->a, this->b, this->c) == true) {
-
-	T m_ab = sqrt(m2_ab);
-
-        // Form factor P -> Rc
-        T F_P = fct::blatt_weisskopf(this->R.J, this->P.r2, 
-				     this->P.m2, m_ab, this->c.m) /
-                fct::blatt_weisskopf(this->R.J, this->P.r2, 
-				     this->P.m2, this->R.m, this->c.m);
 
-        // Form factor R -> ab
-        T F_R = fct::blatt_weisskopf(this->R.J, this->R.r2, 
-				     m2_ab, this->a.m, this->b.m)/
-                fct::blatt_weisskopf(this->R.J, this->R.r2, 
-				     this->R.m2, this->a.m, this->b.m);
+    // As above, with the kinematics shared by the resonances of an
+    // event (see kinematics.hpp)
+    template <typename T>
+    complex::complex_scalar<T>
+    value(const kinematics_3<T>& k) 
+    {
 
-        T width = fct::breit_wigner::relativistic_width(this->R.m, this->W,
-	  this->R.J, this->R.r, m2_ab, this->a.m, this->b.m);
+      if (k.valid == true) {
 
-	std::vector<T> T_R = fct::breit_wigner::value(this->R.m, m2_ab,width);
 	// If the parent particle does not have spin 0, some adjustments
 	// must be performed in this Zemach function (use angular orbital
 	// momentum between P and R instead of R.J)
-        T Z = fct::zemach(this->R.J, m2_ab, m2_bc, 
+        T Z = fct::zemach(this->R.J, k.m2_ab, k.m2_bc, 
 			  this->P.m, this->a, this->b, this->c);
 
-	std::vector<T> res(2);
-	res = complex::scalar::mult(F_P * F_R * Z, T_R);
+	complex::complex_scalar<T> res;
+	if (shape.interpolate(k, Z, res))
+	  return res;
+
+	T F;
+	complex::complex_scalar<T> T_R;
+	factors(k.m2_ab, k.m_ab, k.p2_ab, k.p2_P, F, T_R);
+	res = complex::scalar::mult(F * Z, T_R);
 
         return res;
       }
       else {
-	std::vector<T> res(2, 0.0);
-        return res;
+        return complex::complex_scalar<T>(0.0, 0.0);
+      }
+    }
+
+
+    // Amplitudes of the events of inv (see invariants.hpp) with the
+    // mass M and the width W as (autodiff) parameters in place of R.m
+    // and this->W, not symmetrized ...
+    template <typename T>
+    void values(const invariants_3& inv, const T& M, const T& W,
+		complex::complex_scalar<T>* res) const
+    {
+      this->values(inv.ab, M, W, res, false);
+    }
+
+
+    // ... or symmetrized (A==C); the lineshape table is not used
+    template <typename T>
+    void values_sym(const invariants_3& inv, const T& M, const T& W,
+		    complex::complex_scalar<T>* res) const
+    {
+      this->values(inv.ab, M, W, res, false);
+      this->values(inv.cb, M, W, res, true);
+    }
+
+
+    // res[d] (+)= amplitude of the event d of k: only the lineshape and
+    // the normalization of the form factors depend on M, W
+    template <typename T>
+    void values(const kinematics_3_store& k, const T& M, const T& W,
+		complex::complex_scalar<T>* res, bool add) const
+    {
+      const int J = this->R.J;
+      T norm = 1. / (fct::blatt_weisskopf(J, this->P.r2, this->P.m2, M, this->c.m) *
+		     fct::blatt_weisskopf(J, this->R.r2, M * M, this->a.m, this->b.m));
+
+      for (size_t d = 0; d < k.valid.size(); d++) {
+	if (!k.valid[d]) {
+	  if (!add)
+	    res[d] = complex::complex_scalar<T>(0.0, 0.0);
+	  continue;
+	}
+
+	double F = fct::blatt_weisskopf_p2(J, this->P.r2, k.p2_P[d]) *
+	  fct::blatt_weisskopf_p2(J, this->R.r2, k.p2_ab[d]) * k.zemach(J, d);
+	T width = fct::breit_wigner::relativistic_width(M, W, J, this->R.r,
+	  k.m_ab[d], k.p2_ab[d], this->a.m, this->b.m);
+	complex::complex_scalar<T> A = complex::scalar::mult(F * norm,
+	  fct::breit_wigner::value(M, k.m2_ab[d], width));
+
+	res[d] = add ? complex::scalar::add(res[d], A) : A;
+      }
+    }
+
+
+    // As values(k, M, W, res, add) in double precision, with the
+    // partial derivatives dA[2 d] = d A_d / d M, dA[2 d + 1] = d A_d / d W
+    // (e.g. for cache::column_cache)
+    void partials(const kinematics_3_store& k, double M, double W,
+		  complex::complex_scalar<double>* A,
+		  complex::complex_scalar<double>* dA, bool add) const
+    {
+      const int J = this->R.J;
+      double d_norm;
+      double norm = form_factor_norm(*this, J, this->R.r2, M, d_norm);
+
+      for (size_t d = 0; d < k.valid.size(); d++) {
+	complex::complex_scalar<double> A_d(0.0, 0.0), A_M(0.0, 0.0), A_W(0.0, 0.0);
+	if (k.valid[d]) {
+	  double F = fct::blatt_weisskopf_p2(J, this->P.r2, k.p2_P[d]) *
+	    fct::blatt_weisskopf_p2(J, this->R.r2, k.p2_ab[d]) * k.zemach(J, d);
+	  double w_M, w_W;
+	  double width = fct::breit_wigner::relativistic_width_partials(M, W, J,
+	    this->R.r, k.m_ab[d], k.p2_ab[d], this->a.m, this->b.m, w_M, w_W);
+	  complex::complex_scalar<double> T_M, T_w;
+	  complex::complex_scalar<double> T_R = fct::breit_wigner::value_partials(
+	    M, k.m2_ab[d], width, T_M, T_w);
+
+	  A_d = complex::scalar::mult(F * norm, T_R);
+	  // d A / d M = F (d_norm T_R + norm (T_M + T_w w_M))
+	  A_M = complex::scalar::mult(F, complex::scalar::add(
+	    complex::scalar::mult(d_norm, T_R),
+	    complex::scalar::mult(norm, complex::scalar::add(
+	      T_M, complex::scalar::mult(w_M, T_w)))));
+	  A_W = complex::scalar::mult(F * norm * w_W, T_w);
+	}
+	if (add) {
+	  A[d] = complex::scalar::add(A[d], A_d);
+	  dA[2 * d] = complex::scalar::add(dA[2 * d], A_M);
+	  dA[2 * d + 1] = complex::scalar::add(dA[2 * d + 1], A_W);
+	} else {
+	  A[d] = A_d;
+	  dA[2 * d] = A_M;
+	  dA[2 * d + 1] = A_W;
+	}
       }
     }
 
@@ -71,11 +223,20 @@ namespace resonances {
     // for the decay P -> ABC (symmetrized, i.e. A==C)
     template <typename T>
     inline
-    std::vector<T>
+    complex::complex_scalar<T>
     value_sym(const T& m2_ab, const T& m2_bc) {
 
-      return complex::scalar::add(this->value(m2_ab, m2_bc),
-				  this->value(m2_bc, m2_ab));
+      return this->value_sym(event_3<T>(m2_ab, m2_bc, *this));
+    }
+
+
+    // As above, with the event context shared by the resonances
+    template <typename T>
+    inline
+    complex::complex_scalar<T>
+    value_sym(const event_3<T>& e) {
+
+      return complex::scalar::add(this->value(e.ab), this->value(e.cb));
     }
 
   };
@@ -6,6 +6,7 @@
 #include <meson_deca/lib/c_lib/fct.hpp>
 #include <meson_deca/lib/c_lib/complex.hpp>
 #include <meson_deca/lib/c_lib/structures/three_body/base.hpp>
+#include <meson_deca/lib/c_lib/structures/three_body/kinematics.hpp>
 
 
 namespace resonances {
@@ -20,13 +21,27 @@ namespace resonances {
   
     // Returns 1 if we are within Dalitz plot bounds, 0 else.
     template <typename T>
-    std::vector<T>
+    complex::complex_scalar<T>
     value(const T& m2_ab, const T& m2_bc) {
 
-      std::vector<T> res(2, 0.0);
+      complex::complex_scalar<T> res(0.0, 0.0);
       if (fct::valid(m2_ab, m2_bc, 
 		     this->P, this->a, this->b, this->c) == true) {
-	res[0] = 1.0;
+	res.re = 1.0;
+      }
+      return res;
+    }
+
+
+    // As above, with the kinematics shared by the resonances of an
+    // event (see kinematics.hpp)
+    template <typename T>
+    complex::complex_scalar<T>
+    value(const kinematics_3<T>& k) {
+
+      complex::complex_scalar<T> res(0.0, 0.0);
+      if (k.valid == true) {
+	res.re = 1.0;
       }
       return res;
     }
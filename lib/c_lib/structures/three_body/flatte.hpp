@@ -6,6 +6,9 @@
 #include <meson_deca/lib/c_lib/fct.hpp>
 #include <meson_deca/lib/c_lib/complex.hpp>
 #include <meson_deca/lib/c_lib/structures/three_body/base.hpp>
+#include <meson_deca/lib/c_lib/structures/three_body/invariants.hpp>
+#include <meson_deca/lib/c_lib/structures/three_body/kinematics.hpp>
+#include <meson_deca/lib/c_lib/structures/three_body/lineshape.hpp>
 
 namespace resonances {
 
@@ -16,45 +19,198 @@ namespace resonances {
     const particle R;
     const double G_pp;
     const double G_kk;
+    lineshape_3 shape; // Optional lineshape table
 
     flatte(particle _P, particle _a, particle _b, particle _c,
-	   particle _R, double _G_pp, double _G_kk) :
-      resonance_base_3(_P, _a, _b, _c), R(_R), G_pp(_G_pp), G_kk(_G_kk) {};
+	   particle _R, double _G_pp, double _G_kk,
+	   lineshape_mode mode = exact_lineshape) :
+      resonance_base_3(_P, _a, _b, _c), R(_R), G_pp(_G_pp), G_kk(_G_kk) {
+      if (mode == tabulated_lineshape)
+	tabulate();
+    };
+
+
+    // Interpolates the lineshape from a table with the error bound tol
+    // (see lineshape.hpp) ...
+    void tabulate(double tol = lineshape_tolerance) {
+      // Thresholds of the pi pi and K K channels
+      std::vector<double> branch_points;
+      branch_points.push_back(4. * particles::pi.m2);
+      branch_points.push_back(4. * particles::k.m2);
+      shape.tabulate(*this, tol, branch_points);
+    }
+
+    // ... or evaluates it exactly (the default)
+    void exact() {
+      shape.table.reset();
+    }
+
+    // Largest deviation of the table from the exact lineshape at
+    // 2n + 1 points, relative to its maximum
+    double check_lineshape(int n = 100000) const {
+      return shape.check(*this, n);
+    }
+
+
+    // Form factors F_P F_R and propagator T_R at m2_ab, given
+    // m_ab = sqrt(m2_ab) and the breakup momenta of kinematics_3
+    template <typename T>
+    void factors(const T& m2_ab, const T& m_ab, const T& p2_ab, const T& p2_P,
+		 T& F, complex::complex_scalar<T>& T_R) const
+    {
+      // Form factor P -> Rc
+      T F_P = fct::blatt_weisskopf_p2(this->R.J, this->P.r2, p2_P) /
+	fct::blatt_weisskopf(this->R.J, this->P.r2,
+			     this->P.m2, this->R.m, this->c.m);
+
+      // Form factor R -> ab
+      T F_R = fct::blatt_weisskopf_p2(this->R.J, this->R.r2, p2_ab)/
+	fct::blatt_weisskopf(this->R.J, this->R.r2,
+			     this->R.m2, this->a.m, this->b.m);
+
+      // The pi pi breakup momentum of the Flatte denominator is p2_ab
+      // if a and b are pions
+      T p2_pp = (this->a.m == particles::pi.m && this->b.m == particles::pi.m) ?
+	p2_ab : T(fct::breakup_momentum::p2(m2_ab, particles::pi.m,
+					    particles::pi.m));
+      F = F_P * F_R;
+      T_R = fct::flatte::value(this->R.m, m2_ab, m_ab, p2_pp,
+			       this->G_pp, this->G_kk);
+    }
+
+
+    // Lineshape F_P F_R T_R at m2_ab, exact
+    complex::complex_scalar<double> lineshape(double m2_ab) const
+    {
+      double m_ab = sqrt(m2_ab);
+      double F;
+      complex::complex_scalar<double> T_R;
+      factors(m2_ab, m_ab, fct::breakup_momentum::p2(m2_ab, this->a.m, this->b.m),
+	      fct::breakup_momentum::p2(this->P.m2, m_ab, this->c.m), F, T_R);
+      return complex::scalar::mult(F, T_R);
+    }
 
     // Returns the amplitude of the decay P->abc via Flatte resonance.
     template <typename T>
-    std::vector<T>
+    complex::complex_scalar<T>
     value(const T& m2_ab, const T& m2_bc) 
     {
-      if (fct::valid(m2_ab, m2_bc, 
-		     this->P, this->a, this->b, this->c) == true) {
-
-	T m_ab = sqrt(m2_ab);
-
-        // Form factor P -> Rc
-        T F_P = fct::blatt_weisskopf(this->R.J, this->P.r2, 
-				     this->P.m2, m_ab, this->c.m) /
-	  fct::blatt_weisskopf(this->R.J, this->P.r2,
-			       this->P.m2, this->R.m, this->c.m);
-
-        // Form factor R -> ab
-        T F_R = fct::blatt_weisskopf(this->R.J, this->R.r2, 
-				     m2_ab, this->a.m, this->b.m)/
-	  fct::blatt_weisskopf(this->R.J, this->R.r2,
-			       this->R.m2, this->a.m, this->b.m);
-
-	std::vector<T> T_R = fct::flatte::value(this->R.m, m2_ab,
-						this->G_pp, this->G_kk);
-        T Z = fct::zemach(this->R.J, m2_ab, m2_bc, 
+      return this->value(kinematics_3<T>(m2_ab, m2_bc, *this));
+    }
+
+
+    // As above, with the kinematics shared by the resonances of an
+    // event (see kinematics.hpp)
+    template <typename T>
+    complex::complex_scalar<T>
+    value(const kinematics_3<T>& k) 
+    {
+      if (k.valid == true) {
+
+        T Z = fct::zemach(this->R.J, k.m2_ab, k.m2_bc, 
 			  this->P.m, this->a, this->b, this->c);
 
-	std::vector<T> res(2);
-	res = complex::scalar::mult(F_P * F_R * Z, T_R);
+	complex::complex_scalar<T> res;
+	if (shape.interpolate(k, Z, res))
+	  return res;
+
+	T F;
+	complex::complex_scalar<T> T_R;
+	factors(k.m2_ab, k.m_ab, k.p2_ab, k.p2_P, F, T_R);
+	res = complex::scalar::mult(F * Z, T_R);
         return res;
       }
       else {
-	std::vector<T> res(2, 0.0);
-        return res;
+        return complex::complex_scalar<T>(0.0, 0.0);
+      }
+    }
+
+
+    // Amplitudes of the events of inv (see invariants.hpp) with the
+    // mass M and the couplings gpp, gkk as (autodiff) parameters in
+    // place of R.m, G_pp, G_kk, not symmetrized ...
+    template <typename T>
+    void values(const invariants_3& inv, const T& M, const T& gpp,
+		const T& gkk, complex::complex_scalar<T>* res) const
+    {
+      this->values(inv.ab, M, gpp, gkk, res, false);
+    }
+
+
+    // ... or symmetrized (A==C); the lineshape table is not used
+    template <typename T>
+    void values_sym(const invariants_3& inv, const T& M, const T& gpp,
+		    const T& gkk, complex::complex_scalar<T>* res) const
+    {
+      this->values(inv.ab, M, gpp, gkk, res, false);
+      this->values(inv.cb, M, gpp, gkk, res, true);
+    }
+
+
+    // res[d] (+)= amplitude of the event d of k: only the lineshape and
+    // the normalization of the form factors depend on the parameters
+    template <typename T>
+    void values(const kinematics_3_store& k, const T& M, const T& gpp,
+		const T& gkk, complex::complex_scalar<T>* res, bool add) const
+    {
+      const int J = this->R.J;
+      const bool pions = this->a.m == particles::pi.m && this->b.m == particles::pi.m;
+      T norm = 1. / (fct::blatt_weisskopf(J, this->P.r2, this->P.m2, M, this->c.m) *
+		     fct::blatt_weisskopf(J, this->R.r2, M * M, this->a.m, this->b.m));
+
+      for (size_t d = 0; d < k.valid.size(); d++) {
+	if (!k.valid[d]) {
+	  if (!add)
+	    res[d] = complex::complex_scalar<T>(0.0, 0.0);
+	  continue;
+	}
+
+	double F = fct::blatt_weisskopf_p2(J, this->P.r2, k.p2_P[d]) *
+	  fct::blatt_weisskopf_p2(J, this->R.r2, k.p2_ab[d]) * k.zemach(J, d);
+	double p2_pp = pions ? k.p2_ab[d] :
+	  fct::breakup_momentum::p2(k.m2_ab[d], particles::pi.m, particles::pi.m);
+	complex::complex_scalar<T> A = complex::scalar::mult(F * norm,
+	  fct::flatte::value(M, k.m2_ab[d], k.m_ab[d], p2_pp, gpp, gkk));
+
+	res[d] = add ? complex::scalar::add(res[d], A) : A;
+      }
+    }
+
+
+    // As values(k, M, gpp, gkk, res, add) in double precision, with the
+    // partial derivatives dA[3 d + i] = d A_d / d (M, gpp, gkk)[i]
+    // (e.g. for cache::column_cache)
+    void partials(const kinematics_3_store& k, double M, double gpp,
+		  double gkk, complex::complex_scalar<double>* A,
+		  complex::complex_scalar<double>* dA, bool add) const
+    {
+      const int J = this->R.J;
+      const bool pions = this->a.m == particles::pi.m && this->b.m == particles::pi.m;
+      double d_norm;
+      double norm = form_factor_norm(*this, J, this->R.r2, M, d_norm);
+
+      for (size_t d = 0; d < k.valid.size(); d++) {
+	complex::complex_scalar<double> A_d(0.0, 0.0), A_p[3];
+	for (int i = 0; i < 3; i++)
+	  A_p[i] = complex::complex_scalar<double>(0.0, 0.0);
+	if (k.valid[d]) {
+	  double F = fct::blatt_weisskopf_p2(J, this->P.r2, k.p2_P[d]) *
+	    fct::blatt_weisskopf_p2(J, this->R.r2, k.p2_ab[d]) * k.zemach(J, d);
+	  double p2_pp = pions ? k.p2_ab[d] :
+	    fct::breakup_momentum::p2(k.m2_ab[d], particles::pi.m, particles::pi.m);
+	  complex::complex_scalar<double> T_M, T_gpp, T_gkk;
+	  complex::complex_scalar<double> T_R = fct::flatte::value_partials(
+	    M, k.m2_ab[d], k.m_ab[d], p2_pp, gpp, gkk, T_M, T_gpp, T_gkk);
+
+	  A_d = complex::scalar::mult(F * norm, T_R);
+	  A_p[0] = complex::scalar::mult(F, complex::scalar::add(
+	    complex::scalar::mult(d_norm, T_R), complex::scalar::mult(norm, T_M)));
+	  A_p[1] = complex::scalar::mult(F * norm, T_gpp);
+	  A_p[2] = complex::scalar::mult(F * norm, T_gkk);
+	}
+	A[d] = add ? complex::scalar::add(A[d], A_d) : A_d;
+	for (int i = 0; i < 3; i++)
+	  dA[3 * d + i] = add ? complex::scalar::add(dA[3 * d + i], A_p[i]) : A_p[i];
       }
     }
 
@@ -63,11 +219,20 @@ namespace resonances {
     // for the decay P -> ABC (symmetrized, i.e. A==C)
     template <typename T>
     inline
-    std::vector<T>
+    complex::complex_scalar<T>
     value_sym(const T& m2_ab, const T& m2_bc) {
 
-      return complex::scalar::add(this->value(m2_ab, m2_bc),
-				  this->value(m2_bc, m2_ab));
+      return this->value_sym(event_3<T>(m2_ab, m2_bc, *this));
+    }
+
+
+    // As above, with the event context shared by the resonances
+    template <typename T>
+    inline
+    complex::complex_scalar<T>
+    value_sym(const event_3<T>& e) {
+
+      return complex::scalar::add(this->value(e.ab), this->value(e.cb));
     }
 
   };
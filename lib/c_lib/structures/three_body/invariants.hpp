@@ -0,0 +1,104 @@
+#ifndef MESON_DECA__LIB__C_LIB__STRUCTURES__THREE_BODY__INVARIANTS_HPP
+#define MESON_DECA__LIB__C_LIB__STRUCTURES__THREE_BODY__INVARIANTS_HPP
+
+#include <vector>
+
+#include <meson_deca/lib/c_lib/fct/blatt_weisskopf.hpp>
+#include <meson_deca/lib/c_lib/fct/breakup_momentum.hpp>
+#include <meson_deca/lib/c_lib/fct/zemach.hpp>
+#include <meson_deca/lib/c_lib/structures/three_body/base.hpp>
+#include <meson_deca/lib/c_lib/structures/three_body/kinematics.hpp>
+
+namespace resonances {
+
+  // The kinematics_3 of D events, one column per member (struct of
+  // arrays), and the Zemach factors of spin 1 and 2. None of it
+  // depends on the parameters of a resonance (mass, width,
+  // couplings); see invariants_3.
+  struct kinematics_3_store
+  {
+    std::vector<unsigned char> valid;
+    std::vector<double> m2_ab, m_ab, p2_ab, p2_P;
+    std::vector<double> Z_1, Z_2; // fct::zemach(J = 1, 2, ...)
+
+    void resize(int D) {
+      valid.assign(D, 0);
+      m2_ab.assign(D, 0.);
+      m_ab.assign(D, 0.);
+      p2_ab.assign(D, 0.);
+      p2_P.assign(D, 0.);
+      Z_1.assign(D, 0.);
+      Z_2.assign(D, 0.);
+    }
+
+    void set(int d, const kinematics_3<double>& k, const resonance_base_3& r) {
+      valid[d] = k.valid;
+      m2_ab[d] = k.m2_ab;
+      if (!k.valid)
+        return;
+      m_ab[d] = k.m_ab;
+      p2_ab[d] = k.p2_ab;
+      p2_P[d] = k.p2_P;
+      // As in the resonances: zemach(J, m2_ab, m2_bc, P.m, a, b, c)
+      Z_1[d] = fct::zemach(1, k.m2_ab, k.m2_bc, r.P.m, r.a, r.b, r.c);
+      Z_2[d] = fct::zemach(2, k.m2_ab, k.m2_bc, r.P.m, r.a, r.b, r.c);
+    }
+
+    double zemach(int J, int d) const {
+      if (J == 0) return 1;
+      if (J == 1) return Z_1[d];
+      if (J == 2) return Z_2[d];
+      return 0;
+    }
+  };
+
+
+  // 1 / (B_P B_R): the denominators of the form factors P -> R c and
+  // R -> ab of a resonance R of spin J and squared radius r2_R at its
+  // mass M, the only part of F_P F_R that depends on M; d_M = d / d M
+  inline double
+  form_factor_norm(const resonance_base_3& r, int J, double r2_R, double M,
+                   double& d_M) {
+    double norm = 1. / (fct::blatt_weisskopf(J, r.P.r2, r.P.m2, M, r.c.m) *
+                        fct::blatt_weisskopf(J, r2_R, M * M, r.a.m, r.b.m));
+    double p2_P = fct::breakup_momentum::p2(r.P.m2, M, r.c.m);
+    double p2_R = fct::breakup_momentum::p2(M * M, r.a.m, r.b.m);
+    d_M = - norm *
+      (fct::blatt_weisskopf_p2_dlog(J, r.P.r2, p2_P) *
+         fct::breakup_momentum::dp2_dm_a(r.P.m2, M, r.c.m) +
+       fct::blatt_weisskopf_p2_dlog(J, r2_R, p2_R) *
+         2. * M * fct::breakup_momentum::dp2_dm2_R(M * M, r.a.m, r.b.m));
+    return norm;
+  }
+
+
+  // Parameter-independent part of the amplitudes of D events of
+  // P -> abc: the event_3 of every event, precomputed once. With
+  // floating resonance parameters, the kernels values(inv, ...) of
+  // breit_wigner and flatte read only from here and evaluate only the
+  // lineshape per event, e.g.
+  //
+  //   invariants_3 inv(y, D, resonances::d_to_3pi);  // once
+  //   rho_770.values_sym(inv, M, W, res);             // per gradient
+  struct invariants_3
+  {
+    int size;
+    kinematics_3_store ab; // Resonance in ab
+    kinematics_3_store cb; // Resonance in cb (variables swapped)
+
+    // The D events y[2 d], y[2 d + 1] = m2_ab, m2_bc
+    invariants_3(const double* y, int D, const resonance_base_3& r) :
+      size(D) {
+      ab.resize(D);
+      cb.resize(D);
+      for (int d = 0; d < D; d++) {
+        event_3<double> e(y[2 * d], y[2 * d + 1], r);
+        ab.set(d, e.ab, r);
+        cb.set(d, e.cb, r);
+      }
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef MESON_DECA__LIB__C_LIB__STRUCTURES__THREE_BODY__KINEMATICS_HPP
+#define MESON_DECA__LIB__C_LIB__STRUCTURES__THREE_BODY__KINEMATICS_HPP
+
+#include <cmath> // sqrt, fabs
+
+#include <meson_deca/lib/c_lib/fct/breakup_momentum.hpp>
+#include <meson_deca/lib/c_lib/structures/three_body/base.hpp>
+
+namespace resonances {
+
+  // Kinematics of one point in the Dalitz plot of P -> abc, seen from
+  // a resonance in the pair ab with the spectator c: everything the
+  // resonances of this file compute before their own lineshape.
+  // The values are those of fct::valid, fct::blatt_weisskopf, etc.
+  // at (m2_ab, m2_bc); if valid is false, only m2_ab, m2_bc are set.
+  template <typename T>
+  struct kinematics_3
+  {
+    bool valid; // fct::valid(m2_ab, m2_bc, P, a, b, c)
+    T m2_ab, m2_bc;
+    T m_ab;     // sqrt(m2_ab)
+    T E_b, E_c; // Energies of b and c in the ab rest frame
+    T p2_ab;    // Squared breakup momentum R -> ab at m_ab
+    T p2_P;     // Squared breakup momentum P -> R c at m_ab
+
+    kinematics_3(const T& _m2_ab, const T& _m2_bc,
+                 const resonance_base_3& r) :
+      valid(false), m2_ab(_m2_ab), m2_bc(_m2_bc) {
+
+      const particle &P = r.P, &a = r.a, &b = r.b, &c = r.c;
+      if ( (m2_ab < (a.m2 + b.m2 + 2. * sqrt(a.m2 * b.m2))) ||
+           (m2_ab > (P.m2 + c.m2 - 2. * sqrt(P.m2 * c.m2)))   )
+        return;
+
+      E_b = (m2_ab - a.m2 + b.m2) / 2. / sqrt(m2_ab);
+      E_c = (P.m2 - m2_ab - c.m2) / 2. / sqrt(m2_ab);
+      T P_b = sqrt(E_b * E_b - b.m2);
+      T P_c = sqrt(E_c * E_c - c.m2);
+      if (!((fabs(m2_bc - b.m2 - c.m2 - 2. * E_b * E_c)) <= (2. * P_b * P_c)))
+        return;
+
+      valid = true;
+      m_ab = sqrt(m2_ab);
+      p2_ab = fct::breakup_momentum::p2(m2_ab, a.m, b.m);
+      p2_P = fct::breakup_momentum::p2(P.m2, m_ab, c.m);
+    }
+  };
+
+
+  // Event context of P -> abc: the kinematics of the point (m2_ab, m2_bc)
+  // for resonances in ab (value) and of the point (m2_bc, m2_ab) for the
+  // symmetrized term of value_sym (resonances in cb, a == c). Computed
+  // once per event and passed to every resonance with the same
+  // particles P, a, b, c.
+  template <typename T>
+  struct event_3
+  {
+    static const int num_variables = 2; // m2_ab, m2_bc
+
+    T m2_ab, m2_bc, m2_ac; // Pair masses, m2_ac from the mass sum rule
+    kinematics_3<T> ab;    // Resonance in ab
+    kinematics_3<T> cb;    // Resonance in cb (variables swapped)
+
+    event_3(const T& _m2_ab, const T& _m2_bc, const resonance_base_3& r) :
+      m2_ab(_m2_ab), m2_bc(_m2_bc),
+      m2_ac(r.P.m2 + r.a.m2 + r.b.m2 + r.c.m2 - _m2_ab - _m2_bc),
+      ab(_m2_ab, _m2_bc, r), cb(_m2_bc, _m2_ab, r) {};
+  };
+
+}
+
+#endif
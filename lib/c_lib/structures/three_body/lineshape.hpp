@@ -0,0 +1,71 @@
+#ifndef MESON_DECA__LIB__C_LIB__STRUCTURES__THREE_BODY__LINESHAPE_HPP
+#define MESON_DECA__LIB__C_LIB__STRUCTURES__THREE_BODY__LINESHAPE_HPP
+
+#include <memory> // std::shared_ptr
+#include <vector>
+
+#include <meson_deca/lib/c_lib/complex.hpp>
+#include <meson_deca/lib/c_lib/fct/lineshape_table.hpp>
+#include <meson_deca/lib/c_lib/structures/three_body/kinematics.hpp>
+
+namespace resonances {
+
+  // How a resonance with fixed parameters evaluates its lineshape
+  // (F_P F_R T_R, the factor of value() that depends on m2_ab only):
+  // exactly, or interpolated from a fct::lineshape_table. Chosen per
+  // resonance by the constructor (resonances.hpp), or at run time by
+  // tabulate() and exact().
+  enum lineshape_mode { exact_lineshape, tabulated_lineshape };
+
+  // Default error bound of the tables, relative to max |lineshape|
+  const double lineshape_tolerance = 1e-8;
+
+
+  // Optional lineshape table of a resonance R in ab of P -> abc. R
+  // provides complex_scalar<double> lineshape(double m2_ab) const.
+  struct lineshape_3
+  {
+    std::shared_ptr<const fct::lineshape_table> table; // Null: exact
+
+    // Tabulates r.lineshape over the kinematic range of m2_ab; the
+    // thresholds of its breakup momenta other than (m_a + m_b)^2 are
+    // passed in branch_points
+    template <typename R>
+    void tabulate(const R& r, double tol,
+                  const std::vector<double>& branch_points) {
+      double s_min = (r.a.m + r.b.m) * (r.a.m + r.b.m);
+      double s_max = (r.P.m - r.c.m) * (r.P.m - r.c.m);
+      table = std::make_shared<const fct::lineshape_table>(
+        [&r](double m2_ab) { return r.lineshape(m2_ab); }, s_min, s_max, tol,
+        branch_points);
+    }
+
+    // Largest deviation of the table from r.lineshape on a dense grid,
+    // relative to max |lineshape| (0 without table)
+    template <typename R>
+    double check(const R& r, int n) const {
+      if (!table)
+        return 0.;
+      return table->check([&r](double m2_ab) { return r.lineshape(m2_ab); }, n);
+    }
+
+    // res = Z * lineshape(m2_ab) from the table, if there is one; the
+    // tables are not used for other types than double
+    bool interpolate(const kinematics_3<double>& k, double Z,
+                     complex::complex_scalar<double>& res) const {
+      if (!table)
+        return false;
+      res = complex::scalar::mult(Z, (*table)(k.m2_ab));
+      return true;
+    }
+
+    template <typename T>
+    bool interpolate(const kinematics_3<T>&, const T&,
+                     complex::complex_scalar<T>&) const {
+      return false;
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,128 @@
+// amplitudes.cpp
+//
+// NAME
+//    amplitudes - evaluate A_cv for a file of events
+//
+// SYNOPSIS
+//    ./amplitudes EVENTS [OPTIONS]
+//
+// DESCRIPTION
+//    Reads the events y_1, ..., y_D from the binary file EVENTS (D rows
+//    of num_variables() doubles, native byte order, no header) and
+//    writes the amplitudes of lib/c_lib/model.hpp as doubles
+//
+//        A_cv_data[D][2][R]                  (real parts, imaginary parts)
+//        A_v_background_abs2_data[D][B]      (models with background)
+//
+//    i.e. in the layout of the arrays of STAN_amplitude_fitting.data.R
+//    (cf. utils/data_analysis__root_to_dataR.py, which calls this tool
+//    if it is built). Events outside the phase space get zeros.
+//
+//    With --amplitude-file, the events and amplitudes are also written
+//    as a columnar file for amplitude_file_log_likelihood (see
+//    lib/c_lib/data/amplitude_file.hpp).
+//
+// OPTIONS
+//    --output FILE  output file (default: amplitudes.bin)
+//    --amplitude-file FILE
+//                   also write the amplitude file FILE
+//    --cache DIR    keep the amplitude columns in the folder DIR and
+//                   evaluate the model only if a resonance or the events
+//                   changed (see lib/c_lib/cache.hpp)
+//    --threads T    number of threads (default: MESON_DECA_NUM_THREADS)
+//
+// BUILD
+//    build_tools.sh (from the model folder).
+
+#include <algorithm> // std::min
+#include <cstdio>
+#include <iostream>
+
+#include <meson_deca/lib/c_lib/cache.hpp>
+#include <meson_deca/lib/c_lib/data.hpp>
+#include <meson_deca/lib/c_lib/parallel.hpp>
+#include <meson_deca/lib/c_lib/tools/model_amplitudes.hpp>
+
+int main(int argc, char** argv) {
+
+  tools::options opt(argc, argv, std::vector<std::string>());
+  tools::model_amplitudes model;
+  if (opt.positional.size() != 1) {
+    std::cerr << "amplitudes: expected the event file.\n";
+    return 1;
+  }
+  if (opt.has("threads"))
+    parallel::set_num_threads(opt.get("threads", 1L));
+
+  // Events
+  std::string f_events = opt.positional[0];
+  FILE* f = fopen(f_events.c_str(), "rb");
+  if (f == 0) {
+    std::cerr << "amplitudes: cannot open " << f_events << ".\n";
+    return 1;
+  }
+  int N = model.num_variables();
+  std::vector<Eigen::VectorXd> events;
+  Eigen::VectorXd y(N);
+  while (fread(y.data(), sizeof(double), N, f) == (size_t) N)
+    events.push_back(y);
+  fclose(f);
+  int D = events.size();
+
+  // Amplitudes
+  cache::amplitude_columns A;
+  if (opt.has("cache")) {
+    cache::store store(opt.get("cache", "cache"));
+    std::vector<Eigen::VectorXd> probes(events.begin(),
+      events.begin() + std::min(D, cache::num_probes));
+    A = cache::amplitudes(model, events, cache::hash_file(f_events),
+                          cache::fingerprint(model, probes), store);
+    std::cout << "amplitudes: " << store.hits << " of "
+              << store.hits + store.misses << " columns from the cache "
+              << opt.get("cache", "cache") << ".\n";
+  } else {
+    A = cache::evaluate(model, events);
+  }
+
+  // Output: rows of (A_re, A_im), then the rows of A_bkg
+  std::string f_name = opt.get("output", "amplitudes.bin");
+  f = fopen(f_name.c_str(), "wb");
+  if (f == 0) {
+    std::cerr << "amplitudes: cannot write " << f_name << ".\n";
+    return 1;
+  }
+  Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    row(2, A.re.cols());
+  bool ok = true;
+  for (int d = 0; d < D && ok; d++) {
+    row.row(0) = A.re.row(d);
+    row.row(1) = A.im.row(d);
+    ok = fwrite(row.data(), sizeof(double), row.size(), f) == (size_t) row.size();
+  }
+  for (int d = 0; d < D && ok; d++) {
+    Eigen::VectorXd b = A.bkg.row(d).transpose();
+    ok = fwrite(b.data(), sizeof(double), b.size(), f) == (size_t) b.size();
+  }
+  ok = fclose(f) == 0 && ok;
+  if (!ok) {
+    std::cerr << "amplitudes: cannot write " << f_name << ".\n";
+    return 1;
+  }
+
+  if (opt.has("amplitude-file")) {
+    Eigen::MatrixXd y_data(D, N);
+    for (int d = 0; d < D; d++)
+      y_data.row(d) = events[d].transpose();
+    try {
+      data::write_amplitude_file(opt.get("amplitude-file", ""), y_data,
+                                 A.re, A.im, A.bkg);
+    } catch (const std::exception& e) {
+      std::cerr << "amplitudes: " << e.what() << ".\n";
+      return 1;
+    }
+  }
+
+  std::cout << "amplitudes: " << D << " events, " << parallel::num_threads()
+            << " threads; written to " << f_name << ".\n";
+  return 0;
+}
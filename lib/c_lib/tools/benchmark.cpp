@@ -0,0 +1,680 @@
+// benchmark.cpp
+//
+// NAME
+//    benchmark - microbenchmarks of the kernels of lib/c_lib and the model
+//
+// SYNOPSIS
+//    ./benchmark [OPTIONS]
+//
+// DESCRIPTION
+//    Measures the time, the heap allocations and the autodiff tape per
+//    event of the building blocks of the likelihood, for the scalar
+//    types double, stan::math::var (value and gradient) and
+//    stan::math::fvar<double> (value and one tangent):
+//
+//      fct kernels      blatt_weisskopf, relativistic_width, zemach
+//                       (rho(770) of D -> 3 pi), valid_5d (D0 -> 4 pi)
+//      resonances       breit_wigner::value (rho_770, 3-body),
+//                       P_R1d_R2cd_abcd::value (D_a_rho_S_wave, 4-body)
+//      model.hpp        A_cv(y), f_model(A, theta), Norm(theta, I)
+//
+//    The autodiff variables of the fct, resonance and A_cv kernels are
+//    the event variables y; those of f_model and Norm are theta, as in
+//    STAN_amplitude_fitting (f_model shares one theta among the events
+//    of a batch, Norm gets a new theta per 'event').
+//
+//    Events
+//      inside   events inside the phase space: uniform in the Dalitz
+//               plot (3 variables of the 3-body kernels and models),
+//               GENBOD events (4-body kernels, 4-body models defining
+//               MESON_DECA_PHASE_SPACE)
+//      outside  uniform points of the box [0, 3]^N outside the phase
+//               space (the box of STAN_data_generator.stan), where the
+//               kernels should return early
+//    f_model uses A_cv of the inside events; Norm uses I = mean of
+//    conj(A) A^T over them and the region 'none'. With background
+//    (-DMESON_DECA_BACKGROUND), theta_background_abs2 = 1 is constant.
+//
+//    Every event is a separate evaluation; with var, the outputs of
+//    --batch events are summed and grad() is called once per batch
+//    (then recover_memory()), as for the likelihood of a data set.
+//    The events are repeated until --min-time has passed; the time per
+//    event is the median over the passes.
+//
+//    Output: one JSON object per line and (kernel, type, region), e.g.
+//
+//      {"kernel": "zemach", "type": "var", "region": "inside",
+//       "events": 2000, "passes": 84, "ns_per_event": 95.1,
+//       "allocs_per_event": 0, "tape_bytes_per_event": 424,
+//       "tape_nodes_per_event": 11}
+//
+//    preceded by a line {"benchmark": ..., ...} describing the run.
+//    utils/compare_benchmarks.py compares two such files.
+//
+//      allocs_per_event      calls of malloc/calloc/realloc (glibc) or
+//                            of operator new (elsewhere) per event
+//      tape_bytes_per_event  bytes of the autodiff arena used by the
+//                            kernel per event (var; 0 otherwise),
+//                            measured by markers allocated before and
+//                            after each event (events that fill an
+//                            arena block are skipped)
+//      tape_nodes_per_event  vari pushed on the stack per event (var)
+//
+//    The allocations and the tape are counted in an extra pass, not in
+//    the timed ones.
+//
+// OPTIONS
+//    --events N      events per region (default: 2000)
+//    --batch B       events per gradient (default: 100)
+//    --min-time S    seconds per (kernel, type, region) (default: 0.2)
+//    --seed S        random seed of the events (default: 1)
+//    --filter NAME   only the kernels whose name contains NAME
+//    --output FILE   also write the results to FILE
+//
+// BUILD
+//    build_tools.sh benchmark (from the model folder).
+
+#include <stan/math/rev/mat.hpp>
+#include <stan/math/fwd/mat.hpp>
+
+#include <algorithm> // std::sort
+#include <atomic>
+#include <chrono>
+#include <cstdio>    // snprintf
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <type_traits> // std::true_type
+
+#include <meson_deca/lib/c_lib/fct.hpp>
+#include <meson_deca/lib/c_lib/generate/phase_space.hpp>
+#include <meson_deca/lib/c_lib/rng.hpp>
+#include <meson_deca/lib/c_lib/structures/resonances.hpp>
+#include <meson_deca/lib/c_lib/tools/model_amplitudes.hpp>
+
+typedef stan::math::var var;
+typedef stan::math::fvar<double> fvar;
+
+
+///// Allocation counter
+
+std::atomic<long> allocations(0);
+std::atomic<bool> counting(false);
+
+inline void count_allocation() {
+  if (counting.load(std::memory_order_relaxed))
+    allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+#ifdef __GLIBC__
+// Eigen allocates with malloc, so the C allocator is counted (operator
+// new of libstdc++ calls malloc, too)
+extern "C" {
+  void* __libc_malloc(size_t);
+  void* __libc_calloc(size_t, size_t);
+  void* __libc_realloc(void*, size_t);
+
+  void* malloc(size_t n) {
+    count_allocation();
+    return __libc_malloc(n);
+  }
+
+  void* calloc(size_t n, size_t size) {
+    count_allocation();
+    return __libc_calloc(n, size);
+  }
+
+  void* realloc(void* p, size_t n) {
+    count_allocation();
+    return __libc_realloc(p, n);
+  }
+}
+#else
+void* operator new(size_t n) {
+  count_allocation();
+  void* p = std::malloc(n ? n : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+#endif
+
+
+///// Scalar types
+
+// Result of a batch, kept to stop the compiler from dropping the kernels
+volatile double sink;
+
+// make_variable<T>(x, seed): x as an input of type T; the tangent of
+// fvar is 1 for the first input (seed), else 0
+template <typename T>
+inline T make_variable(double x, bool) {
+  return x;
+}
+
+template <>
+inline fvar make_variable<fvar>(double x, bool seed) {
+  return fvar(x, seed ? 1. : 0.);
+}
+
+// Gradient and cleanup at the end of a batch
+inline void finish(double sum) {
+  sink = sum;
+}
+
+inline void finish(const var& sum) {
+  stan::math::grad(sum.vi_);
+  sink = sum.val();
+  stan::math::recover_memory();
+}
+
+inline void finish(const fvar& sum) {
+  sink = sum.val_ + sum.d_;
+}
+
+// Marker in the autodiff arena and size of the vari stack (var only)
+template <typename T>
+inline char* tape_mark() {
+  return 0;
+}
+
+template <>
+inline char* tape_mark<var>() {
+  return static_cast<char*>(stan::math::ChainableStack::memalloc_.alloc(1));
+}
+
+template <typename T>
+inline long tape_nodes() {
+  return 0;
+}
+
+template <>
+inline long tape_nodes<var>() {
+  return stan::math::ChainableStack::var_stack_.size();
+}
+
+template <typename T> const char* type_name();
+template <> const char* type_name<double>() { return "double"; }
+template <> const char* type_name<var>() { return "var"; }
+template <> const char* type_name<fvar>() { return "fvar"; }
+
+
+///// Adding the kernel outputs to the sum of a batch
+
+template <typename T>
+inline void add(T& sum, const T& x) {
+  sum += x;
+}
+
+template <typename T>
+inline void add(T& sum, bool x) {
+  if (x)
+    sum += 1.;
+}
+
+template <typename T>
+inline void add(T& sum, const complex::complex_scalar<T>& x) {
+  sum += x.re + x.im;
+}
+
+template <typename T>
+inline void add(T& sum, const std::vector<Eigen::Matrix<T, Eigen::Dynamic, 1> >& x) {
+  for (size_t k = 0; k < x.size(); k++)
+    for (int i = 0; i < x[k].rows(); i++)
+      sum += x[k](i);
+}
+
+
+///// Events
+
+struct event_set {
+  std::string region;
+  int dim;
+  std::vector<double> y; // event d: y[d * dim ...]
+
+  int size() const {
+    return dim ? y.size() / dim : 0;
+  }
+};
+
+// n points of the box [0, 3]^dim with inside(y) == want (at most
+// 1000 n tries)
+template <typename In>
+event_set box_events(int dim, int n, bool want, const In& inside,
+                     unsigned long seed, uint32_t round) {
+  event_set res;
+  res.region = want ? "inside" : "outside";
+  res.dim = dim;
+  std::vector<double> u(dim);
+  for (uint32_t k = 0; res.size() < n && k < 1000u * n; k++) {
+    rng::uniform(seed, k, 1, dim, &u[0], round);
+    for (int i = 0; i < dim; i++)
+      u[i] *= 3.;
+    if (inside(&u[0]) == want)
+      res.y.insert(res.y.end(), u.begin(), u.end());
+  }
+  if (res.size() < n)
+    std::cerr << "Warning: benchmark: only " << res.size() << " points "
+              << res.region << " the phase space.\n";
+  return res;
+}
+
+// n GENBOD events of ps
+event_set genbod_events(const generate::phase_space_4& ps, int n,
+                        unsigned long seed, uint32_t round) {
+  event_set res;
+  res.region = "inside";
+  res.dim = 5;
+  std::vector<double> u(generate::phase_space_4::dim);
+  Eigen::VectorXd y;
+  for (int k = 0; k < n; k++) {
+    rng::uniform(seed, k, 1, u.size(), &u[0], round);
+    ps.event(&u[0], y);
+    res.y.insert(res.y.end(), y.data(), y.data() + 5);
+  }
+  return res;
+}
+
+
+///// Kernels
+//
+// K(x, in, sum) adds the output(s) of the kernel for the event data x
+// and the autodiff inputs in to sum. The inputs are the event variables
+// (per_event) or theta, shared by the events of a batch; the kernels of
+// theta (theta_inputs) read them as the complex vector in.theta.
+
+// Autodiff inputs of a kernel, allocated once per pass
+template <typename T>
+struct inputs {
+  Eigen::Matrix<T, Eigen::Dynamic, 1> v;
+  std::vector<Eigen::Matrix<T, Eigen::Dynamic, 1> > theta;
+
+  inputs(int V, bool theta_inputs) :
+    v(V), theta(2, Eigen::Matrix<T, Eigen::Dynamic, 1>(theta_inputs ? V / 2 : 0)) {};
+
+  // v = x (the tangent of fvar is 1 for x[0]), theta = (v[0..R-1], v[R..])
+  void set(const double* x, bool theta_inputs) {
+    for (int i = 0; i < v.rows(); i++)
+      v(i) = make_variable<T>(x[i], i == 0);
+    if (theta_inputs) {
+      int R = theta[0].rows();
+      theta[0] = v.head(R);
+      theta[1] = v.tail(R);
+    }
+  }
+};
+
+resonances::breit_wigner& rho = resonances::rho_770;
+
+struct blatt_weisskopf_kernel {
+  static const bool per_event = true, theta_inputs = false;
+  int num_inputs() const { return 2; }
+
+  template <typename T>
+  void operator()(const double*, const inputs<T>& in, T& sum) const {
+    add(sum, fct::blatt_weisskopf(rho.R.J, rho.R.r2, in.v(0), rho.a.m, rho.b.m));
+  }
+};
+
+struct relativistic_width_kernel {
+  static const bool per_event = true, theta_inputs = false;
+  int num_inputs() const { return 2; }
+
+  template <typename T>
+  void operator()(const double*, const inputs<T>& in, T& sum) const {
+    add(sum, fct::breit_wigner::relativistic_width(rho.R.m, rho.W, rho.R.J,
+      rho.R.r, in.v(0), rho.a.m, rho.b.m));
+  }
+};
+
+struct zemach_kernel {
+  static const bool per_event = true, theta_inputs = false;
+  int num_inputs() const { return 2; }
+
+  template <typename T>
+  void operator()(const double*, const inputs<T>& in, T& sum) const {
+    add(sum, fct::zemach(rho.R.J, in.v(0), in.v(1), rho.R.m2, rho.a, rho.b, rho.c));
+  }
+};
+
+struct breit_wigner_3_kernel {
+  static const bool per_event = true, theta_inputs = false;
+  int num_inputs() const { return 2; }
+
+  template <typename T>
+  void operator()(const double*, const inputs<T>& in, T& sum) const {
+    add(sum, rho.value(in.v(0), in.v(1)));
+  }
+};
+
+struct valid_5d_kernel {
+  static const bool per_event = true, theta_inputs = false;
+  int num_inputs() const { return 5; }
+
+  template <typename T>
+  void operator()(const double*, const inputs<T>& in, T& sum) const {
+    const resonances::P_R1d_R2cd_abcd& r = resonances::D_a_rho_S_wave;
+    add(sum, fct::valid_5d(in.v(0), in.v(1), in.v(2), in.v(3), in.v(4),
+                           r.P, r.a, r.b, r.c, r.d));
+  }
+};
+
+struct P_R1d_R2cd_abcd_kernel {
+  static const bool per_event = true, theta_inputs = false;
+  int num_inputs() const { return 5; }
+
+  template <typename T>
+  void operator()(const double*, const inputs<T>& in, T& sum) const {
+    add(sum, resonances::D_a_rho_S_wave.value(0, in.v(0), in.v(1), in.v(2),
+                                              in.v(3), in.v(4)));
+  }
+};
+
+struct A_cv_kernel {
+  static const bool per_event = true, theta_inputs = false;
+  int num_inputs() const { return stan::math::num_variables(); }
+
+  template <typename T>
+  void operator()(const double*, const inputs<T>& in, T& sum) const {
+    add(sum, stan::math::A_cv(in.v));
+  }
+};
+
+// x: index of the event in A (its A_cv), theta shared by the batch.
+// With background, theta_background_abs2 is kept constant
+struct f_model_kernel {
+  static const bool per_event = false, theta_inputs = true;
+  int num_inputs() const { return 2 * stan::math::num_resonances(); }
+
+  std::vector<std::vector<Eigen::VectorXd> > A;
+  std::vector<Eigen::VectorXd> A_bkg;
+  Eigen::VectorXd theta_bkg;
+
+  template <typename T>
+  void operator()(const double* x, const inputs<T>& in, T& sum) const {
+#ifdef MESON_DECA_BACKGROUND
+    add(sum, stan::math::f_model(A[long(x[0])], in.theta, A_bkg[long(x[0])],
+                                 theta_bkg));
+#else
+    add(sum, stan::math::f_model(A[long(x[0])], in.theta));
+#endif
+  }
+};
+
+// x: theta of the event
+struct Norm_kernel {
+  static const bool per_event = true, theta_inputs = true;
+  int num_inputs() const { return 2 * stan::math::num_resonances(); }
+
+  std::vector<Eigen::MatrixXd> I;
+  Eigen::VectorXd theta_bkg, I_bkg;
+
+  template <typename T>
+  void operator()(const double*, const inputs<T>& in, T& sum) const {
+#ifdef MESON_DECA_BACKGROUND
+    add(sum, stan::math::Norm(in.theta, I, theta_bkg, I_bkg));
+#else
+    add(sum, stan::math::Norm(in.theta, I));
+#endif
+  }
+};
+
+
+///// Measurement
+
+struct result {
+  long events;
+  int passes;
+  double ns_per_event;
+  double allocs_per_event;
+  double tape_bytes_per_event;
+  double tape_nodes_per_event;
+};
+
+// Counts of a measured pass
+struct tape_stats {
+  long events, bytes, nodes;
+
+  tape_stats() : events(0), bytes(0), nodes(0) {};
+};
+
+// One pass over the events ev (measured if tape != 0). theta: the
+// inputs of the kernels with per_event == false
+template <typename T, typename K>
+void pass(const K& kernel, const event_set& ev, const std::vector<double>& theta,
+          int batch, inputs<T>& in, tape_stats* tape) {
+  int n = ev.size();
+  for (int b = 0; b < n; b += batch) {
+    T sum(0.);
+    if (!K::per_event)
+      in.set(&theta[0], K::theta_inputs);
+    for (int d = b; d < std::min(n, b + batch); d++) {
+      const double* x = &ev.y[long(d) * ev.dim];
+      if (K::per_event)
+        in.set(x, K::theta_inputs);
+      if (!tape) {
+        kernel(x, in, sum);
+        continue;
+      }
+      long nodes = tape_nodes<T>();
+      char* before = tape_mark<T>();
+      kernel(x, in, sum);
+      char* after = tape_mark<T>();
+      tape->nodes += tape_nodes<T>() - nodes;
+      // Skip the events which moved the arena to its next block
+      if (after > before && after - before < (1 << 20)) {
+        tape->events++;
+        tape->bytes += after - before - 1;
+      }
+    }
+    finish(sum);
+  }
+}
+
+template <typename T, typename K>
+result measure(const K& kernel, const event_set& ev,
+               const std::vector<double>& theta, int batch, double min_time) {
+  typedef std::chrono::steady_clock clock;
+  result res;
+  res.events = ev.size();
+
+  // Allocations and tape
+  inputs<T> in(kernel.num_inputs(), K::theta_inputs);
+  tape_stats tape;
+  long allocs_0 = allocations;
+  counting = true;
+  pass<T>(kernel, ev, theta, batch, in, &tape);
+  counting = false;
+  res.allocs_per_event = double(allocations - allocs_0) / res.events;
+  res.tape_bytes_per_event = tape.events ? double(tape.bytes) / tape.events : 0;
+  res.tape_nodes_per_event = double(tape.nodes) / res.events;
+
+  // Time
+  std::vector<double> ns;
+  clock::time_point start = clock::now();
+  while (ns.size() < 3
+         || std::chrono::duration<double>(clock::now() - start).count() < min_time) {
+    clock::time_point t_0 = clock::now();
+    pass<T>(kernel, ev, theta, batch, in, 0);
+    ns.push_back(std::chrono::duration<double, std::nano>(clock::now() - t_0).count());
+  }
+  std::sort(ns.begin(), ns.end());
+  res.passes = ns.size();
+  res.ns_per_event = ns[ns.size() / 2] / res.events;
+  return res;
+}
+
+
+///// Output
+
+struct report {
+  std::vector<std::ostream*> out;
+  std::string filter;
+
+  bool wanted(const std::string& kernel) const {
+    return kernel.find(filter) != std::string::npos;
+  }
+
+  void line(const std::string& s) {
+    for (size_t k = 0; k < out.size(); k++)
+      *out[k] << s << "\n" << std::flush;
+  }
+
+  template <typename T>
+  void add(const std::string& kernel, const std::string& region, const result& r) {
+    char buffer[512];
+    snprintf(buffer, sizeof(buffer),
+             "{\"kernel\": \"%s\", \"type\": \"%s\", \"region\": \"%s\", "
+             "\"events\": %ld, \"passes\": %d, \"ns_per_event\": %.4g, "
+             "\"allocs_per_event\": %.4g, \"tape_bytes_per_event\": %.4g, "
+             "\"tape_nodes_per_event\": %.4g}",
+             kernel.c_str(), type_name<T>(), region.c_str(), r.events, r.passes,
+             r.ns_per_event, r.allocs_per_event, r.tape_bytes_per_event,
+             r.tape_nodes_per_event);
+    line(buffer);
+  }
+
+  // Runs kernel on the events of all regions, for double, var and fvar
+  template <typename K>
+  void run(const std::string& name, const K& kernel,
+           const std::vector<event_set>& regions,
+           const std::vector<double>& theta, int batch, double min_time) {
+    if (!wanted(name))
+      return;
+    for (size_t k = 0; k < regions.size(); k++) {
+      const event_set& ev = regions[k];
+      if (ev.size() == 0)
+        continue;
+      add<double>(name, ev.region, measure<double>(kernel, ev, theta, batch, min_time));
+      add<var>(name, ev.region, measure<var>(kernel, ev, theta, batch, min_time));
+      add<fvar>(name, ev.region, measure<fvar>(kernel, ev, theta, batch, min_time));
+    }
+  }
+};
+
+
+int main(int argc, char** argv) {
+
+  tools::options opt(argc, argv, std::vector<std::string>());
+  tools::model_amplitudes model;
+
+  int n = opt.get("events", 2000L);
+  int batch = std::max(1L, opt.get("batch", 100L));
+  double min_time = opt.get("min-time", 0.2);
+  unsigned long seed = opt.get("seed", 1L);
+
+  report rep;
+  rep.filter = opt.get("filter", "");
+  rep.out.push_back(&std::cout);
+  std::ofstream f_out;
+  if (opt.has("output")) {
+    f_out.open(opt.get("output", "benchmark.json").c_str());
+    rep.out.push_back(&f_out);
+  }
+
+  int N = model.num_variables();
+  int R = model.num_resonances();
+  std::ostringstream head;
+  head << "{\"benchmark\": \"meson_deca\", \"num_variables\": " << N
+       << ", \"num_resonances\": " << R << ", \"events\": " << n
+       << ", \"batch\": " << batch << ", \"min_time\": " << min_time
+       << ", \"seed\": " << seed << ", \"compiler\": \"" << __VERSION__ << "\"}";
+  rep.line(head.str());
+
+  // Events (round: the event set)
+  std::vector<event_set> dalitz, four_body, model_events;
+  struct {
+    bool operator()(const double* y) const {
+      return fct::valid(y[0], y[1], rho.P, rho.a, rho.b, rho.c);
+    }
+  } in_dalitz;
+  dalitz.push_back(box_events(2, n, true, in_dalitz, seed, 0));
+  dalitz.push_back(box_events(2, n, false, in_dalitz, seed, 1));
+
+  const resonances::P_R1d_R2cd_abcd& r4 = resonances::D_a_rho_S_wave;
+  struct {
+    const resonances::P_R1d_R2cd_abcd& r;
+    bool operator()(const double* y) const {
+      return fct::valid_5d(y[0], y[1], y[2], y[3], y[4], r.P, r.a, r.b, r.c, r.d);
+    }
+  } in_5d = {r4};
+  four_body.push_back(genbod_events(generate::make_phase_space(r4), n, seed, 2));
+  four_body.push_back(box_events(5, n, false, in_5d, seed, 3));
+
+  struct {
+    const tools::model_amplitudes& model;
+    int N;
+    bool operator()(const double* y) const {
+      return model.in_phase_space(
+        Eigen::VectorXd(Eigen::Map<const Eigen::VectorXd>(y, N)));
+    }
+  } in_model = {model, N};
+#ifdef MESON_DECA_PHASE_SPACE
+  model_events.push_back(genbod_events(
+    generate::make_phase_space(MESON_DECA_PHASE_SPACE), n, seed, 4));
+#else
+  model_events.push_back(box_events(N, n, true, in_model, seed, 4));
+#endif
+  model_events.push_back(box_events(N, n, false, in_model, seed, 5));
+
+  std::vector<double> none;
+  rep.run("blatt_weisskopf", blatt_weisskopf_kernel(), dalitz, none, batch, min_time);
+  rep.run("relativistic_width", relativistic_width_kernel(), dalitz, none, batch, min_time);
+  rep.run("zemach", zemach_kernel(), dalitz, none, batch, min_time);
+  rep.run("breit_wigner_3", breit_wigner_3_kernel(), dalitz, none, batch, min_time);
+  rep.run("valid_5d", valid_5d_kernel(), four_body, none, batch, min_time);
+  rep.run("P_R1d_R2cd_abcd", P_R1d_R2cd_abcd_kernel(), four_body, none, batch, min_time);
+  rep.run("A_cv", A_cv_kernel(), model_events, none, batch, min_time);
+
+  // theta: standard normal
+  std::vector<double> theta(2 * R);
+  rng::normal(seed, 0, 1, 2 * R, &theta[0], 6);
+
+  // f_model: A_cv of the inside events; the event data is their index
+  const event_set& inside = model_events[0];
+  f_model_kernel f_model;
+  event_set index;
+  index.region = "inside";
+  index.dim = 1;
+  Eigen::VectorXd A_re, A_im, A_bkg;
+  for (int d = 0; d < inside.size(); d++) {
+    Eigen::VectorXd y = Eigen::Map<const Eigen::VectorXd>(&inside.y[long(d) * N], N);
+    if (!model(y, A_re, A_im, A_bkg))
+      continue;
+    std::vector<Eigen::VectorXd> A(2);
+    A[0] = A_re;
+    A[1] = A_im;
+    f_model.A.push_back(A);
+    f_model.A_bkg.push_back(A_bkg);
+    index.y.push_back(f_model.A.size() - 1);
+  }
+  f_model.theta_bkg = Eigen::VectorXd::Ones(model.num_background());
+  rep.run("f_model", f_model, std::vector<event_set>(1, index), theta, batch, min_time);
+
+  // Norm: I = mean of conj(A) A^T over the inside events, a new theta
+  // per event
+  Norm_kernel norm;
+  norm.I.assign(2, Eigen::MatrixXd::Zero(R, R));
+  norm.I_bkg = Eigen::VectorXd::Zero(model.num_background());
+  for (size_t d = 0; d < f_model.A.size(); d++) {
+    const Eigen::VectorXd& a = f_model.A[d][0];
+    const Eigen::VectorXd& b = f_model.A[d][1];
+    norm.I[0] += (a * a.transpose() + b * b.transpose()) / f_model.A.size();
+    norm.I[1] += (a * b.transpose() - b * a.transpose()) / f_model.A.size();
+    norm.I_bkg += f_model.A_bkg[d] / f_model.A.size();
+  }
+  norm.theta_bkg = f_model.theta_bkg;
+  event_set thetas;
+  thetas.region = "none";
+  thetas.dim = 2 * R;
+  thetas.y.resize(long(n) * thetas.dim);
+  rng::normal(seed, 0, n, thetas.dim, &thetas.y[0], 7);
+  rep.run("Norm", norm, std::vector<event_set>(1, thetas), none, batch, min_time);
+
+  return 0;
+}
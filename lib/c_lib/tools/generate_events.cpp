@@ -0,0 +1,291 @@
+// generate_events.cpp
+//
+// NAME
+//    generate_events - generate independent model events
+//
+// SYNOPSIS
+//    ./generate_events [y1_min y1_max ... yN_min yN_max] [OPTIONS]
+//    ./generate_events --phase-space [OPTIONS]
+//
+// DESCRIPTION
+//    Native replacement of the STAN_data_generator executable of
+//    generate.sh. Draws events with the density
+//
+//        f(y) = |sum_i theta_i A_i(y)|^2 + sum_k theta_background_abs2_k B_k(y)
+//
+//    (f_model of lib/c_lib/model.hpp) by accept-reject from uniform
+//    points in the box y_min <= y <= y_max (default: 0 <= y_n <= 3, as
+//    in STAN_data_generator.stan), or from GENBOD phase space events.
+//    Unlike the Markov chain of STAN, the events are independent, and
+//    the points are tried in parallel.
+//
+//    The envelope maximum h_max is estimated from the largest weight of
+//    --train-points trial points (times --safety). If a generated point
+//    exceeds h_max, h_max is raised to --safety times the largest weight
+//    seen and the events are generated again (at most --retries times).
+//
+//    theta and theta_background_abs2 are read from the R dump --data.
+//    The events are written to --output in the layout of the CmdSTAN
+//    output file (header 'lp__,y.1,...,y.N', lp__ = log f(y)), as read
+//    by utils/csv_to_root.py and utils/plot_2d_csv.py.
+//
+// OPTIONS
+//    --events N     number of events (default: 1000)
+//    --seed S       random seed (default: 1)
+//    --threads T    number of threads (default: MESON_DECA_NUM_THREADS)
+//    --data FILE    theta, theta_background_abs2 (default:
+//                   STAN_data_generator.data.R)
+//    --output FILE  output file (default: generated_data.csv)
+//    --binary FILE  also write the events to FILE, in the layout of
+//                   y_data.bin (see lib/c_lib/tools/amplitudes.cpp)
+//    --phase-space  sample GENBOD phase space events instead of uniform
+//                   points in the box (4-body models defining
+//                   MESON_DECA_PHASE_SPACE; no bounds needed)
+//    --weighted     write weighted events instead: all of N tried points
+//                   with f(y) > 0, with the weight w f(y) in the column
+//                   'weight' (no envelope)
+//
+//    --channels         mix the uniform box with Breit-Wigner channels of
+//                       the narrow resonances (MESON_DECA_CHANNELS in
+//                       model.hpp; not with --phase-space)
+//    --vegas ITER       adapt a VEGAS grid to f in ITER training
+//                       iterations; raises the fraction of kept points
+//    --train-points N   points per training iteration and for the
+//                       estimate of h_max (default: 100000)
+//    --safety S         h_max = S * largest training weight (default: 1.2)
+//    --retries K        how often h_max may be raised (default: 3)
+//
+// BUILD
+//    build_tools.sh (from the model folder).
+
+#include <algorithm> // std::min
+#include <cmath>     // log
+#include <fstream>
+#include <iostream>
+#include <map>
+
+#include <meson_deca/lib/c_lib/data.hpp>
+#include <meson_deca/lib/c_lib/generate.hpp>
+#include <meson_deca/lib/c_lib/integrate.hpp>
+#include <meson_deca/lib/c_lib/parallel.hpp>
+#include <meson_deca/lib/c_lib/tools/model_amplitudes.hpp>
+
+// log f(y) of the events, evaluated in parallel
+std::vector<double>
+log_density(const tools::model_amplitudes& model,
+            const integrate::intensity_importance& importance,
+            const std::vector<Eigen::VectorXd>& events) {
+  int D = events.size();
+  std::vector<double> lp(D);
+  int block = integrate::points_per_batch;
+  parallel::pool()->run((D + block - 1) / block, [&](int b) {
+    Eigen::VectorXd A_re, A_im, A_bkg;
+    for (int d = b * block; d < std::min(D, (b + 1) * block); d++)
+      lp[d] = model(events[d], A_re, A_im, A_bkg) ?
+        log(importance(A_re, A_im, A_bkg)) : -INFINITY;
+  });
+  return lp;
+}
+
+
+// Writes the events (and weights h, if not 0) to the files of opt
+void write_events(const tools::model_amplitudes& model,
+                  const integrate::intensity_importance& importance,
+                  const std::vector<Eigen::VectorXd>& events,
+                  const std::vector<double>* h, const std::string& comment,
+                  const tools::options& opt) {
+  std::string f_name = opt.get("output", "generated_data.csv");
+  std::ofstream f_csv(f_name.c_str());
+  f_csv << "# generate_events: " << comment << "\n";
+  generate::write_csv(f_csv, events, log_density(model, importance, events), h);
+  std::cout << "generate_events: events saved in " << f_name << ".\n";
+
+  if (opt.has("binary")) {
+    std::string b_name = opt.get("binary", "y_data.bin");
+    std::ofstream f_bin(b_name.c_str(), std::ios::binary);
+    generate::write_binary(f_bin, events);
+  }
+}
+
+
+// Prints number of points, relative variance and efficiency of weights w
+void print_weights(const std::string& name, const integrate::weight_stats& w) {
+  std::cout << "  " << name << ": " << w.n << " points, variance "
+            << w.variance() / (w.mean() * w.mean()) << " (relative), "
+            << "efficiency " << w.efficiency() << "\n";
+}
+
+
+// Generates the events from the points of map and writes them
+template <typename Map>
+int generate_from(const tools::model_amplitudes& model, const Map& map,
+                  const integrate::intensity_importance& importance,
+                  const tools::options& opt) {
+
+  int n_events = opt.get("events", 1000L);
+  unsigned long seed = opt.get("seed", 1L);
+
+  if (opt.has("weighted")) {
+    generate::weighted_sample res
+      = generate::weighted(model, map, importance, n_events, seed);
+    std::cout << "generate_events: " << res.events.size() << " of "
+              << res.weights.n << " points with f > 0, "
+              << parallel::num_threads() << " threads; integral "
+              << res.weights.mean() << ".\n";
+    write_events(model, importance, res.events, &res.h,
+                 "weighted, seed " + std::to_string(seed), opt);
+    return 0;
+  }
+
+  // Envelope
+  integrate::weight_stats train = integrate::sample_weights(model, map,
+    importance, opt.get("train-points", 100000L), seed);
+  print_weights("training", train);
+  if (!(train.max > 0)) {
+    std::cerr << "generate_events: f vanishes at all training points.\n";
+    return 1;
+  }
+  double safety = opt.get("safety", 1.2);
+  if (!(safety >= 1.)) {
+    std::cerr << "generate_events: --safety must be at least 1.\n";
+    return 1;
+  }
+  double h_max = safety * train.max;
+
+  generate::event_sample res;
+  for (int retry = 0; ; retry++) {
+    res = generate::accept_reject(model, map, importance, n_events, h_max, seed);
+    std::cout << "generate_events: " << res.events.size() << " events of "
+              << res.weights.n << " points (efficiency "
+              << double(res.events.size()) / res.weights.n << "), h_max "
+              << h_max << ", " << parallel::num_threads() << " threads.\n";
+    if (res.overflows == 0)
+      break;
+    if (retry == opt.get("retries", 3L)) {
+      std::cout << "Warning: generate_events: " << res.overflows
+                << " points above h_max; their region is undersampled.\n";
+      break;
+    }
+    std::cout << "generate_events: " << res.overflows << " points above h_max, "
+              << "generating again.\n";
+    h_max = safety * res.weights.max;
+  }
+
+  write_events(model, importance, res.events, 0,
+               "seed " + std::to_string(seed) + ", h_max "
+               + std::to_string(h_max), opt);
+  return 0;
+}
+
+
+// With --vegas, adapts a grid to f on map and generates from the
+// adapted map
+template <typename Map>
+int adapt_and_generate(const tools::model_amplitudes& model, const Map& map,
+                       const integrate::intensity_importance& importance,
+                       const tools::options& opt) {
+
+  if (!opt.has("vegas"))
+    return generate_from(model, map, importance, opt);
+
+  int iterations = opt.get("vegas", 5L);
+  int n_train = opt.get("train-points", 100000L);
+  unsigned long seed = opt.get("seed", 1L);
+
+  integrate::vegas_stats stats;
+  stats.uniform = integrate::sample_weights(model, map, importance,
+                                            n_train, seed);
+  integrate::vegas_map<Map> adapted
+    = integrate::adapt(model, map, importance, iterations, n_train, seed, stats);
+
+  std::cout << "generate_events: VEGAS training\n";
+  print_weights("uniform", stats.uniform);
+  for (size_t it = 0; it < stats.iterations.size(); it++)
+    print_weights("iteration " + std::to_string(it), stats.iterations[it]);
+  std::cout << "  efficiency gain " << stats.efficiency_gain() << ".\n";
+
+  return generate_from(model, adapted, importance, opt);
+}
+
+
+int main(int argc, char** argv) {
+
+  std::vector<std::string> flags;
+  flags.push_back("phase-space");
+  flags.push_back("channels");
+  flags.push_back("weighted");
+  tools::options opt(argc, argv, flags);
+  tools::model_amplitudes model;
+
+  int N = model.num_variables();
+  bool phase_space = opt.has("phase-space");
+  if (!phase_space && !opt.positional.empty()
+      && (int) opt.positional.size() != 2 * N) {
+    std::cerr << "generate_events: expected " << 2 * N
+              << " bounds (y1_min y1_max ...) or none.\n";
+    return 1;
+  }
+
+  // The box of STAN_data_generator.stan, unless given
+  Eigen::VectorXd lower = Eigen::VectorXd::Zero(N);
+  Eigen::VectorXd upper = Eigen::VectorXd::Constant(N, 3.);
+  for (int n = 0; n < N && !opt.positional.empty(); n++) {
+    lower(n) = atof(opt.positional[2 * n].c_str());
+    upper(n) = atof(opt.positional[2 * n + 1].c_str());
+  }
+
+  // theta[2] (column-major in the R dump) and theta_background_abs2
+  std::string d_name = opt.get("data", "STAN_data_generator.data.R");
+  std::ifstream f_data(d_name.c_str());
+  if (!f_data) {
+    std::cerr << "generate_events: cannot open " << d_name << ".\n";
+    return 1;
+  }
+  std::map<std::string, std::vector<double> > data = data::read_rdump(f_data);
+  int R = model.num_resonances();
+  int B = model.num_background();
+  if ((int) data["theta"].size() != 2 * R
+      || (int) data["theta_background_abs2"].size() != B) {
+    std::cerr << "generate_events: " << d_name << " must define theta ("
+              << 2 << " x " << R << ") and theta_background_abs2 (" << B
+              << ").\n";
+    return 1;
+  }
+  Eigen::VectorXd theta_re(R), theta_im(R), theta_bkg(B);
+  for (int i = 0; i < R; i++) {
+    theta_re(i) = data["theta"][2 * i];
+    theta_im(i) = data["theta"][2 * i + 1];
+  }
+  for (int k = 0; k < B; k++)
+    theta_bkg(k) = data["theta_background_abs2"][k];
+  integrate::intensity_importance importance(theta_re, theta_im, theta_bkg);
+
+  if (opt.has("threads"))
+    parallel::set_num_threads(opt.get("threads", 1L));
+
+  if (phase_space) {
+#ifdef MESON_DECA_PHASE_SPACE
+    integrate::phase_space_map map(
+      generate::make_phase_space(MESON_DECA_PHASE_SPACE));
+    return adapt_and_generate(model, map, importance, opt);
+#else
+    std::cerr << "generate_events: --phase-space needs a 4-body model "
+              << "(MESON_DECA_PHASE_SPACE in model.hpp).\n";
+    return 1;
+#endif
+  } else if (opt.has("channels")) {
+#ifdef MESON_DECA_CHANNELS
+    integrate::bw_channel list[] = {MESON_DECA_CHANNELS};
+    std::vector<integrate::bw_channel> channels(list, list + sizeof(list)
+                                                / sizeof(list[0]));
+    integrate::box region(lower, upper);
+    return adapt_and_generate(model, integrate::multichannel(region, channels),
+                              importance, opt);
+#else
+    std::cerr << "generate_events: --channels needs MESON_DECA_CHANNELS "
+              << "in model.hpp.\n";
+    return 1;
+#endif
+  }
+  return adapt_and_generate(model, integrate::box(lower, upper), importance, opt);
+}
@@ -0,0 +1,148 @@
+#ifndef MESON_DECA__LIB__C_LIB__TOOLS__MODEL_AMPLITUDES_HPP
+#define MESON_DECA__LIB__C_LIB__TOOLS__MODEL_AMPLITUDES_HPP
+
+#include <cstdlib> // atof, atol
+#include <cstring> // strcmp
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <meson_deca/lib/c_lib/complex/matrix.hpp>
+#include <meson_deca/lib/c_lib/model.hpp>
+
+/*
+ *  Glue between the native tools and the current model (model.hpp).
+ *
+ *  DESCRIPTION
+ *    The tools are compiled against lib/c_lib/model.hpp, just like the
+ *    python wrapper. Models with incoherent background must be built
+ *    with -DMESON_DECA_BACKGROUND (build_tools.sh does this if the model
+ *    defines MESON_DECA_HAS_BACKGROUND).
+ *
+ *  TYPES
+ *    model_amplitudes
+ *    options
+ */
+
+namespace tools {
+
+  /**
+   * model_amplitudes
+   *
+   * The amplitude model expected by the integrators in lib/c_lib/integrate:
+   * A_cv(y) (and A_v_background_abs2(y)) at points inside the phase space,
+   * one point at a time or in batches (A_cm).
+   */
+  struct model_amplitudes {
+
+    int num_resonances() const {
+      return stan::math::num_resonances();
+    }
+
+    int num_background() const {
+#ifdef MESON_DECA_BACKGROUND
+      return stan::math::num_background();
+#else
+      return 0;
+#endif
+    }
+
+    int num_variables() const {
+      return stan::math::num_variables();
+    }
+
+    bool in_phase_space(const Eigen::VectorXd& y) const {
+      return stan::math::in_phase_space(y);
+    }
+
+    // mask[d] = in_phase_space(y_d) for the D events y[d * num_variables() ..]
+    void in_phase_space(const double* y, int D, unsigned char* mask) const {
+      stan::math::in_phase_space(y, D, mask);
+    }
+
+    // Amplitudes of the D events y[d * num_variables() ..] (inside the
+    // phase space): A is R x D, A_bkg is B x D
+    void batch(const double* y, int D, complex::split_matrix& A,
+               Eigen::MatrixXd& A_bkg) const {
+      stan::math::A_cm(y, D, A);
+      A_bkg.resize(num_background(), D);
+#ifdef MESON_DECA_BACKGROUND
+      int N = num_variables();
+      for (int d = 0; d < D; d++)
+        A_bkg.col(d) = stan::math::A_v_background_abs2(
+          Eigen::VectorXd(Eigen::Map<const Eigen::VectorXd>(y + long(d) * N, N)));
+#endif
+    }
+
+    bool operator()(const Eigen::VectorXd& y, Eigen::VectorXd& A_re,
+                    Eigen::VectorXd& A_im, Eigen::VectorXd& A_bkg) const {
+      if (!stan::math::in_phase_space(y))
+        return false;
+
+      std::vector<Eigen::VectorXd> A = stan::math::A_cv(y);
+      A_re = A[0];
+      A_im = A[1];
+#ifdef MESON_DECA_BACKGROUND
+      A_bkg = stan::math::A_v_background_abs2(y);
+#else
+      A_bkg.resize(0);
+#endif
+      return true;
+    }
+  };
+
+
+  /**
+   * options
+   *
+   * Minimal command line parser: '--name value' pairs and flags, the
+   * remaining arguments are positional.
+   */
+  struct options {
+    std::vector<std::string> names;
+    std::vector<std::string> values;
+    std::vector<std::string> positional;
+
+    // flags: names of the options that take no value
+    options(int argc, char** argv, const std::vector<std::string>& flags) {
+      for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+          std::string name = arg.substr(2);
+          bool flag = false;
+          for (size_t k = 0; k < flags.size(); k++)
+            flag = flag || flags[k] == name;
+          names.push_back(name);
+          values.push_back((flag || i + 1 == argc) ? "1" : argv[++i]);
+        } else {
+          positional.push_back(arg);
+        }
+      }
+    }
+
+    bool has(const std::string& name) const {
+      for (size_t k = 0; k < names.size(); k++)
+        if (names[k] == name)
+          return true;
+      return false;
+    }
+
+    std::string get(const std::string& name, const std::string& def) const {
+      for (size_t k = 0; k < names.size(); k++)
+        if (names[k] == name)
+          return values[k];
+      return def;
+    }
+
+    double get(const std::string& name, double def) const {
+      return has(name) ? atof(get(name, "").c_str()) : def;
+    }
+
+    long get(const std::string& name, long def) const {
+      return has(name) ? atol(get(name, "").c_str()) : def;
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,269 @@
+// normalization_integral.cpp
+//
+// NAME
+//    normalization_integral - make a file containing I[i,j]
+//
+// SYNOPSIS
+//    ./normalization_integral y1_min y1_max ... yN_min yN_max [OPTIONS]
+//    ./normalization_integral --phase-space [OPTIONS]
+//
+// DESCRIPTION
+//    Native replacement of utils/calculate_normalization_integral.py.
+//    Calculates
+//
+//        I[i,j] = \int conj(A_i(y)) A_j(y) dy
+//
+//    for the amplitudes A_cv of lib/c_lib/model.hpp by Monte Carlo
+//    integration over the box y_min <= y <= y_max, and writes I (with
+//    the statistical error of every entry) to 'normalization_integral.py'
+//    in the format read by utils/data_analysis__root_to_dataR.py.
+//    Points outside the phase space (in_phase_space(y) == false) are
+//    not passed to A_cv. If an entry of I is not finite, the resonance
+//    is reported and the tool exits with status 1 without writing I.
+//
+// OPTIONS
+//    --points N     number of sample points (default: 1000000)
+//    --seed S       random seed (default: 1)
+//    --threads T    number of threads (default: MESON_DECA_NUM_THREADS)
+//    --background   also integrate A_v_background_abs2
+//    --phase-space  sample GENBOD phase space events instead of uniform
+//                   points in the box (4-body models defining
+//                   MESON_DECA_PHASE_SPACE; no bounds needed)
+//    --output FILE  output file (default: normalization_integral.py)
+//
+//    --qmc SEQ          randomized quasi-Monte Carlo with the sequence
+//                       SEQ = sobol or halton instead of random points
+//    --replicas K       number of random shifts for --qmc (default: 16)
+//    --precision EPS    with --qmc: double the number of points until
+//                       every entry has the relative error EPS (relative
+//                       to sqrt(I[i,i] I[j,j]), see max_rel_error)
+//    --max-points N     upper limit for --precision (default: 100000000)
+//
+//    --channels         mix the uniform box with Breit-Wigner channels of
+//                       the narrow resonances (MESON_DECA_CHANNELS in
+//                       model.hpp; not with --phase-space)
+//    --vegas ITER       adapt a VEGAS grid in ITER training iterations
+//                       before the integration and print the variance
+//                       reduction against uniform points (--vegas 1 only
+//                       measures the channels)
+//    --train-points N   points per training iteration (default: 100000)
+//
+//    --cache DIR    keep the entries of I in the folder DIR (created if
+//                   necessary) and reuse them if neither the amplitudes
+//                   of the entry (see lib/c_lib/cache.hpp) nor the other
+//                   options changed
+//
+// BUILD
+//    build_tools.sh (from the model folder).
+
+#include <fstream>
+#include <iostream>
+#include <map>
+
+#include <meson_deca/lib/c_lib/cache.hpp>
+#include <meson_deca/lib/c_lib/integrate.hpp>
+#include <meson_deca/lib/c_lib/parallel.hpp>
+#include <meson_deca/lib/c_lib/tools/model_amplitudes.hpp>
+
+// Integrates with pseudo-random or QMC points of map, as set in opt
+template <typename Map>
+integrate::normalization_integral
+compute_integral(const tools::model_amplitudes& model, const Map& map,
+          const tools::options& opt) {
+
+  int n_points = opt.get("points", 1000000L);
+  unsigned long seed = opt.get("seed", 1L);
+  if (!opt.has("qmc"))
+    return integrate::plain(model, map, n_points, seed);
+
+  // Points per replica: a power of 2 (required by Sobol nets)
+  int K = opt.get("replicas", 16L);
+  int n_start = 1;
+  while (2 * n_start * K <= n_points)
+    n_start *= 2;
+  int n_max = opt.get("max-points", 100000000L) / K;
+  double precision = opt.get("precision", 0.);
+
+  std::string name = opt.get("qmc", "sobol");
+  if (name == "halton")
+    return integrate::qmc(model, map, integrate::halton(map.dim()),
+                          K, n_start, n_max, precision, seed);
+  return integrate::qmc(model, map, integrate::sobol(map.dim()),
+                        K, n_start, n_max, precision, seed);
+}
+
+
+// Prints number of points, variance per point and accept-reject
+// efficiency of the weights w * sum_i |A_i|^2
+void print_weights(const std::string& name, const integrate::weight_stats& w) {
+  std::cout << "  " << name << ": " << w.n << " points, variance "
+            << w.variance() / (w.mean() * w.mean()) << " (relative), "
+            << "efficiency " << w.efficiency() << "\n";
+}
+
+
+// With --vegas, adapts a grid to map and integrates with the adapted
+// map; the variance is compared with the one of the points of baseline
+template <typename Map, typename Baseline>
+integrate::normalization_integral
+adapt_and_integrate(const tools::model_amplitudes& model, const Map& map,
+                    const Baseline& baseline, const tools::options& opt) {
+
+  if (!opt.has("vegas"))
+    return compute_integral(model, map, opt);
+
+  int iterations = opt.get("vegas", 5L);
+  int n_train = opt.get("train-points", 100000L);
+  unsigned long seed = opt.get("seed", 1L);
+
+  integrate::trace_importance trace;
+  integrate::vegas_stats stats;
+  stats.uniform = integrate::sample_weights(model, baseline, trace,
+                                            n_train, seed);
+  integrate::vegas_map<Map> adapted
+    = integrate::adapt(model, map, trace, iterations, n_train, seed, stats);
+
+  std::cout << "normalization_integral: VEGAS training\n";
+  print_weights("uniform", stats.uniform);
+  for (size_t it = 0; it < stats.iterations.size(); it++)
+    print_weights("iteration " + std::to_string(it), stats.iterations[it]);
+  std::cout << "  variance reduction " << stats.variance_reduction()
+            << ", efficiency gain " << stats.efficiency_gain() << ".\n";
+
+  return compute_integral(model, adapted, opt);
+}
+
+
+// Hash of the options that change the result (plus salt, a hash of
+// parameters of the map not given by options)
+uint64_t settings_hash(const tools::options& opt, uint64_t salt) {
+  std::map<std::string, std::string> settings;
+  for (size_t k = 0; k < opt.names.size(); k++)
+    if (opt.names[k] != "threads" && opt.names[k] != "output"
+        && opt.names[k] != "cache" && opt.names[k] != "background")
+      settings[opt.names[k]] = opt.values[k];
+
+  cache::hasher h;
+  h.add(salt);
+  for (size_t k = 0; k < opt.positional.size(); k++)
+    h.add(atof(opt.positional[k].c_str()));
+  for (std::map<std::string, std::string>::const_iterator it = settings.begin();
+       it != settings.end(); ++it)
+    h.add(it->first).add(it->second);
+  return h.value();
+}
+
+
+// adapt_and_integrate() through the cache, if --cache is given
+template <typename Map, typename Baseline>
+integrate::normalization_integral
+integrate_cached(const tools::model_amplitudes& model, const Map& map,
+                 const Baseline& baseline, const tools::options& opt,
+                 uint64_t salt) {
+
+  if (!opt.has("cache"))
+    return adapt_and_integrate(model, map, baseline, opt);
+
+  cache::store store(opt.get("cache", "cache"));
+  cache::fingerprints fp = cache::fingerprint(model,
+    cache::probe_points(model, baseline, cache::num_probes));
+  integrate::normalization_integral res = cache::integral(fp,
+    settings_hash(opt, salt), store,
+    [&]() { return adapt_and_integrate(model, map, baseline, opt); });
+
+  std::cout << "normalization_integral: " << store.hits << " of "
+            << store.hits + store.misses << " entries from the cache "
+            << opt.get("cache", "cache") << ".\n";
+  return res;
+}
+
+
+int main(int argc, char** argv) {
+
+  std::vector<std::string> flags;
+  flags.push_back("background");
+  flags.push_back("phase-space");
+  flags.push_back("channels");
+  tools::options opt(argc, argv, flags);
+  tools::model_amplitudes model;
+
+  int N = model.num_variables();
+  bool phase_space = opt.has("phase-space");
+  if (!phase_space && (int) opt.positional.size() != 2 * N) {
+    std::cerr << "normalization_integral: expected " << 2 * N
+              << " integration bounds (y1_min y1_max ...).\n";
+    return 1;
+  }
+
+  Eigen::VectorXd lower(N), upper(N);
+  for (int n = 0; n < N && !phase_space; n++) {
+    lower(n) = atof(opt.positional[2 * n].c_str());
+    upper(n) = atof(opt.positional[2 * n + 1].c_str());
+  }
+
+  bool background = opt.has("background");
+  if (background && model.num_background() == 0) {
+    std::cerr << "normalization_integral: the model has no background "
+              << "(build with -DMESON_DECA_BACKGROUND).\n";
+    return 1;
+  }
+  if (opt.has("threads"))
+    parallel::set_num_threads(opt.get("threads", 1L));
+
+  integrate::normalization_integral res;
+  if (phase_space) {
+#ifdef MESON_DECA_PHASE_SPACE
+    integrate::phase_space_map map(
+      generate::make_phase_space(MESON_DECA_PHASE_SPACE));
+    res = integrate_cached(model, map, map, opt, 0);
+#else
+    std::cerr << "normalization_integral: --phase-space needs a 4-body model "
+              << "(MESON_DECA_PHASE_SPACE in model.hpp).\n";
+    return 1;
+#endif
+  } else if (opt.has("channels")) {
+#ifdef MESON_DECA_CHANNELS
+    integrate::bw_channel list[] = {MESON_DECA_CHANNELS};
+    std::vector<integrate::bw_channel> channels(list, list + sizeof(list)
+                                                / sizeof(list[0]));
+    integrate::box region(lower, upper);
+    cache::hasher salt;
+    for (size_t c = 0; c < channels.size(); c++)
+      salt.add(uint64_t(channels[c].k)).add(channels[c].m2).add(channels[c].mw);
+    res = integrate_cached(model, integrate::multichannel(region, channels),
+                           region, opt, salt.value());
+#else
+    std::cerr << "normalization_integral: --channels needs MESON_DECA_CHANNELS "
+              << "in model.hpp.\n";
+    return 1;
+#endif
+  } else {
+    integrate::box region(lower, upper);
+    res = integrate_cached(model, region, region, opt, 0);
+  }
+
+  std::cout << "normalization_integral: " << res.n_points << " points ("
+            << res.n_valid << " inside the phase space), "
+            << parallel::num_threads() << " threads; "
+            << "max. relative error " << res.max_rel_error() << ".\n";
+
+  // A nan amplitude at a single point spoils its row and column of I
+  std::string f_name = opt.get("output", "normalization_integral.py");
+  int r = res.non_finite_resonance();
+  int b = background ? res.non_finite_background() : -1;
+  if (r >= 0 || b >= 0) {
+    std::cerr << "normalization_integral: I is not finite for ";
+    if (r >= 0)
+      std::cerr << "the resonance res_id = " << r + 1
+                << " (A_cv is nan or inf at some points)";
+    else
+      std::cerr << "the background component " << b + 1
+                << " (A_v_background_abs2 is nan or inf at some points)";
+    std::cerr << "; " << f_name << " not written.\n";
+    return 1;
+  }
+
+  std::ofstream f_py(f_name.c_str());
+  integrate::write_python(f_py, res, background);
+  return 0;
+}
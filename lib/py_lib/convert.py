@@ -1,5 +1,8 @@
 # Convert the output of the boost::python function to a usable form.
 
+import multiprocessing
+import os
+
 import numpy as np
 
 def ComplexVectorForm(vector_like_var):
@@ -41,3 +44,51 @@ def VectorForm(vector_like_var):
     """
     return np.asarray([vector_like_var[i] for i in range(vector_like_var.__len__())])
 
+
+
+def AmplitudesBatch(model, y):
+    """
+    Returns the complex (N, R) array of the amplitudes A_cv of the model
+    module at the N events y (array of shape (N, num_variables())),
+    computed by the buffer-based model.A_cv_batch without per-event
+    python objects.
+    """
+    y = np.ascontiguousarray(y, dtype=np.float64)
+    out = np.empty((y.shape[0], model.num_resonances()), dtype=np.complex128)
+    model.A_cv_batch(y, out)
+    return out
+
+
+def BackgroundBatch(model, y):
+    """
+    Returns the real (N, B) array of the background amplitudes
+    A_v_background_abs2 at the N events y (see AmplitudesBatch).
+    """
+    y = np.ascontiguousarray(y, dtype=np.float64)
+    out = np.empty((y.shape[0], model.num_background()), dtype=np.float64)
+    model.A_v_background_abs2_batch(y, out)
+    return out
+
+
+def PhaseSpaceBatch(model, y):
+    """
+    Returns the boolean array of shape (N,): whether the N events y lie
+    in the phase space of the model (see AmplitudesBatch).
+    """
+    y = np.ascontiguousarray(y, dtype=np.float64)
+    out = np.empty(y.shape[0], dtype=bool)
+    model.in_phase_space_batch(y, out)
+    return out
+
+
+def SetNumThreads(model, n_threads=None):
+    """
+    Sets the number of threads of the batch functions of the model
+    module (*Batch above). Default: MESON_DECA_NUM_THREADS if set, else
+    all cores. The native thread pool persists across calls.
+    """
+    if n_threads is None:
+        if 'MESON_DECA_NUM_THREADS' in os.environ:
+            return
+        n_threads = multiprocessing.cpu_count()
+    model.set_num_threads(n_threads)
@@ -40,6 +40,7 @@ import sys
 
 sys.path.insert(1, "../phys") 
 import particles
+import philox
 
 def blatt_weisskopf(J_R, r2_P, m2_ab, m_a, m_b = -1):
     """
@@ -205,18 +206,23 @@ def resonance_bw(m2_ab, m2_bc, A_R = 1.0,
 def uniform_dalitz_points(D, m2_p = particles.m2_d,
                              m2_a = particles.m2_pi,
                              m2_b = -1,
-                             m2_c = -1):
+                             m2_c = -1,
+                             seed = None):
     """
     Returns D points uniformely distributed over the Dalitz plot,
-    assuming the decay D -> 3pi.
+    assuming the decay D -> 3pi. The points are drawn from the Philox
+    streams of philox.py (seed=None: a new seed).
     """
+    if seed is None:
+        seed = philox.new_seed()
     d = 0 # Counter for points
+    k = 0 # Counter for tried points
     m2_ab_list = np.zeros(D, dtype=float) # Point coordinates
     m2_bc_list = np.zeros(D, dtype=float)
 
     while d < D:
-        m2_ab = np.random.uniform(0,3)
-        m2_bc = np.random.uniform(0,3)
+        m2_ab, m2_bc = 3. * philox.uniform(seed, k, 1, 2)[0]
+        k += 1
         if valid(m2_ab, m2_bc, m2_p, m2_a, m2_b, m2_c) == True:
             m2_ab_list[d] = m2_ab
             m2_bc_list[d] = m2_bc
@@ -1,6 +1,14 @@
 import numpy as np
 
-def integral(func, bounds, N=10000):
+import philox  # Counter-based random numbers
+
+# The random points of the functions below are drawn from the Philox
+# streams of philox.py (point k of the first estimate has the same
+# random numbers as point k of the native integrate::plain() with the
+# same seed; the second estimate uses round 1). seed=None draws a new
+# seed.
+
+def integral(func, bounds, N=10000, seed=None):
     """
     Compute a definite Monte Carlo integral.
 
@@ -16,6 +24,8 @@ def integral(func, bounds, N=10000):
         and upper limits of integration of i-th variable.
     N : int, optional
         2*N is the number of drawn samples.
+    seed : int, optional
+        Seed of the random points.
 
     Returns
     -------
@@ -28,23 +38,35 @@ def integral(func, bounds, N=10000):
     random_point = np.zeros(n_vars, dtype=float)
     total_volume = np.product([(bounds[i][1] - bounds[i][0]) for i in range(n_vars)])
 
-    res1 =  sum(__eval_integrate(func, bounds, N, n_vars)) \
+    if seed is None:
+        seed = philox.new_seed()
+
+    res1 =  sum(__eval_integrate(func, bounds, N, n_vars, seed, 0)) \
            / float(N) * total_volume
-    res2 =  sum(__eval_integrate(func, bounds, N, n_vars)) \
+    res2 =  sum(__eval_integrate(func, bounds, N, n_vars, seed, 1)) \
            / float(N) * total_volume
 
     return [(res1+res2)/2., np.abs(res1-res2)/2]
 
 
-def __eval_integrate(func, m, N_points, n_vars):
+def __points(m, num, n, n_vars, seed, round):
+    # The random points num, ..., num + n - 1 in the bounds m
+    low = np.asarray([m[i][0] for i in range(n_vars)], dtype=float)
+    high = np.asarray([m[i][1] for i in range(n_vars)], dtype=float)
+    return low + (high - low) * philox.uniform(seed, num, n, n_vars, round)
+
+
+def __eval_integrate(func, m, N_points, n_vars, seed, round):
     # Generator yielding func evaluated at N_points random points.
     num = 0
     while num < N_points:
-        yield func(*[np.random.uniform(m[i][0], m[i][1]) for i in range(n_vars)])
-        num += 1
+        n = min(4096, N_points - num)
+        for y in __points(m, num, n, n_vars, seed, round):
+            yield func(*y)
+        num += n
 
 
-def integral_A(func, bounds, N=1000000):
+def integral_A(func, bounds, N=1000000, seed=None):
     """
     Similar function, more oriented to our purposes.
 
@@ -56,19 +78,80 @@ def integral_A(func, bounds, N=1000000):
     random_point = np.zeros(n_vars, dtype=float)
     total_volume = np.product([(bounds[i][1] - bounds[i][0]) for i in range(n_vars)])
 
-    res1 =  sum(__eval_integrate_A(func, bounds, N, n_vars)) \
+    if seed is None:
+        seed = philox.new_seed()
+
+    res1 =  sum(__eval_integrate_A(func, bounds, N, n_vars, seed, 0)) \
            / float(N) * total_volume
-    res2 =  sum(__eval_integrate_A(func, bounds, N, n_vars)) \
+    res2 =  sum(__eval_integrate_A(func, bounds, N, n_vars, seed, 1)) \
            / float(N) * total_volume
 
     return [(res1+res2)/2., np.abs(res1-res2)/2]
 
-def __eval_integrate_A(func, m, N_points, n_vars):
+def __eval_integrate_A(func, m, N_points, n_vars, seed, round):
     # Generator yielding I for func evaluated at N_points random points,
     # as described above.
     num = 0
     while num < N_points:
-        A = func([np.random.uniform(m[i][0], m[i][1]) for i in range(n_vars)])
-        n_res = A.shape[0]
-        yield np.asarray([[np.conj(A[i1]) * A[i2] for i1 in range(n_res)] for i2 in range(n_res)])
-        num += 1
+        n = min(4096, N_points - num)
+        for y in __points(m, num, n, n_vars, seed, round):
+            A = func(list(y))
+            n_res = A.shape[0]
+            yield np.asarray([[np.conj(A[i1]) * A[i2] for i1 in range(n_res)] for i2 in range(n_res)])
+        num += n
+
+
+def integral_A_batch(func_batch, bounds, N=1000000, block=65536, seed=None):
+    """
+    As integral_A, for a function func_batch that takes an array of n
+    points (shape (n, n_vars)) and returns the complex (n, R) array of
+    their amplitudes, e.g. convert.AmplitudesBatch. The points are
+    drawn and evaluated in blocks of at most 'block' points.
+    """
+    n_vars = len(bounds)
+    low = np.asarray([bounds[i][0] for i in range(n_vars)], dtype=float)
+    high = np.asarray([bounds[i][1] for i in range(n_vars)], dtype=float)
+    total_volume = np.prod(high - low)
+    if seed is None:
+        seed = philox.new_seed()
+
+    res = []
+    for k in range(2):
+        S = 0
+        num = 0
+        while num < N:
+            n = min(block, N - num)
+            A = func_batch(low + (high - low) * philox.uniform(seed, num, n, n_vars, k))
+            # S[i2, i1] = sum conj(A[i1]) A[i2], as in integral_A
+            S = S + np.dot(A.T, np.conj(A))
+            num += n
+        res.append(S / float(N) * total_volume)
+
+    return [(res[0]+res[1])/2., np.abs(res[0]-res[1])/2]
+
+
+def integral_batch(func_batch, bounds, N=10000, block=65536, seed=None):
+    """
+    As integral, for a function func_batch that takes an array of n
+    points (shape (n, n_vars)) and returns an array of n values (or of
+    shape (n, B)).
+    """
+    n_vars = len(bounds)
+    low = np.asarray([bounds[i][0] for i in range(n_vars)], dtype=float)
+    high = np.asarray([bounds[i][1] for i in range(n_vars)], dtype=float)
+    total_volume = np.prod(high - low)
+    if seed is None:
+        seed = philox.new_seed()
+
+    res = []
+    for k in range(2):
+        S = 0
+        num = 0
+        while num < N:
+            n = min(block, N - num)
+            y = low + (high - low) * philox.uniform(seed, num, n, n_vars, k)
+            S = S + np.sum(func_batch(y), axis=0)
+            num += n
+        res.append(S / float(N) * total_volume)
+
+    return [(res[0]+res[1])/2., np.abs(res[0]-res[1])/2]
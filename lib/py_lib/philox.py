@@ -0,0 +1,88 @@
+import numpy as np
+
+# Counter-based random numbers, the numpy version of
+# lib/c_lib/rng/philox.hpp and lib/c_lib/rng/stream.hpp: point k of a
+# sampler is drawn from the Philox4x32-10 counters (j, k, round,
+# purpose) with the key seed, so the points of a range of k are the
+# same as in the native code and do not depend on the ranges before.
+
+# Purposes (rng::purpose)
+POINTS = 0
+TRAINING = 1
+ACCEPT_REJECT = 2
+SHIFTS = 3
+PROBES = 4
+
+_M0 = np.uint64(0xD2511F53)
+_M1 = np.uint64(0xCD9E8D57)
+_W0 = 0x9E3779B9
+_W1 = 0xBB67AE85
+_MASK = np.uint64(0xFFFFFFFF)
+
+
+def philox(c0, c1, c2, c3, k0, k1):
+    """
+    Philox4x32-10 of the counters (c0, c1, c2, c3) (arrays of the same
+    shape, or scalars) with the key (k0, k1). Returns the four words of
+    the blocks as uint64 arrays.
+    """
+    c0, c1, c2, c3 = [np.asarray(c, dtype=np.uint64) & _MASK
+                      for c in np.broadcast_arrays(c0, c1, c2, c3)]
+    k0 = int(k0) & 0xFFFFFFFF
+    k1 = int(k1) & 0xFFFFFFFF
+    for r in range(10):
+        p0 = _M0 * c0
+        p1 = _M1 * c2
+        c0, c1, c2, c3 = ((p1 >> np.uint64(32)) ^ c1 ^ np.uint64(k0),
+                          p1 & _MASK,
+                          (p0 >> np.uint64(32)) ^ c3 ^ np.uint64(k1),
+                          p0 & _MASK)
+        k0 = (k0 + _W0) & 0xFFFFFFFF
+        k1 = (k1 + _W1) & 0xFFFFFFFF
+    return c0, c1, c2, c3
+
+
+def _to_uniform(hi, lo):
+    # rng::to_uniform: 53 upper bits of hi:lo, in (0, 1)
+    x = ((hi << np.uint64(32)) | lo) >> np.uint64(11)
+    return (x.astype(float) + 0.5) * (1. / 9007199254740992.)
+
+
+def uniform(seed, k_begin, n, dim, round=0, purpose=POINTS):
+    """
+    The (n, dim) array of the uniform numbers of the points
+    k_begin, ..., k_begin + n - 1 (rng::uniform).
+    """
+    seed = int(seed)
+    k = np.arange(k_begin, k_begin + n, dtype=np.uint64)
+    u = np.empty((n, dim), dtype=float)
+    for j in range(0, (dim + 1) // 2):
+        b = philox(j, k, round, purpose, seed, seed >> 32)
+        u[:, 2 * j] = _to_uniform(b[0], b[1])
+        if 2 * j + 1 < dim:
+            u[:, 2 * j + 1] = _to_uniform(b[2], b[3])
+    return u
+
+
+def normal(seed, k_begin, n, dim, round=0, purpose=POINTS):
+    """
+    As uniform, standard normal numbers (rng::normal, Box-Muller).
+    """
+    seed = int(seed)
+    k = np.arange(k_begin, k_begin + n, dtype=np.uint64)
+    z = np.empty((n, dim), dtype=float)
+    for j in range(0, (dim + 1) // 2):
+        b = philox(j, k, round, purpose, seed, seed >> 32)
+        r = np.sqrt(-2. * np.log(_to_uniform(b[0], b[1])))
+        phi = 2. * np.pi * _to_uniform(b[2], b[3])
+        z[:, 2 * j] = r * np.cos(phi)
+        if 2 * j + 1 < dim:
+            z[:, 2 * j + 1] = r * np.sin(phi)
+    return z
+
+
+def new_seed():
+    """
+    A random 64-bit seed, for callers that pass seed=None.
+    """
+    return int(np.random.randint(0, 2**62))
@@ -7,46 +7,117 @@
 #include <boost/math/tools/promotion.hpp>
 
 #include <meson_deca/lib/c_lib/complex.hpp>
+#include <meson_deca/lib/c_lib/fct/valid_mask.hpp>
+#include <meson_deca/lib/c_lib/data.hpp>
+#include <meson_deca/lib/c_lib/likelihood.hpp>
 #include <meson_deca/lib/c_lib/structures/resonances.hpp>
 
 
-// These variables should be adjusted manually
-const int NUM_RES=8; // Number of PWA resonances
-const int NUM_VAR=5; // Number of independent masses (e.g., 2 for 3-body-decay)
+// The PWA amplitudes of the model, in the order of res_id = 1, 2, ...
+// (the only list to adjust; see structures/resonance_list.hpp)
+typedef resonances::resonance_list<resonances::event_4,
+  MESON_DECA_COMPONENT(resonances::D_a_rho_S_wave, 1),
+  MESON_DECA_COMPONENT(resonances::D_a_rho_S_wave, 2),
+  MESON_DECA_COMPONENT(resonances::D_a_rho_S_wave, 3),
+  MESON_DECA_COMPONENT(resonances::D_a_rho_S_wave, 4),
+  MESON_DECA_COMPONENT(resonances::D_a_rho_S_wave, 5),
+  MESON_DECA_COMPONENT(resonances::D_a_rho_S_wave, 6),
+  MESON_DECA_COMPONENT(resonances::D_a_rho_S_wave, 7),
+  MESON_DECA_COMPONENT(resonances::D_a_rho_S_wave, 8)> model_resonances;
+
+const int NUM_RES=model_resonances::size; // Number of PWA resonances
+const int NUM_VAR=model_resonances::num_variables; // Number of independent masses (e.g., 2 for 3-body-decay)
+
+// 4-body resonance whose particles define the phase space of the native
+// tools (lib/c_lib/tools, option --phase-space); 4-body models only.
+#define MESON_DECA_PHASE_SPACE resonances::D_a_rho_S_wave
 
 namespace stan {
   namespace math {
 
     /**
-     * complex_scalar A_c(vector)
+     * active_set& active_resonances()
+     *
+     * The resonances of the model that are switched on (all, unless
+     * MESON_DECA_ACTIVE_RESONANCES lists res_ids); A_cv, A_cm, f_model
+     * and Norm skip the others, see structures/active_resonances.hpp.
+     * Not STAN-callable.
+     */
+    inline resonances::active_set& active_resonances() {
+        static resonances::active_set active =
+          resonances::active_set::from_environment(NUM_RES);
+        return active;
+    }
+
+
+    /**
+     * event_4 event_context(vector)
+     *
+     * Kinematics of the event y shared by all resonances (validity,
+     * masses, breakup momenta, Zemach variables); see
+     * structures/four_body/kinematics.hpp.
+     *
+     * @tparam T0__ Scalar type of the data vector
+     */
+    template <typename T0__>
+    inline
+    resonances::event_4<typename boost::math::tools::promote_arg<T0__>::type>
+    event_context(const Eigen::Matrix<T0__, Eigen::Dynamic,1>& y) {
+        typedef typename boost::math::tools::promote_arg<T0__>::type T;
+        return resonances::event_4<T>(y(0,0), y(1,0), y(2,0), y(3,0), y(4,0),
+                                      resonances::d0_to_4pi);
+    }
+
+
+    /**
+     * complex_scalar A_cs(int, event_4)
+     *
+     * Returns the PWA amplitude of the resonance res_id for the event
+     * context e (see event_context).
+     *
+     * @tparam T Scalar type of the event
+     */
+    template <typename T>
+    inline
+    complex::complex_scalar<T>
+    A_cs(const int &res_id, const resonances::event_4<T>& e) {
+
+        return model_resonances::value(res_id - 1, e);
+    }
+
+
+    /**
+     * complex_scalar A_cs(int, vector)
      *
      * Takes the data vector y as an argument, returns the corresponding PWA 
      * amplitude (complex number). The number res_id tells, which resonance
      * to use.
      *
+     * This is the allocation-free version used inside C++; STAN sees A_c.
+     *
+     * @tparam T0__ Scalar type of the data vector
+     */
+    template <typename T0__>
+    inline
+    complex::complex_scalar<typename boost::math::tools::promote_arg<T0__>::type>
+    A_cs(const int &res_id, const Eigen::Matrix<T0__, Eigen::Dynamic,1>& y) {
+        return A_cs(res_id, event_context(y));
+    }
+
+
+    /**
+     * complex_scalar A_c(int, vector)
+     *
+     * STAN-callable version of A_cs; converts the result to an array
+     * of two reals.
+     *
      * @tparam T0__ Scalar type of the data vector
      */
     template <typename T0__>
     inline
     std::vector<typename boost::math::tools::promote_arg<T0__>::type>
     A_c(const int &res_id, const Eigen::Matrix<T0__, Eigen::Dynamic,1>& y) {
-
-        switch (res_id) {
-	// This resonance list must be adjusted manually
-        case 1: return resonances::D_a_rho_S_wave.value(1, y(0,0), y(1,0), y(2,0), y(3,0), y(4,0));
-        case 2: return resonances::D_a_rho_S_wave.value(2, y(0,0), y(1,0), y(2,0), y(3,0), y(4,0));
-        case 3: return resonances::D_a_rho_S_wave.value(3, y(0,0), y(1,0), y(2,0), y(3,0), y(4,0));
-        case 4: return resonances::D_a_rho_S_wave.value(4, y(0,0), y(1,0), y(2,0), y(3,0), y(4,0));
-        case 5: return resonances::D_a_rho_S_wave.value(5, y(0,0), y(1,0), y(2,0), y(3,0), y(4,0));
-        case 6: return resonances::D_a_rho_S_wave.value(6, y(0,0), y(1,0), y(2,0), y(3,0), y(4,0));
-        case 7: return resonances::D_a_rho_S_wave.value(7, y(0,0), y(1,0), y(2,0), y(3,0), y(4,0));
-        case 8: return resonances::D_a_rho_S_wave.value(8, y(0,0), y(1,0), y(2,0), y(3,0), y(4,0));
-
-        default: {
-            std::cout << "Fatal error: Unknown resonance occured.";
-            return complex::scalar::one(y(0,0)); // Dummy return
-        }
-        }
+        return complex::scalar::to_array(A_cs(res_id, y));
     }
 
 
@@ -54,7 +125,8 @@ namespace stan {
      * complex_vector A_cv(vector)
      *
      * Takes the data vector y as an argument, returns 
-     * complex vector [A(1,y) ... A(NUM_RES, y)] of PWA amplitudes.
+     * complex vector [A(1,y) ... A(NUM_RES, y)] of PWA amplitudes
+     * (0 for the inactive resonances, see active_resonances).
      */
     template <typename T0__>
     inline
@@ -65,22 +137,81 @@ namespace stan {
 
         // Somewhat convoluted initialization of the return
         std::vector<Eigen::Matrix<T2, Eigen::Dynamic, 1> > res(2, (Eigen::Matrix<T2,Eigen::Dynamic,1> (NUM_RES)));
-        for (int i = 0; i < NUM_RES; i++) {
-            std::vector<T0__> tmp;
-            tmp = A_c(i+1, y);
-            res[0](i) = tmp[0];
-            res[1](i) = tmp[1];
-        }
+        resonances::event_4<T2> e = event_context(y);
+        model_resonances::values(e, res[0].data(), res[1].data(),
+                                 active_resonances().mask());
         return res;
     }
 
 
+    /**
+     * void A_cm(const double* y, int D, split_matrix A)
+     *
+     * Batch version of A_cv for the D events y[d*NUM_VAR .. ]: computes
+     * the event contexts, then fills the NUM_RES x D matrix
+     * A(i, d) = A(i+1, y_d), one resonance at a time. Not STAN-callable;
+     * used by the native tools and the python wrapper.
+     */
+    inline
+    void A_cm(const double* y, int D, complex::split_matrix& A) {
+        A.resize(NUM_RES, D);
+        if (D == 0)
+            return;
+
+        // Event contexts, shared by the rows
+        std::vector<resonances::event_4<double> > e;
+        e.reserve(D);
+        for (int d = 0; d < D; d++) {
+            const double* x = y + d*NUM_VAR;
+            e.push_back(resonances::event_4<double>(x[0], x[1], x[2], x[3], x[4],
+                                                    resonances::d0_to_4pi));
+        }
+
+        model_resonances::fill(A, &e[0], active_resonances().mask());
+    }
+
+
+    /**
+     * bool in_phase_space(vector)
+     *
+     * Checks whether y lies in the energetically allowed region of the
+     * decay (A_cv vanishes outside of it). Not STAN-callable; used by
+     * the native tools in lib/c_lib/tools to skip A_cv there.
+     */
+    inline
+    bool in_phase_space(const Eigen::Matrix<double, Eigen::Dynamic, 1>& y) {
+      const resonances::P_R1d_R2cd_abcd& r = resonances::D_a_rho_S_wave;
+      return fct::valid_5d(y(0), y(1), y(2), y(3), y(4),
+                           r.P, r.a, r.b, r.c, r.d);
+    }
+
+    /**
+     * void in_phase_space(const double* y, int D, unsigned char* mask)
+     *
+     * Batch version of in_phase_space for the D events y[d*NUM_VAR .. ]:
+     * mask[d] = in_phase_space(y_d), computed by the branch-free kernel
+     * fct::valid_5d_mask. Not STAN-callable.
+     */
+    inline
+    void in_phase_space(const double* y, int D, unsigned char* mask) {
+      const resonances::P_R1d_R2cd_abcd& r = resonances::D_a_rho_S_wave;
+      std::vector<double> x(5 * D);
+      for (int d = 0; d < D; d++)
+        for (int v = 0; v < 5; v++)
+          x[v*D + d] = y[d*NUM_VAR + v];
+      if (D > 0)
+        fct::valid_5d_mask(&x[0], &x[D], &x[2*D], &x[3*D], &x[4*D], D,
+                           r.P, r.a, r.b, r.c, r.d, mask);
+    }
+
+
 
     /**
      *
      * double f_model(vector A_y[2], vector theta[2]
      *
      * Takes two comlex vectors, returns |A_y * theta|^2
+     * (sum over the active resonances, see active_mask)
      *
      */
     template <typename T0, typename T1>
@@ -89,10 +220,12 @@ namespace stan {
       const std::vector<Eigen::Matrix<T1, Eigen::Dynamic, 1> >& theta) {
 
       //typename boost::math::tools::promote_args<T0,T1>::type res = 0;
+      unsigned char buffer[NUM_RES];
+      const unsigned char* mask =
+        resonances::active_mask(active_resonances(), theta, buffer);
 
       return complex::scalar::abs2(
-               complex::vector::sum(
-                 complex::vector::mult(A_r, theta)));
+               complex::vector::mult_sum<NUM_RES>(A_r, theta, mask));
     }
 
 
@@ -102,32 +235,137 @@ namespace stan {
      *
      * Takes complex vector theta and complex matrix I,
      * returns conj(theta)' * I * theta.
+     *
+     * I is Hermitian, so only its upper triangle is used; the gradient
+     * w.r.t. theta is computed analytically (see likelihood/norm.hpp).
+     * The sum runs over the active resonances only (see active_mask):
+     * theta and I are restricted to them. I must be data.
      */
-    template <typename T0, typename T1>
-    typename boost::math::tools::promote_args<T0,T1>::type
+    template <typename T0>
+    inline
+    typename boost::math::tools::promote_args<T0>::type
     Norm(const std::vector<Eigen::Matrix<T0, Eigen::Dynamic, 1> >& theta,
-         const std::vector<Eigen::Matrix<T1, Eigen::Dynamic, Eigen::Dynamic> >& I) {
-
-      typename boost::math::tools::promote_args<T0,T1>::type res = 0;
-      // I * theta holder, real and imaginary part
-      typename boost::math::tools::promote_args<T0,T1>::type tmp[2];
-
-      for (int i = 0; i < NUM_RES; i++) {
-      for (int j = 0; j < NUM_RES; j++) {
-        // Complex multiplication
-        tmp[0] = I[0](i,j) * theta[0](j) - I[1](i,j) * theta[1](j);
-        tmp[1] = I[0](i,j) * theta[1](j) + I[1](i,j) * theta[0](j);
-          // Keep only the real palt of the product; imaginary part
-          // should be 0 (+- float calculation errors).
-          // Note that Re(conj(a)*b) = a[0] * b[0] + a[1] * b[1]
-        res = res + theta[0](i) * tmp[0] + theta[1](i) * tmp[1];
-        }
-      }
+         const std::vector<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> >& I) {
+      unsigned char buffer[NUM_RES];
+      const unsigned char* mask =
+        resonances::active_mask(active_resonances(), theta, buffer);
+      if (mask == 0)
+        return likelihood::norm_cv(theta, likelihood::pack(I));
+      return likelihood::norm_cv(likelihood::restrict(theta, mask),
+                                 likelihood::restrict(likelihood::pack(I), mask));
+    }
 
+
+    /**
+     *
+     * double Norm(vector theta[2], vector I_packed[2])
+     *
+     * As above, for I given in packed Hermitian storage (upper triangle
+     * row by row, vector[R*(R+1)/2] I_packed[2]; cf. pack_hermitian).
+     */
+    template <typename T0>
+    inline
+    typename boost::math::tools::promote_args<T0>::type
+    Norm(const std::vector<Eigen::Matrix<T0, Eigen::Dynamic, 1> >& theta,
+         const std::vector<Eigen::Matrix<double, Eigen::Dynamic, 1> >& I_packed) {
+      unsigned char buffer[NUM_RES];
+      const unsigned char* mask =
+        resonances::active_mask(active_resonances(), theta, buffer);
+      if (mask == 0)
+        return likelihood::norm_cv(theta, likelihood::pack(I_packed));
+      return likelihood::norm_cv(likelihood::restrict(theta, mask),
+                                 likelihood::restrict(likelihood::pack(I_packed), mask));
+    }
+
+
+    /**
+     *
+     * vector[R*(R+1)/2] pack_hermitian(matrix I[2])[2]
+     *
+     * Returns the upper triangle of the Hermitian part of I, row by row,
+     * as expected by the packed Norm overloads. Meant to be called once
+     * in the 'transformed data' block.
+     */
+    inline
+    std::vector<Eigen::Matrix<double, Eigen::Dynamic, 1> >
+    pack_hermitian(const std::vector<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> >& I) {
+      likelihood::packed_hermitian I_packed = likelihood::pack(I);
+      std::vector<Eigen::Matrix<double, Eigen::Dynamic, 1> > res(2);
+      res[0] = I_packed.re;
+      res[1] = I_packed.im;
       return res;
     }
 
 
+    /**
+     * double amplitude_log_likelihood(vector A_cv_data[D,2], 
+     *                                 vector theta[2], matrix I[2])
+     *
+     * Returns sum_d log(f_model(A_cv_data[d], theta) / Norm(theta, I))
+     * in one pass over the data. The gradient w.r.t. theta is computed
+     * analytically and attached to a single autodiff node, so no
+     * per-event expression graph is built (see likelihood.hpp). Like
+     * f_model and Norm, it sums over the active resonances only (see
+     * active_mask).
+     *
+     * A_cv_data and I must be data.
+     */
+    template <typename T1>
+    inline
+    typename boost::math::tools::promote_args<T1>::type
+    amplitude_log_likelihood(
+      const std::vector<std::vector<Eigen::Matrix<double, Eigen::Dynamic, 1> > >& A_cv_data,
+      const std::vector<Eigen::Matrix<T1, Eigen::Dynamic, 1> >& theta,
+      const std::vector<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> >& I) {
+      unsigned char buffer[NUM_RES];
+      const unsigned char* mask =
+        resonances::active_mask(active_resonances(), theta, buffer);
+      return likelihood::log_likelihood_cv(A_cv_data, theta,
+                                           likelihood::pack(I), mask);
+    }
+
+
+    /**
+     * int num_events()
+     *
+     * Number of events in the amplitude file (data::mapped_amplitudes,
+     * i.e. $MESON_DECA_AMPLITUDE_FILE or amplitudes.mdamp).
+     */
+    inline int num_events() {
+      return data::mapped_amplitudes().num_events();
+    }
+
+
+    /**
+     * double amplitude_file_log_likelihood(vector theta[2], matrix I[2])
+     *
+     * amplitude_log_likelihood for the events of the memory-mapped
+     * amplitude file instead of A_cv_data, which then need not be in
+     * the R dump. I must be data.
+     */
+    template <typename T1>
+    inline
+    typename boost::math::tools::promote_args<T1>::type
+    amplitude_file_log_likelihood(
+      const std::vector<Eigen::Matrix<T1, Eigen::Dynamic, 1> >& theta,
+      const std::vector<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> >& I) {
+
+      const data::amplitude_file& file = data::mapped_amplitudes();
+      likelihood::amplitude_view A = file.view();
+      if (A.R != NUM_RES || A.B != 0)
+        throw std::domain_error("amplitude_file_log_likelihood: "
+                                + file.path() + " does not match the model");
+
+      Eigen::Matrix<T1, Eigen::Dynamic, 1> theta_bkg(0);
+      Eigen::VectorXd I_bkg(0);
+      unsigned char buffer[NUM_RES];
+      const unsigned char* mask =
+        resonances::active_mask(active_resonances(), theta, buffer);
+      return likelihood::log_likelihood_cv(A, theta, likelihood::pack(I),
+                                           theta_bkg, I_bkg, mask);
+    }
+
+
     /**
      * int num_resonances()
      *
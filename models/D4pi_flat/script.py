@@ -24,7 +24,11 @@ def f_list(num):
     return [var_min + (var_max - var_min) * np.random.rand() for i in list(range(num))]
 
 x = np.linspace(0.0,8.0,100)
-z = np.asarray([[convert.ComplexVectorForm(model.A_cv( 5, [_x, y] + f_list(3) )) for _x in x] for y in x])
+# All grid points [_x, y] + f_list(3) in one batch call (z[j,i] at x[i], y = x[j])
+X, Y = np.meshgrid(x, x)
+y_grid = np.column_stack([X.ravel(), Y.ravel(), np.asarray([f_list(3) for i in range(X.size)])])
+convert.SetNumThreads(model)
+z = convert.AmplitudesBatch(model, y_grid).reshape(len(x), len(x), -1)
 
 z[np.isnan(z)] = 0.
 var_names = ['F_P','F_R_1','F_R_2','Z_1','Z_2','T_R_1','T_R_2','Total']
@@ -1,57 +1,132 @@
 #ifndef MESON_DECA__LIB__C_LIB__MODEL_HPP
 #define MESON_DECA__LIB__C_LIB__MODEL_HPP
 
+#include <memory> // std::unique_ptr
+#include <type_traits> // std::enable_if
 #include <vector>
 
 #include <stan/math/prim/mat/fun/Eigen.hpp>
 #include <boost/math/tools/promotion.hpp>
 
+#include <meson_deca/lib/c_lib/cache/columns.hpp>
 #include <meson_deca/lib/c_lib/complex.hpp>
+#include <meson_deca/lib/c_lib/fct/valid_mask.hpp>
+#include <meson_deca/lib/c_lib/likelihood.hpp>
 #include <meson_deca/lib/c_lib/structures/resonances.hpp>
 
 
-// These variables should be adjusted manually
-const int NUM_RES=7; // Number of PWA resonances
-const int NUM_VAR=2; // Number of independent masses (e.g., 2 for 3-body-decay)
+// The PWA resonances of the model, in the order of res_id = 1, 2, ...
+// (the only list to adjust; see structures/resonance_list.hpp)
+typedef resonances::resonance_list<resonances::event_3,
+  MESON_DECA_AB(resonances::flat_D3pi),
+  MESON_DECA_SYM(resonances::f0_980),
+  MESON_DECA_SYM(resonances::f0_600),
+  MESON_DECA_SYM(resonances::f0_1370),
+  MESON_DECA_SYM(resonances::f0_1500),
+  MESON_DECA_SYM(resonances::rho_770),
+  MESON_DECA_SYM(resonances::f2_1270)> model_resonances;
+
+const int NUM_RES=model_resonances::size; // Number of PWA resonances
+const int NUM_VAR=model_resonances::num_variables; // Number of independent masses (e.g., 2 for 3-body-decay)
+
+// Narrow resonances {variable, resonance} for the multi-channel sampling
+// of the native tools (lib/c_lib/tools, option --channels). The
+// amplitudes are symmetrized, so every peak appears in both variables.
+#define MESON_DECA_CHANNELS \
+  {0, resonances::rho_770}, {1, resonances::rho_770}, \
+  {0, resonances::f0_980}, {1, resonances::f0_980}, \
+  {0, resonances::f2_1270}, {1, resonances::f2_1270}
+
+// The resonance with floating mass and width in A_cv_events (res_id - 1)
+const int FLOATING_RES=5; // rho_770
+
+// Marks a model with A_cv_events (models/test/checks/check_column_cache.cpp)
+#define MESON_DECA_HAS_A_CV_EVENTS
 
 namespace stan {
   namespace math {
 
     /**
-     * complex_scalar A_c(vector)
+     * active_set& active_resonances()
      *
-     * Takes the data vector y as an argument, returns the corresponding PWA 
-     * amplitude (complex number). The number res_id tells, which resonance
-     * to use.
+     * The resonances of the model that are switched on (all, unless
+     * MESON_DECA_ACTIVE_RESONANCES lists res_ids); A_cv, A_cm, f_model
+     * and Norm skip the others, see structures/active_resonances.hpp.
+     * Not STAN-callable.
+     */
+    inline resonances::active_set& active_resonances() {
+        static resonances::active_set active =
+          resonances::active_set::from_environment(NUM_RES);
+        return active;
+    }
+
+
+    /**
+     * event_3 event_context(vector)
+     *
+     * Kinematics of the event y shared by all resonances (validity,
+     * masses, breakup momenta); see structures/three_body/kinematics.hpp.
      *
      * @tparam T0__ Scalar type of the data vector
      */
     template <typename T0__>
     inline
-    std::vector<typename boost::math::tools::promote_arg<T0__>::type>
-    A_c(const int &res_id, const Eigen::Matrix<T0__, Eigen::Dynamic,1>& y) {
-
-        switch (res_id) {
-	// This resonance list must be adjusted manually
-        case 1: return resonances::flat_D3pi.value(y(0,0), y(1,0));
+    resonances::event_3<typename boost::math::tools::promote_arg<T0__>::type>
+    event_context(const Eigen::Matrix<T0__, Eigen::Dynamic,1>& y) {
+        typedef typename boost::math::tools::promote_arg<T0__>::type T;
+        return resonances::event_3<T>(y(0,0), y(1,0), resonances::d_to_3pi);
+    }
 
-        case 2: return resonances::f0_980.value_sym(y(0,0), y(1,0));
 
-        case 3: return resonances::f0_600.value_sym(y(0,0), y(1,0));
+    /**
+     * complex_scalar A_cs(int, event_3)
+     *
+     * Returns the PWA amplitude of the resonance res_id for the event
+     * context e (see event_context).
+     *
+     * @tparam T Scalar type of the event
+     */
+    template <typename T>
+    inline
+    complex::complex_scalar<T>
+    A_cs(const int &res_id, const resonances::event_3<T>& e) {
 
-        case 4: return resonances::f0_1370.value_sym(y(0,0), y(1,0));
+        return model_resonances::value(res_id - 1, e);
+    }
 
-        case 5: return resonances::f0_1500.value_sym(y(0,0), y(1,0));
 
-        case 6: return resonances::rho_770.value_sym(y(0,0), y(1,0));
+    /**
+     * complex_scalar A_cs(int, vector)
+     *
+     * Takes the data vector y as an argument, returns the corresponding PWA 
+     * amplitude (complex number). The number res_id tells, which resonance
+     * to use.
+     *
+     * This is the allocation-free version used inside C++; STAN sees A_c.
+     *
+     * @tparam T0__ Scalar type of the data vector
+     */
+    template <typename T0__>
+    inline
+    complex::complex_scalar<typename boost::math::tools::promote_arg<T0__>::type>
+    A_cs(const int &res_id, const Eigen::Matrix<T0__, Eigen::Dynamic,1>& y) {
+        return A_cs(res_id, event_context(y));
+    }
 
-        case 7: return resonances::f2_1270.value_sym(y(0,0), y(1,0));
 
-        default: {
-            std::cout << "Fatal error: Unknown resonance occured.";
-            return complex::scalar::one(y(0,0)); // Dummy return
-        }
-        }
+    /**
+     * complex_scalar A_c(int, vector)
+     *
+     * STAN-callable version of A_cs; converts the result to an array
+     * of two reals.
+     *
+     * @tparam T0__ Scalar type of the data vector
+     */
+    template <typename T0__>
+    inline
+    std::vector<typename boost::math::tools::promote_arg<T0__>::type>
+    A_c(const int &res_id, const Eigen::Matrix<T0__, Eigen::Dynamic,1>& y) {
+        return complex::scalar::to_array(A_cs(res_id, y));
     }
 
 
@@ -59,7 +134,8 @@ namespace stan {
      * complex_vector A_cv(vector)
      *
      * Takes the data vector y as an argument, returns 
-     * complex vector [A(1,y) ... A(NUM_RES, y)] of PWA amplitudes.
+     * complex vector [A(1,y) ... A(NUM_RES, y)] of PWA amplitudes
+     * (0 for the inactive resonances, see active_resonances).
      */
     template <typename T0__>
     inline
@@ -70,15 +146,187 @@ namespace stan {
 
         // Somewhat convoluted initialization of the return
         std::vector<Eigen::Matrix<T2, Eigen::Dynamic, 1> > res(2, (Eigen::Matrix<T2,Eigen::Dynamic,1> (NUM_RES)));
-        for (int i = 0; i < NUM_RES; i++) {
-            std::vector<T0__> tmp;
-            tmp = A_c(i+1, y);
-            res[0](i) = tmp[0];
-            res[1](i) = tmp[1];
+        resonances::event_3<T2> e = event_context(y);
+        model_resonances::values(e, res[0].data(), res[1].data(),
+                                 active_resonances().mask());
+        return res;
+    }
+
+
+    /**
+     * void A_cm(const double* y, int D, split_matrix A)
+     *
+     * Batch version of A_cv for the D events y[d*NUM_VAR .. ]: computes
+     * the event contexts, then fills the NUM_RES x D matrix
+     * A(i, d) = A(i+1, y_d), one resonance at a time. Not STAN-callable;
+     * used by the native tools and the python wrapper.
+     */
+    inline
+    void A_cm(const double* y, int D, complex::split_matrix& A) {
+        A.resize(NUM_RES, D);
+        if (D == 0)
+            return;
+
+        // Event contexts, shared by the rows
+        std::vector<resonances::event_3<double> > e;
+        e.reserve(D);
+        for (int d = 0; d < D; d++)
+            e.push_back(resonances::event_3<double>(y[d*NUM_VAR], y[d*NUM_VAR + 1],
+                                                    resonances::d_to_3pi));
+
+        model_resonances::fill(A, &e[0], active_resonances().mask());
+    }
+
+
+    /**
+     * event_columns
+     *
+     * The events of A_cv_events with their invariants (see
+     * structures/three_body/invariants.hpp) and the cache of their
+     * amplitude columns. Not STAN-callable.
+     */
+    struct event_columns {
+        std::vector<double> y; // y[d*NUM_VAR + v]
+        resonances::invariants_3 inv;
+        cache::column_cache columns;
+
+        explicit event_columns(const std::vector<double>& _y) :
+            y(_y), inv(&y[0], y.size() / NUM_VAR, resonances::d_to_3pi),
+            columns(NUM_RES) {};
+    };
+
+
+    /**
+     * event_columns& A_cv_events_cache(vector[] y)
+     *
+     * The event_columns of the events y (D > 0), kept between the calls;
+     * rebuilt with an empty cache if y differs from the events of the
+     * previous call (STAN passes the same data at every gradient
+     * evaluation). Its columns.hits() and columns.misses() count the
+     * lookups. Not STAN-callable.
+     */
+    inline event_columns&
+    A_cv_events_cache(const std::vector<Eigen::Matrix<double, Eigen::Dynamic, 1> >& y) {
+        static std::unique_ptr<event_columns> cached;
+        std::vector<double> flat(y.size() * NUM_VAR);
+        for (size_t d = 0; d < y.size(); d++)
+            for (int v = 0; v < NUM_VAR; v++)
+                flat[d*NUM_VAR + v] = y[d](v);
+        if (!cached || cached->y != flat)
+            cached.reset(new event_columns(flat));
+        return *cached;
+    }
+
+
+    /**
+     * void A_cv_events_fixed(event_columns, r, A)
+     *
+     * A[d] = A(r+1, y_d) of the events of c, with the fixed parameters
+     * of the resonance. Not STAN-callable.
+     */
+    inline void
+    A_cv_events_fixed(const event_columns& c, int r,
+                      complex::complex_scalar<double>* A) {
+        int D = c.inv.size;
+        for (int d = 0; d < D; d++)
+            A[d] = model_resonances::value(r, resonances::event_3<double>(
+              c.y[d*NUM_VAR], c.y[d*NUM_VAR + 1], resonances::d_to_3pi));
+    }
+
+
+    /**
+     * vector[] A_cv_events(vector[] y, vector lineshape)
+     *
+     * Returns the amplitudes A_cv(y[d]) of the events y in the layout
+     * vector[NUM_RES] A_cv_data[D,2], with the mass and the width of
+     * FLOATING_RES (rho_770) given by the (autodiff) parameters
+     * lineshape = [M, W] in place of the fixed ones.
+     *
+     * The columns A_r(y_1 .. y_D) come from cache::column_cache (see
+     * A_cv_events_cache), keyed on the parameter values of their
+     * resonance: the fixed resonances are computed once for the events,
+     * the floating one once per new [M, W], so a leapfrog step that
+     * returns to a known point (e.g. after a rejected proposal) costs no
+     * amplitude evaluations. The gradient w.r.t. lineshape is analytic
+     * (breit_wigner::partials), so lineshape must be double or var.
+     */
+    template <typename T1__>
+    inline
+    typename std::enable_if<likelihood::precomputed<T1__>::value,
+      std::vector<std::vector<Eigen::Matrix<T1__, Eigen::Dynamic, 1> > > >::type
+    A_cv_events(const std::vector<Eigen::Matrix<double, Eigen::Dynamic, 1> >& y,
+                const Eigen::Matrix<T1__, Eigen::Dynamic, 1>& lineshape) {
+
+        int D = y.size();
+        std::vector<std::vector<Eigen::Matrix<T1__, Eigen::Dynamic, 1> > > res(D,
+          std::vector<Eigen::Matrix<T1__, Eigen::Dynamic, 1> >(2,
+            Eigen::Matrix<T1__, Eigen::Dynamic, 1>::Zero(NUM_RES)));
+        if (D == 0)
+            return res;
+
+        event_columns& c = A_cv_events_cache(y);
+        const resonances::invariants_3& inv = c.inv;
+        std::vector<T1__> none, params(2);
+        params[0] = lineshape(0);
+        params[1] = lineshape(1);
+
+        std::vector<complex::complex_scalar<T1__> > A(D);
+        for (int r = 0; r < NUM_RES; r++) {
+            if (!active_resonances().contains(r))
+                continue;
+            if (r == FLOATING_RES)
+                cache::column(c.columns, r, params, D,
+                  [&](const double* p, complex::complex_scalar<double>* A_r,
+                      complex::complex_scalar<double>* dA_r) {
+                    resonances::rho_770.partials(inv.ab, p[0], p[1], A_r, dA_r, false);
+                    resonances::rho_770.partials(inv.cb, p[0], p[1], A_r, dA_r, true);
+                  }, &A[0]);
+            else
+                cache::column(c.columns, r, none, D,
+                  [&](const double*, complex::complex_scalar<double>* A_r,
+                      complex::complex_scalar<double>*) {
+                    A_cv_events_fixed(c, r, A_r);
+                  }, &A[0]);
+            for (int d = 0; d < D; d++) {
+                res[d][0](r) = A[d].re;
+                res[d][1](r) = A[d].im;
+            }
         }
         return res;
     }
 
+    /**
+     * bool in_phase_space(vector)
+     *
+     * Checks whether y lies in the energetically allowed region of the
+     * decay (A_cv vanishes outside of it). Not STAN-callable; used by
+     * the native tools in lib/c_lib/tools to skip A_cv there.
+     */
+    inline
+    bool in_phase_space(const Eigen::Matrix<double, Eigen::Dynamic, 1>& y) {
+      return fct::valid(y(0), y(1), particles::d, particles::pi,
+                        particles::pi, particles::pi);
+    }
+
+    /**
+     * void in_phase_space(const double* y, int D, unsigned char* mask)
+     *
+     * Batch version of in_phase_space for the D events y[d*NUM_VAR .. ]:
+     * mask[d] = in_phase_space(y_d), computed by the branch-free kernel
+     * fct::valid_mask. Not STAN-callable.
+     */
+    inline
+    void in_phase_space(const double* y, int D, unsigned char* mask) {
+      std::vector<double> m2_ab(D), m2_bc(D);
+      for (int d = 0; d < D; d++) {
+        m2_ab[d] = y[d*NUM_VAR];
+        m2_bc[d] = y[d*NUM_VAR + 1];
+      }
+      if (D > 0)
+        fct::valid_mask(&m2_ab[0], &m2_bc[0], D, particles::d, particles::pi,
+                        particles::pi, particles::pi, mask);
+    }
+
 
 
     /**
@@ -86,6 +334,7 @@ namespace stan {
      * double f_model(vector A_y[2], vector theta[2]
      *
      * Takes two comlex vectors, returns |A_y * theta|^2
+     * (sum over the active resonances, see active_mask)
      *
      */
     template <typename T0, typename T1>
@@ -94,10 +343,12 @@ namespace stan {
       const std::vector<Eigen::Matrix<T1, Eigen::Dynamic, 1> >& theta) {
 
       //typename boost::math::tools::promote_args<T0,T1>::type res = 0;
+      unsigned char buffer[NUM_RES];
+      const unsigned char* mask =
+        resonances::active_mask(active_resonances(), theta, buffer);
 
       return complex::scalar::abs2(
-               complex::vector::sum(
-                 complex::vector::mult(A_r, theta)));
+               complex::vector::mult_sum<NUM_RES>(A_r, theta, mask));
     }
 
 
@@ -106,30 +357,53 @@ namespace stan {
      * double Norm(vector theta[2], matrix I[2])
      *
      * Takes complex vector theta and complex matrix I,
-     * returns conj(theta)' * I * theta.
+     * returns conj(theta)' * I * theta (sum over the active resonances).
+     *
+     * I is Hermitian, so only its upper triangle is used; the gradient
+     * w.r.t. theta is computed analytically (see likelihood/norm.hpp).
+     * I must be data.
      */
-    template <typename T0, typename T1>
-    typename boost::math::tools::promote_args<T0,T1>::type
+    template <typename T0>
+    inline
+    typename boost::math::tools::promote_args<T0>::type
     Norm(const std::vector<Eigen::Matrix<T0, Eigen::Dynamic, 1> >& theta,
-         const std::vector<Eigen::Matrix<T1, Eigen::Dynamic, Eigen::Dynamic> >& I) {
-
-      typename boost::math::tools::promote_args<T0,T1>::type res = 0;
-      // I * theta holder, real and imaginary part
-      typename boost::math::tools::promote_args<T0,T1>::type tmp[2];
-
-      for (int i = 0; i < NUM_RES; i++) {
-      for (int j = 0; j < NUM_RES; j++) {
-        // Complex multiplication
-        tmp[0] = I[0](i,j) * theta[0](j) - I[1](i,j) * theta[1](j);
-        tmp[1] = I[0](i,j) * theta[1](j) + I[1](i,j) * theta[0](j);
-          // Keep only the real palt of the product; imaginary part
-          // should be 0 (+- float calculation errors).
-          // Note that Re(conj(a)*b) = a[0] * b[0] + a[1] * b[1]
-        res = res + theta[0](i) * tmp[0] + theta[1](i) * tmp[1];
-        }
-      }
+         const std::vector<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> >& I) {
+      // Inactive resonances and, for constant theta, zero couplings
+      unsigned char buffer[NUM_RES];
+      const unsigned char* mask =
+        resonances::active_mask(active_resonances(), theta, buffer);
+      if (mask == 0)
+        return likelihood::norm_cv(theta, likelihood::pack(I));
+      return likelihood::norm_cv(likelihood::restrict(theta, mask),
+                                 likelihood::restrict(likelihood::pack(I), mask));
+    }
 
-      return res;
+
+    /**
+     * double amplitude_log_likelihood(vector A_cv_data[D,2], 
+     *                                 vector theta[2], matrix I[2])
+     *
+     * Returns sum_d log(f_model(A_cv_data[d], theta) / Norm(theta, I))
+     * in one pass over the data. The gradient w.r.t. theta is computed
+     * analytically and attached to a single autodiff node, so no
+     * per-event expression graph is built (see likelihood.hpp). Like
+     * f_model and Norm, it sums over the active resonances only (see
+     * active_mask).
+     *
+     * A_cv_data and I must be data.
+     */
+    template <typename T1>
+    inline
+    typename boost::math::tools::promote_args<T1>::type
+    amplitude_log_likelihood(
+      const std::vector<std::vector<Eigen::Matrix<double, Eigen::Dynamic, 1> > >& A_cv_data,
+      const std::vector<Eigen::Matrix<T1, Eigen::Dynamic, 1> >& theta,
+      const std::vector<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> >& I) {
+      unsigned char buffer[NUM_RES];
+      const unsigned char* mask =
+        resonances::active_mask(active_resonances(), theta, buffer);
+      return likelihood::log_likelihood_cv(A_cv_data, theta,
+                                           likelihood::pack(I), mask);
     }
 
 
@@ -7,53 +7,147 @@
 #include <boost/math/tools/promotion.hpp>
 
 #include <meson_deca/lib/c_lib/complex.hpp>
+#include <meson_deca/lib/c_lib/data.hpp>
+#include <meson_deca/lib/c_lib/fct/valid_mask.hpp>
+#include <meson_deca/lib/c_lib/likelihood.hpp>
 #include <meson_deca/lib/c_lib/real.hpp>
 #include <meson_deca/lib/c_lib/structures/resonances.hpp>
 
 
-// These variables should be adjusted manually
-const int NUM_RES=7; // Number of PWA resonances
-const int NUM_VAR=2; // Number of independent masses (e.g., 2 for 3-body-decay)
-const int NUM_BCKGR=2; // Number of background amplitudes
+// The PWA resonances of the model, in the order of res_id = 1, 2, ...
+// (the only list to adjust; see structures/resonance_list.hpp)
+typedef resonances::resonance_list<resonances::event_3,
+  MESON_DECA_AB(resonances::flat_D3pi),
+  MESON_DECA_SYM(resonances::f0_980),
+  MESON_DECA_SYM(resonances::f0_600),
+  MESON_DECA_SYM(resonances::f0_1370),
+  MESON_DECA_SYM(resonances::f0_1500),
+  MESON_DECA_SYM(resonances::rho_770),
+  MESON_DECA_SYM(resonances::f2_1270)> model_resonances;
+
+// The background amplitudes, in the order of res_id = 1, 2, ...
+typedef resonances::resonance_list<resonances::event_3,
+  MESON_DECA_AB(resonances::flat_D3pi),
+  MESON_DECA_SYM(resonances::rho_770)> model_background;
+
+const int NUM_RES=model_resonances::size; // Number of PWA resonances
+const int NUM_VAR=model_resonances::num_variables; // Number of independent masses (e.g., 2 for 3-body-decay)
+const int NUM_BCKGR=model_background::size; // Number of background amplitudes
+
+// Marks a model with incoherent background (f_model, Norm and
+// amplitude_log_likelihood with background arguments, num_background);
+// build_tools.sh and py_wrapper/setup.py then define MESON_DECA_BACKGROUND.
+#define MESON_DECA_HAS_BACKGROUND
+
+// Narrow resonances {variable, resonance} for the multi-channel sampling
+// of the native tools (lib/c_lib/tools, option --channels). The
+// amplitudes are symmetrized, so every peak appears in both variables.
+#define MESON_DECA_CHANNELS \
+  {0, resonances::rho_770}, {1, resonances::rho_770}, \
+  {0, resonances::f0_980}, {1, resonances::f0_980}, \
+  {0, resonances::f2_1270}, {1, resonances::f2_1270}
 
 namespace stan {
   namespace math {
 
     /**
-     * complex_scalar A_c(vector)
+     * active_set& active_resonances()
      *
-     * Takes the data vector y as an argument, returns the corresponding PWA 
-     * amplitude (complex number). The number res_id tells, which resonance
-     * to use.
+     * The resonances of the model that are switched on (all, unless
+     * MESON_DECA_ACTIVE_RESONANCES lists res_ids); A_cv, A_cm, f_model
+     * and Norm skip the others, see structures/active_resonances.hpp.
+     * Not STAN-callable.
+     */
+    inline resonances::active_set& active_resonances() {
+        static resonances::active_set active =
+          resonances::active_set::from_environment(NUM_RES);
+        return active;
+    }
+
+
+    /**
+     * event_3 event_context(vector)
+     *
+     * Kinematics of the event y shared by all resonances (validity,
+     * masses, breakup momenta); see structures/three_body/kinematics.hpp.
      *
      * @tparam T0__ Scalar type of the data vector
      */
     template <typename T0__>
+    inline
+    resonances::event_3<typename boost::math::tools::promote_arg<T0__>::type>
+    event_context(const Eigen::Matrix<T0__, Eigen::Dynamic,1>& y) {
+        typedef typename boost::math::tools::promote_arg<T0__>::type T;
+        return resonances::event_3<T>(y(0,0), y(1,0), resonances::d_to_3pi);
+    }
+
+
+    /**
+     * complex_scalar A_cs(int, event_3)
+     *
+     * Returns the PWA amplitude of the resonance res_id for the event
+     * context e (see event_context).
+     *
+     * @tparam T Scalar type of the event
+     */
+    template <typename T>
     //inline
-    std::vector<typename boost::math::tools::promote_arg<T0__>::type>
-    A_c(const int &res_id, const Eigen::Matrix<T0__, Eigen::Dynamic,1>& y) {
+    complex::complex_scalar<T>
+    A_cs(const int &res_id, const resonances::event_3<T>& e) {
 
-        switch (res_id) {
-	// This resonance list must be adjusted manually
-        case 1: return resonances::flat_D3pi.value(y(0,0), y(1,0));
+        return model_resonances::value(res_id - 1, e);
+    }
 
-        case 2: return resonances::f0_980.value_sym(y(0,0), y(1,0));
 
-        case 3: return resonances::f0_600.value_sym(y(0,0), y(1,0));
+    /**
+     * complex_scalar A_cs(int, vector)
+     *
+     * Takes the data vector y as an argument, returns the corresponding PWA 
+     * amplitude (complex number). The number res_id tells, which resonance
+     * to use.
+     *
+     * This is the allocation-free version used inside C++; STAN sees A_c.
+     *
+     * @tparam T0__ Scalar type of the data vector
+     */
+    template <typename T0__>
+    //inline
+    complex::complex_scalar<typename boost::math::tools::promote_arg<T0__>::type>
+    A_cs(const int &res_id, const Eigen::Matrix<T0__, Eigen::Dynamic,1>& y) {
+        return A_cs(res_id, event_context(y));
+    }
 
-        case 4: return resonances::f0_1370.value_sym(y(0,0), y(1,0));
 
-        case 5: return resonances::f0_1500.value_sym(y(0,0), y(1,0));
+    /**
+     * complex_scalar A_c(int, vector)
+     *
+     * STAN-callable version of A_cs; converts the result to an array
+     * of two reals.
+     *
+     * @tparam T0__ Scalar type of the data vector
+     */
+    template <typename T0__>
+    //inline
+    std::vector<typename boost::math::tools::promote_arg<T0__>::type>
+    A_c(const int &res_id, const Eigen::Matrix<T0__, Eigen::Dynamic,1>& y) {
+        return complex::scalar::to_array(A_cs(res_id, y));
+    }
 
-        case 6: return resonances::rho_770.value_sym(y(0,0), y(1,0));
 
-        case 7: return resonances::f2_1270.value_sym(y(0,0), y(1,0));
+    /**
+     * complex_scalar A_c_background(int, event_3)
+     *
+     * Returns the background amplitude res_id (complex number) for the
+     * event context e (see event_context).
+     *
+     * @tparam T Scalar type of the event
+     */
+    template <typename T>
+    //inline
+    complex::complex_scalar<T>
+    A_c_background(const int &res_id, const resonances::event_3<T>& e) {
 
-        default: {
-            std::cout << "Fatal error: Unknown resonance occured.";
-            return complex::scalar::one(y(0,0)); // Dummy return
-        }
-        }
+        return model_background::value(res_id - 1, e);
     }
 
 
@@ -69,21 +163,10 @@ namespace stan {
      */
     template <typename T0__>
     //inline
-    std::vector<typename boost::math::tools::promote_arg<T0__>::type>
+    complex::complex_scalar<typename boost::math::tools::promote_arg<T0__>::type>
     A_c_background(const int &res_id, const Eigen::Matrix<T0__, 
 		   Eigen::Dynamic,1>& y) {
-
-        switch (res_id) {
-	// This resonance list must be adjusted manually
-        case 1: return resonances::flat_D3pi.value(y(0,0), y(1,0));
-
-        case 2: return resonances::rho_770.value_sym(y(0,0), y(1,0));
-
-        default: {
-            std::cout << "Fatal error: Unknown resonance occured.";
-            return complex::scalar::one(y(0,0)); // Dummy return
-        }
-        }
+        return A_c_background(res_id, event_context(y));
     }
 
 
@@ -91,7 +174,8 @@ namespace stan {
      * complex_vector A_cv(vector)
      *
      * Takes the data vector y as an argument, returns 
-     * complex vector [A(1,y) ... A(NUM_RES, y)] of PWA amplitudes.
+     * complex vector [A(1,y) ... A(NUM_RES, y)] of PWA amplitudes
+     * (0 for the inactive resonances, see active_resonances).
      */
     template <typename T0__>
     //inline
@@ -102,16 +186,71 @@ namespace stan {
 
         // Somewhat convoluted initialization of the return
         std::vector<Eigen::Matrix<T2, Eigen::Dynamic, 1> > res(2, (Eigen::Matrix<T2,Eigen::Dynamic,1> (NUM_RES)));
-        for (int i = 0; i < NUM_RES; i++) {
-            std::vector<T0__> tmp;
-            tmp = A_c(i+1, y);
-            res[0](i) = tmp[0];
-            res[1](i) = tmp[1];
-        }
+        resonances::event_3<T2> e = event_context(y);
+        model_resonances::values(e, res[0].data(), res[1].data(),
+                                 active_resonances().mask());
         return res;
     }
 
 
+    /**
+     * void A_cm(const double* y, int D, split_matrix A)
+     *
+     * Batch version of A_cv for the D events y[d*NUM_VAR .. ]: computes
+     * the event contexts, then fills the NUM_RES x D matrix
+     * A(i, d) = A(i+1, y_d), one resonance at a time. Not STAN-callable;
+     * used by the native tools and the python wrapper.
+     */
+    inline
+    void A_cm(const double* y, int D, complex::split_matrix& A) {
+        A.resize(NUM_RES, D);
+        if (D == 0)
+            return;
+
+        // Event contexts, shared by the rows
+        std::vector<resonances::event_3<double> > e;
+        e.reserve(D);
+        for (int d = 0; d < D; d++)
+            e.push_back(resonances::event_3<double>(y[d*NUM_VAR], y[d*NUM_VAR + 1],
+                                                    resonances::d_to_3pi));
+
+        model_resonances::fill(A, &e[0], active_resonances().mask());
+    }
+
+
+    /**
+     * bool in_phase_space(vector)
+     *
+     * Checks whether y lies in the energetically allowed region of the
+     * decay (A_cv vanishes outside of it). Not STAN-callable; used by
+     * the native tools in lib/c_lib/tools to skip A_cv there.
+     */
+    inline
+    bool in_phase_space(const Eigen::Matrix<double, Eigen::Dynamic, 1>& y) {
+      return fct::valid(y(0), y(1), particles::d, particles::pi,
+                        particles::pi, particles::pi);
+    }
+
+    /**
+     * void in_phase_space(const double* y, int D, unsigned char* mask)
+     *
+     * Batch version of in_phase_space for the D events y[d*NUM_VAR .. ]:
+     * mask[d] = in_phase_space(y_d), computed by the branch-free kernel
+     * fct::valid_mask. Not STAN-callable.
+     */
+    inline
+    void in_phase_space(const double* y, int D, unsigned char* mask) {
+      std::vector<double> m2_ab(D), m2_bc(D);
+      for (int d = 0; d < D; d++) {
+        m2_ab[d] = y[d*NUM_VAR];
+        m2_bc[d] = y[d*NUM_VAR + 1];
+      }
+      if (D > 0)
+        fct::valid_mask(&m2_ab[0], &m2_bc[0], D, particles::d, particles::pi,
+                        particles::pi, particles::pi, mask);
+    }
+
+
     /**
      * vector A_v_background_abs2(vector)
      *
@@ -127,8 +266,11 @@ namespace stan {
         typedef typename boost::math::tools::promote_args<T0__>::type T2;
 
 	Eigen::Matrix<T2, Eigen::Dynamic, 1> res(NUM_BCKGR);
+        resonances::event_3<T2> e = event_context(y);
+        Eigen::Matrix<T2, NUM_BCKGR, 1> re, im;
+        model_background::values(e, re.data(), im.data());
         for (int i = 0; i < NUM_BCKGR; i++) {
-	  res(i) = complex::scalar::abs2(A_c_background(i+1, y));
+	  res(i) = complex::scalar::abs2(complex::complex_scalar<T2>(re(i), im(i)));
         }
         return res;
     }
@@ -141,6 +283,7 @@ namespace stan {
      *
      * Takes four comlex vectors, returns 
      *  |A_y * theta|^2 + A_y_background_abs2 * theta_background_abs2)
+     *  (coherent sum over the active resonances, see active_mask)
      *
      */
     template <typename T1, typename T2, typename T3, typename T4>
@@ -151,12 +294,14 @@ namespace stan {
 	    const Eigen::Matrix<T4, Eigen::Dynamic, 1>& theta_background_abs2_) {
 
       //typename boost::math::tools::promote_args<T0,T1>::type res = 0;
+      unsigned char buffer[NUM_RES];
+      const unsigned char* mask =
+        resonances::active_mask(active_resonances(), theta, buffer);
 
       return 
 	// Sum coherent amplitudes
 	complex::scalar::abs2(
-          complex::vector::sum(
-	    complex::vector::mult(A_r, theta)))
+          complex::vector::mult_sum<NUM_RES>(A_r, theta, mask))
 
 	// Add background
 	// Use STAN vector dot multiplication.
@@ -172,34 +317,136 @@ namespace stan {
      * Takes complex vector theta and complex matrix I, real vectors
      * theta_background_abs2_, I_background_abs2_,
      * returns 
-     *   conj(theta)' * I * theta + theta_background_abs2_ * I_background_abs2_.
+     *   conj(theta)' * I * theta + theta_background_abs2_ * I_background_abs2_
+     * (first term summed over the active resonances).
+     *
+     * I is Hermitian, so only its upper triangle is used; the gradient
+     * w.r.t. theta and theta_background_abs2_ is computed analytically
+     * (see likelihood/norm.hpp). I and I_background_abs2_ must be data.
      */
-    template <typename T0, typename T1, typename T2, typename T3>
-    typename boost::math::tools::promote_args<T0,T1,T2,T3>::type
+    template <typename T0, typename T2>
+    inline
+    typename boost::math::tools::promote_args<T0,T2>::type
     Norm(const std::vector<Eigen::Matrix<T0, Eigen::Dynamic, 1> >& theta,
-         const std::vector<Eigen::Matrix<T1, Eigen::Dynamic, Eigen::Dynamic> >& I,
+         const std::vector<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> >& I,
 	 const Eigen::Matrix<T2, Eigen::Dynamic, 1>& theta_background_abs2_,
-	 const Eigen::Matrix<T3, Eigen::Dynamic, 1>& I_background_abs2_) {
-
-      typename boost::math::tools::promote_args<T0,T1>::type res = 0;
-      // I * theta holder, real and imaginary part
-      typename boost::math::tools::promote_args<T0,T1>::type tmp[2];
-
-      for (int i = 0; i < NUM_RES; i++) {
-      for (int j = 0; j < NUM_RES; j++) {
-        // Complex multiplication
-        tmp[0] = I[0](i,j) * theta[0](j) - I[1](i,j) * theta[1](j);
-        tmp[1] = I[0](i,j) * theta[1](j) + I[1](i,j) * theta[0](j);
-          // Keep only the real palt of the product; imaginary part
-          // should be 0 (+- float calculation errors).
-          // Note that Re(conj(a)*b) = a[0] * b[0] + a[1] * b[1]
-        res = res + theta[0](i) * tmp[0] + theta[1](i) * tmp[1];
-        }
-      }
+	 const Eigen::Matrix<double, Eigen::Dynamic, 1>& I_background_abs2_) {
+      // Inactive resonances and, for constant theta, zero couplings
+      unsigned char buffer[NUM_RES];
+      const unsigned char* mask =
+        resonances::active_mask(active_resonances(), theta, buffer);
+      if (mask == 0)
+        return likelihood::norm_cv(theta, likelihood::pack(I),
+                                   theta_background_abs2_, I_background_abs2_);
+      return likelihood::norm_cv(likelihood::restrict(theta, mask),
+                                 likelihood::restrict(likelihood::pack(I), mask),
+                                 theta_background_abs2_, I_background_abs2_);
+    }
 
-      res = res + real::vector::mult(theta_background_abs2_,I_background_abs2_);
 
-      return res;
+    /**
+     * double amplitude_log_likelihood(vector A_cv_data[D,2], 
+     *                                 vector theta[2], matrix I[2])
+     *
+     * Returns sum_d log(f_model(A_cv_data[d], theta) / Norm(theta, I))
+     * in one pass over the data. The gradient w.r.t. theta is computed
+     * analytically and attached to a single autodiff node, so no
+     * per-event expression graph is built (see likelihood.hpp). Like
+     * f_model and Norm, it sums over the active resonances only (see
+     * active_mask).
+     *
+     * A_cv_data and I must be data.
+     */
+    template <typename T1>
+    inline
+    typename boost::math::tools::promote_args<T1>::type
+    amplitude_log_likelihood(
+      const std::vector<std::vector<Eigen::Matrix<double, Eigen::Dynamic, 1> > >& A_cv_data,
+      const std::vector<Eigen::Matrix<T1, Eigen::Dynamic, 1> >& theta,
+      const std::vector<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> >& I) {
+      unsigned char buffer[NUM_RES];
+      const unsigned char* mask =
+        resonances::active_mask(active_resonances(), theta, buffer);
+      return likelihood::log_likelihood_cv(A_cv_data, theta,
+                                           likelihood::pack(I), mask);
+    }
+
+
+    /**
+     * double amplitude_log_likelihood(vector A_cv_data[D,2], 
+     *                                 vector theta[2], matrix I[2],
+     *                                 vector A_v_background_abs2_data[D],
+     *                                 vector theta_background_abs2,
+     *                                 vector I_background_abs2)
+     *
+     * As above, with the incoherently summed background (cf. f_model
+     * and Norm with background arguments).
+     *
+     * A_cv_data, I, A_v_background_abs2_data and I_background_abs2
+     * must be data.
+     */
+    template <typename T1, typename T2>
+    inline
+    typename boost::math::tools::promote_args<T1,T2>::type
+    amplitude_log_likelihood(
+      const std::vector<std::vector<Eigen::Matrix<double, Eigen::Dynamic, 1> > >& A_cv_data,
+      const std::vector<Eigen::Matrix<T1, Eigen::Dynamic, 1> >& theta,
+      const std::vector<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> >& I,
+      const std::vector<Eigen::Matrix<double, Eigen::Dynamic, 1> >& A_v_background_abs2_data,
+      const Eigen::Matrix<T2, Eigen::Dynamic, 1>& theta_background_abs2,
+      const Eigen::Matrix<double, Eigen::Dynamic, 1>& I_background_abs2) {
+      unsigned char buffer[NUM_RES];
+      const unsigned char* mask =
+        resonances::active_mask(active_resonances(), theta, buffer);
+      return likelihood::log_likelihood_cv(A_cv_data, theta, likelihood::pack(I),
+                                           A_v_background_abs2_data,
+                                           theta_background_abs2,
+                                           I_background_abs2, mask);
+    }
+
+
+    /**
+     * int num_events()
+     *
+     * Number of events in the amplitude file (data::mapped_amplitudes,
+     * i.e. $MESON_DECA_AMPLITUDE_FILE or amplitudes.mdamp).
+     */
+    inline int num_events() {
+      return data::mapped_amplitudes().num_events();
+    }
+
+
+    /**
+     * double amplitude_file_log_likelihood(vector theta[2], matrix I[2],
+     *                                      vector theta_background_abs2,
+     *                                      vector I_background_abs2)
+     *
+     * amplitude_log_likelihood with background for the events of the
+     * memory-mapped amplitude file instead of A_cv_data and
+     * A_v_background_abs2_data, which then need not be in the R dump.
+     * I and I_background_abs2 must be data.
+     */
+    template <typename T1, typename T2>
+    inline
+    typename boost::math::tools::promote_args<T1,T2>::type
+    amplitude_file_log_likelihood(
+      const std::vector<Eigen::Matrix<T1, Eigen::Dynamic, 1> >& theta,
+      const std::vector<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> >& I,
+      const Eigen::Matrix<T2, Eigen::Dynamic, 1>& theta_background_abs2,
+      const Eigen::Matrix<double, Eigen::Dynamic, 1>& I_background_abs2) {
+
+      const data::amplitude_file& file = data::mapped_amplitudes();
+      likelihood::amplitude_view A = file.view();
+      if (A.R != NUM_RES || A.B != NUM_BCKGR)
+        throw std::domain_error("amplitude_file_log_likelihood: "
+                                + file.path() + " does not match the model");
+
+      unsigned char buffer[NUM_RES];
+      const unsigned char* mask =
+        resonances::active_mask(active_resonances(), theta, buffer);
+      return likelihood::log_likelihood_cv(A, theta, likelihood::pack(I),
+                                           theta_background_abs2,
+                                           I_background_abs2, mask);
     }
 
 
@@ -0,0 +1,131 @@
+// check_column_cache.cpp
+//   A_cv_events (floating lineshape parameters through
+//   cache::column_cache) against A_cv at the fixed parameters, its
+//   gradient against finite differences, and the cache hits of a
+//   sequence of gradient evaluations as in HMC: leapfrog steps along a
+//   trajectory and returns to points evaluated before.
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include <stan/math/rev/mat.hpp>
+#include <meson_deca/lib/c_lib/model.hpp>
+
+#ifdef MESON_DECA_HAS_A_CV_EVENTS
+
+using stan::math::var;
+
+typedef std::vector<Eigen::Matrix<double, Eigen::Dynamic, 1> > events;
+
+// sum_d log f_model(A_cv_events(y, lineshape)[d], theta)
+template <typename T>
+T log_f_sum(const events& y, const Eigen::Matrix<T, Eigen::Dynamic, 1>& lineshape,
+            const std::vector<Eigen::VectorXd>& theta) {
+  std::vector<std::vector<Eigen::Matrix<T, Eigen::Dynamic, 1> > > A
+    = stan::math::A_cv_events(y, lineshape);
+  T res = 0;
+  for (size_t d = 0; d < A.size(); d++)
+    res += log(stan::math::f_model(A[d], theta));
+  return res;
+}
+
+
+int main() {
+  // Events on a grid inside the Dalitz plot
+  events y;
+  for (int i = 1; i < 40; i++) {
+    for (int j = 1; j < 40; j++) {
+      Eigen::VectorXd e(2);
+      e << 3.5 * i / 40, 3.5 * j / 40;
+      if (stan::math::in_phase_space(e))
+        y.push_back(e);
+    }
+  }
+  std::vector<Eigen::VectorXd> theta(2, Eigen::VectorXd(NUM_RES));
+  for (int r = 0; r < NUM_RES; r++) {
+    theta[0](r) = cos(0.5 * r);
+    theta[1](r) = sin(0.5 * r);
+  }
+
+  const resonances::breit_wigner& rho = resonances::rho_770;
+  Eigen::VectorXd p(2);
+  p << rho.R.m, rho.W;
+
+  // Values at the fixed parameters
+  std::vector<std::vector<Eigen::VectorXd> > A = stan::math::A_cv_events(y, p);
+  double max_diff = 0;
+  for (size_t d = 0; d < y.size(); d++) {
+    std::vector<Eigen::VectorXd> A_d = stan::math::A_cv(y[d]);
+    for (int c = 0; c < 2; c++)
+      max_diff = std::max(max_diff, (A_d[c] - A[d][c]).cwiseAbs().maxCoeff());
+  }
+
+  // Gradient w.r.t. (M, W)
+  Eigen::Matrix<var, Eigen::Dynamic, 1> p_var(2);
+  p_var << p(0), p(1);
+  var L = log_f_sum(y, p_var, theta);
+  stan::math::grad(L.vi_);
+  double max_grad_diff = 0;
+  for (int k = 0; k < 2; k++) {
+    const double h = 1e-6;
+    Eigen::VectorXd p_plus = p, p_minus = p;
+    p_plus(k) += h;
+    p_minus(k) -= h;
+    double fd = (log_f_sum(y, p_plus, theta) - log_f_sum(y, p_minus, theta)) / (2 * h);
+    max_grad_diff = std::max(max_grad_diff,
+                             std::fabs(p_var(k).adj() - fd) / std::max(1., std::fabs(fd)));
+  }
+  stan::math::recover_memory();
+
+  // Four leapfrog steps, then the rejected proposal returns to the start
+  cache::column_cache& columns = stan::math::A_cv_events_cache(y).columns;
+  columns.clear();
+  columns.reset_counts();
+  const double steps[][2] = {{0.770, 0.150}, {0.772, 0.151}, {0.774, 0.152},
+                             {0.776, 0.153}, {0.770, 0.150}};
+  const int n_steps = 5;
+  for (int s = 0; s < n_steps; s++) {
+    Eigen::Matrix<var, Eigen::Dynamic, 1> q(2);
+    q << steps[s][0], steps[s][1];
+    var L_s = log_f_sum(y, q, theta);
+    stan::math::grad(L_s.vi_);
+    stan::math::recover_memory();
+  }
+  // One miss per fixed column, one per new (M, W): the start is evicted
+  // by the later steps (two slots), so the return misses as well
+  long expected_misses = (NUM_RES - 1) + n_steps;
+  long expected_hits = long(NUM_RES) * n_steps - expected_misses;
+  bool ok_steps = columns.hits() == expected_hits
+    && columns.misses() == expected_misses;
+
+  std::cout << "  " << y.size() << " events: max |A_cv_events - A_cv| " << max_diff
+            << ", gradient vs finite differences " << max_grad_diff << "\n"
+            << "  " << n_steps << " gradient evaluations: " << columns.hits()
+            << " hits, " << columns.misses() << " misses (expected "
+            << expected_hits << ", " << expected_misses << ")\n";
+
+  // A return to the previous step finds all columns in the cache
+  columns.reset_counts();
+  Eigen::Matrix<var, Eigen::Dynamic, 1> q(2);
+  q << steps[n_steps - 2][0], steps[n_steps - 2][1];
+  var L_q = log_f_sum(y, q, theta);
+  stan::math::grad(L_q.vi_);
+  stan::math::recover_memory();
+  std::cout << "  return to the previous step: " << columns.hits() << " hits, "
+            << columns.misses() << " misses\n";
+
+  bool ok = max_diff < 1e-12 && max_grad_diff < 1e-5 && ok_steps
+    && columns.misses() == 0 && columns.hits() == NUM_RES;
+  columns.reset_counts();
+  return ok ? 0 : 1;
+}
+
+#else
+
+int main() {
+  std::cout << "  skipped: the model has no A_cv_events\n";
+  return 0;
+}
+
+#endif
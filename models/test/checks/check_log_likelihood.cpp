@@ -0,0 +1,132 @@
+// check_log_likelihood.cpp
+//   The fused amplitude_log_likelihood against the naive sum of
+//   log(f_model / Norm) over the same events (cf.
+//   models/test/D4pi_flat/amplitude_log_likelihood.stan): value and
+//   gradient w.r.t. theta (and the background couplings), with all
+//   resonances and with a part of them switched on (active_resonances).
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include <stan/math/rev/mat.hpp>
+#include <meson_deca/lib/c_lib/model.hpp>
+
+using stan::math::var;
+
+typedef Eigen::Matrix<var, Eigen::Dynamic, 1> vector_var;
+
+
+// Deterministic events and couplings; I = mean of conj(A_d) A_d^T
+struct sample {
+  std::vector<std::vector<Eigen::VectorXd> > A;
+  std::vector<Eigen::MatrixXd> I;
+  std::vector<Eigen::VectorXd> theta;
+  std::vector<Eigen::VectorXd> A_bkg;
+  Eigen::VectorXd I_bkg, theta_bkg;
+
+  sample(int R, int B, int D) :
+    A(D, std::vector<Eigen::VectorXd>(2, Eigen::VectorXd(R))),
+    I(2, Eigen::MatrixXd::Zero(R, R)), theta(2, Eigen::VectorXd(R)),
+    A_bkg(D, Eigen::VectorXd(B)), I_bkg(Eigen::VectorXd::Zero(B)),
+    theta_bkg(B) {
+    for (int d = 0; d < D; d++) {
+      for (int i = 0; i < R; i++) {
+        A[d][0](i) = cos(d + 0.7 * i);
+        A[d][1](i) = sin(2 * d - 0.3 * i);
+      }
+      for (int b = 0; b < B; b++)
+        A_bkg[d](b) = 1.1 + sin(3 * d + b);
+      I[0] += (A[d][0] * A[d][0].transpose() + A[d][1] * A[d][1].transpose()) / D;
+      I[1] += (A[d][0] * A[d][1].transpose() - A[d][1] * A[d][0].transpose()) / D;
+      I_bkg += A_bkg[d] / D;
+    }
+    for (int i = 0; i < R; i++) {
+      theta[0](i) = 0.5 + 0.1 * i;
+      theta[1](i) = 0.2 - 0.05 * i;
+    }
+    for (int b = 0; b < B; b++)
+      theta_bkg(b) = 0.3 + 0.1 * b;
+  }
+};
+
+
+// Log-likelihood of s, fused or as the naive sum
+var log_likelihood(const sample& s, const std::vector<vector_var>& theta,
+                   const vector_var& theta_bkg, bool fused) {
+  var res = 0;
+#ifdef MESON_DECA_HAS_BACKGROUND
+  if (fused)
+    return stan::math::amplitude_log_likelihood(s.A, theta, s.I, s.A_bkg,
+                                                theta_bkg, s.I_bkg);
+  var N = stan::math::Norm(theta, s.I, theta_bkg, s.I_bkg);
+  for (size_t d = 0; d < s.A.size(); d++)
+    res += log(stan::math::f_model(s.A[d], theta, s.A_bkg[d], theta_bkg) / N);
+#else
+  (void) theta_bkg; // Empty
+  if (fused)
+    return stan::math::amplitude_log_likelihood(s.A, theta, s.I);
+  var N = stan::math::Norm(theta, s.I);
+  for (size_t d = 0; d < s.A.size(); d++)
+    res += log(stan::math::f_model(s.A[d], theta) / N);
+#endif
+  return res;
+}
+
+
+// Largest difference of value and gradient, relative to max(1, |naive|)
+double compare(const sample& s) {
+  int R = s.theta[0].rows(), B = s.theta_bkg.rows();
+  std::vector<double> result[2];
+  for (int fused = 0; fused < 2; fused++) {
+    std::vector<vector_var> theta(2, vector_var(R));
+    vector_var theta_bkg(B);
+    for (int c = 0; c < 2; c++)
+      for (int i = 0; i < R; i++)
+        theta[c](i) = s.theta[c](i);
+    for (int b = 0; b < B; b++)
+      theta_bkg(b) = s.theta_bkg(b);
+
+    var L = log_likelihood(s, theta, theta_bkg, fused);
+    stan::math::grad(L.vi_);
+    result[fused].push_back(L.val());
+    for (int c = 0; c < 2; c++)
+      for (int i = 0; i < R; i++)
+        result[fused].push_back(theta[c](i).adj());
+    for (int b = 0; b < B; b++)
+      result[fused].push_back(theta_bkg(b).adj());
+    stan::math::recover_memory();
+  }
+
+  double res = 0;
+  for (size_t k = 0; k < result[0].size(); k++)
+    res = std::max(res, std::fabs(result[1][k] - result[0][k])
+                          / std::max(1., std::fabs(result[0][k])));
+  return res;
+}
+
+
+int main() {
+  int R = NUM_RES, D = 1000;
+#ifdef MESON_DECA_HAS_BACKGROUND
+  int B = NUM_BCKGR;
+#else
+  int B = 0;
+#endif
+  sample s(R, B, D);
+
+  double all = compare(s);
+
+  // Every second resonance switched on (res_id = 1, 3, ...)
+  std::vector<int> res_ids;
+  for (int i = 1; i <= R; i += 2)
+    res_ids.push_back(i);
+  stan::math::active_resonances().set(res_ids);
+  double part = compare(s);
+  stan::math::active_resonances().set_all();
+
+  std::cout << "  " << D << " events, largest relative difference of value"
+            << " and gradient: " << all << " (all resonances), " << part
+            << " (every second one)\n";
+  return all < 1e-10 && part < 1e-10 ? 0 : 1;
+}
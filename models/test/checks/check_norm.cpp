@@ -0,0 +1,115 @@
+// check_norm.cpp
+//   likelihood::norm_cv on the packed normalization matrix: the value
+//   against conj(theta)' I theta with the full matrix, the analytic
+//   gradient w.r.t. theta and theta_bkg against finite differences,
+//   and the error for a theta that does not match I.
+
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include <stan/math/rev/mat.hpp>
+#include <meson_deca/lib/c_lib/likelihood.hpp>
+
+using stan::math::var;
+
+typedef Eigen::Matrix<var, Eigen::Dynamic, 1> vector_var;
+
+
+// conj(theta)' I theta + theta_bkg . I_bkg with the full matrix I
+double norm_full(const std::vector<Eigen::VectorXd>& theta,
+                 const std::vector<Eigen::MatrixXd>& I,
+                 const Eigen::VectorXd& theta_bkg, const Eigen::VectorXd& I_bkg) {
+  int R = theta[0].rows();
+  double res = theta_bkg.dot(I_bkg);
+  for (int i = 0; i < R; i++) {
+    for (int j = 0; j < R; j++) {
+      // Re(conj(t_i) I_ij t_j)
+      double a_re = theta[0](i) * theta[0](j) + theta[1](i) * theta[1](j);
+      double a_im = theta[0](i) * theta[1](j) - theta[1](i) * theta[0](j);
+      res += a_re * I[0](i,j) - a_im * I[1](i,j);
+    }
+  }
+  return res;
+}
+
+
+int main() {
+  const int R = 7, B = 2;
+
+  // Hermitian I = X X^H with a deterministic complex X
+  Eigen::MatrixXd X_re(R, R), X_im(R, R);
+  for (int i = 0; i < R; i++) {
+    for (int j = 0; j < R; j++) {
+      X_re(i,j) = cos(1.3 * i + 0.4 * j);
+      X_im(i,j) = sin(0.7 * i - 1.1 * j);
+    }
+  }
+  std::vector<Eigen::MatrixXd> I(2);
+  I[0] = X_re * X_re.transpose() + X_im * X_im.transpose();
+  I[1] = X_im * X_re.transpose() - X_re * X_im.transpose();
+  Eigen::VectorXd I_bkg(B);
+  I_bkg << 0.8, 1.7;
+  likelihood::packed_hermitian I_packed = likelihood::pack(I);
+
+  std::vector<Eigen::VectorXd> theta(2, Eigen::VectorXd(R));
+  for (int i = 0; i < R; i++) {
+    theta[0](i) = 0.4 - 0.1 * i;
+    theta[1](i) = 0.3 * cos(i);
+  }
+  Eigen::VectorXd theta_bkg(B);
+  theta_bkg << 0.5, 0.25;
+
+  double value_diff = std::fabs(
+    likelihood::norm_cv(theta, I_packed, theta_bkg, I_bkg)
+    - norm_full(theta, I, theta_bkg, I_bkg));
+
+  // Analytic gradient
+  std::vector<vector_var> theta_var(2, vector_var(R));
+  vector_var theta_bkg_var(B);
+  for (int c = 0; c < 2; c++)
+    for (int i = 0; i < R; i++)
+      theta_var[c](i) = theta[c](i);
+  for (int b = 0; b < B; b++)
+    theta_bkg_var(b) = theta_bkg(b);
+  var N = likelihood::norm_cv(theta_var, I_packed, theta_bkg_var, I_bkg);
+  stan::math::grad(N.vi_);
+
+  // Finite differences (N is quadratic, so central differences are exact
+  // up to rounding)
+  const double h = 1e-5;
+  double grad_diff = 0;
+  for (int k = 0; k < 2 * R + B; k++) {
+    std::vector<Eigen::VectorXd> t_plus = theta, t_minus = theta;
+    Eigen::VectorXd b_plus = theta_bkg, b_minus = theta_bkg;
+    double adj;
+    if (k < 2 * R) {
+      t_plus[k / R](k % R) += h;
+      t_minus[k / R](k % R) -= h;
+      adj = theta_var[k / R](k % R).adj();
+    } else {
+      b_plus(k - 2 * R) += h;
+      b_minus(k - 2 * R) -= h;
+      adj = theta_bkg_var(k - 2 * R).adj();
+    }
+    double fd = (likelihood::norm_cv(t_plus, I_packed, b_plus, I_bkg)
+                 - likelihood::norm_cv(t_minus, I_packed, b_minus, I_bkg)) / (2 * h);
+    grad_diff = std::max(grad_diff, std::fabs(adj - fd));
+  }
+  stan::math::recover_memory();
+
+  // theta of the wrong size
+  bool thrown = false;
+  try {
+    std::vector<Eigen::VectorXd> theta_short(2, Eigen::VectorXd::Zero(R - 1));
+    likelihood::norm_cv(theta_short, I_packed);
+  } catch (const std::domain_error& e) {
+    thrown = true;
+  }
+
+  std::cout << "  R = " << R << ", B = " << B << ": value difference " << value_diff
+            << ", gradient vs finite differences " << grad_diff
+            << ", size mismatch " << (thrown ? "rejected" : "NOT rejected") << "\n";
+  return value_diff < 1e-12 && grad_diff < 1e-7 && thrown ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+// check_partials.cpp
+//   The analytic parameter derivatives of the lineshapes against
+//   central finite differences: fct::breit_wigner::value_partials and
+//   relativistic_width_partials (J = 0, 1, 2), fct::flatte::value_partials,
+//   and the column kernels breit_wigner::partials and flatte::partials of
+//   resonances.hpp (symmetrized, on the invariants of a grid of events).
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include <stan/math/rev/mat.hpp>
+#include <meson_deca/lib/c_lib/structures/resonances.hpp>
+
+using complex::complex_scalar;
+
+const double h = 1e-6;
+
+double max_error = 0;
+
+// Records the difference of an analytic and a numerical derivative,
+// relative to max(1, |numerical|)
+void compare(const complex_scalar<double>& analytic,
+             const complex_scalar<double>& plus,
+             const complex_scalar<double>& minus, double step) {
+  double fd_re = (plus.re - minus.re) / (2 * step);
+  double fd_im = (plus.im - minus.im) / (2 * step);
+  max_error = std::max(max_error, std::fabs(analytic.re - fd_re) / std::max(1., std::fabs(fd_re)));
+  max_error = std::max(max_error, std::fabs(analytic.im - fd_im) / std::max(1., std::fabs(fd_im)));
+}
+
+
+int main() {
+  const double m_pi = particles::pi.m;
+
+  // Points of m2_ab across the rho and f0 peaks
+  std::vector<double> m2_ab;
+  for (int k = 1; k < 60; k++)
+    m2_ab.push_back(4 * m_pi * m_pi + 0.05 * k);
+
+  // Breit-Wigner propagator and running width
+  const double M = 0.775, W = 0.149, r = 1.5;
+  for (size_t k = 0; k < m2_ab.size(); k++) {
+    double s = m2_ab[k], m_ab = sqrt(s);
+    double p2_ab = fct::breakup_momentum::p2(s, m_pi, m_pi);
+
+    complex_scalar<double> d_M, d_W;
+    fct::breit_wigner::value_partials(M, s, W, d_M, d_W);
+    compare(d_M, fct::breit_wigner::value(M + h, s, W),
+            fct::breit_wigner::value(M - h, s, W), h);
+    compare(d_W, fct::breit_wigner::value(M, s, W + h),
+            fct::breit_wigner::value(M, s, W - h), h);
+
+    for (int J = 0; J <= 2; J++) {
+      double w_M, w_W;
+      fct::breit_wigner::relativistic_width_partials(M, W, J, r, m_ab, p2_ab,
+                                                     m_pi, m_pi, w_M, w_W);
+      compare(complex_scalar<double>(w_M, 0.),
+        complex_scalar<double>(fct::breit_wigner::relativistic_width(
+          M + h, W, J, r, m_ab, p2_ab, m_pi, m_pi), 0.),
+        complex_scalar<double>(fct::breit_wigner::relativistic_width(
+          M - h, W, J, r, m_ab, p2_ab, m_pi, m_pi), 0.), h);
+      compare(complex_scalar<double>(w_W, 0.),
+        complex_scalar<double>(fct::breit_wigner::relativistic_width(
+          M, W + h, J, r, m_ab, p2_ab, m_pi, m_pi), 0.),
+        complex_scalar<double>(fct::breit_wigner::relativistic_width(
+          M, W - h, J, r, m_ab, p2_ab, m_pi, m_pi), 0.), h);
+    }
+
+    // Flatte propagator (above and below the K K threshold)
+    const double M_f = 0.98, gpp = 0.329, gkk = 0.658;
+    complex_scalar<double> f_M, f_gpp, f_gkk;
+    fct::flatte::value_partials(M_f, s, m_ab, p2_ab, gpp, gkk, f_M, f_gpp, f_gkk);
+    compare(f_M, fct::flatte::value(M_f + h, s, m_ab, p2_ab, gpp, gkk),
+            fct::flatte::value(M_f - h, s, m_ab, p2_ab, gpp, gkk), h);
+    compare(f_gpp, fct::flatte::value(M_f, s, m_ab, p2_ab, gpp + h, gkk),
+            fct::flatte::value(M_f, s, m_ab, p2_ab, gpp - h, gkk), h);
+    compare(f_gkk, fct::flatte::value(M_f, s, m_ab, p2_ab, gpp, gkk + h),
+            fct::flatte::value(M_f, s, m_ab, p2_ab, gpp, gkk - h), h);
+  }
+  double max_error_fct = max_error;
+  max_error = 0;
+
+  // Column kernels on a grid of events of D -> 3 pi
+  std::vector<double> y;
+  for (int i = 1; i < 30; i++) {
+    for (int j = 1; j < 30; j++) {
+      double s = 3.5 * i / 30, t = 3.5 * j / 30;
+      if (fct::valid(s, t, particles::d, particles::pi, particles::pi,
+                     particles::pi)) {
+        y.push_back(s);
+        y.push_back(t);
+      }
+    }
+  }
+  int D = y.size() / 2;
+  resonances::invariants_3 inv(&y[0], D, resonances::d_to_3pi);
+
+  // rho_770.partials: dA[2 d + i] = d A_d / d (M, W)[i]
+  const resonances::breit_wigner& rho = resonances::rho_770;
+  std::vector<complex_scalar<double> > A(D), dA(2 * D), A_plus(D), A_minus(D);
+  double p[2] = {rho.R.m, rho.W};
+  rho.partials(inv.ab, p[0], p[1], &A[0], &dA[0], false);
+  rho.partials(inv.cb, p[0], p[1], &A[0], &dA[0], true);
+  for (int i = 0; i < 2; i++) {
+    double q[2] = {p[0], p[1]};
+    q[i] = p[i] + h;
+    rho.values_sym(inv, q[0], q[1], &A_plus[0]);
+    q[i] = p[i] - h;
+    rho.values_sym(inv, q[0], q[1], &A_minus[0]);
+    for (int d = 0; d < D; d++)
+      compare(dA[2 * d + i], A_plus[d], A_minus[d], h);
+  }
+
+  // f0_980.partials: dA[3 d + i] = d A_d / d (M, gpp, gkk)[i]
+  const resonances::flatte& f0 = resonances::f0_980;
+  std::vector<complex_scalar<double> > dA_f(3 * D);
+  double g[3] = {f0.R.m, f0.G_pp, f0.G_kk};
+  f0.partials(inv.ab, g[0], g[1], g[2], &A[0], &dA_f[0], false);
+  f0.partials(inv.cb, g[0], g[1], g[2], &A[0], &dA_f[0], true);
+  for (int i = 0; i < 3; i++) {
+    double q[3] = {g[0], g[1], g[2]};
+    q[i] = g[i] + h;
+    f0.values_sym(inv, q[0], q[1], q[2], &A_plus[0]);
+    q[i] = g[i] - h;
+    f0.values_sym(inv, q[0], q[1], q[2], &A_minus[0]);
+    for (int d = 0; d < D; d++)
+      compare(dA_f[3 * d + i], A_plus[d], A_minus[d], h);
+  }
+
+  std::cout << "  largest relative difference to finite differences: "
+            << max_error_fct << " (fct), " << max_error
+            << " (column kernels, " << D << " events)\n";
+  return max_error_fct < 1e-5 && max_error < 1e-5 ? 0 : 1;
+}
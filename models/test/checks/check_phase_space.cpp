@@ -0,0 +1,110 @@
+// check_phase_space.cpp
+//   Integrates a small smooth model, A_0 = 1 and A_1 = m2_12 + i m2_23,
+//   over the phase space of the current 4-body model once with GENBOD
+//   events (integrate::phase_space) and once with uniform points in the
+//   enclosing box (fct::valid_5d deciding what is inside). Both must
+//   agree within errors: a point map with a wrong density, or a
+//   phase space check accepting unphysical points, shows up as a
+//   difference of many standard deviations.
+
+#include <cmath>
+#include <iostream>
+
+#include <meson_deca/lib/c_lib/integrate.hpp>
+#include <meson_deca/lib/c_lib/model.hpp>
+
+#ifdef MESON_DECA_PHASE_SPACE
+
+// The amplitude model expected by integrate::plain (cf. tools::model_amplitudes)
+struct small_model {
+  const resonances::resonance_base_4& r;
+
+  explicit small_model(const resonances::resonance_base_4& _r) : r(_r) {};
+
+  int num_resonances() const { return 2; }
+  int num_background() const { return 0; }
+
+  bool in_phase_space(const Eigen::VectorXd& y) const {
+    return fct::valid_5d(y(0), y(1), y(2), y(3), y(4), r.P, r.a, r.b, r.c, r.d);
+  }
+
+  void in_phase_space(const double* y, int D, unsigned char* mask) const {
+    for (int d = 0; d < D; d++)
+      mask[d] = in_phase_space(Eigen::Map<const Eigen::VectorXd>(y + 5L * d, 5));
+  }
+
+  void batch(const double* y, int D, complex::split_matrix& A,
+             Eigen::MatrixXd& A_bkg) const {
+    A.resize(2, D);
+    for (int d = 0; d < D; d++) {
+      A.re(0)[d] = 1.;
+      A.im(0)[d] = 0.;
+      A.re(1)[d] = y[5L * d];
+      A.im(1)[d] = y[5L * d + 2];
+    }
+    A_bkg.resize(0, D);
+  }
+
+  bool operator()(const Eigen::VectorXd& y, Eigen::VectorXd& A_re,
+                  Eigen::VectorXd& A_im, Eigen::VectorXd& A_bkg) const {
+    if (!in_phase_space(y))
+      return false;
+    A_re.resize(2);
+    A_im.resize(2);
+    A_re << 1., y(0);
+    A_im << 0., y(2);
+    A_bkg.resize(0);
+    return true;
+  }
+};
+
+
+int main() {
+  const resonances::resonance_base_4& r = MESON_DECA_PHASE_SPACE;
+  small_model model(r);
+
+  // Box of the invariants m2_12, m2_14, m2_23, m2_34, m2_13
+  const particle* pairs[5][2] = {
+    {&r.a, &r.b}, {&r.a, &r.d}, {&r.b, &r.c}, {&r.c, &r.d}, {&r.a, &r.c}};
+  double m_sum = r.a.m + r.b.m + r.c.m + r.d.m;
+  Eigen::VectorXd lower(5), upper(5);
+  for (int k = 0; k < 5; k++) {
+    double m_pair = pairs[k][0]->m + pairs[k][1]->m;
+    lower(k) = m_pair * m_pair;
+    upper(k) = (r.P.m - m_sum + m_pair) * (r.P.m - m_sum + m_pair);
+  }
+
+  integrate::normalization_integral I_box
+    = integrate::plain(model, integrate::box(lower, upper), 4000000, 1);
+  integrate::normalization_integral I_genbod
+    = integrate::phase_space(model, generate::make_phase_space(r), 2000000, 2);
+
+  double max_pull = 0;
+  for (int c = 0; c < 2; c++) {
+    for (int i = 0; i < 2; i++) {
+      for (int j = 0; j < 2; j++) {
+        double err = std::sqrt(I_box.I_error[c](i,j) * I_box.I_error[c](i,j)
+                               + I_genbod.I_error[c](i,j) * I_genbod.I_error[c](i,j));
+        double diff = std::fabs(I_box.I[c](i,j) - I_genbod.I[c](i,j));
+        if (err > 0)
+          max_pull = std::max(max_pull, diff / err);
+        else if (diff > 0)
+          max_pull = HUGE_VAL;
+      }
+    }
+  }
+
+  std::cout << "  volume: box " << I_box.I[0](0,0) << " +- " << I_box.I_error[0](0,0)
+            << ", GENBOD " << I_genbod.I[0](0,0) << " +- " << I_genbod.I_error[0](0,0)
+            << "\n  largest difference of I: " << max_pull << " standard deviations\n";
+  return max_pull < 4. ? 0 : 1;
+}
+
+#else
+
+int main() {
+  std::cout << "  skipped: the model defines no MESON_DECA_PHASE_SPACE\n";
+  return 0;
+}
+
+#endif
@@ -0,0 +1,120 @@
+// check_random_streams.cpp
+//   The Philox streams (lib/c_lib/rng): the known-answer vectors of
+//   Philox4x32-10 (Random123), the batched rng::uniform against
+//   rng::stream, and results that do not depend on the number of
+//   threads: integrate::plain and generate::accept_reject of a small
+//   model are bitwise the same with 1, 3 and 8 threads.
+
+#include <iostream>
+#include <vector>
+
+#include <meson_deca/lib/c_lib/generate.hpp>
+#include <meson_deca/lib/c_lib/integrate.hpp>
+#include <meson_deca/lib/c_lib/parallel.hpp>
+#include <meson_deca/lib/c_lib/rng.hpp>
+
+// A_0 = 1, A_1 = y_0 + i y_1 on the triangle y_0 + y_1 < 1 (the model
+// interface of integrate::plain, cf. tools::model_amplitudes)
+struct triangle_model {
+  int num_resonances() const { return 2; }
+  int num_background() const { return 0; }
+
+  bool in_phase_space(const Eigen::VectorXd& y) const {
+    return y(0) + y(1) < 1.;
+  }
+
+  void in_phase_space(const double* y, int D, unsigned char* mask) const {
+    for (int d = 0; d < D; d++)
+      mask[d] = y[2 * d] + y[2 * d + 1] < 1.;
+  }
+
+  void batch(const double* y, int D, complex::split_matrix& A,
+             Eigen::MatrixXd& A_bkg) const {
+    A.resize(2, D);
+    for (int d = 0; d < D; d++) {
+      A.re(0)[d] = 1.;
+      A.im(0)[d] = 0.;
+      A.re(1)[d] = y[2 * d];
+      A.im(1)[d] = y[2 * d + 1];
+    }
+    A_bkg.resize(0, D);
+  }
+
+  bool operator()(const Eigen::VectorXd& y, Eigen::VectorXd& A_re,
+                  Eigen::VectorXd& A_im, Eigen::VectorXd& A_bkg) const {
+    if (!in_phase_space(y))
+      return false;
+    A_re.resize(2);
+    A_im.resize(2);
+    A_re << 1., y(0);
+    A_im << 0., y(1);
+    A_bkg.resize(0);
+    return true;
+  }
+};
+
+
+int main() {
+  bool ok = true;
+
+  // Random123 known-answer tests of Philox4x32-10
+  const uint32_t kat[3][10] = {
+    {0, 0, 0, 0, 0, 0,
+     0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8},
+    {~0u, ~0u, ~0u, ~0u, ~0u, ~0u,
+     0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd},
+    {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344, 0xa4093822, 0x299f31d0,
+     0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}};
+  bool kat_ok = true;
+  for (int t = 0; t < 3; t++) {
+    rng::block b = rng::philox(kat[t][0], kat[t][1], kat[t][2], kat[t][3],
+                               kat[t][4], kat[t][5]);
+    for (int i = 0; i < 4; i++)
+      kat_ok = kat_ok && b.v[i] == kat[t][6 + i];
+  }
+  ok = ok && kat_ok;
+
+  // rng::uniform gives the numbers of rng::stream for every point
+  const uint64_t seed = 0x123456789abcdefULL;
+  const int n = 100, dim = 5;
+  std::vector<double> u(n * dim);
+  rng::uniform(seed, 1000, n, dim, &u[0], 2, rng::training);
+  bool stream_ok = true;
+  for (int p = 0; p < n; p++) {
+    rng::stream s(seed, 1000 + p, 2, rng::training);
+    for (int i = 0; i < dim; i++)
+      stream_ok = stream_ok && u[p * dim + i] == s.uniform();
+  }
+  ok = ok && stream_ok;
+
+  // Integrals and events with 1, 3 and 8 threads
+  triangle_model model;
+  integrate::box unit(Eigen::VectorXd::Zero(2), Eigen::VectorXd::Ones(2));
+  integrate::intensity_importance importance(
+    Eigen::VectorXd::Ones(2), Eigen::VectorXd::Zero(2), Eigen::VectorXd());
+  const int threads[3] = {1, 3, 8};
+  std::vector<integrate::normalization_integral> I;
+  std::vector<generate::event_sample> events;
+  for (int t = 0; t < 3; t++) {
+    parallel::set_num_threads(threads[t]);
+    I.push_back(integrate::plain(model, unit, 100000, 7));
+    events.push_back(generate::accept_reject(model, unit, importance, 5000, 3., 7));
+  }
+  bool threads_ok = true;
+  for (int t = 1; t < 3; t++) {
+    for (int c = 0; c < 2; c++)
+      threads_ok = threads_ok && (I[t].I[c].array() == I[0].I[c].array()).all()
+        && (I[t].I_error[c].array() == I[0].I_error[c].array()).all();
+    threads_ok = threads_ok && events[t].events.size() == events[0].events.size();
+    for (size_t e = 0; threads_ok && e < events[0].events.size(); e++)
+      threads_ok = (events[t].events[e].array() == events[0].events[e].array()).all();
+  }
+  ok = ok && threads_ok;
+
+  std::cout << "  known answers " << (kat_ok ? "ok" : "FAILED")
+            << ", uniform vs stream " << (stream_ok ? "ok" : "FAILED")
+            << ", 1/3/8 threads " << (threads_ok ? "identical" : "DIFFERENT")
+            << " (I[0](1,1) = " << I[0].I[0](1,1) << ", "
+            << events[0].events.size() << " events)\n";
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,60 @@
+// check_valid_mask.cpp
+//   The batched phase space checks fct::valid_mask and fct::valid_5d_mask
+//   against the scalar fct::valid and fct::valid_5d on random points of a
+//   box around the phase space of D -> 3 pi and D0 -> 4 pi. The number of
+//   points is odd, so the scalar tail after the SIMD lanes is used too.
+
+#include <iostream>
+#include <vector>
+
+#include <stan/math/rev/mat.hpp>
+#include <meson_deca/lib/c_lib/fct/valid_mask.hpp>
+#include <meson_deca/lib/c_lib/rng.hpp>
+#include <meson_deca/lib/c_lib/structures/particles.hpp>
+
+using particles::pi;
+
+
+int main() {
+  const int n = 1000003;
+
+  // D -> 3 pi: m2_ab, m2_bc in [0, 3.5]
+  std::vector<double> u(2 * n), m2_ab(n), m2_bc(n);
+  rng::uniform(1, 0, n, 2, &u[0]);
+  for (int k = 0; k < n; k++) {
+    m2_ab[k] = 3.5 * u[2 * k];
+    m2_bc[k] = 3.5 * u[2 * k + 1];
+  }
+  std::vector<unsigned char> mask(n);
+  fct::valid_mask(&m2_ab[0], &m2_bc[0], n, particles::d, pi, pi, pi, &mask[0]);
+  long mismatch_3 = 0, inside_3 = 0;
+  for (int k = 0; k < n; k++) {
+    bool scalar = fct::valid(m2_ab[k], m2_bc[k], particles::d, pi, pi, pi);
+    mismatch_3 += bool(mask[k]) != scalar;
+    inside_3 += scalar;
+  }
+
+  // D0 -> 4 pi: the five invariants in [4 m2_pi, (M - 2 m_pi)^2] (slightly
+  // enlarged, so that the lower bounds are checked as well)
+  const double lo = 0.05, hi = 2.6;
+  std::vector<double> v(5 * n);
+  std::vector<std::vector<double> > x(5, std::vector<double>(n));
+  rng::uniform(2, 0, n, 5, &v[0]);
+  for (int k = 0; k < n; k++)
+    for (int i = 0; i < 5; i++)
+      x[i][k] = lo + (hi - lo) * v[5 * k + i];
+  fct::valid_5d_mask(&x[0][0], &x[1][0], &x[2][0], &x[3][0], &x[4][0], n,
+                     particles::D0, pi, pi, pi, pi, &mask[0]);
+  long mismatch_5 = 0, inside_5 = 0;
+  for (int k = 0; k < n; k++) {
+    bool scalar = fct::valid_5d(x[0][k], x[1][k], x[2][k], x[3][k], x[4][k],
+                                particles::D0, pi, pi, pi, pi);
+    mismatch_5 += bool(mask[k]) != scalar;
+    inside_5 += scalar;
+  }
+
+  std::cout << "  " << n << " points: valid_mask " << mismatch_3
+            << " mismatches (" << inside_3 << " inside), valid_5d_mask "
+            << mismatch_5 << " mismatches (" << inside_5 << " inside)\n";
+  return mismatch_3 == 0 && mismatch_5 == 0 && inside_3 > 0 && inside_5 > 0 ? 0 : 1;
+}
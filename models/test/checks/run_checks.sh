@@ -0,0 +1,58 @@
+#!/bin/bash
+
+# run_checks.sh
+#   This script builds the deterministic checks check_*.cpp of this
+#   folder for the current lib/c_lib/model.hpp and runs them. A check
+#   prints what it compares and exits with a non-zero status if the
+#   comparison fails.
+#
+# USAGE
+#   run_checks.sh [CHECK...]
+#
+#   Runs all checks if no CHECK (e.g. check_phase_space) is given. CXX
+#   and ARCH are used as in build_tools.sh.
+
+
+###### FUNCTIONS
+function cdmeson_deca
+{
+  while [[ $PWD != '/' && ${PWD##*/} != 'meson_deca' ]]; do cd ..; done
+}
+
+###### MAIN
+# Define checks directory, meson_deca directory and CmdStan directory
+CHECKS_FOLDER=$(cd "$(dirname "$0")" && pwd)
+cd "$CHECKS_FOLDER"
+cdmeson_deca
+MESON_DECA=$(pwd)
+CMDSTAN=$(dirname "$MESON_DECA")
+
+CXX=${CXX:-clang++}
+ARCH=${ARCH:--march=native}
+FLAGS="-O3 -std=c++11 -pthread $ARCH"
+INCLUDES="-isystem $CMDSTAN/stan/lib/boost_1.55.0 -isystem $CMDSTAN/stan/lib/eigen_3.2.4 -I $CMDSTAN/stan/src -I $CMDSTAN"
+
+# Models with incoherent background define MESON_DECA_HAS_BACKGROUND
+if grep -q "^#define MESON_DECA_HAS_BACKGROUND" "$MESON_DECA/lib/c_lib/model.hpp"; then
+  FLAGS="$FLAGS -DMESON_DECA_BACKGROUND"
+fi
+
+CHECKS="$@"
+if [[ -z $CHECKS ]]; then
+  CHECKS=$(cd "$CHECKS_FOLDER" && ls check_*.cpp | sed "s@\.cpp@@")
+fi
+
+BUILD=$(mktemp -d)
+FAILED=0
+for CHECK in $CHECKS
+do
+  echo "#### MESON_DECA: $CHECK"
+  if ! $CXX $FLAGS $INCLUDES "$CHECKS_FOLDER/$CHECK.cpp" -o "$BUILD/$CHECK"; then
+    FAILED=1
+  elif ! "$BUILD/$CHECK"; then
+    echo "#### MESON_DECA: $CHECK FAILED"
+    FAILED=1
+  fi
+done
+rm -rf "$BUILD"
+exit $FAILED
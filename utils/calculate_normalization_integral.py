@@ -27,6 +27,10 @@
 #
 # CAVEAT. This script MUST be called from the folder containing the
 #    module model.so corresponding to the described model.
+#
+# SEE ALSO
+#    lib/c_lib/tools/normalization_integral.cpp - native, multithreaded
+#    version with the same arguments (build it with build_tools.sh).
 
 import argparse
 import numpy as np
@@ -50,7 +54,7 @@ parser = argparse.ArgumentParser(description='Script to calculate the integral l
 # y1min, y1max, ... yRmin, yRmax
 N = model.num_variables()
 R = model.num_resonances()
-B = model.num_background()
+B = model.num_background() if hasattr(model, 'num_background') else 0
 parser.add_argument('bounds',
                     nargs=2*N,
                     required=True,
@@ -61,31 +65,43 @@ parser.add_argument('--background',
                     type=int,
                     help="Flag: check for background amplitudes.")
 
+parser.add_argument('--threads',
+                    default=None,
+                    type=int,
+                    help="number of threads (default: all cores, or MESON_DECA_NUM_THREADS).")
+
+parser.add_argument('--seed',
+                    default=1,
+                    type=int,
+                    help="random seed; the points are those of the native normalization_integral with the same seed.")
+
 args = parser.parse_args()
+convert.SetNumThreads(model, args.threads)
 
 I = np.zeros([R,R], dtype=complex)
 
-# Complex vector containing all PWA amplitudes
+# Complex vectors containing all PWA amplitudes of a batch of points
+# (array of shape (n, N)), evaluated on all threads
 def func(y):
-    return convert.ComplexVectorForm(model.A_cv(N, y))
+    return convert.AmplitudesBatch(model, y)
 
 
 # Repack the integration bounds
 bounds = [[args.bounds[2*n], args.bounds[2*n+1]] for n in range(N)]
 
 # Calculate the integral matrix
-I = mcint.integral_A(func, bounds, N=1000000)
+I = mcint.integral_A_batch(func, bounds, N=1000000, seed=args.seed)
 
 # If necessary, calculate background amplitude normalization
-if args.bounds == 1:
+if args.background == 1 and B > 0:
     def func_backgr(y):
-        return convert.VectorForm(model.A_v_background_abs2(B, y))
+        return convert.BackgroundBatch(model, y)
     I_background = np.zeros(B, dtype=float)
-    I_background = mcint.integral(func_backgr, bounds, N=1000000)
+    I_background = mcint.integral_batch(func_backgr, bounds, N=1000000, seed=args.seed)
 
 
 f_py = open('normalization_integral.py', 'w')
 f_py.write('I_ = ' + save.array_to_string(I[0]) + '\n')
-if args.bounds == 1:
+if args.background == 1 and B > 0:
     f_py.write('I_background_ = ' + save.array_to_string(I_background[0]) + '\n')
 f_py.close()
@@ -0,0 +1,89 @@
+#!/usr/bin/env python
+# compare_benchmarks.py
+
+# NAME
+#    compare_benchmarks.py - compare two runs of the native benchmark tool
+#
+# SYNOPSIS
+#    ./compare_benchmarks.py BASELINE NEW [OPTIONS...]
+#
+# DESCRIPTION
+#    compare_benchmarks.py reads two output files of
+#    lib/c_lib/tools/benchmark.cpp (one JSON object per line) and prints,
+#    for every (kernel, type, region) measured in both, the time,
+#    allocations and tape bytes per event of NEW relative to BASELINE.
+#    Times that changed by more than --threshold are marked with '<'
+#    (faster) or '>' (slower).
+
+import argparse
+import json
+
+
+# Parse the arguments
+parser = argparse.ArgumentParser(description='Script to compare two benchmark runs.')
+
+parser.add_argument('baseline',
+                    type=argparse.FileType('r'),
+                    help="Output file of the baseline run.")
+
+parser.add_argument('new',
+                    type=argparse.FileType('r'),
+                    help="Output file of the new run.")
+
+parser.add_argument('--threshold',
+                    default=0.05,
+                    type=float,
+                    help="Relative change of the time to mark (default: 0.05).")
+
+args = parser.parse_args()
+
+
+def read_results(f):
+    """
+    Returns the header of the run and its results, keyed by
+    (kernel, type, region), in the order of the file.
+    """
+    header = {}
+    results = []
+    for line in f:
+        line = line.strip()
+        if not line.startswith('{'):
+            continue
+        entry = json.loads(line)
+        if 'benchmark' in entry:
+            header = entry
+        else:
+            results.append(((entry['kernel'], entry['type'], entry['region']), entry))
+    return header, results
+
+
+def ratio(new, old):
+    if old == 0:
+        return '-' if new == 0 else 'inf'
+    return '{0:.3f}'.format(new / old)
+
+
+header_old, results_old = read_results(args.baseline)
+header_new, results_new = read_results(args.new)
+old = dict(results_old)
+
+for name in ['num_variables', 'num_resonances', 'events', 'batch']:
+    if header_old.get(name) != header_new.get(name):
+        print('Warning: compare_benchmarks.py: {0} differs ({1} vs {2}).'.format(
+            name, header_old.get(name), header_new.get(name)))
+
+print('{0:<20} {1:<7} {2:<8} {3:>12} {4:>12} {5:>8} {6:>8} {7:>8}'.format(
+    'kernel', 'type', 'region', 'ns (old)', 'ns (new)', 'time', 'allocs', 'tape'))
+for key, new in results_new:
+    if key not in old:
+        continue
+    o = old[key]
+    change = new['ns_per_event'] / o['ns_per_event'] - 1 if o['ns_per_event'] > 0 else 0
+    mark = ''
+    if abs(change) > args.threshold:
+        mark = '<' if change < 0 else '>'
+    print('{0:<20} {1:<7} {2:<8} {3:>12.4g} {4:>12.4g} {5:>8} {6:>8} {7:>8} {8}'.format(
+        key[0], key[1], key[2], o['ns_per_event'], new['ns_per_event'],
+        ratio(new['ns_per_event'], o['ns_per_event']),
+        ratio(new['allocs_per_event'], o['allocs_per_event']),
+        ratio(new['tape_bytes_per_event'], o['tape_bytes_per_event']), mark))
@@ -29,6 +29,11 @@
 #    Takes the ROOT file f_in ('generated_data.root' by default),
 #    saves results in f_out ('STAN_amplitude_fitting.data.R' by default).
 #
+#    With --binary, the amplitudes are written to the memory-mapped file
+#    'amplitudes.mdamp' (read by amplitude_file_log_likelihood, see
+#    lib/c_lib/data.hpp) instead of the R dump; needs the native tool
+#    'amplitudes' (build_tools.sh amplitudes).
+#
 # CAVEAT
 #    MUST be called from the model folder containing the .root file
 #    and where the output file will be saved.
@@ -36,6 +41,7 @@
 import argparse
 import numpy as np
 import os
+import subprocess
 import sys
 
 MODEL_FOLDER = os.getcwdu()
@@ -64,6 +70,10 @@ parser.add_argument('f_out',
 )
 
 
+parser.add_argument('--binary',
+                    action='store_true',
+                    help='write the amplitudes to amplitudes.mdamp, not to f_out')
+
 args = parser.parse_args()
 
 # User must know what's happening!
@@ -97,11 +107,33 @@ for d in range(D_):
     y_data_[:,d] = y
 
 
-# Evaluate A_cv_ at y_data_
-A_cv_data_ = np.asarray([convert.MatrixForm(model.A_cv(model.num_variables(), y_data_[:,d].tolist())) for d in range(D_)])
-
-# Evaluate A_v_background_abs2_data_ at y_data_
-A_v_background_abs2_data_ = np.asarray([convert.VectorForm(model.A_v_background_abs2(model.num_background(), y_data_[:,d].tolist())) for d in range(D_)])
+if os.path.isfile(MODEL_FOLDER + '/amplitudes'):
+    # Native tool (build_tools.sh amplitudes): multithreaded, and cached
+    # in the folder 'cache' as long as neither the model nor the events
+    # change (see lib/c_lib/tools/amplitudes.cpp)
+    R_ = model.num_resonances()
+    B_ = model.num_background() if hasattr(model, 'num_background') else 0
+    np.ascontiguousarray(y_data_.T, dtype=np.float64).tofile('y_data.bin')
+    subprocess.check_call([MODEL_FOLDER + '/amplitudes', 'y_data.bin',
+                           '--cache', 'cache', '--output', 'amplitudes.bin']
+                          + (['--amplitude-file', 'amplitudes.mdamp'] if args.binary else []))
+    A_ = np.fromfile('amplitudes.bin', dtype=np.float64)
+    A_cv_data_ = A_[:D_*2*R_].reshape(D_, 2, R_)
+    A_v_background_abs2_data_ = A_[D_*2*R_:].reshape(D_, B_)
+elif args.binary:
+    sys.exit("data_analysis__root_to_dataR.py: --binary needs the native tool 'amplitudes'.")
+else:
+    # Evaluate A_cv_ at y_data_, all events in one call of the batch
+    # function A_cv_batch (numpy buffers, shape (D, R)) on all cores
+    convert.SetNumThreads(model)
+    A_batch_ = convert.AmplitudesBatch(model, y_data_.T)
+    A_cv_data_ = np.stack([A_batch_.real, A_batch_.imag], axis=1)
+
+    # Evaluate A_v_background_abs2_data_ at y_data_
+    if hasattr(model, 'num_background'):
+        A_v_background_abs2_data_ = convert.BackgroundBatch(model, y_data_.T)
+    else:
+        A_v_background_abs2_data_ = np.zeros((D_, 0))
 
 # Define the integrals for the normalization function
 # Usually these integrals can be generated by calling
@@ -130,6 +162,11 @@ if 'I_background_' in locals():
 else:
     data = dict(D = D_, y_data = y_data_, A_cv_data = A_cv_data_, I = I_out_)
 
+# The amplitudes are in amplitudes.mdamp
+if args.binary:
+    data.pop('A_cv_data')
+    data.pop('A_v_background_abs2_data', None)
+
 stan_rdump(data, MODEL_FOLDER + '/' + args.f_out.name)
 print("data_analysis__root_to_dataR.py: Done. Data dumped in {0}.".format(args.f_out.name))
 